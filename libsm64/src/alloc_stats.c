@@ -0,0 +1,66 @@
+#include "alloc_stats.h"
+
+#include <stdlib.h>
+
+// Marios can allocate from several threads in sm64_mario_tick_many
+#ifdef _MSC_VER
+    #include <intrin.h>
+    #define ATOMIC_ADD( ptr, value ) _InterlockedExchangeAdd64( (volatile long long *)(ptr), (long long)(value) )
+    #define ATOMIC_LOAD( ptr ) _InterlockedOr64( (volatile long long *)(ptr), 0 )
+    #define ATOMIC_STORE( ptr, value ) _InterlockedExchange64( (volatile long long *)(ptr), (long long)(value) )
+#else
+    #define ATOMIC_ADD( ptr, value ) __atomic_fetch_add( (ptr), (value), __ATOMIC_RELAXED )
+    #define ATOMIC_LOAD( ptr ) __atomic_load_n( (ptr), __ATOMIC_RELAXED )
+    #define ATOMIC_STORE( ptr, value ) __atomic_store_n( (ptr), (value), __ATOMIC_RELAXED )
+#endif
+
+static uint64_t s_alloc_count = 0;
+static uint64_t s_free_count = 0;
+static uint64_t s_allocated_bytes = 0;
+
+static void count_alloc( size_t size )
+{
+    ATOMIC_ADD( &s_alloc_count, 1 );
+    ATOMIC_ADD( &s_allocated_bytes, (uint64_t)size );
+}
+
+void *counted_malloc( size_t size )
+{
+    count_alloc( size );
+    return malloc( size );
+}
+
+void *counted_calloc( size_t count, size_t size )
+{
+    count_alloc( count * size );
+    return calloc( count, size );
+}
+
+void *counted_realloc( void *ptr, size_t size )
+{
+    count_alloc( size );
+    return realloc( ptr, size );
+}
+
+void counted_free( void *ptr )
+{
+    if( ptr == NULL )
+        return;
+
+    ATOMIC_ADD( &s_free_count, 1 );
+    free( ptr );
+}
+
+void alloc_stats_get( struct SM64AllocStats *outStats )
+{
+    outStats->allocCount = ATOMIC_LOAD( &s_alloc_count );
+    outStats->freeCount = ATOMIC_LOAD( &s_free_count );
+    outStats->allocatedBytes = ATOMIC_LOAD( &s_allocated_bytes );
+}
+
+void alloc_stats_reset( void )
+{
+    ATOMIC_STORE( &s_alloc_count, 0 );
+    ATOMIC_STORE( &s_free_count, 0 );
+    ATOMIC_STORE( &s_allocated_bytes, 0 );
+}
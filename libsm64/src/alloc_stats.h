@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "libsm64.h"
+
+// Heap wrappers that feed sm64_get_alloc_stats. Used by the pools that live as long
+// as the Marios and surfaces, so that per-tick heap traffic shows up in the counters.
+extern void *counted_malloc( size_t size );
+extern void *counted_calloc( size_t count, size_t size );
+extern void *counted_realloc( void *ptr, size_t size );
+extern void counted_free( void *ptr );
+
+extern void alloc_stats_get( struct SM64AllocStats *outStats );
+extern void alloc_stats_reset( void );
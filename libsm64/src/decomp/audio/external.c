@@ -1,3 +1,4 @@
+#include <pthread.h>
 #include <ultra64.h>
 #include <sm64.h>
 #include "heap.h"
@@ -804,13 +805,18 @@ void create_next_audio_buffer(s16 *samples, u32 num_samples) {
 #endif
 #endif
 
+// libsm64: Marios ticked by sm64_mario_tick_many queue sounds from worker threads
+static pthread_mutex_t sSoundRequestMutex = PTHREAD_MUTEX_INITIALIZER;
+
 /**
  * Called from threads: thread5_game_loop
  */
 void play_sound(s32 soundBits, f32 *pos) {
+    pthread_mutex_lock(&sSoundRequestMutex);
     sSoundRequests[sSoundRequestCount].soundBits = soundBits;
     sSoundRequests[sSoundRequestCount].position = pos;
     sSoundRequestCount++;
+    pthread_mutex_unlock(&sSoundRequestMutex);
 	//DEBUG_PRINT("play_sound(%d) request#%d; pos %f %f %f\n", soundBits,sSoundRequestCount,pos[0],pos[1],pos[2]);
 }
 
@@ -346,10 +346,10 @@ struct GraphNodeCullingRadius
     u8 pad1E[2];
 };
 
-extern struct GraphNodeMasterList *gCurGraphNodeMasterList;
-extern struct GraphNodePerspective *gCurGraphNodeCamFrustum;
-extern struct GraphNodeCamera *gCurGraphNodeCamera;
-extern struct GraphNodeHeldObject *gCurGraphNodeHeldObject;
+extern SM64_THREAD_LOCAL struct GraphNodeMasterList *gCurGraphNodeMasterList;
+extern SM64_THREAD_LOCAL struct GraphNodePerspective *gCurGraphNodeCamFrustum;
+extern SM64_THREAD_LOCAL struct GraphNodeCamera *gCurGraphNodeCamera;
+extern SM64_THREAD_LOCAL struct GraphNodeHeldObject *gCurGraphNodeHeldObject;
 
 extern struct GraphNode *gCurRootGraphNode;
 extern struct GraphNode *gCurGraphNodeList[];
@@ -1441,8 +1441,8 @@ s16 gArctanTable[0x401] = {
 
 // Variables for a spline curve animation (used for the flight path in the grand star cutscene)
 Vec4s *gSplineKeyframe;
-float gSplineKeyframeFraction;
-int gSplineState;
+SM64_THREAD_LOCAL float gSplineKeyframeFraction;
+SM64_THREAD_LOCAL int gSplineState;
 
 // These functions have bogus return values.
 // Disable the compiler warning.
@@ -2,150 +2,174 @@
 #include "surface_collision.h"
 #include "../include/surface_terrains.h"
 #include "../../load_surfaces.h"
+#include "../../surface_partition.h"
+#include "../../surface_soa.h"
 
 /**
- * Iterate through the list of ceilings and find the first ceiling over a given point.
+ * libsm64: Floors and ceilings come from either the spatial partition cell containing the
+ * point and the list of oversized surfaces, or from every loaded surface group whose
+ * bounds contain the point when the partition is disabled. Every list only holds valid
+ * surfaces of the right class, sorted by group and index, so both paths give
+ * bit-identical results. The partition's two lists interleave, of two equal heights the
+ * one a scan in group/index order would have met first wins.
  */
-static struct Surface *find_ceil_from_list( s32 x, s32 y, s32 z, f32 *pheight) {
-    register struct Surface *surf;
-    register s32 x1, z1, x2, z2, x3, z3;
-    struct Surface *ceil = NULL;
-
-    ceil = NULL;
-
-    uint32_t groupCount = loaded_surface_iter_group_count();
-    for( int i = 0; i < groupCount; ++i ) {
-    uint32_t surfCount = loaded_surface_iter_group_size( i );
-    for( int j = 0; j < surfCount; ++j ) {
-        surf = loaded_surface_iter_get_at_index( i, j );
+static bool group_contains_xz(const struct SurfaceGroup *group, s32 x, s32 z, s32 margin) {
+    return x >= group->minX - margin && x <= group->maxX + margin
+        && z >= group->minZ - margin && z <= group->maxZ + margin;
+}
 
-        // libsm64: Weed out surfaces whose triangles are actually line segs. TODO do this at surface load time
-        if( !surf->isValid ) continue;
+static bool pick_second(const struct SurfaceSoA *first, s32 firstIndex, f32 firstHeight,
+                        const struct SurfaceSoA *second, s32 secondIndex, f32 secondHeight, bool lowest) {
+    if (secondIndex < 0) {
+        return FALSE;
+    }
+    if (firstIndex < 0) {
+        return TRUE;
+    }
+    if (secondHeight != firstHeight) {
+        return lowest ? secondHeight < firstHeight : secondHeight > firstHeight;
+    }
+    return second->orders[secondIndex] < first->orders[firstIndex];
+}
 
-        // Do the check normally done in add_surface_to_cell
-        if( surf->normal.y >= -0.01f ) continue;
+static struct Surface *find_surface_from_lists(s32 x, s32 y, s32 z, f32 *pheight, enum SurfacePartitionClass surfClass) {
+    bool lowest = surfClass == SURFACE_PARTITION_CEILS;
+    int32_t (*find)(const struct SurfaceSoA *, s32, s32, s32, f32 *) = lowest ? surface_soa_find_ceil : surface_soa_find_floor;
 
-        x1 = surf->vertex1[0];
-        z1 = surf->vertex1[2];
-        z2 = surf->vertex2[2];
-        x2 = surf->vertex2[0];
+    if (surface_partition_is_enabled()) {
+        const struct SurfaceSoA *cell, *large;
+        f32 cellHeight = *pheight;
+        f32 largeHeight = *pheight;
+        s32 cellIndex, largeIndex;
 
-        // Checking if point is in bounds of the triangle laterally.
-        if ((z1 - z) * (x2 - x1) - (x1 - x) * (z2 - z1) > 0) {
-            continue;
-        }
+        surface_partition_query(x, z, surfClass, &cell, &large);
+        cellIndex = cell != NULL ? find(cell, x, y, z, &cellHeight) : -1;
+        largeIndex = find(large, x, y, z, &largeHeight);
 
-        // Slight optimization by checking these later.
-        x3 = surf->vertex3[0];
-        z3 = surf->vertex3[2];
-        if ((z2 - z) * (x3 - x2) - (x2 - x) * (z3 - z2) > 0) {
-            continue;
+        if (pick_second(cell, cellIndex, cellHeight, large, largeIndex, largeHeight, lowest)) {
+            *pheight = largeHeight;
+            return large->surfaces[largeIndex];
         }
-        if ((z3 - z) * (x1 - x3) - (x3 - x) * (z1 - z3) > 0) {
-            continue;
+        if (cellIndex >= 0) {
+            *pheight = cellHeight;
+            return cell->surfaces[cellIndex];
         }
+        return NULL;
+    }
 
-        {
-            f32 nx = surf->normal.x;
-            f32 ny = surf->normal.y;
-            f32 nz = surf->normal.z;
-            f32 oo = surf->originOffset;
-            f32 height;
-
-            // If a wall, ignore it. Likely a remnant, should never occur.
-            if (ny == 0.0f) {
-                continue;
-            }
-
-            // Find the ceil height at the specific point.
-            height = -(x * nx + nz * z + oo) / ny;
+    // Groups come in order, a later one only wins with a strictly better height
+    struct Surface *result = NULL;
+    uint32_t groupCount = loaded_surface_group_count();
+    for (uint32_t i = 0; i < groupCount; i++) {
+        const struct SurfaceGroup *group = loaded_surface_group(i);
+        const struct SurfaceSoA *list = &group->lists[surfClass];
+        s32 index;
 
-            // Checks for ceiling interaction with a 78 unit buffer.
-            //! (Exposed Ceilings) Because any point above a ceiling counts
-            //  as interacting with a ceiling, ceilings far below can cause
-            // "invisible walls" that are really just exposed ceilings.
-            if (y - (height - -78.0f) > 0.0f) {
-                continue;
-            }
+        // A point outside the group's bounds is outside all of its triangles
+        if (list->count == 0 || !group_contains_xz(group, x, z, 0)) {
+            continue;
+        }
 
-            if( height < *pheight )
-            {
-                *pheight = height;
-                ceil = surf;
-            }
+        index = find(list, x, y, z, pheight);
+        if (index >= 0) {
+            result = list->surfaces[index];
         }
-    }}
-    return ceil;
+    }
+    return result;
+}
+
+/**
+ * Iterate through the list of ceilings and find the first ceiling over a given point.
+ */
+static struct Surface *find_ceil_from_list( s32 x, s32 y, s32 z, f32 *pheight) {
+    // libsm64: The point-in-triangle tests and the 78 unit buffer check live in surface_soa.c
+    return find_surface_from_lists(x, y, z, pheight, SURFACE_PARTITION_CEILS);
 }
 
 /**
  * Iterate through the list of floors and find the first floor under a given point.
  */
 static struct Surface *find_floor_from_list( s32 x, s32 y, s32 z, f32 *pheight) {
-    register struct Surface *surf;
-    register s32 x1, z1, x2, z2, x3, z3;
-    f32 nx, ny, nz;
-    f32 oo;
-    f32 height;
-    struct Surface *floor = NULL;
-
-    uint32_t groupCount = loaded_surface_iter_group_count();
-    for( int i = 0; i < groupCount; ++i ) {
-    uint32_t surfCount = loaded_surface_iter_group_size( i );
-    for( int j = 0; j < surfCount; ++j ) {
-        surf = loaded_surface_iter_get_at_index( i, j );
-
-        // libsm64: Weed out surfaces whose triangles are actually line segs. TODO do this at surface load time
-        if( !surf->isValid ) continue;
-
-        // Do the check normally done in add_surface_to_cell
-        if( surf->normal.y <= 0.01f ) continue;
-
-        x1 = surf->vertex1[0];
-        z1 = surf->vertex1[2];
-        x2 = surf->vertex2[0];
-        z2 = surf->vertex2[2];
-
-        // Check that the point is within the triangle bounds.
-        if ((z1 - z) * (x2 - x1) - (x1 - x) * (z2 - z1) < 0) {
-            continue;
-        }
+    // libsm64: The point-in-triangle tests and the 78 unit buffer check live in surface_soa.c
+    return find_surface_from_lists(x, y, z, pheight, SURFACE_PARTITION_FLOORS);
+}
 
-        // To slightly save on computation time, set this later.
-        x3 = surf->vertex3[0];
-        z3 = surf->vertex3[2];
+/**
+ * libsm64: Walls in group/index order, from the partition cell merged with the oversized
+ * walls or from every group whose bounds are near the point. The cursors skip walls that
+ * fail the y range or plane distance tests below by more than a unit.
+ */
+struct WallIterator {
+    bool usePartition;
+
+    // Partition cell, merged with the list of oversized walls
+    struct SurfaceSoAWallCursor cell;
+    struct SurfaceSoAWallCursor large;
+
+    // Linear scan over the groups
+    struct SurfaceSoAWallCursor list;
+    uint32_t groupIndex;
+    uint32_t groupCount;
+
+    f32 x, y, z, radius;
+};
+
+static void wall_iter_begin(struct WallIterator *it, f32 x, f32 y, f32 z, f32 radius) {
+    it->usePartition = surface_partition_is_enabled();
+
+    if (it->usePartition) {
+        const struct SurfaceSoA *cell, *large;
+
+        surface_partition_query((s32) x, (s32) z, SURFACE_PARTITION_WALLS, &cell, &large);
+        surface_soa_wall_cursor_begin(&it->cell, cell, x, y, z, radius);
+        surface_soa_wall_cursor_begin(&it->large, large, x, y, z, radius);
+    } else {
+        surface_soa_wall_cursor_begin(&it->list, NULL, x, y, z, radius);
+        it->groupIndex = 0;
+        it->groupCount = loaded_surface_group_count();
+        it->x = x;
+        it->y = y;
+        it->z = z;
+        it->radius = radius;
+    }
+}
 
-        if ((z2 - z) * (x3 - x2) - (x2 - x) * (z3 - z2) < 0) {
-            continue;
+static struct Surface *wall_iter_next(struct WallIterator *it) {
+    s32 index;
+
+    if (it->usePartition) {
+        s32 cellIndex = surface_soa_wall_cursor_peek(&it->cell);
+        s32 largeIndex = surface_soa_wall_cursor_peek(&it->large);
+
+        if (cellIndex >= 0 && (largeIndex < 0 || it->cell.list->orders[cellIndex] < it->large.list->orders[largeIndex])) {
+            surface_soa_wall_cursor_pop(&it->cell);
+            return it->cell.list->surfaces[cellIndex];
         }
-        if ((z3 - z) * (x1 - x3) - (x3 - x) * (z1 - z3) < 0) {
-            continue;
+        if (largeIndex >= 0) {
+            surface_soa_wall_cursor_pop(&it->large);
+            return it->large.list->surfaces[largeIndex];
         }
+        return NULL;
+    }
 
-        nx = surf->normal.x;
-        ny = surf->normal.y;
-        nz = surf->normal.z;
-        oo = surf->originOffset;
+    while ((index = surface_soa_wall_cursor_peek(&it->list)) < 0) {
+        const struct SurfaceGroup *group;
 
-        // If a wall, ignore it. Likely a remnant, should never occur.
-        if (ny == 0.0f) {
-            continue;
+        if (it->groupIndex >= it->groupCount) {
+            return NULL;
         }
+        group = loaded_surface_group(it->groupIndex++);
 
-        // Find the height of the floor at a given location.
-        height = -(x * nx + nz * z + oo) / ny;
-        // Checks for floor interaction with a 78 unit buffer.
-        if (y - (height + -78.0f) < 0.0f) {
-            continue;
+        // Same reach as the partition gives walls, and the y range every wall's lowerY/upperY
+        // check below would reject
+        if (group_contains_xz(group, (s32) it->x, (s32) it->z, SURFACE_PARTITION_WALL_MARGIN)
+            && it->y >= group->minY - 5 && it->y <= group->maxY + 5) {
+            surface_soa_wall_cursor_begin(&it->list, &group->lists[SURFACE_PARTITION_WALLS], it->x, it->y, it->z, it->radius);
         }
+    }
 
-        if( height > *pheight )
-        {
-            *pheight = height;
-            floor = surf;
-        }
-    }}
-    return floor;
+    surface_soa_wall_cursor_pop(&it->list);
+    return it->list.list->surfaces[index];
 }
 
 static s32 find_wall_collisions_from_list( struct WallCollisionData *data) {
@@ -159,27 +183,16 @@ static s32 find_wall_collisions_from_list( struct WallCollisionData *data) {
     register f32 w1, w2, w3;
     register f32 y1, y2, y3;
     s32 numCols = 0;
+    struct WallIterator it;
 
     // Max collision radius = 200
     if (radius > 200.0f) {
         radius = 200.0f;
     }
 
-    uint32_t groupCount = loaded_surface_iter_group_count();
-    for( int i = 0; i < groupCount; ++i ) {
-    uint32_t surfCount = loaded_surface_iter_group_size( i );
-    for( int j = 0; j < surfCount; ++j ) {
-        surf = loaded_surface_iter_get_at_index( i, j );
-
-        // libsm64: Weed out surfaces whose triangles are actually line segs. TODO do this at surface load time
-        if( !surf->isValid ) continue;
-
-        // Do the check normally done in add_surface_to_cell
-        if( surf->normal.y < -0.01f || surf->normal.y > 0.01f ) continue;
-
-        if( surf->normal.x < -0.707f || surf->normal.x > 0.707f ) {
-            surf->flags |= SURFACE_FLAG_X_PROJECTION;
-        }
+    // libsm64: The walls come pre-filtered, invalid surfaces were dropped at load time
+    wall_iter_begin(&it, x, y, z, radius);
+    while ((surf = wall_iter_next(&it)) != NULL) {
 
         // Exclude a large number of walls immediately to optimize.
         if (y < surf->lowerY || y > surf->upperY) {
@@ -263,7 +276,7 @@ static s32 find_wall_collisions_from_list( struct WallCollisionData *data) {
         }
 
         numCols++;
-    }}
+    }
 
     return numCols;
 }
@@ -317,7 +330,7 @@ f32 find_ceil(f32 posX, f32 posY, f32 posZ, struct Surface **pceil)
 	return height;
 }
 
-struct FloorGeometry sFloorGeo;
+SM64_THREAD_LOCAL struct FloorGeometry sFloorGeo;
 
 f32 find_floor_height_and_data(f32 xPos, f32 yPos, f32 zPos, struct FloorGeometry **floorGeo)
 {
@@ -77,9 +77,9 @@ static u32 sBackwardKnockbackActions[][3] = {
     { ACT_BACKWARD_WATER_KB,       ACT_BACKWARD_WATER_KB,  ACT_BACKWARD_WATER_KB },
 };
 
-static u8 sDisplayingDoorText = FALSE;
-static u8 sJustTeleported = FALSE;
-static u8 sPssSlideStarted = FALSE;
+static SM64_THREAD_LOCAL u8 sDisplayingDoorText = FALSE;
+static SM64_THREAD_LOCAL u8 sJustTeleported = FALSE;
+static SM64_THREAD_LOCAL u8 sPssSlideStarted = FALSE;
 
 /**
  * Returns the type of cap Mario is wearing.
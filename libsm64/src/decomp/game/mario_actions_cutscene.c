@@ -58,13 +58,13 @@
 // TODO: put this elsewhere
 enum SaveOption { SAVE_OPT_SAVE_AND_CONTINUE = 1, SAVE_OPT_SAVE_AND_QUIT, SAVE_OPT_CONTINUE_DONT_SAVE };
 
-static struct Object *sIntroWarpPipeObj;
-static struct Object *sEndPeachObj;
+static SM64_THREAD_LOCAL struct Object *sIntroWarpPipeObj;
+static SM64_THREAD_LOCAL struct Object *sEndPeachObj;
 //static struct Object *sEndRightToadObj;
 //static struct Object *sEndLeftToadObj;
 //static struct Object *sEndJumboStarObj;
 static UNUSED s32 sUnused;
-static s16 sEndPeachAnimation;
+static SM64_THREAD_LOCAL s16 sEndPeachAnimation;
 //static s16 sEndToadAnims[2];
 
 static Vp sEndCutsceneVp = { { { 640, 480, 511, 0 }, { 640, 480, 511, 0 } } };
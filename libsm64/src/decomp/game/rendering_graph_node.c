@@ -21,7 +21,7 @@
 // PATCH
 static Vec3s gVec3sZero = { 0, 0, 0 };
 static Vec3f gVec3fZero = { 0, 0, 0 };
-static Gfx *gDisplayListHead;
+static SM64_THREAD_LOCAL Gfx *gDisplayListHead;
 #define USE_SYSTEM_MALLOC
 
 
@@ -51,9 +51,9 @@ static Gfx *gDisplayListHead;
  *
  */
 
-s16 gMatStackIndex;
-Mat4 gMatStack[32];
-Mtx *gMatStackFixed[32];
+SM64_THREAD_LOCAL s16 gMatStackIndex;
+SM64_THREAD_LOCAL Mat4 gMatStack[32];
+SM64_THREAD_LOCAL Mtx *gMatStackFixed[32];
 
 /**
  * Animation nodes have state in global variables, so this struct captures
@@ -71,16 +71,16 @@ struct GeoAnimState {
 
 // For some reason, this is a GeoAnimState struct, but the current state consists
 // of separate global variables. It won't match EU otherwise.
-struct GeoAnimState gGeoTempState;
+SM64_THREAD_LOCAL struct GeoAnimState gGeoTempState;
 
-u8 gCurAnimType;
-u8 gCurAnimEnabled;
-s16 gCurrAnimFrame;
-f32 gCurAnimTranslationMultiplier;
-u16 *gCurrAnimAttribute;
-s16 *gCurAnimData;
+SM64_THREAD_LOCAL u8 gCurAnimType;
+SM64_THREAD_LOCAL u8 gCurAnimEnabled;
+SM64_THREAD_LOCAL s16 gCurrAnimFrame;
+SM64_THREAD_LOCAL f32 gCurAnimTranslationMultiplier;
+SM64_THREAD_LOCAL u16 *gCurrAnimAttribute;
+SM64_THREAD_LOCAL s16 *gCurAnimData;
 
-struct AllocOnlyPool *gDisplayListHeap;
+SM64_THREAD_LOCAL struct AllocOnlyPool *gDisplayListHeap;
 
 struct RenderModeContainer {
     u32 modes[8];
@@ -132,12 +132,12 @@ struct RenderModeContainer renderModeTable_2Cycle[2] = { { {
     G_RM_AA_ZB_XLU_INTER2,
     } } };
 
-struct GraphNodeRoot *gCurGraphNodeRoot = NULL;
-struct GraphNodeMasterList *gCurGraphNodeMasterList = NULL;
-struct GraphNodePerspective *gCurGraphNodeCamFrustum = NULL;
-struct GraphNodeCamera *gCurGraphNodeCamera = NULL;
-struct GraphNodeObject *gCurGraphNodeObject = NULL;
-struct GraphNodeHeldObject *gCurGraphNodeHeldObject = NULL;
+SM64_THREAD_LOCAL struct GraphNodeRoot *gCurGraphNodeRoot = NULL;
+SM64_THREAD_LOCAL struct GraphNodeMasterList *gCurGraphNodeMasterList = NULL;
+SM64_THREAD_LOCAL struct GraphNodePerspective *gCurGraphNodeCamFrustum = NULL;
+SM64_THREAD_LOCAL struct GraphNodeCamera *gCurGraphNodeCamera = NULL;
+SM64_THREAD_LOCAL struct GraphNodeObject *gCurGraphNodeObject = NULL;
+SM64_THREAD_LOCAL struct GraphNodeHeldObject *gCurGraphNodeHeldObject = NULL;
 
 #ifdef F3DEX_GBI_2
 LookAt lookAt;
@@ -1126,7 +1126,8 @@ void geo_process_root_hack_single_node(struct GraphNode *node)
 
     Mtx *initialMatrix;
 
-    gDisplayListHeap = alloc_only_pool_init();
+    // libsm64: display list nodes go into the display list pool as well, it was reset above
+    gDisplayListHeap = display_list_pool();
     initialMatrix = alloc_display_list(sizeof(*initialMatrix));
     gMatStackIndex = 0;
     gCurAnimType = 0;
@@ -1161,5 +1162,5 @@ void geo_process_root_hack_single_node(struct GraphNode *node)
 
     gMarioObject->header.gfx.throwMatrix = NULL;
 
-    alloc_only_pool_free(gDisplayListHeap);
+    gDisplayListHeap = NULL;
 }
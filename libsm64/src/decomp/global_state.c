@@ -3,11 +3,13 @@
 #include <stdlib.h>
 #include <string.h>
 
-struct GlobalState *g_state = 0;
+#include "../alloc_stats.h"
+
+SM64_THREAD_LOCAL struct GlobalState *g_state = 0;
 
 struct GlobalState *global_state_create(void)
 {
-	struct GlobalState *state = malloc( sizeof( struct GlobalState ));
+	struct GlobalState *state = counted_malloc( sizeof( struct GlobalState ));
 	memset( state, 0, sizeof( struct GlobalState ));
 	state->msSwimStrength = MIN_SWIM_STRENGTH;
 	return state;
@@ -20,5 +22,5 @@ void global_state_bind(struct GlobalState *state)
 
 void global_state_delete(struct GlobalState *state)
 {
-	free( state );
+	counted_free( state );
 }
\ No newline at end of file
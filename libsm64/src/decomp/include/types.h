@@ -19,6 +19,14 @@
     #define BAD_RETURN(cmd) cmd
 #endif
 
+// libsm64: Marios can be ticked from several threads at once (sm64_mario_tick_many),
+// so the bound global state and the scratch globals of the decomp are per thread.
+#ifdef _MSC_VER
+    #define SM64_THREAD_LOCAL __declspec(thread)
+#else
+    #define SM64_THREAD_LOCAL __thread
+#endif
+
 
 struct Controller
 {
@@ -2,58 +2,107 @@
 #include <stdbool.h>
 
 #include "memory.h"
+#include "../sm64_context.h"
+#include "../alloc_stats.h"
 
-// TODO don't handle every individual allocation with malloc, it sucks on windows
+// libsm64: the pool is a bump allocator over a chain of blocks. Resetting it keeps the
+// blocks around, so a pool that is reset every tick stops touching the heap once it
+// has grown to the size of one tick's allocations.
 
-struct AllocOnlyPool 
+#define ALLOC_ONLY_POOL_BLOCK_SIZE 0x4000
+#define ALLOC_ONLY_POOL_ALIGN 16
+#define ALIGN_UP( x ) (((x) + ALLOC_ONLY_POOL_ALIGN - 1) & ~(size_t)(ALLOC_ONLY_POOL_ALIGN - 1))
+
+struct AllocOnlyBlock
 {
-    size_t allocatedCount;
-    void **allocatedBlocks;
+    struct AllocOnlyBlock *next;
+    size_t size;
+    size_t used;
 };
 
-struct AllocOnlyPool *s_display_list_pool;
+#define BLOCK_DATA( block ) ((u8 *)(block) + ALIGN_UP( sizeof( struct AllocOnlyBlock )))
 
-void memory_init(void)
+struct AllocOnlyPool 
 {
-    s_display_list_pool = alloc_only_pool_init();
-}
+    struct AllocOnlyBlock *firstBlock;
+    struct AllocOnlyBlock *currentBlock;
+};
 
-void memory_terminate(void)
+struct AllocOnlyPool *alloc_only_pool_init(void)
 {
-    alloc_only_pool_free( s_display_list_pool );
+    struct AllocOnlyPool *newPool = counted_malloc( sizeof( struct AllocOnlyPool ));
+    newPool->firstBlock = NULL;
+    newPool->currentBlock = NULL;
+    return newPool;
 }
 
-struct AllocOnlyPool *alloc_only_pool_init(void)
+static struct AllocOnlyBlock *alloc_block( size_t minSize )
 {
-    struct AllocOnlyPool *newPool = malloc( sizeof( struct AllocOnlyPool ));
-    newPool->allocatedCount = 0;
-    newPool->allocatedBlocks = NULL;
-    return newPool;
+    size_t size = minSize > ALLOC_ONLY_POOL_BLOCK_SIZE ? minSize : ALLOC_ONLY_POOL_BLOCK_SIZE;
+    struct AllocOnlyBlock *block = counted_malloc( ALIGN_UP( sizeof( struct AllocOnlyBlock )) + size );
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
 }
 
 void *alloc_only_pool_alloc(struct AllocOnlyPool *pool, s32 size)
 {
-    pool->allocatedCount++;
-    pool->allocatedBlocks = realloc( pool->allocatedBlocks, pool->allocatedCount * sizeof( void * ));
-    pool->allocatedBlocks[ pool->allocatedCount - 1 ] = malloc( size );
-    return pool->allocatedBlocks[ pool->allocatedCount - 1 ];
+    size_t alignedSize = ALIGN_UP( (size_t)size );
+    struct AllocOnlyBlock *block = pool->currentBlock;
+
+    // Move on to the next block with enough room, blocks left over from before a reset are reused
+    while( block == NULL || block->used + alignedSize > block->size )
+    {
+        if( block == NULL )
+        {
+            if( pool->firstBlock == NULL )
+                pool->firstBlock = alloc_block( alignedSize );
+            block = pool->firstBlock;
+            continue;
+        }
+
+        if( block->next == NULL )
+            block->next = alloc_block( alignedSize );
+        block = block->next;
+    }
+
+    pool->currentBlock = block;
+    void *result = BLOCK_DATA( block ) + block->used;
+    block->used += alignedSize;
+    return result;
+}
+
+void alloc_only_pool_reset(struct AllocOnlyPool *pool)
+{
+    for( struct AllocOnlyBlock *block = pool->firstBlock; block != NULL; block = block->next )
+        block->used = 0;
+    pool->currentBlock = pool->firstBlock;
 }
 
 void alloc_only_pool_free(struct AllocOnlyPool *pool)
 {
-    for( int i = 0; i < pool->allocatedCount; ++i )
-        free( pool->allocatedBlocks[i] );
-    free( pool->allocatedBlocks );
-    free( pool );
+    struct AllocOnlyBlock *block = pool->firstBlock;
+    while( block != NULL )
+    {
+        struct AllocOnlyBlock *next = block->next;
+        counted_free( block );
+        block = next;
+    }
+    counted_free( pool );
 }
 
 void display_list_pool_reset(void)
 {
-    alloc_only_pool_free( s_display_list_pool );
-    s_display_list_pool = alloc_only_pool_init();
+    alloc_only_pool_reset( context_current()->displayListPool );
+}
+
+struct AllocOnlyPool *display_list_pool(void)
+{
+    return context_current()->displayListPool;
 }
 
 void *alloc_display_list(u32 size)
 {
-    return alloc_only_pool_alloc( s_display_list_pool, (s32)size );
-}
\ No newline at end of file
+    return alloc_only_pool_alloc( context_current()->displayListPool, (s32)size );
+}
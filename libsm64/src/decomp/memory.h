@@ -4,12 +4,11 @@
 
 struct AllocOnlyPool;
 
-extern void memory_init(void);
-extern void memory_terminate(void);
-
 extern struct AllocOnlyPool *alloc_only_pool_init(void);
 extern void *alloc_only_pool_alloc(struct AllocOnlyPool *pool, s32 size);
+extern void alloc_only_pool_reset(struct AllocOnlyPool *pool);
 extern void alloc_only_pool_free(struct AllocOnlyPool *pool);
 
 extern void display_list_pool_reset(void);
+extern struct AllocOnlyPool *display_list_pool(void);
 extern void *alloc_display_list(u32 size);
\ No newline at end of file
@@ -8,20 +8,20 @@
 #include "gfx_adapter_commands.h"
 #include "load_tex_data.h"
 
-static Mat4 s_curMatrix;
-static float s_curColor[3];
+static SM64_THREAD_LOCAL Mat4 s_curMatrix;
+static SM64_THREAD_LOCAL float s_curColor[3];
 
-static uint16_t s_scaleS, s_scaleT, s_uls, s_ult;
-static int s_textureOn, s_textureIndex;
-static float s_texWidth;
-static float s_texHeight;
+static SM64_THREAD_LOCAL uint16_t s_scaleS, s_scaleT, s_uls, s_ult;
+static SM64_THREAD_LOCAL int s_textureOn, s_textureIndex;
+static SM64_THREAD_LOCAL float s_texWidth;
+static SM64_THREAD_LOCAL float s_texHeight;
 
-static struct SM64MarioGeometryBuffers *s_outBuffers;
+static SM64_THREAD_LOCAL struct SM64MarioGeometryBuffers *s_outBuffers;
 
-static float *s_trianglePtr;
-static float *s_colorPtr;
-static float *s_normalPtr;
-static float *s_uvPtr;
+static SM64_THREAD_LOCAL float *s_trianglePtr;
+static SM64_THREAD_LOCAL float *s_colorPtr;
+static SM64_THREAD_LOCAL float *s_normalPtr;
+static SM64_THREAD_LOCAL float *s_uvPtr;
 
 static void mtxf_mul_vec3f_x(Mat4 mtx, Vec3f b, float w, Vec3f out)
 {
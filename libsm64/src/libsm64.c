@@ -36,6 +36,10 @@
 #include "load_tex_data.h"
 #include "obj_pool.h"
 #include "fake_interaction.h"
+#include "sm64_context.h"
+#include "worker_pool.h"
+#include "alloc_stats.h"
+#include "mario_snapshot.h"
 #include "decomp/pc/audio/audio_null.h"
 #include "decomp/pc/audio/audio_wasapi.h"
 #include "decomp/pc/audio/audio_pulse.h"
@@ -47,18 +51,29 @@
 #include "decomp/tools/convUtils.h"
 #include "decomp/mario/geo.inc.h"
 
-static struct AllocOnlyPool *s_mario_geo_pool = NULL;
-static struct GraphNode *s_mario_graph_node = NULL;
 static struct AudioAPI *audio_api;
+static struct WorkerPool *s_worker_pool = NULL;
 
 static bool s_init_global = false;
-static bool s_init_one_mario = false;
+static bool s_headless = false;
 
 struct MarioInstance
 {
     struct GlobalState *globalState;
 };
-struct ObjPool s_mario_instance_pool = { 0, 0 };
+
+// Per-context state, see sm64_context.h
+#define s_mario_instance_pool (context_current()->marioInstancePool)
+#define s_mario_geo_pool      (context_current()->marioGeoPool)
+#define s_mario_graph_node    (context_current()->marioGraphNode)
+
+static struct MarioInstance *get_mario_instance( int32_t marioId )
+{
+    if( marioId < 0 || marioId >= s_mario_instance_pool.size )
+        return NULL;
+
+    return s_mario_instance_pool.objects[ marioId ];
+}
 
 static void update_button( bool on, u16 button )
 {
@@ -95,10 +110,41 @@ static void free_area( struct Area *area )
     free( area );
 }
 
+// Surfaces can be loaded before sm64_global_init, they go into the default context it then keeps
+static void ensure_default_context( void )
+{
+    if( g_default_context == NULL )
+        g_default_context = context_create();
+}
+
 pthread_t gSoundThread;
 SM64_LIB_FN void sm64_global_init( uint8_t *rom, uint8_t *outTexture, SM64DebugPrintFunctionPtr debugPrintFunction )
+{
+    sm64_global_init_ex( rom, outTexture, debugPrintFunction, 0 );
+}
+
+SM64_LIB_FN void sm64_global_init_ex( uint8_t *rom, uint8_t *outTexture, SM64DebugPrintFunctionPtr debugPrintFunction, uint32_t flags )
 {
 	g_debug_print_func = debugPrintFunction;
+
+    if( s_init_global )
+        sm64_global_terminate();
+
+    s_init_global = true;
+    s_headless = (flags & SM64_INIT_HEADLESS) != 0;
+
+    if( outTexture != NULL )
+        load_mario_textures_from_rom( rom, outTexture );
+    load_mario_anims_from_rom( rom );
+
+    ensure_default_context();
+
+    // Nobody listens on a headless instance, don't load the sound banks or start the audio thread
+    if( s_headless )
+    {
+        DEBUG_PRINT("Headless, audio disabled");
+        return;
+    }
 	
 	uint8_t* rom2 = malloc(0x800000);
 	memcpy(rom2, rom, 0x800000);
@@ -112,16 +158,6 @@ SM64_LIB_FN void sm64_global_init( uint8_t *rom, uint8_t *outTexture, SM64DebugP
 	ptrs_to_offsets(gSoundDataADSR);
 	
 	DEBUG_PRINT("ADSR: %p, raw: %p, bs: %p, seq: %p", gSoundDataADSR, gSoundDataRaw, gBankSetsData, gMusicData);
-
-    if( s_init_global )
-        sm64_global_terminate();
-
-    s_init_global = true;
-
-    load_mario_textures_from_rom( rom, outTexture );
-    load_mario_anims_from_rom( rom );
-
-    memory_init();
 	
 	#if defined(HAVE_WASAPI) && !defined(SM64_NULL_AUDIO)
 	if (audio_api == NULL && audio_wasapi.init()) {
@@ -162,32 +198,76 @@ SM64_LIB_FN void sm64_global_terminate( void )
 {
     if( !s_init_global ) return;
 
-	audio_api = NULL;
-	pthread_cancel(gSoundThread);
+	if( !s_headless )
+	{
+		audio_api = NULL;
+		pthread_cancel(gSoundThread);
+	}
 
-    global_state_bind( NULL );
-    
-    if( s_init_one_mario )
-    {
-        for( int i = 0; i < s_mario_instance_pool.size; ++i )
-            if( s_mario_instance_pool.objects[i] != NULL )
-                sm64_mario_delete( i );
+    worker_pool_delete( s_worker_pool );
+    s_worker_pool = NULL;
 
-        obj_pool_free_all( &s_mario_instance_pool );
-    }
+    context_bind( NULL );
+    sm64_context_delete( g_default_context );
+    g_default_context = NULL;
+
+    global_state_bind( NULL );
 
     s_init_global = false;
-    s_init_one_mario = false;
 	   
-	ctl_free();
-    alloc_only_pool_free( s_mario_geo_pool );
-    surfaces_unload_all();
+	if( !s_headless )
+		ctl_free();
+    s_headless = false;
     unload_mario_anims();
-    memory_terminate();
+}
+
+SM64_LIB_FN struct SM64Context *sm64_context_create( void )
+{
+    return context_create();
+}
+
+SM64_LIB_FN void sm64_context_delete( struct SM64Context *context )
+{
+    if( context == NULL )
+        return;
+
+    struct SM64Context *prevContext = g_bound_context;
+    context_bind( context );
+
+    for( int i = 0; i < s_mario_instance_pool.size; ++i )
+        if( s_mario_instance_pool.objects[i] != NULL )
+            sm64_mario_delete( i );
+
+    surfaces_unload_all();
+
+    context_bind( prevContext == context ? NULL : prevContext );
+    context_delete( context );
+}
+
+SM64_LIB_FN void sm64_context_bind( struct SM64Context *context )
+{
+    context_bind( context );
+}
+
+SM64_LIB_FN void sm64_get_alloc_stats( struct SM64AllocStats *outStats )
+{
+    alloc_stats_get( outStats );
+}
+
+SM64_LIB_FN void sm64_reset_alloc_stats( void )
+{
+    alloc_stats_reset();
+}
+
+SM64_LIB_FN void sm64_set_worker_count( uint32_t workerCount )
+{
+    worker_pool_delete( s_worker_pool );
+    s_worker_pool = workerCount > 0 ? worker_pool_create( workerCount ) : NULL;
 }
 
 SM64_LIB_FN void sm64_static_surfaces_load( const struct SM64Surface *surfaceArray, uint32_t numSurfaces )
 {
+    ensure_default_context();
     surfaces_load_static( surfaceArray, numSurfaces );
 }
 
@@ -199,9 +279,8 @@ SM64_LIB_FN int32_t sm64_mario_create( float x, float y, float z, int16_t rx, in
     newInstance->globalState = global_state_create();
     global_state_bind( newInstance->globalState );
 
-    if( !s_init_one_mario )
+    if( s_mario_graph_node == NULL )
     {
-        s_init_one_mario = true;
         s_mario_geo_pool = alloc_only_pool_init();
         s_mario_graph_node = process_geo_layout( s_mario_geo_pool, mario_geo_ptr );
     }
@@ -289,17 +368,10 @@ SM64_LIB_FN void sm64_mario_anim_tick( int32_t marioId, uint32_t stateFlags, str
 }
 
 
-SM64_LIB_FN void sm64_mario_tick( int32_t marioId, const struct SM64MarioInputs *inputs, struct SM64MarioState *outState, struct SM64MarioGeometryBuffers *outBuffers )
+// Advances the bound Mario by one frame. Only touches the Mario's own GlobalState
+// and reads the surfaces, so different Marios can run this in parallel.
+static void mario_tick_physics( const struct SM64MarioInputs *inputs )
 {
-    if( marioId >= s_mario_instance_pool.size || s_mario_instance_pool.objects[marioId] == NULL )
-    {
-        DEBUG_PRINT("Tried to tick non-existant Mario with ID: %u", marioId);
-        return;
-    }
-
-	struct GlobalState *state = ((struct MarioInstance *)s_mario_instance_pool.objects[ marioId ])->globalState;
-    global_state_bind( state );
-
     update_button( inputs->buttonA, A_BUTTON );
     update_button( inputs->buttonB, B_BUTTON );
     update_button( inputs->buttonZ, Z_TRIG );
@@ -317,13 +389,43 @@ SM64_LIB_FN void sm64_mario_tick( int32_t marioId, const struct SM64MarioInputs
 	apply_mario_platform_displacement();
     bhv_mario_update();
     update_mario_platform(); // TODO platform grabbed here and used next tick could be a use-after-free
+}
 
+// Runs the Mario graph node of the bound context, which also advances the animation.
+// The graph node is shared by all Marios of a context, so this has to run serially.
+static void mario_tick_geometry( struct SM64MarioGeometryBuffers *outBuffers )
+{
     gfx_adapter_bind_output_buffers( outBuffers );
 
     geo_process_root_hack_single_node( s_mario_graph_node );
 
     gAreaUpdateCounter++;
+}
+
+// Stand-in for mario_tick_geometry when no geometry is requested. Only does the parts of
+// the graph node processing that the simulation depends on, so it's safe to run in parallel.
+static void mario_tick_animation( void )
+{
+    struct AnimInfo *animInfo = &gMarioObject->header.gfx.animInfo;
+    if( animInfo->curAnim != NULL )
+    {
+        // The action code checks animation frames, see geo_set_animation_globals
+        animInfo->animFrame = geo_update_animation_frame( animInfo, &animInfo->animFrameAccelAssist );
+        animInfo->animTimer = gAreaUpdateCounter;
+    }
+
+    // Normally counted down by geo_mario_hand_foot_scaler
+    struct MarioBodyState *bodyState = gMarioState->marioBodyState;
+    if( (bodyState->punchState & 0x3F) > 0 )
+        bodyState->punchState -= 1;
+
+    gMarioObject->header.gfx.throwMatrix = NULL;
+
+    gAreaUpdateCounter++;
+}
 
+static void mario_write_state( struct SM64MarioState *outState )
+{
     outState->health = gMarioState->health;
     vec3f_copy( outState->position, gMarioState->pos );
     vec3f_copy( outState->velocity, gMarioState->vel );
@@ -334,6 +436,88 @@ SM64_LIB_FN void sm64_mario_tick( int32_t marioId, const struct SM64MarioInputs
 	outState->invincTimer = gMarioState->invincTimer;
 }
 
+SM64_LIB_FN void sm64_mario_tick( int32_t marioId, const struct SM64MarioInputs *inputs, struct SM64MarioState *outState, struct SM64MarioGeometryBuffers *outBuffers )
+{
+    struct MarioInstance *instance = get_mario_instance( marioId );
+    if( instance == NULL )
+    {
+        DEBUG_PRINT("Tried to tick non-existant Mario with ID: %u", marioId);
+        return;
+    }
+
+    global_state_bind( instance->globalState );
+
+    mario_tick_physics( inputs );
+    if( outBuffers != NULL )
+        mario_tick_geometry( outBuffers );
+    else
+        mario_tick_animation();
+    mario_write_state( outState );
+}
+
+struct TickManyJob
+{
+    struct SM64Context *context;
+    const int32_t *marioIds;
+    const struct SM64MarioInputs *inputs;
+    struct SM64MarioState *outStates;
+    bool physicsOnly;
+};
+
+static void tick_many_physics_job( void *userData, uint32_t index )
+{
+    struct TickManyJob *job = userData;
+
+    context_bind( job->context );
+
+    struct MarioInstance *instance = get_mario_instance( job->marioIds[index] );
+    if( instance == NULL )
+        return;
+
+    global_state_bind( instance->globalState );
+    mario_tick_physics( &job->inputs[index] );
+
+    if( job->physicsOnly )
+    {
+        mario_tick_animation();
+        mario_write_state( &job->outStates[index] );
+    }
+}
+
+SM64_LIB_FN void sm64_mario_tick_many( uint32_t count, const int32_t *marioIds, const struct SM64MarioInputs *inputs, struct SM64MarioState *outStates, struct SM64MarioGeometryBuffers *outBuffers )
+{
+    struct SM64Context *prevContext = g_bound_context;
+
+    struct TickManyJob job;
+    job.context = context_current();
+    job.marioIds = marioIds;
+    job.inputs = inputs;
+    job.outStates = outStates;
+    job.physicsOnly = outBuffers == NULL;
+
+    // Marios of one context only share read-only data while simulating, spread them over the workers
+    worker_pool_run( s_worker_pool, count, tick_many_physics_job, &job );
+
+    context_bind( prevContext );
+
+    if( job.physicsOnly )
+        return;
+
+    for( uint32_t i = 0; i < count; ++i )
+    {
+        struct MarioInstance *instance = get_mario_instance( marioIds[i] );
+        if( instance == NULL )
+        {
+            DEBUG_PRINT("Tried to tick non-existant Mario with ID: %d", marioIds[i]);
+            continue;
+        }
+
+        global_state_bind( instance->globalState );
+        mario_tick_geometry( &outBuffers[i] );
+        mario_write_state( &outStates[i] );
+    }
+}
+
 SM64_LIB_FN void sm64_mario_delete( int32_t marioId )
 {
     if( marioId >= s_mario_instance_pool.size || s_mario_instance_pool.objects[marioId] == NULL )
@@ -352,6 +536,46 @@ SM64_LIB_FN void sm64_mario_delete( int32_t marioId )
     obj_pool_free_index( &s_mario_instance_pool, marioId );
 }
 
+SM64_LIB_FN uint32_t sm64_mario_snapshot_size( void )
+{
+    return mario_snapshot_size();
+}
+
+SM64_LIB_FN bool sm64_mario_snapshot( int32_t marioId, void *outBuffer, uint32_t bufferSize )
+{
+    struct MarioInstance *instance = get_mario_instance( marioId );
+    if( instance == NULL )
+    {
+        DEBUG_PRINT("Tried to snapshot non-existant Mario with ID: %d", marioId);
+        return false;
+    }
+
+    if( bufferSize < mario_snapshot_size() )
+        return false;
+
+    global_state_bind( instance->globalState );
+    mario_snapshot_save( outBuffer );
+    return true;
+}
+
+SM64_LIB_FN bool sm64_mario_restore( int32_t marioId, const void *buffer, uint32_t bufferSize, struct SM64MarioState *outState )
+{
+    struct MarioInstance *instance = get_mario_instance( marioId );
+    if( instance == NULL )
+    {
+        DEBUG_PRINT("Tried to restore non-existant Mario with ID: %d", marioId);
+        return false;
+    }
+
+    global_state_bind( instance->globalState );
+    if( !mario_snapshot_restore( buffer, bufferSize ))
+        return false;
+
+    if( outState != NULL )
+        mario_write_state( outState );
+    return true;
+}
+
 SM64_LIB_FN void sm64_set_mario_position(int32_t marioId, float x, float y, float z)
 {
 	if( marioId >= s_mario_instance_pool.size || s_mario_instance_pool.objects[marioId] == NULL )
@@ -684,6 +908,7 @@ SM64_LIB_FN bool sm64_mario_attack(int32_t marioId, float x, float y, float z, f
 
 SM64_LIB_FN uint32_t sm64_surface_object_create( const struct SM64SurfaceObject *surfaceObject )
 {
+    ensure_default_context();
     uint32_t id = surfaces_load_object( surfaceObject );
     return id;
 }
@@ -711,26 +936,31 @@ SM64_LIB_FN void sm64_surface_object_delete( uint32_t objectId )
 
 SM64_LIB_FN void sm64_seq_player_play_sequence(uint8_t player, uint8_t seqId, uint16_t arg2)
 {
+    if( s_headless ) return;
     seq_player_play_sequence(player,seqId,arg2);
 }
 
 SM64_LIB_FN void sm64_play_music(uint8_t player, uint16_t seqArgs, uint16_t fadeTimer)
 {
+    if( s_headless ) return;
     play_music(player,seqArgs,fadeTimer);
 }
 
 SM64_LIB_FN void sm64_stop_background_music(uint16_t seqId)
 {
+    if( s_headless ) return;
     stop_background_music(seqId);
 }
 
 SM64_LIB_FN void sm64_fadeout_background_music(uint16_t arg0, uint16_t fadeOut)
 {
+    if( s_headless ) return;
     fadeout_background_music(arg0,fadeOut);
 }
 
 SM64_LIB_FN uint16_t sm64_get_current_background_music()
 {
+    if( s_headless ) return 0;
     return get_current_background_music();
 }
 
@@ -16,6 +16,15 @@
     #define SM64_LIB_FN
 #endif
 
+struct SM64Context;
+
+struct SM64AllocStats
+{
+    uint64_t allocCount;
+    uint64_t freeCount;
+    uint64_t allocatedBytes;
+};
+
 struct SM64Surface
 {
     int16_t type;
@@ -115,17 +124,49 @@ enum
     SM64_GEO_MAX_TRIANGLES = 1024,
 };
 
+enum
+{
+    SM64_INIT_HEADLESS = 1 << 0,
+};
+
 extern SM64_LIB_FN void sm64_global_init( uint8_t *rom, uint8_t *outTexture, SM64DebugPrintFunctionPtr debugPrintFunction );
+// Headless skips the sound banks and the audio thread, music calls are ignored. outTexture may be NULL.
+extern SM64_LIB_FN void sm64_global_init_ex( uint8_t *rom, uint8_t *outTexture, SM64DebugPrintFunctionPtr debugPrintFunction, uint32_t flags );
 extern SM64_LIB_FN void sm64_global_terminate( void );
 
 extern SM64_LIB_FN void sm64_static_surfaces_load( const struct SM64Surface *surfaceArray, uint32_t numSurfaces );
 
 extern SM64_LIB_FN int32_t sm64_mario_create( float x, float y, float z, int16_t rx, int16_t ry, int16_t rz, uint8_t fake );
+// Pass NULL outBuffers to only run the simulation, Mario's animation still advances
 extern SM64_LIB_FN void sm64_mario_tick( int32_t marioId, const struct SM64MarioInputs *inputs, struct SM64MarioState *outState, struct SM64MarioGeometryBuffers *outBuffers );
 extern SM64_LIB_FN struct SM64AnimInfo* sm64_mario_get_anim_info( int32_t marioId, int16_t rot[3] );
 extern SM64_LIB_FN void sm64_mario_anim_tick( int32_t marioId, uint32_t stateFlags, struct SM64AnimInfo* animInfo, struct SM64MarioGeometryBuffers *outBuffers, int16_t rot[3] );
 extern SM64_LIB_FN void sm64_mario_delete( int32_t marioId );
 
+// Snapshots hold everything a Mario's simulation depends on, restoring one into any Mario of
+// the same build continues exactly where the snapshot was taken. Restore returns false and
+// leaves the Mario untouched if the buffer wasn't written by sm64_mario_snapshot.
+extern SM64_LIB_FN uint32_t sm64_mario_snapshot_size( void );
+extern SM64_LIB_FN bool sm64_mario_snapshot( int32_t marioId, void *outBuffer, uint32_t bufferSize );
+extern SM64_LIB_FN bool sm64_mario_restore( int32_t marioId, const void *buffer, uint32_t bufferSize, struct SM64MarioState *outState );
+
+// A context owns a set of surfaces and Marios. Calls operate on the context bound on the
+// calling thread, or on the default one when none is bound. Passing NULL to
+// sm64_context_bind rebinds the default context.
+extern SM64_LIB_FN struct SM64Context *sm64_context_create( void );
+extern SM64_LIB_FN void sm64_context_delete( struct SM64Context *context );
+extern SM64_LIB_FN void sm64_context_bind( struct SM64Context *context );
+
+// Heap allocations made by the surface, Mario and display list pools since the last reset.
+// Ticking Marios that were already ticked once should not change these.
+extern SM64_LIB_FN void sm64_get_alloc_stats( struct SM64AllocStats *outStats );
+extern SM64_LIB_FN void sm64_reset_alloc_stats( void );
+
+// Number of extra threads sm64_mario_tick_many spreads the Mario physics over, 0 ticks serially.
+extern SM64_LIB_FN void sm64_set_worker_count( uint32_t workerCount );
+// With NULL outBuffers the whole tick runs on the workers
+extern SM64_LIB_FN void sm64_mario_tick_many( uint32_t count, const int32_t *marioIds, const struct SM64MarioInputs *inputs, struct SM64MarioState *outStates, struct SM64MarioGeometryBuffers *outBuffers );
+
 extern SM64_LIB_FN void sm64_set_mario_action(int32_t marioId, uint32_t action);
 extern SM64_LIB_FN void sm64_set_mario_action_arg(int32_t marioId, uint32_t action, uint32_t actionArg);
 extern SM64_LIB_FN void sm64_set_mario_animation(int32_t marioId, int32_t animID);
@@ -88,6 +88,11 @@ void load_mario_animation(struct MarioAnimation *a, u32 index)
     }
 }
 
+uint32_t get_mario_animation_count( void )
+{
+    return s_num_entries;
+}
+
 void unload_mario_anims( void )
 {
     for( int i = 0; i < s_num_entries; ++i )
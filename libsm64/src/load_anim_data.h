@@ -7,4 +7,5 @@
 
 extern void load_mario_animation(struct MarioAnimation *a, u32 index);
 extern void load_mario_anims_from_rom( uint8_t *rom );
+extern uint32_t get_mario_animation_count( void );
 extern void unload_mario_anims( void );
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <math.h>
 
 #include "decomp/include/types.h"
@@ -10,23 +11,38 @@
 #include "decomp/shim.h"
 
 #include "debug_print.h"
+#include "surface_partition.h"
+#include "sm64_context.h"
+#include "alloc_stats.h"
 
 struct LoadedSurfaceObject
 {
     struct SurfaceObjectTransform *transform;
     uint32_t surfaceCount;
+    // Unloaded objects keep their buffers for the next object loaded into the slot
+    uint32_t surfaceCapacity;
     struct SM64Surface *libSurfaces;
     struct Surface *engineSurfaces;
+    struct SurfaceGroup group;
 };
 
-static uint32_t s_static_surface_count = 0;
-static struct Surface *s_static_surface_list = NULL;
-
-static uint32_t s_surface_object_count = 0;
-static struct LoadedSurfaceObject *s_surface_object_list = NULL;
+// The surfaces of the bound context
+#define s_static_surface_count (context_current()->staticSurfaceCount)
+#define s_static_surface_list  (context_current()->staticSurfaceList)
+#define s_static_surface_group (context_current()->staticSurfaceGroup)
+#define s_surface_object_count    (context_current()->surfaceObjectCount)
+#define s_surface_object_capacity (context_current()->surfaceObjectCapacity)
+#define s_surface_object_list     (context_current()->surfaceObjectList)
+#define s_free_object_count       (context_current()->freeSurfaceObjectCount)
+#define s_free_objects            (context_current()->freeSurfaceObjects)
 
 #define CONVERT_ANGLE( x ) ((s16)( -(x) / 180.0f * 32768.0f ))
 
+static uint64_t surface_order( uint32_t groupIndex, uint32_t surfaceIndex )
+{
+    return ((uint64_t)groupIndex << 32) | surfaceIndex;
+}
+
 static void init_transform( struct SurfaceObjectTransform *out, const struct SM64ObjectTransform *in )
 {
     out->aVelX = 0.0f;
@@ -194,6 +210,11 @@ static void engine_surface_from_lib_surface( struct Surface *surface, const stru
     s16 hasForce = surface_has_force(type);
     s16 flags = 0; // surf_has_no_cam_collision(type);
 
+    // libsm64: Set once here rather than on every wall query, so queries never write to
+    // surfaces and can run on several threads at once.
+    if( ny >= -0.01f && ny <= 0.01f && ( nx < -0.707f || nx > 0.707f ))
+        flags |= SURFACE_FLAG_X_PROJECTION;
+
     surface->room = 0;
     surface->type = type;
     surface->flags = (s8) flags;
@@ -208,74 +229,139 @@ static void engine_surface_from_lib_surface( struct Surface *surface, const stru
     surface->isValid = 1;
 }
 
-uint32_t loaded_surface_iter_group_count( void )
+static void group_reset( struct SurfaceGroup *group )
 {
-    return 1 + s_surface_object_count;
+    for( int i = 0; i < SURFACE_PARTITION_CLASS_COUNT; ++i )
+        group->lists[i].count = 0;
+
+    group->minX = group->minY = group->minZ = INT_MAX;
+    group->maxX = group->maxY = group->maxZ = INT_MIN;
 }
 
-uint32_t loaded_surface_iter_group_size( uint32_t groupIndex )
+static void group_free( struct SurfaceGroup *group )
 {
-    if( groupIndex == 0 )
-        return s_static_surface_count;
+    for( int i = 0; i < SURFACE_PARTITION_CLASS_COUNT; ++i )
+        surface_soa_free( &group->lists[i] );
+
+    group_reset( group );
+}
+
+static void group_extend( s32 *min, s32 *max, s32 a, s32 b, s32 c )
+{
+    if( a < *min ) *min = a;
+    if( b < *min ) *min = b;
+    if( c < *min ) *min = c;
+    if( a > *max ) *max = a;
+    if( b > *max ) *max = b;
+    if( c > *max ) *max = c;
+}
+
+// Surfaces have to be added in index order
+static void group_add( struct SurfaceGroup *group, struct Surface *surface, uint64_t order )
+{
+    enum SurfacePartitionClass surfClass;
+    if( !surface_partition_classify( surface, &surfClass ))
+        return;
+
+    struct SurfaceSoA *list = &group->lists[surfClass];
+    surface_soa_insert( list, list->count, surface, order );
 
-    return s_surface_object_list[ groupIndex - 1 ].surfaceCount;
+    group_extend( &group->minX, &group->maxX, surface->vertex1[0], surface->vertex2[0], surface->vertex3[0] );
+    group_extend( &group->minY, &group->maxY, surface->vertex1[1], surface->vertex2[1], surface->vertex3[1] );
+    group_extend( &group->minZ, &group->maxZ, surface->vertex1[2], surface->vertex2[2], surface->vertex3[2] );
 }
 
-struct Surface *loaded_surface_iter_get_at_index( uint32_t groupIndex, uint32_t surfaceIndex )
+uint32_t loaded_surface_group_count( void )
+{
+    return 1 + s_surface_object_count;
+}
+
+const struct SurfaceGroup *loaded_surface_group( uint32_t groupIndex )
 {
     if( groupIndex == 0 )
-        return &s_static_surface_list[ surfaceIndex ];
+        return &s_static_surface_group;
 
-    return &s_surface_object_list[ groupIndex - 1 ].engineSurfaces[ surfaceIndex ];
+    return &s_surface_object_list[ groupIndex - 1 ].group;
 }
 
 void surfaces_load_static( const struct SM64Surface *surfaceArray, uint32_t numSurfaces )
 {
     if( s_static_surface_list != NULL )
-        free( s_static_surface_list );
+    {
+        for( int i = 0; i < s_static_surface_count; ++i )
+            surface_partition_remove( &s_static_surface_list[i], surface_order( 0, i ));
+        counted_free( s_static_surface_list );
+    }
 
-    s_static_surface_count = numSurfaces;
-    s_static_surface_list = malloc( sizeof( struct Surface ) * numSurfaces );
+    s_static_surface_list = counted_malloc( sizeof( struct Surface ) * numSurfaces );
+    group_reset( &s_static_surface_group );
 
+    // Degenerate triangles are dropped here, queries never see them
+    uint32_t count = 0;
     for( int i = 0; i < numSurfaces; ++i )
-        engine_surface_from_lib_surface( &s_static_surface_list[i], &surfaceArray[i], NULL );
+    {
+        struct Surface *surface = &s_static_surface_list[count];
+        engine_surface_from_lib_surface( surface, &surfaceArray[i], NULL );
+        if( !surface->isValid )
+            continue;
+
+        group_add( &s_static_surface_group, surface, surface_order( 0, count ));
+        surface_partition_add( surface, surface_order( 0, count ));
+        count++;
+    }
+    s_static_surface_count = count;
 }
 
 uint32_t surfaces_load_object( const struct SM64SurfaceObject *surfaceObject )
 {
-    bool pickedOldIndex = false;
-    uint32_t idx = s_surface_object_count;
+    uint32_t idx;
 
-    for( int i = 0; i < s_surface_object_count; ++i )
+    if( s_free_object_count > 0 )
     {
-        if( s_surface_object_list[i].surfaceCount == 0 )
+        idx = s_free_objects[ --s_free_object_count ];
+    }
+    else
+    {
+        if( s_surface_object_count == s_surface_object_capacity )
         {
-            pickedOldIndex = true;
-            idx = i;
-            break;
+            s_surface_object_capacity = s_surface_object_capacity ? s_surface_object_capacity * 2 : 64;
+            s_surface_object_list = counted_realloc( s_surface_object_list, s_surface_object_capacity * sizeof( struct LoadedSurfaceObject ));
+            s_free_objects = counted_realloc( s_free_objects, s_surface_object_capacity * sizeof( uint32_t ));
         }
-    }
 
-    if( !pickedOldIndex )
-    {
         idx = s_surface_object_count;
         s_surface_object_count++;
-        s_surface_object_list = realloc( s_surface_object_list, s_surface_object_count * sizeof( struct LoadedSurfaceObject ));
+        memset( &s_surface_object_list[idx], 0, sizeof( struct LoadedSurfaceObject ));
+        group_reset( &s_surface_object_list[idx].group );
     }
 
     struct LoadedSurfaceObject *obj = &s_surface_object_list[idx];
 
     obj->surfaceCount = surfaceObject->surfaceCount;
 
-    obj->transform = malloc( sizeof( struct SurfaceObjectTransform ));
+    if( obj->transform == NULL )
+        obj->transform = counted_malloc( sizeof( struct SurfaceObjectTransform ));
     init_transform( obj->transform, &surfaceObject->transform );
 
-    obj->libSurfaces = malloc( obj->surfaceCount * sizeof( struct SM64Surface ));
+    if( obj->surfaceCapacity < obj->surfaceCount )
+    {
+        obj->surfaceCapacity = obj->surfaceCount;
+        counted_free( obj->libSurfaces );
+        counted_free( obj->engineSurfaces );
+        obj->libSurfaces = counted_malloc( obj->surfaceCapacity * sizeof( struct SM64Surface ));
+        obj->engineSurfaces = counted_malloc( obj->surfaceCapacity * sizeof( struct Surface ));
+    }
+
     memcpy( obj->libSurfaces, surfaceObject->surfaces, obj->surfaceCount * sizeof( struct SM64Surface ));
 
-    obj->engineSurfaces = malloc( obj->surfaceCount * sizeof( struct Surface ));
+    // Object surfaces keep their index so they can be transformed again, invalid ones
+    // are only left out of the group and the partition
     for( int i = 0; i < obj->surfaceCount; ++i )
+    {
         engine_surface_from_lib_surface( &obj->engineSurfaces[i], &obj->libSurfaces[i], obj->transform );
+        group_add( &obj->group, &obj->engineSurfaces[i], surface_order( idx + 1, i ));
+        surface_partition_add( &obj->engineSurfaces[i], surface_order( idx + 1, i ));
+    }
 
     return idx;
 }
@@ -288,14 +374,12 @@ void surfaces_unload_object( uint32_t objId )
         return;
     }
 
-    free( s_surface_object_list[objId].transform );
-    free( s_surface_object_list[objId].libSurfaces );
-    free( s_surface_object_list[objId].engineSurfaces );
+    for( int i = 0; i < s_surface_object_list[objId].surfaceCount; ++i )
+        surface_partition_remove( &s_surface_object_list[objId].engineSurfaces[i], surface_order( objId + 1, i ));
 
     s_surface_object_list[objId].surfaceCount = 0;
-    s_surface_object_list[objId].transform = NULL;
-    s_surface_object_list[objId].libSurfaces = NULL;
-    s_surface_object_list[objId].engineSurfaces = NULL;
+    group_reset( &s_surface_object_list[objId].group );
+    s_free_objects[ s_free_object_count++ ] = objId;
 }
 
 void surface_object_update_transform( uint32_t objId, const struct SM64ObjectTransform *newTransform )
@@ -306,11 +390,15 @@ void surface_object_update_transform( uint32_t objId, const struct SM64ObjectTra
         return;
     }
 
-    update_transform( s_surface_object_list[objId].transform, newTransform );
-    for( int i = 0; i < s_surface_object_list[objId].surfaceCount; ++i )
+    struct LoadedSurfaceObject *obj = &s_surface_object_list[objId];
+    update_transform( obj->transform, newTransform );
+    group_reset( &obj->group );
+    for( int i = 0; i < obj->surfaceCount; ++i )
     {
-        struct LoadedSurfaceObject *obj = &s_surface_object_list[objId];
+        surface_partition_remove( &obj->engineSurfaces[i], surface_order( objId + 1, i ));
         engine_surface_from_lib_surface( &obj->engineSurfaces[i], &obj->libSurfaces[i], obj->transform );
+        group_add( &obj->group, &obj->engineSurfaces[i], surface_order( objId + 1, i ));
+        surface_partition_add( &obj->engineSurfaces[i], surface_order( objId + 1, i ));
     }
 }
 
@@ -324,14 +412,26 @@ struct SurfaceObjectTransform *surfaces_object_get_transform_ptr( uint32_t objId
 
 void surfaces_unload_all( void )
 {
-    free( s_static_surface_list );
+    counted_free( s_static_surface_list );
     s_static_surface_count = 0;
     s_static_surface_list = NULL;
+    group_free( &s_static_surface_group );
 
     for( int i = 0; i < s_surface_object_count; ++i )
-        surfaces_unload_object( i );
+    {
+        group_free( &s_surface_object_list[i].group );
+        counted_free( s_surface_object_list[i].transform );
+        counted_free( s_surface_object_list[i].libSurfaces );
+        counted_free( s_surface_object_list[i].engineSurfaces );
+    }
 
-    free( s_surface_object_list );
+    counted_free( s_surface_object_list );
+    counted_free( s_free_objects );
     s_surface_object_count = 0;
+    s_surface_object_capacity = 0;
     s_surface_object_list = NULL;
+    s_free_object_count = 0;
+    s_free_objects = NULL;
+
+    surface_partition_clear();
 }
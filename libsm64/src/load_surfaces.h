@@ -2,10 +2,20 @@
 
 #include "decomp/include/types.h"
 #include "libsm64.h"
+#include "surface_partition.h"
 
-extern uint32_t loaded_surface_iter_group_count( void );
-extern uint32_t loaded_surface_iter_group_size( uint32_t groupIndex );
-extern struct Surface *loaded_surface_iter_get_at_index( uint32_t groupIndex, uint32_t surfaceIndex );
+// The static surfaces or the surfaces of one object, split by class in load order. Invalid
+// surfaces are left out. The bounds cover all vertices of the group, min > max if it's empty.
+struct SurfaceGroup
+{
+    struct SurfaceSoA lists[SURFACE_PARTITION_CLASS_COUNT];
+    s32 minX, minY, minZ;
+    s32 maxX, maxY, maxZ;
+};
+
+// Group 0 holds the static surfaces, group n the object with ID n-1
+extern uint32_t loaded_surface_group_count( void );
+extern const struct SurfaceGroup *loaded_surface_group( uint32_t groupIndex );
 
 extern void surfaces_load_static( const struct SM64Surface *surfaceArray, uint32_t numSurfaces );
 extern uint32_t surfaces_load_object( const struct SM64SurfaceObject *surfaceObject );
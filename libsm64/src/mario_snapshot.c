@@ -0,0 +1,216 @@
+#include "mario_snapshot.h"
+
+#include <string.h>
+
+#include "decomp/include/types.h"
+#include "decomp/shim.h"
+#include "decomp/engine/math_util.h"
+#include "decomp/global_state.h"
+#include "decomp/game/mario.h"
+#include "decomp/engine/surface_collision.h"
+#include "decomp/game/platform_displacement.h"
+#include "load_anim_data.h"
+
+#define MARIO_SNAPSHOT_MAGIC   0x34364d53 // "SM64"
+#define MARIO_SNAPSHOT_VERSION 1
+
+// Everything a Mario's next tick depends on. Struct members are copied whole, so a snapshot
+// only loads into a build with the same struct layout, the header size catches mismatches.
+struct MarioSnapshot
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+
+    // GlobalState
+    u8 delayInvincTimer;
+    s16 invulnerable;
+    Mat4 floorAlignMatrix;
+    s16 wasAtSurface;
+    s16 swimStrength;
+    s16 D_80339FD0;
+    s16 D_80339FD2;
+    f32 D_80339FD4;
+    struct MarioBodyState bodyStates[2];
+    s16 marioAttackAnimCounter;
+    u16 areaUpdateCounter;
+    u32 globalTimer;
+    u8 specialTripleJump;
+    u32 audioRandom;
+    struct Controller controller;
+    u32 currentAnimAddr;
+    struct MarioState marioState; // pointer members are NULL
+
+    // gMarioObject
+    struct AnimInfo animInfo; // curAnim is looked up from animID on restore
+    Vec3s gfxAngle;
+    Vec3f gfxPos;
+    Vec3f gfxScale;
+    u32 collidedObjInteractTypes;
+    s16 activeFlags;
+    u32 rawData[0x50];
+    f32 hitboxRadius;
+    f32 hitboxHeight;
+    f32 hurtboxRadius;
+    f32 hurtboxHeight;
+    f32 hitboxDownOffset;
+};
+
+uint32_t mario_snapshot_size( void )
+{
+    return sizeof( struct MarioSnapshot );
+}
+
+void mario_snapshot_save( void *outBuffer )
+{
+    struct MarioSnapshot *snap = outBuffer;
+    struct Object *o = gMarioObject;
+
+    // Zero the padding too, equal states always give equal bytes
+    memset( snap, 0, sizeof( struct MarioSnapshot ));
+
+    snap->magic = MARIO_SNAPSHOT_MAGIC;
+    snap->version = MARIO_SNAPSHOT_VERSION;
+    snap->size = sizeof( struct MarioSnapshot );
+
+    snap->delayInvincTimer = g_state->msDelayInvincTimer;
+    snap->invulnerable = g_state->msInvulnerable;
+    memcpy( snap->floorAlignMatrix, g_state->msFloorAlignMatrix, sizeof( Mat4 ));
+    snap->wasAtSurface = g_state->msWasAtSurface;
+    snap->swimStrength = g_state->msSwimStrength;
+    snap->D_80339FD0 = g_state->mD_80339FD0;
+    snap->D_80339FD2 = g_state->mD_80339FD2;
+    snap->D_80339FD4 = g_state->mD_80339FD4;
+    memcpy( snap->bodyStates, g_state->mgBodyStates, sizeof( snap->bodyStates ));
+    snap->marioAttackAnimCounter = g_state->msMarioAttackAnimCounter;
+    snap->areaUpdateCounter = g_state->mgAreaUpdateCounter;
+    snap->globalTimer = g_state->mgGlobalTimer;
+    snap->specialTripleJump = g_state->mgSpecialTripleJump;
+    snap->audioRandom = g_state->mgAudioRandom;
+    snap->controller = g_state->mgController;
+    snap->currentAnimAddr = g_state->mD_80339D10.currentAnimAddr;
+    memcpy( &snap->marioState, &g_state->mgMarioStateVal, sizeof( struct MarioState ));
+    snap->marioState.wall = NULL;
+    snap->marioState.ceil = NULL;
+    snap->marioState.floor = NULL;
+    snap->marioState.interactObj = NULL;
+    snap->marioState.heldObj = NULL;
+    snap->marioState.usedObj = NULL;
+    snap->marioState.riddenObj = NULL;
+    snap->marioState.marioObj = NULL;
+    snap->marioState.spawnInfo = NULL;
+    snap->marioState.area = NULL;
+    snap->marioState.marioBodyState = NULL;
+    snap->marioState.controller = NULL;
+    snap->marioState.animation = NULL;
+
+    snap->animInfo = o->header.gfx.animInfo;
+    snap->animInfo.curAnim = NULL;
+    vec3s_copy( snap->gfxAngle, o->header.gfx.angle );
+    vec3f_copy( snap->gfxPos, o->header.gfx.pos );
+    vec3f_copy( snap->gfxScale, o->header.gfx.scale );
+    snap->collidedObjInteractTypes = o->collidedObjInteractTypes;
+    snap->activeFlags = o->activeFlags;
+    memcpy( snap->rawData, o->rawData.asU32, sizeof( snap->rawData ));
+    snap->hitboxRadius = o->hitboxRadius;
+    snap->hitboxHeight = o->hitboxHeight;
+    snap->hurtboxRadius = o->hurtboxRadius;
+    snap->hurtboxHeight = o->hurtboxHeight;
+    snap->hitboxDownOffset = o->hitboxDownOffset;
+}
+
+static bool anim_index_valid( s32 index )
+{
+    return index >= 0 && (uint32_t)index < get_mario_animation_count();
+}
+
+bool mario_snapshot_restore( const void *buffer, uint32_t bufferSize )
+{
+    struct MarioSnapshot snap;
+    if( bufferSize != sizeof( struct MarioSnapshot ))
+        return false;
+
+    // The buffer may come from a save file, don't assume it's aligned
+    memcpy( &snap, buffer, sizeof( struct MarioSnapshot ));
+
+    if( snap.magic != MARIO_SNAPSHOT_MAGIC || snap.version != MARIO_SNAPSHOT_VERSION || snap.size != sizeof( struct MarioSnapshot ))
+        return false;
+    if( snap.animInfo.animID != -1 && !anim_index_valid( snap.animInfo.animID ))
+        return false;
+    if( snap.currentAnimAddr != 0 && !anim_index_valid( (s32)snap.currentAnimAddr - 1 ))
+        return false;
+
+    struct MarioState *m = gMarioState;
+    struct Object *o = gMarioObject;
+
+    g_state->msDelayInvincTimer = snap.delayInvincTimer;
+    g_state->msInvulnerable = snap.invulnerable;
+    memcpy( g_state->msFloorAlignMatrix, snap.floorAlignMatrix, sizeof( Mat4 ));
+    g_state->msWasAtSurface = snap.wasAtSurface;
+    g_state->msSwimStrength = snap.swimStrength;
+    g_state->mD_80339FD0 = snap.D_80339FD0;
+    g_state->mD_80339FD2 = snap.D_80339FD2;
+    g_state->mD_80339FD4 = snap.D_80339FD4;
+    memcpy( g_state->mgBodyStates, snap.bodyStates, sizeof( snap.bodyStates ));
+    g_state->msMarioAttackAnimCounter = snap.marioAttackAnimCounter;
+    g_state->mgAreaUpdateCounter = snap.areaUpdateCounter;
+    g_state->mgGlobalTimer = snap.globalTimer;
+    g_state->mgSpecialTripleJump = snap.specialTripleJump;
+    g_state->mgAudioRandom = snap.audioRandom;
+    g_state->mgController = snap.controller;
+
+    // Keep this Mario's own pointers, everything else comes from the snapshot
+    struct MarioState pointers = *m;
+    *m = snap.marioState;
+    m->marioObj = pointers.marioObj;
+    m->spawnInfo = pointers.spawnInfo;
+    m->area = pointers.area;
+    m->marioBodyState = pointers.marioBodyState;
+    m->controller = pointers.controller;
+    m->animation = pointers.animation;
+
+    // libsm64 has no objects Mario could hold, ride or interact with
+    m->interactObj = NULL;
+    m->heldObj = NULL;
+    m->usedObj = NULL;
+    m->riddenObj = NULL;
+
+    // Animations are shared by all Marios, look them up again by their index
+    struct MarioAnimation *anim = m->animation;
+    anim->currentAnimAddr = 0;
+    anim->targetAnim = NULL;
+    o->header.gfx.animInfo = snap.animInfo;
+    if( snap.animInfo.animID != -1 )
+    {
+        load_mario_animation( anim, snap.animInfo.animID );
+        o->header.gfx.animInfo.curAnim = anim->targetAnim;
+    }
+    if( snap.currentAnimAddr != 0 )
+        load_mario_animation( anim, snap.currentAnimAddr - 1 );
+    else
+        anim->targetAnim = NULL;
+
+    vec3s_copy( o->header.gfx.angle, snap.gfxAngle );
+    vec3f_copy( o->header.gfx.pos, snap.gfxPos );
+    vec3f_copy( o->header.gfx.scale, snap.gfxScale );
+    o->header.gfx.throwMatrix = NULL;
+    o->collidedObjInteractTypes = snap.collidedObjInteractTypes;
+    o->activeFlags = snap.activeFlags;
+    o->numCollidedObjs = 0;
+    memcpy( o->rawData.asU32, snap.rawData, sizeof( snap.rawData ));
+    o->hitboxRadius = snap.hitboxRadius;
+    o->hitboxHeight = snap.hitboxHeight;
+    o->hurtboxRadius = snap.hurtboxRadius;
+    o->hurtboxHeight = snap.hurtboxHeight;
+    o->hitboxDownOffset = snap.hitboxDownOffset;
+
+    // Surfaces belong to the context, query them again. The heights stay as they were saved,
+    // the next tick recomputes them before reading them. The wall is only read in the step
+    // that found it.
+    m->wall = NULL;
+    find_floor( m->pos[0], m->pos[1], m->pos[2], &m->floor );
+    vec3f_find_ceil( m->pos, m->floorHeight, &m->ceil );
+    update_mario_platform();
+
+    return true;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Serializes the value state of the Mario bound with global_state_bind. Pointers are not
+// part of the snapshot, restoring rebuilds them for the Mario it's restored into.
+extern uint32_t mario_snapshot_size( void );
+extern void mario_snapshot_save( void *outBuffer );
+extern bool mario_snapshot_restore( const void *buffer, uint32_t bufferSize );
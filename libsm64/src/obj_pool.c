@@ -2,36 +2,50 @@
 
 #include <stdlib.h>
 
+#include "alloc_stats.h"
+
 uint32_t obj_pool_alloc_index( struct ObjPool *pool, size_t size )
 {
-    for( uint32_t i = 0; i < pool->size; ++i )
+    if( pool->freeCount > 0 )
+    {
+        struct ObjPoolFreeSlot *slot = &pool->freeSlots[ --pool->freeCount ];
+        pool->objects[ slot->index ] = slot->memory;
+        return slot->index;
+    }
+
+    if( pool->size == pool->capacity )
     {
-        if( pool->objects[i] == NULL )
-        {
-            pool->objects[i] = malloc( size );
-            return i;
-        }
+        pool->capacity = pool->capacity ? pool->capacity * 2 : 8;
+        pool->objects = counted_realloc( pool->objects, pool->capacity * sizeof( void * ));
+        pool->freeSlots = counted_realloc( pool->freeSlots, pool->capacity * sizeof( struct ObjPoolFreeSlot ));
     }
 
     uint32_t i = pool->size;
     pool->size++;
-    pool->objects = realloc( pool->objects, pool->size * sizeof( void * ));
-    pool->objects[i] = malloc( size );
+    pool->objects[i] = counted_malloc( size );
     return i;
 }
 
 void obj_pool_free_index( struct ObjPool *pool, uint32_t index )
 {
-    free( pool->objects[index] );
+    struct ObjPoolFreeSlot *slot = &pool->freeSlots[ pool->freeCount++ ];
+    slot->index = index;
+    slot->memory = pool->objects[index];
     pool->objects[index] = NULL;
 }
 
 void obj_pool_free_all( struct ObjPool *pool )
 {
     for( uint32_t i = 0; i < pool->size; ++i )
-        free( pool->objects[i] );
-    free( pool->objects );
+        counted_free( pool->objects[i] );
+    for( uint32_t i = 0; i < pool->freeCount; ++i )
+        counted_free( pool->freeSlots[i].memory );
+    counted_free( pool->objects );
+    counted_free( pool->freeSlots );
 
     pool->size = 0;
     pool->objects = NULL;
-}
\ No newline at end of file
+    pool->capacity = 0;
+    pool->freeCount = 0;
+    pool->freeSlots = NULL;
+}
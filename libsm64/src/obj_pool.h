@@ -3,12 +3,24 @@
 #include <stddef.h>
 #include <stdint.h>
 
+// All objects of one pool have to be the same size, freed objects keep their
+// memory and index on a free list and are handed out again by the next alloc.
+struct ObjPoolFreeSlot
+{
+    uint32_t index;
+    void *memory;
+};
+
 struct ObjPool
 {
     size_t size;
     void **objects;
+
+    size_t capacity;
+    uint32_t freeCount;
+    struct ObjPoolFreeSlot *freeSlots;
 };
 
 extern uint32_t obj_pool_alloc_index( struct ObjPool *pool, size_t size );
 extern void obj_pool_free_index( struct ObjPool *pool, uint32_t index );
-extern void obj_pool_free_all( struct ObjPool *pool );
\ No newline at end of file
+extern void obj_pool_free_all( struct ObjPool *pool );
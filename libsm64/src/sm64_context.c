@@ -0,0 +1,33 @@
+#include "sm64_context.h"
+
+#include <stdlib.h>
+
+#include "decomp/memory.h"
+#include "surface_partition.h"
+
+SM64_THREAD_LOCAL struct SM64Context *g_bound_context = NULL;
+struct SM64Context *g_default_context = NULL;
+
+struct SM64Context *context_create( void )
+{
+    struct SM64Context *context = calloc( 1, sizeof( struct SM64Context ));
+    context->partition = surface_partition_create();
+    context->displayListPool = alloc_only_pool_init();
+    return context;
+}
+
+void context_delete( struct SM64Context *context )
+{
+    // Surfaces and Marios have to be unloaded by the caller while the context is still bound
+    surface_partition_delete( context->partition );
+    alloc_only_pool_free( context->displayListPool );
+    if( context->marioGeoPool != NULL )
+        alloc_only_pool_free( context->marioGeoPool );
+    obj_pool_free_all( &context->marioInstancePool );
+    free( context );
+}
+
+void context_bind( struct SM64Context *context )
+{
+    g_bound_context = context;
+}
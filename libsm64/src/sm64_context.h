@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "decomp/include/types.h"
+#include "obj_pool.h"
+#include "load_surfaces.h"
+
+struct LoadedSurfaceObject;
+struct SurfacePartition;
+struct AllocOnlyPool;
+struct GraphNode;
+
+/**
+ * Everything a group of Marios shares: the loaded surfaces, their spatial partition,
+ * the Mario instances and the scratch memory used while generating their geometry.
+ * Separate contexts don't share any mutable state, so they can be used from
+ * different threads at the same time.
+ */
+struct SM64Context
+{
+    // load_surfaces.c
+    uint32_t staticSurfaceCount;
+    struct Surface *staticSurfaceList;
+    struct SurfaceGroup staticSurfaceGroup;
+    uint32_t surfaceObjectCount;
+    uint32_t surfaceObjectCapacity;
+    struct LoadedSurfaceObject *surfaceObjectList;
+    uint32_t freeSurfaceObjectCount;
+    uint32_t *freeSurfaceObjects;
+
+    // surface_partition.c
+    struct SurfacePartition *partition;
+
+    // decomp/memory.c
+    struct AllocOnlyPool *displayListPool;
+
+    // libsm64.c
+    struct ObjPool marioInstancePool;
+    struct AllocOnlyPool *marioGeoPool;
+    struct GraphNode *marioGraphNode;
+};
+
+// The context bound on this thread, falls back to the default one created by sm64_global_init
+extern SM64_THREAD_LOCAL struct SM64Context *g_bound_context;
+extern struct SM64Context *g_default_context;
+
+static inline struct SM64Context *context_current( void )
+{
+    return g_bound_context ? g_bound_context : g_default_context;
+}
+
+extern struct SM64Context *context_create( void );
+extern void context_delete( struct SM64Context *context );
+extern void context_bind( struct SM64Context *context );
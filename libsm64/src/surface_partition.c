@@ -0,0 +1,245 @@
+#include "surface_partition.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sm64_context.h"
+#include "alloc_stats.h"
+
+#define BUCKET_COUNT 1024
+
+struct PartitionCell
+{
+    s32 cellX;
+    s32 cellZ;
+    struct SurfaceSoA lists[SURFACE_PARTITION_CLASS_COUNT];
+    struct PartitionCell *next;
+};
+
+struct SurfacePartition
+{
+    struct PartitionCell *buckets[BUCKET_COUNT];
+    struct SurfaceSoA largeLists[SURFACE_PARTITION_CLASS_COUNT];
+};
+
+// The partition of the bound context
+#define s_buckets     (context_current()->partition->buckets)
+#define s_large_lists (context_current()->partition->largeLists)
+
+static bool s_enabled = true;
+
+static s32 cell_index( s32 coord )
+{
+    // Round towards negative infinity, plain division would fold -1 and 1 into cell 0
+    if( coord < 0 )
+        return -((-coord - 1) / SURFACE_PARTITION_CELL_SIZE) - 1;
+    return coord / SURFACE_PARTITION_CELL_SIZE;
+}
+
+static uint32_t cell_hash( s32 cellX, s32 cellZ )
+{
+    return (((uint32_t)cellX * 73856093u) ^ ((uint32_t)cellZ * 19349663u)) & (BUCKET_COUNT - 1);
+}
+
+bool surface_partition_classify( const struct Surface *surf, enum SurfacePartitionClass *outClass )
+{
+    // The split find_floor/find_ceil/find_wall_collisions used to redo on every query
+    if( !surf->isValid )
+        return false;
+
+    if( surf->normal.y > 0.01f )
+        *outClass = SURFACE_PARTITION_FLOORS;
+    else if( surf->normal.y < -0.01f )
+        *outClass = SURFACE_PARTITION_CEILS;
+    else
+        *outClass = SURFACE_PARTITION_WALLS;
+
+    return true;
+}
+
+static void surface_cell_bounds( const struct Surface *surf, enum SurfacePartitionClass surfClass, s32 *minCellX, s32 *minCellZ, s32 *maxCellX, s32 *maxCellZ )
+{
+    s32 minX = surf->vertex1[0], maxX = surf->vertex1[0];
+    s32 minZ = surf->vertex1[2], maxZ = surf->vertex1[2];
+
+    if( surf->vertex2[0] < minX ) minX = surf->vertex2[0];
+    if( surf->vertex3[0] < minX ) minX = surf->vertex3[0];
+    if( surf->vertex2[0] > maxX ) maxX = surf->vertex2[0];
+    if( surf->vertex3[0] > maxX ) maxX = surf->vertex3[0];
+    if( surf->vertex2[2] < minZ ) minZ = surf->vertex2[2];
+    if( surf->vertex3[2] < minZ ) minZ = surf->vertex3[2];
+    if( surf->vertex2[2] > maxZ ) maxZ = surf->vertex2[2];
+    if( surf->vertex3[2] > maxZ ) maxZ = surf->vertex3[2];
+
+    if( surfClass == SURFACE_PARTITION_WALLS )
+    {
+        minX -= SURFACE_PARTITION_WALL_MARGIN;
+        minZ -= SURFACE_PARTITION_WALL_MARGIN;
+        maxX += SURFACE_PARTITION_WALL_MARGIN;
+        maxZ += SURFACE_PARTITION_WALL_MARGIN;
+    }
+
+    *minCellX = cell_index( minX );
+    *minCellZ = cell_index( minZ );
+    *maxCellX = cell_index( maxX );
+    *maxCellZ = cell_index( maxZ );
+}
+
+static bool surface_is_large( s32 minCellX, s32 minCellZ, s32 maxCellX, s32 maxCellZ )
+{
+    int64_t numCells = ((int64_t)maxCellX - minCellX + 1) * ((int64_t)maxCellZ - minCellZ + 1);
+    return numCells > SURFACE_PARTITION_MAX_CELLS;
+}
+
+static void list_insert( struct SurfaceSoA *list, struct Surface *surface, uint64_t order )
+{
+    surface_soa_insert( list, surface_soa_lower_bound( list, order ), surface, order );
+}
+
+static void list_remove( struct SurfaceSoA *list, struct Surface *surface, uint64_t order )
+{
+    uint32_t pos = surface_soa_lower_bound( list, order );
+    if( pos >= list->count || list->surfaces[pos] != surface )
+        return;
+
+    surface_soa_remove( list, pos );
+}
+
+static struct PartitionCell *find_cell( s32 cellX, s32 cellZ )
+{
+    struct PartitionCell *cell = s_buckets[ cell_hash( cellX, cellZ ) ];
+    while( cell != NULL && ( cell->cellX != cellX || cell->cellZ != cellZ ))
+        cell = cell->next;
+    return cell;
+}
+
+static struct PartitionCell *find_or_create_cell( s32 cellX, s32 cellZ )
+{
+    struct PartitionCell *cell = find_cell( cellX, cellZ );
+    if( cell != NULL )
+        return cell;
+
+    uint32_t bucket = cell_hash( cellX, cellZ );
+    cell = counted_calloc( 1, sizeof( struct PartitionCell ));
+    cell->cellX = cellX;
+    cell->cellZ = cellZ;
+    cell->next = s_buckets[bucket];
+    s_buckets[bucket] = cell;
+    return cell;
+}
+
+static void release_cell_if_empty( struct PartitionCell *cell )
+{
+    for( int i = 0; i < SURFACE_PARTITION_CLASS_COUNT; ++i )
+        if( cell->lists[i].count > 0 )
+            return;
+
+    struct PartitionCell **link = &s_buckets[ cell_hash( cell->cellX, cell->cellZ ) ];
+    while( *link != cell )
+        link = &(*link)->next;
+    *link = cell->next;
+
+    for( int i = 0; i < SURFACE_PARTITION_CLASS_COUNT; ++i )
+        surface_soa_free( &cell->lists[i] );
+    counted_free( cell );
+}
+
+struct SurfacePartition *surface_partition_create( void )
+{
+    return counted_calloc( 1, sizeof( struct SurfacePartition ));
+}
+
+void surface_partition_delete( struct SurfacePartition *partition )
+{
+    // Cells are owned by the partition, clear() has to run while its context is bound
+    counted_free( partition );
+}
+
+void surface_partition_add( struct Surface *surface, uint64_t order )
+{
+    enum SurfacePartitionClass surfClass;
+    if( !surface_partition_classify( surface, &surfClass ))
+        return;
+
+    s32 minCellX, minCellZ, maxCellX, maxCellZ;
+    surface_cell_bounds( surface, surfClass, &minCellX, &minCellZ, &maxCellX, &maxCellZ );
+
+    if( surface_is_large( minCellX, minCellZ, maxCellX, maxCellZ ))
+    {
+        list_insert( &s_large_lists[surfClass], surface, order );
+        return;
+    }
+
+    for( s32 cellZ = minCellZ; cellZ <= maxCellZ; ++cellZ )
+        for( s32 cellX = minCellX; cellX <= maxCellX; ++cellX )
+            list_insert( &find_or_create_cell( cellX, cellZ )->lists[surfClass], surface, order );
+}
+
+void surface_partition_remove( struct Surface *surface, uint64_t order )
+{
+    // Must be called before the surface's vertices or normal are overwritten,
+    // the cells it was added to are derived from them.
+    enum SurfacePartitionClass surfClass;
+    if( !surface_partition_classify( surface, &surfClass ))
+        return;
+
+    s32 minCellX, minCellZ, maxCellX, maxCellZ;
+    surface_cell_bounds( surface, surfClass, &minCellX, &minCellZ, &maxCellX, &maxCellZ );
+
+    if( surface_is_large( minCellX, minCellZ, maxCellX, maxCellZ ))
+    {
+        list_remove( &s_large_lists[surfClass], surface, order );
+        return;
+    }
+
+    for( s32 cellZ = minCellZ; cellZ <= maxCellZ; ++cellZ )
+    {
+        for( s32 cellX = minCellX; cellX <= maxCellX; ++cellX )
+        {
+            struct PartitionCell *cell = find_cell( cellX, cellZ );
+            if( cell == NULL )
+                continue;
+
+            list_remove( &cell->lists[surfClass], surface, order );
+            release_cell_if_empty( cell );
+        }
+    }
+}
+
+void surface_partition_clear( void )
+{
+    for( int i = 0; i < BUCKET_COUNT; ++i )
+    {
+        struct PartitionCell *cell = s_buckets[i];
+        while( cell != NULL )
+        {
+            struct PartitionCell *next = cell->next;
+            for( int j = 0; j < SURFACE_PARTITION_CLASS_COUNT; ++j )
+                surface_soa_free( &cell->lists[j] );
+            counted_free( cell );
+            cell = next;
+        }
+        s_buckets[i] = NULL;
+    }
+
+    for( int i = 0; i < SURFACE_PARTITION_CLASS_COUNT; ++i )
+        surface_soa_free( &s_large_lists[i] );
+}
+
+void surface_partition_query( s32 x, s32 z, enum SurfacePartitionClass surfClass, const struct SurfaceSoA **outCell, const struct SurfaceSoA **outLarge )
+{
+    struct PartitionCell *cell = find_cell( cell_index( x ), cell_index( z ));
+
+    *outCell = cell ? &cell->lists[surfClass] : NULL;
+    *outLarge = &s_large_lists[surfClass];
+}
+
+bool surface_partition_is_enabled( void )
+{
+    return s_enabled;
+}
+
+void surface_partition_set_enabled( bool enabled )
+{
+    s_enabled = enabled;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "decomp/include/types.h"
+#include "surface_soa.h"
+
+// Edge length of one XZ cell. Much smaller than SM64's 0x400 because a single
+// teeworlds tile is only ~40 units wide at the default Mario scale.
+#define SURFACE_PARTITION_CELL_SIZE 256
+
+// Surfaces which would cover more cells than this are kept in a per-class list
+// that every query checks, so huge triangles can't blow up the cell table.
+#define SURFACE_PARTITION_MAX_CELLS 256
+
+// Max wall query radius is 200, walls are projected on the axis closest to their
+// normal, so a point can sit up to 200*sqrt(2) units outside a wall's bounds.
+#define SURFACE_PARTITION_WALL_MARGIN 300
+
+enum SurfacePartitionClass
+{
+    SURFACE_PARTITION_FLOORS,
+    SURFACE_PARTITION_CEILS,
+    SURFACE_PARTITION_WALLS,
+    SURFACE_PARTITION_CLASS_COUNT
+};
+
+struct SurfacePartition;
+
+extern struct SurfacePartition *surface_partition_create( void );
+extern void surface_partition_delete( struct SurfacePartition *partition );
+
+// False for invalid surfaces, which are never added
+extern bool surface_partition_classify( const struct Surface *surf, enum SurfacePartitionClass *outClass );
+
+extern void surface_partition_add( struct Surface *surface, uint64_t order );
+extern void surface_partition_remove( struct Surface *surface, uint64_t order );
+extern void surface_partition_clear( void );
+
+// Lists are sorted by (groupIndex << 32) | surfaceIndex so that merging them by order visits
+// surfaces in the same order as a linear scan over all groups. outCell is NULL for empty cells.
+extern void surface_partition_query( s32 x, s32 z, enum SurfacePartitionClass surfClass, const struct SurfaceSoA **outCell, const struct SurfaceSoA **outLarge );
+
+extern bool surface_partition_is_enabled( void );
+extern void surface_partition_set_enabled( bool enabled );
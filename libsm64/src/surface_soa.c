@@ -0,0 +1,392 @@
+#include "surface_soa.h"
+
+#include <string.h>
+
+#include "alloc_stats.h"
+
+// Every column of a list lives in one block, capacity entries each
+#define COLUMN_COUNT 14
+
+static void column_layout( struct SurfaceSoA *list, uint8_t *block, uint8_t *outColumns[COLUMN_COUNT], size_t outSizes[COLUMN_COUNT] )
+{
+    const size_t sizes[COLUMN_COUNT] = {
+        sizeof( uint64_t ), sizeof( struct Surface * ),
+        sizeof( s32 ), sizeof( s32 ), sizeof( s32 ), sizeof( s32 ), sizeof( s32 ), sizeof( s32 ),
+        sizeof( f32 ), sizeof( f32 ), sizeof( f32 ), sizeof( f32 ), sizeof( f32 ), sizeof( f32 ),
+    };
+
+    for( int i = 0; i < COLUMN_COUNT; ++i )
+    {
+        outColumns[i] = block;
+        outSizes[i] = sizes[i];
+        block += sizes[i] * list->capacity;
+    }
+}
+
+static void assign_columns( struct SurfaceSoA *list, uint8_t *columns[COLUMN_COUNT] )
+{
+    list->orders       = (uint64_t *)columns[0];
+    list->surfaces     = (struct Surface **)columns[1];
+    list->x1           = (s32 *)columns[2];
+    list->z1           = (s32 *)columns[3];
+    list->x2           = (s32 *)columns[4];
+    list->z2           = (s32 *)columns[5];
+    list->x3           = (s32 *)columns[6];
+    list->z3           = (s32 *)columns[7];
+    list->lowerY       = (f32 *)columns[8];
+    list->upperY       = (f32 *)columns[9];
+    list->nx           = (f32 *)columns[10];
+    list->ny           = (f32 *)columns[11];
+    list->nz           = (f32 *)columns[12];
+    list->originOffset = (f32 *)columns[13];
+}
+
+static void current_columns( struct SurfaceSoA *list, uint8_t *outColumns[COLUMN_COUNT], size_t outSizes[COLUMN_COUNT] )
+{
+    // orders is the first column, so it's also the block
+    column_layout( list, (uint8_t *)list->orders, outColumns, outSizes );
+}
+
+static void grow( struct SurfaceSoA *list )
+{
+    uint8_t *oldColumns[COLUMN_COUNT], *newColumns[COLUMN_COUNT];
+    size_t sizes[COLUMN_COUNT];
+    size_t entrySize = 0;
+
+    current_columns( list, oldColumns, sizes );
+    for( int i = 0; i < COLUMN_COUNT; ++i )
+        entrySize += sizes[i];
+
+    uint32_t oldCapacity = list->capacity;
+    list->capacity = oldCapacity ? oldCapacity * 2 : SURFACE_SOA_LANES;
+
+    // Zeroed, queries read whole blocks of lanes past count
+    uint8_t *block = counted_calloc( list->capacity, entrySize );
+    column_layout( list, block, newColumns, sizes );
+    for( int i = 0; i < COLUMN_COUNT; ++i )
+        if( oldCapacity > 0 )
+            memcpy( newColumns[i], oldColumns[i], list->count * sizes[i] );
+
+    counted_free( list->orders );
+    assign_columns( list, newColumns );
+}
+
+void surface_soa_insert( struct SurfaceSoA *list, uint32_t pos, struct Surface *surface, uint64_t order )
+{
+    if( list->count == list->capacity )
+        grow( list );
+
+    uint8_t *columns[COLUMN_COUNT];
+    size_t sizes[COLUMN_COUNT];
+    current_columns( list, columns, sizes );
+    for( int i = 0; i < COLUMN_COUNT; ++i )
+        memmove( columns[i] + ( pos + 1 ) * sizes[i], columns[i] + pos * sizes[i], ( list->count - pos ) * sizes[i] );
+
+    list->orders[pos] = order;
+    list->surfaces[pos] = surface;
+    list->x1[pos] = surface->vertex1[0];
+    list->z1[pos] = surface->vertex1[2];
+    list->x2[pos] = surface->vertex2[0];
+    list->z2[pos] = surface->vertex2[2];
+    list->x3[pos] = surface->vertex3[0];
+    list->z3[pos] = surface->vertex3[2];
+    list->lowerY[pos] = surface->lowerY;
+    list->upperY[pos] = surface->upperY;
+    list->nx[pos] = surface->normal.x;
+    list->ny[pos] = surface->normal.y;
+    list->nz[pos] = surface->normal.z;
+    list->originOffset[pos] = surface->originOffset;
+    list->count++;
+}
+
+void surface_soa_remove( struct SurfaceSoA *list, uint32_t pos )
+{
+    uint8_t *columns[COLUMN_COUNT];
+    size_t sizes[COLUMN_COUNT];
+    current_columns( list, columns, sizes );
+    for( int i = 0; i < COLUMN_COUNT; ++i )
+        memmove( columns[i] + pos * sizes[i], columns[i] + ( pos + 1 ) * sizes[i], ( list->count - pos - 1 ) * sizes[i] );
+
+    list->count--;
+}
+
+void surface_soa_free( struct SurfaceSoA *list )
+{
+    counted_free( list->orders );
+    memset( list, 0, sizeof( struct SurfaceSoA ));
+}
+
+uint32_t surface_soa_lower_bound( const struct SurfaceSoA *list, uint64_t order )
+{
+    uint32_t lo = 0, hi = list->count;
+    while( lo < hi )
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if( list->orders[mid] < order )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * Point-in-triangle tests of one block of lanes. The edge functions are the ones from
+ * find_floor_from_list, done in wrapping 32 bit math like the s32 expressions there.
+ * Floors pass when no edge is negative, ceilings when no edge is positive.
+ * Returns a bit per lane.
+ */
+#if defined( __GNUC__ )
+
+typedef uint32_t LanesU32 __attribute__(( vector_size( SURFACE_SOA_LANES * sizeof( uint32_t ))));
+typedef int32_t  LanesS32 __attribute__(( vector_size( SURFACE_SOA_LANES * sizeof( int32_t ))));
+
+// memcpy, columns are only aligned to their element. A macro since passing vectors by value
+// changes ABI with the lane width.
+#define LOAD_LANES( v, column ) memcpy( &(v), (column), sizeof( v ))
+
+static uint32_t edge_test_lanes( const struct SurfaceSoA *list, uint32_t base, s32 x, s32 z, bool ceil )
+{
+    LanesU32 x1, z1, x2, z2, x3, z3;
+    LOAD_LANES( x1, list->x1 + base );
+    LOAD_LANES( z1, list->z1 + base );
+    LOAD_LANES( x2, list->x2 + base );
+    LOAD_LANES( z2, list->z2 + base );
+    LOAD_LANES( x3, list->x3 + base );
+    LOAD_LANES( z3, list->z3 + base );
+    uint32_t px = (uint32_t)x, pz = (uint32_t)z;
+
+    LanesS32 e1 = (LanesS32)( (z1 - pz) * (x2 - x1) - (x1 - px) * (z2 - z1) );
+    LanesS32 e2 = (LanesS32)( (z2 - pz) * (x3 - x2) - (x2 - px) * (z3 - z2) );
+    LanesS32 e3 = (LanesS32)( (z3 - pz) * (x1 - x3) - (x3 - px) * (z1 - z3) );
+
+    LanesS32 pass;
+    if( ceil )
+        pass = (e1 <= 0) & (e2 <= 0) & (e3 <= 0);
+    else
+        pass = (e1 >= 0) & (e2 >= 0) & (e3 >= 0);
+
+    uint32_t mask = 0;
+    for( int lane = 0; lane < SURFACE_SOA_LANES; ++lane )
+        mask |= (uint32_t)( pass[lane] & 1 ) << lane;
+    return mask;
+}
+
+#else
+
+static uint32_t edge_test_lanes( const struct SurfaceSoA *list, uint32_t base, s32 x, s32 z, bool ceil )
+{
+    uint32_t mask = 0;
+    uint32_t px = (uint32_t)x, pz = (uint32_t)z;
+
+    for( int lane = 0; lane < SURFACE_SOA_LANES; ++lane )
+    {
+        uint32_t i = base + lane;
+        uint32_t x1 = list->x1[i], z1 = list->z1[i];
+        uint32_t x2 = list->x2[i], z2 = list->z2[i];
+        uint32_t x3 = list->x3[i], z3 = list->z3[i];
+
+        int32_t e1 = (int32_t)( (z1 - pz) * (x2 - x1) - (x1 - px) * (z2 - z1) );
+        int32_t e2 = (int32_t)( (z2 - pz) * (x3 - x2) - (x2 - px) * (z3 - z2) );
+        int32_t e3 = (int32_t)( (z3 - pz) * (x1 - x3) - (x3 - px) * (z1 - z3) );
+
+        bool pass = ceil
+            ? ( e1 <= 0 && e2 <= 0 && e3 <= 0 )
+            : ( e1 >= 0 && e2 >= 0 && e3 >= 0 );
+        mask |= (uint32_t)pass << lane;
+    }
+    return mask;
+}
+
+#endif
+
+static uint32_t block_mask( const struct SurfaceSoA *list, uint32_t base, s32 x, s32 z, bool ceil )
+{
+    uint32_t mask = edge_test_lanes( list, base, x, z, ceil );
+
+    // The last block reads zeroed or stale lanes past count, drop them
+    uint32_t valid = list->count - base;
+    if( valid < SURFACE_SOA_LANES )
+        mask &= ( 1u << valid ) - 1;
+    return mask;
+}
+
+static int lowest_lane( uint32_t mask )
+{
+    int lane = 0;
+    while( !( mask & 1 ))
+    {
+        mask >>= 1;
+        lane++;
+    }
+    return lane;
+}
+
+int32_t surface_soa_find_floor( const struct SurfaceSoA *list, s32 x, s32 y, s32 z, f32 *pheight )
+{
+    int32_t floor = -1;
+
+    for( uint32_t base = 0; base < list->count; base += SURFACE_SOA_LANES )
+    {
+        uint32_t mask = block_mask( list, base, x, z, false );
+        while( mask )
+        {
+            uint32_t i = base + lowest_lane( mask );
+            mask &= mask - 1;
+
+            const struct Surface *surf = list->surfaces[i];
+            f32 nx = surf->normal.x;
+            f32 ny = surf->normal.y;
+            f32 nz = surf->normal.z;
+            f32 oo = surf->originOffset;
+
+            // Find the height of the floor at a given location.
+            f32 height = -(x * nx + nz * z + oo) / ny;
+            // Checks for floor interaction with a 78 unit buffer.
+            if (y - (height + -78.0f) < 0.0f)
+                continue;
+
+            if( height > *pheight )
+            {
+                *pheight = height;
+                floor = i;
+            }
+        }
+    }
+
+    return floor;
+}
+
+int32_t surface_soa_find_ceil( const struct SurfaceSoA *list, s32 x, s32 y, s32 z, f32 *pheight )
+{
+    int32_t ceil = -1;
+
+    for( uint32_t base = 0; base < list->count; base += SURFACE_SOA_LANES )
+    {
+        uint32_t mask = block_mask( list, base, x, z, true );
+        while( mask )
+        {
+            uint32_t i = base + lowest_lane( mask );
+            mask &= mask - 1;
+
+            const struct Surface *surf = list->surfaces[i];
+            f32 nx = surf->normal.x;
+            f32 ny = surf->normal.y;
+            f32 nz = surf->normal.z;
+            f32 oo = surf->originOffset;
+
+            // Find the ceil height at the specific point.
+            f32 height = -(x * nx + nz * z + oo) / ny;
+            // Checks for ceiling interaction with a 78 unit buffer.
+            if (y - (height - -78.0f) > 0.0f)
+                continue;
+
+            if( height < *pheight )
+            {
+                *pheight = height;
+                ceil = i;
+            }
+        }
+    }
+
+    return ceil;
+}
+
+/**
+ * Wall rejection tests of one block of lanes: the y range and the distance to the plane.
+ * They're looser than the ones in find_wall_collisions_from_list by a unit, so rounding
+ * differences in the vector math never drop a wall the exact tests would keep.
+ */
+#if defined( __GNUC__ )
+
+typedef f32 LanesF32 __attribute__(( vector_size( SURFACE_SOA_LANES * sizeof( f32 ))));
+
+static uint32_t wall_test_lanes( const struct SurfaceSoAWallCursor *cursor, uint32_t base )
+{
+    const struct SurfaceSoA *list = cursor->list;
+    LanesF32 lowerY, upperY, nx, ny, nz, oo;
+    LOAD_LANES( lowerY, list->lowerY + base );
+    LOAD_LANES( upperY, list->upperY + base );
+    LOAD_LANES( nx, list->nx + base );
+    LOAD_LANES( ny, list->ny + base );
+    LOAD_LANES( nz, list->nz + base );
+    LOAD_LANES( oo, list->originOffset + base );
+    f32 reach = cursor->radius + 1.0f;
+
+    LanesF32 offset = nx * cursor->x + ny * cursor->y + nz * cursor->z + oo;
+    LanesS32 pass = (cursor->y >= lowerY - 1.0f) & (cursor->y <= upperY + 1.0f)
+                  & (offset >= -reach) & (offset <= reach);
+
+    uint32_t mask = 0;
+    for( int lane = 0; lane < SURFACE_SOA_LANES; ++lane )
+        mask |= (uint32_t)( pass[lane] & 1 ) << lane;
+    return mask;
+}
+
+#else
+
+static uint32_t wall_test_lanes( const struct SurfaceSoAWallCursor *cursor, uint32_t base )
+{
+    const struct SurfaceSoA *list = cursor->list;
+    f32 reach = cursor->radius + 1.0f;
+    uint32_t mask = 0;
+
+    for( int lane = 0; lane < SURFACE_SOA_LANES; ++lane )
+    {
+        uint32_t i = base + lane;
+        f32 offset = list->nx[i] * cursor->x + list->ny[i] * cursor->y + list->nz[i] * cursor->z + list->originOffset[i];
+
+        bool pass = cursor->y >= list->lowerY[i] - 1.0f && cursor->y <= list->upperY[i] + 1.0f
+                 && offset >= -reach && offset <= reach;
+        mask |= (uint32_t)pass << lane;
+    }
+    return mask;
+}
+
+#endif
+
+static uint32_t wall_block_mask( const struct SurfaceSoAWallCursor *cursor, uint32_t base )
+{
+    uint32_t mask = wall_test_lanes( cursor, base );
+
+    uint32_t valid = cursor->list->count - base;
+    if( valid < SURFACE_SOA_LANES )
+        mask &= ( 1u << valid ) - 1;
+    return mask;
+}
+
+void surface_soa_wall_cursor_begin( struct SurfaceSoAWallCursor *cursor, const struct SurfaceSoA *list, f32 x, f32 y, f32 z, f32 radius )
+{
+    cursor->list = list;
+    cursor->x = x;
+    cursor->y = y;
+    cursor->z = z;
+    cursor->radius = radius;
+    cursor->base = 0;
+    cursor->mask = list != NULL && list->count > 0 ? wall_block_mask( cursor, 0 ) : 0;
+}
+
+int32_t surface_soa_wall_cursor_peek( struct SurfaceSoAWallCursor *cursor )
+{
+    if( cursor->list == NULL )
+        return -1;
+
+    // Blocks are only tested once the previous one ran out
+    while( cursor->mask == 0 )
+    {
+        cursor->base += SURFACE_SOA_LANES;
+        if( cursor->base >= cursor->list->count )
+        {
+            cursor->list = NULL;
+            return -1;
+        }
+        cursor->mask = wall_block_mask( cursor, cursor->base );
+    }
+
+    return cursor->base + lowest_lane( cursor->mask );
+}
+
+void surface_soa_wall_cursor_pop( struct SurfaceSoAWallCursor *cursor )
+{
+    cursor->mask &= cursor->mask - 1;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "decomp/include/types.h"
+
+// Queries test this many surfaces at once, capacities are kept a multiple of it
+#define SURFACE_SOA_LANES 8
+
+// Surfaces of one class in structure-of-arrays form. Queries run their rejection tests over
+// the columns and only touch the struct Surface of the few entries that pass them.
+struct SurfaceSoA
+{
+    uint32_t count;
+    uint32_t capacity;
+
+    // Floors and ceilings: XZ vertices for the point-in-triangle tests
+    s32 *x1, *z1;
+    s32 *x2, *z2;
+    s32 *x3, *z3;
+
+    // Walls: y range and plane
+    f32 *lowerY, *upperY;
+    f32 *nx, *ny, *nz;
+    f32 *originOffset;
+
+    struct Surface **surfaces;
+    // (groupIndex << 32) | surfaceIndex, see surface_partition.h
+    uint64_t *orders;
+};
+
+extern void surface_soa_insert( struct SurfaceSoA *list, uint32_t pos, struct Surface *surface, uint64_t order );
+extern void surface_soa_remove( struct SurfaceSoA *list, uint32_t pos );
+extern void surface_soa_free( struct SurfaceSoA *list );
+
+// Returns the index of the first entry with an order >= the given one
+extern uint32_t surface_soa_lower_bound( const struct SurfaceSoA *list, uint64_t order );
+
+// Same rules as find_floor_from_list/find_ceil_from_list in surface_collision.c. Returns the
+// index of the highest floor/lowest ceiling that beats *pheight, or -1. Of equal heights the
+// first entry wins, like in a scan over the list.
+extern int32_t surface_soa_find_floor( const struct SurfaceSoA *list, s32 x, s32 y, s32 z, f32 *pheight );
+extern int32_t surface_soa_find_ceil( const struct SurfaceSoA *list, s32 x, s32 y, s32 z, f32 *pheight );
+
+// Visits the walls of a list that may be within radius of a point, in list order. This is a
+// superset of the walls that collide, the exact tests stay in find_wall_collisions_from_list.
+struct SurfaceSoAWallCursor
+{
+    const struct SurfaceSoA *list;
+    uint32_t base;
+    uint32_t mask;
+    f32 x, y, z;
+    f32 radius;
+};
+
+extern void surface_soa_wall_cursor_begin( struct SurfaceSoAWallCursor *cursor, const struct SurfaceSoA *list, f32 x, f32 y, f32 z, f32 radius );
+// Index of the current wall, -1 when the list is done
+extern int32_t surface_soa_wall_cursor_peek( struct SurfaceSoAWallCursor *cursor );
+extern void surface_soa_wall_cursor_pop( struct SurfaceSoAWallCursor *cursor );
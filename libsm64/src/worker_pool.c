@@ -0,0 +1,135 @@
+#include "worker_pool.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+struct WorkerPool
+{
+    pthread_t *threads;
+    uint32_t numThreads;
+
+    // Serializes batches submitted from different threads
+    pthread_mutex_t runMutex;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t workCond;
+    pthread_cond_t doneCond;
+
+    // Bumped for every worker_pool_run call so sleeping workers know there is a new batch
+    uint32_t generation;
+    bool shutdown;
+
+    WorkerPoolJobFn job;
+    void *userData;
+    uint32_t count;
+    uint32_t nextIndex;
+    uint32_t remaining;
+};
+
+// Runs jobs of the current batch until none are left. Expects the mutex to be held.
+static void run_pending_jobs( struct WorkerPool *pool )
+{
+    while( pool->nextIndex < pool->count )
+    {
+        uint32_t index = pool->nextIndex++;
+        WorkerPoolJobFn job = pool->job;
+        void *userData = pool->userData;
+
+        pthread_mutex_unlock( &pool->mutex );
+        job( userData, index );
+        pthread_mutex_lock( &pool->mutex );
+
+        if( --pool->remaining == 0 )
+            pthread_cond_broadcast( &pool->doneCond );
+    }
+}
+
+static void *worker_thread( void *param )
+{
+    struct WorkerPool *pool = param;
+    uint32_t seenGeneration = 0;
+
+    pthread_mutex_lock( &pool->mutex );
+    while( true )
+    {
+        while( !pool->shutdown && pool->generation == seenGeneration )
+            pthread_cond_wait( &pool->workCond, &pool->mutex );
+
+        if( pool->shutdown )
+            break;
+
+        seenGeneration = pool->generation;
+        run_pending_jobs( pool );
+    }
+    pthread_mutex_unlock( &pool->mutex );
+
+    return NULL;
+}
+
+struct WorkerPool *worker_pool_create( uint32_t numThreads )
+{
+    struct WorkerPool *pool = calloc( 1, sizeof( struct WorkerPool ));
+
+    pthread_mutex_init( &pool->runMutex, NULL );
+    pthread_mutex_init( &pool->mutex, NULL );
+    pthread_cond_init( &pool->workCond, NULL );
+    pthread_cond_init( &pool->doneCond, NULL );
+
+    pool->threads = malloc( numThreads * sizeof( pthread_t ));
+    for( uint32_t i = 0; i < numThreads; ++i )
+    {
+        if( pthread_create( &pool->threads[pool->numThreads], NULL, worker_thread, pool ) == 0 )
+            pool->numThreads++;
+    }
+
+    return pool;
+}
+
+void worker_pool_delete( struct WorkerPool *pool )
+{
+    if( pool == NULL )
+        return;
+
+    pthread_mutex_lock( &pool->mutex );
+    pool->shutdown = true;
+    pthread_cond_broadcast( &pool->workCond );
+    pthread_mutex_unlock( &pool->mutex );
+
+    for( uint32_t i = 0; i < pool->numThreads; ++i )
+        pthread_join( pool->threads[i], NULL );
+
+    pthread_cond_destroy( &pool->doneCond );
+    pthread_cond_destroy( &pool->workCond );
+    pthread_mutex_destroy( &pool->mutex );
+    pthread_mutex_destroy( &pool->runMutex );
+    free( pool->threads );
+    free( pool );
+}
+
+void worker_pool_run( struct WorkerPool *pool, uint32_t count, WorkerPoolJobFn job, void *userData )
+{
+    if( pool == NULL || pool->numThreads == 0 || count <= 1 )
+    {
+        for( uint32_t i = 0; i < count; ++i )
+            job( userData, i );
+        return;
+    }
+
+    pthread_mutex_lock( &pool->runMutex );
+    pthread_mutex_lock( &pool->mutex );
+    pool->job = job;
+    pool->userData = userData;
+    pool->count = count;
+    pool->nextIndex = 0;
+    pool->remaining = count;
+    pool->generation++;
+    pthread_cond_broadcast( &pool->workCond );
+
+    run_pending_jobs( pool );
+
+    while( pool->remaining > 0 )
+        pthread_cond_wait( &pool->doneCond, &pool->mutex );
+    pthread_mutex_unlock( &pool->mutex );
+    pthread_mutex_unlock( &pool->runMutex );
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+struct WorkerPool;
+
+typedef void (*WorkerPoolJobFn)( void *userData, uint32_t index );
+
+extern struct WorkerPool *worker_pool_create( uint32_t numThreads );
+extern void worker_pool_delete( struct WorkerPool *pool );
+
+// Calls job( userData, i ) for every i in [0, count) spread across the pool's threads
+// and the calling thread, and returns once all of them are done. A NULL pool runs
+// everything on the calling thread.
+extern void worker_pool_run( struct WorkerPool *pool, uint32_t count, WorkerPoolJobFn job, void *userData );
@@ -0,0 +1,163 @@
+// Compares floor/ceiling/wall queries through the surface partition against the
+// plain linear scan over every loaded surface group.
+//
+// Usage: sm64-surface-bench [columns] [queries]
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../src/libsm64.h"
+#include "../src/load_surfaces.h"
+#include "../src/surface_partition.h"
+#include "../src/decomp/engine/surface_collision.h"
+#include "../src/decomp/include/surface_terrains.h"
+
+#include "ns_clock.h"
+
+#define TILE_SIZE 43
+#define MAP_HEIGHT 64
+
+struct QueryPoint
+{
+    float x, y, z;
+};
+
+static uint32_t s_rng = 0x12345678;
+
+static uint32_t next_random( void )
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static void set_quad( struct SM64Surface *out, const int32_t a[3], const int32_t b[3], const int32_t c[3], const int32_t d[3] )
+{
+    for( int i = 0; i < 2; ++i )
+    {
+        out[i].type = SURFACE_DEFAULT;
+        out[i].force = 0;
+        out[i].terrain = TERRAIN_STONE;
+    }
+    memcpy( out[0].vertices[0], a, sizeof( int32_t ) * 3 );
+    memcpy( out[0].vertices[1], b, sizeof( int32_t ) * 3 );
+    memcpy( out[0].vertices[2], c, sizeof( int32_t ) * 3 );
+    memcpy( out[1].vertices[0], c, sizeof( int32_t ) * 3 );
+    memcpy( out[1].vertices[1], d, sizeof( int32_t ) * 3 );
+    memcpy( out[1].vertices[2], a, sizeof( int32_t ) * 3 );
+}
+
+// One surface object per solid tile, the same way CMario streams blocks in
+static uint32_t load_tile_map( int columns, const uint8_t *solid )
+{
+    uint32_t objects = 0;
+
+    for( int x = 0; x < columns; ++x )
+    {
+        for( int y = 0; y < MAP_HEIGHT; ++y )
+        {
+            if( !solid[x * MAP_HEIGHT + y] )
+                continue;
+
+            const int32_t s = TILE_SIZE, d = 64;
+            const int32_t top[4][3]    = {{ s, s, d }, { s, s, -d }, { 0, s, -d }, { 0, s, d }};
+            const int32_t bottom[4][3] = {{ 0, 0, d }, { 0, 0, -d }, { s, 0, -d }, { s, 0, d }};
+            const int32_t left[4][3]   = {{ 0, 0, -d }, { 0, 0, d }, { 0, s, d }, { 0, s, -d }};
+            const int32_t right[4][3]  = {{ s, 0, d }, { s, 0, -d }, { s, s, -d }, { s, s, d }};
+
+            struct SM64Surface surfaces[8];
+            struct SM64SurfaceObject obj;
+            memset( &obj, 0, sizeof( obj ));
+            obj.transform.position[0] = x * TILE_SIZE;
+            obj.transform.position[1] = y * TILE_SIZE;
+            obj.surfaces = surfaces;
+
+            set_quad( &surfaces[0], top[0], top[1], top[2], top[3] );
+            set_quad( &surfaces[2], bottom[0], bottom[1], bottom[2], bottom[3] );
+            set_quad( &surfaces[4], left[0], left[1], left[2], left[3] );
+            set_quad( &surfaces[6], right[0], right[1], right[2], right[3] );
+            obj.surfaceCount = 8;
+
+            surfaces_load_object( &obj );
+            objects++;
+        }
+    }
+
+    return objects;
+}
+
+static double run_queries( const struct QueryPoint *points, int numPoints, double *outChecksum )
+{
+    double checksum = 0.0;
+    uint64_t start = ns_clock();
+
+    for( int i = 0; i < numPoints; ++i )
+    {
+        struct Surface *floor, *ceil;
+        struct WallCollisionData wall;
+
+        checksum += find_floor( points[i].x, points[i].y, points[i].z, &floor );
+        checksum += find_ceil( points[i].x, points[i].y, points[i].z, &ceil );
+
+        memset( &wall, 0, sizeof( wall ));
+        wall.x = points[i].x;
+        wall.y = points[i].y;
+        wall.z = points[i].z;
+        wall.offsetY = 60.0f;
+        wall.radius = 50.0f;
+        checksum += find_wall_collisions( &wall ) + wall.x + wall.z;
+    }
+
+    *outChecksum = checksum;
+    return (ns_clock() - start) / 1.0e6;
+}
+
+int main( int argc, char **argv )
+{
+    int columns = argc > 1 ? atoi( argv[1] ) : 200;
+    int numPoints = argc > 2 ? atoi( argv[2] ) : 10000;
+
+    // No sm64_global_init here, the surfaces only need a context to live in
+    struct SM64Context *context = sm64_context_create();
+    sm64_context_bind( context );
+
+    uint8_t *solid = calloc( columns, MAP_HEIGHT );
+    for( int i = 0; i < columns * MAP_HEIGHT; ++i )
+        solid[i] = next_random() % 4 == 0;
+
+    uint32_t objects = load_tile_map( columns, solid );
+
+    struct QueryPoint *points = malloc( numPoints * sizeof( struct QueryPoint ));
+    for( int i = 0; i < numPoints; ++i )
+    {
+        points[i].x = (float)( next_random() % ( columns * TILE_SIZE ));
+        points[i].y = (float)( next_random() % ( MAP_HEIGHT * TILE_SIZE ));
+        points[i].z = 0.0f;
+    }
+
+    double linearChecksum, partitionChecksum;
+
+    surface_partition_set_enabled( false );
+    double linearMs = run_queries( points, numPoints, &linearChecksum );
+
+    surface_partition_set_enabled( true );
+    double partitionMs = run_queries( points, numPoints, &partitionChecksum );
+
+    printf( "surface objects: %u, queries: %d\n", objects, numPoints * 3 );
+    printf( "linear scan:     %10.3f ms\n", linearMs );
+    printf( "partition:       %10.3f ms (%.1fx)\n", partitionMs, partitionMs > 0.0 ? linearMs / partitionMs : 0.0 );
+
+    sm64_context_delete( context );
+    free( points );
+    free( solid );
+
+    if( linearChecksum != partitionChecksum )
+    {
+        printf( "results differ: %f != %f\n", linearChecksum, partitionChecksum );
+        return 1;
+    }
+    return 0;
+}
@@ -26,6 +26,7 @@
 
 #if defined(CONF_FAMILY_UNIX)
 #include <csignal>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/utsname.h>
@@ -148,6 +149,22 @@ typedef struct
 #endif
 } NETSOCKET_BUFFER;
 
+/* packets waiting to be sent with one sendmmsg per socket */
+typedef struct
+{
+#ifdef CONF_PLATFORM_LINUX
+	int enabled;
+	int size;
+	int socks[VLEN];
+	struct mmsghdr msgs[VLEN];
+	struct iovec iovecs[VLEN];
+	char bufs[VLEN][PACKETSIZE];
+	char sockaddrs[VLEN][128];
+#else
+	int enabled;
+#endif
+} NETSOCKET_SEND_QUEUE;
+
 void net_buffer_init(NETSOCKET_BUFFER *buffer);
 void net_buffer_reinit(NETSOCKET_BUFFER *buffer);
 void net_buffer_simple(NETSOCKET_BUFFER *buffer, char **buf, int *size);
@@ -160,6 +177,7 @@ struct NETSOCKET_INTERNAL
 	int web_ipv4sock;
 
 	NETSOCKET_BUFFER buffer;
+	NETSOCKET_SEND_QUEUE send_queue;
 };
 static NETSOCKET_INTERNAL invalid_socket = {NETTYPE_INVALID, -1, -1, -1};
 
@@ -390,6 +408,41 @@ int io_sync(IOHANDLE io)
 #endif
 }
 
+void *io_map(IOHANDLE io, unsigned *size)
+{
+	long int length = io_length(io);
+	*size = 0;
+	if(length <= 0 || (unsigned long)length > 0xffffffffUL)
+		return nullptr;
+#if defined(CONF_FAMILY_WINDOWS)
+	HANDLE mapping = CreateFileMappingW((HANDLE)_get_osfhandle(_fileno((FILE *)io)), nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(!mapping)
+		return nullptr;
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	// the view keeps the mapping alive
+	CloseHandle(mapping);
+	if(!data)
+		return nullptr;
+#else
+	void *data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fileno((FILE *)io), 0);
+	if(data == MAP_FAILED)
+		return nullptr;
+#endif
+	*size = length;
+	return data;
+}
+
+void io_unmap(void *data, unsigned size)
+{
+	if(!data)
+		return;
+#if defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#else
+	munmap(data, size);
+#endif
+}
+
 #define ASYNC_BUFSIZE (8 * 1024)
 #define ASYNC_LOCAL_BUFSIZE (64 * 1024)
 
@@ -401,6 +454,9 @@ struct ASYNCIO
 	SEMAPHORE sphore;
 	void *thread;
 
+	ASYNCIO_WRITE_CALLBACK write_callback;
+	void *write_user;
+
 	unsigned char *buffer;
 	unsigned int buffer_size;
 	unsigned int read_pos;
@@ -475,6 +531,16 @@ static void aio_thread(void *user)
 		{
 			if(aio->finish != ASYNCIO_RUNNING)
 			{
+				if(aio->write_callback)
+				{
+					// let the callback write what it still holds back
+					lock_unlock(aio->lock);
+					int result_error = aio->write_callback(aio->io, 0, 0, aio->write_user);
+					io_flush(aio->io);
+					result_error |= io_error(aio->io);
+					lock_wait(aio->lock);
+					aio->error = result_error;
+				}
 				if(aio->finish == ASYNCIO_CLOSE)
 				{
 					io_close(aio->io);
@@ -510,9 +576,17 @@ static void aio_thread(void *user)
 		aio->read_pos = (aio->read_pos + buffers.len1 + buffers.len2) % aio->buffer_size;
 		lock_unlock(aio->lock);
 
-		io_write(aio->io, local_buffer, local_buffer_len);
+		if(aio->write_callback)
+		{
+			result_io_error = aio->write_callback(aio->io, local_buffer, local_buffer_len, aio->write_user);
+		}
+		else
+		{
+			io_write(aio->io, local_buffer, local_buffer_len);
+			result_io_error = 0;
+		}
 		io_flush(aio->io);
-		result_io_error = io_error(aio->io);
+		result_io_error |= io_error(aio->io);
 
 		lock_wait(aio->lock);
 		aio->error = result_io_error;
@@ -520,6 +594,11 @@ static void aio_thread(void *user)
 }
 
 ASYNCIO *aio_new(IOHANDLE io)
+{
+	return aio_new_ex(io, 0, 0);
+}
+
+ASYNCIO *aio_new_ex(IOHANDLE io, ASYNCIO_WRITE_CALLBACK write_callback, void *user)
 {
 	ASYNCIO *aio = (ASYNCIO *)malloc(sizeof(*aio));
 	if(!aio)
@@ -527,6 +606,8 @@ ASYNCIO *aio_new(IOHANDLE io)
 		return 0;
 	}
 	aio->io = io;
+	aio->write_callback = write_callback;
+	aio->write_user = user;
 	aio->lock = lock_create();
 	sphore_init(&aio->sphore);
 	aio->thread = 0;
@@ -1595,6 +1676,84 @@ NETSOCKET net_udp_create(NETADDR bindaddr)
 	return sock;
 }
 
+static int priv_net_udp_send(NETSOCKET sock, int sockfd, const struct sockaddr *sa, int salen, const void *data, int size, bool queueable)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	NETSOCKET_SEND_QUEUE *queue = &sock->send_queue;
+	if(queueable && queue->enabled && size <= PACKETSIZE && salen <= (int)sizeof(queue->sockaddrs[0]))
+	{
+		if(queue->size == VLEN)
+			net_udp_flush(sock);
+
+		int i = queue->size++;
+		queue->socks[i] = sockfd;
+		mem_copy(queue->bufs[i], data, size);
+		mem_copy(queue->sockaddrs[i], sa, salen);
+		queue->iovecs[i].iov_base = queue->bufs[i];
+		queue->iovecs[i].iov_len = size;
+		mem_zero(&queue->msgs[i], sizeof(queue->msgs[i]));
+		queue->msgs[i].msg_hdr.msg_iov = &queue->iovecs[i];
+		queue->msgs[i].msg_hdr.msg_iovlen = 1;
+		queue->msgs[i].msg_hdr.msg_name = queue->sockaddrs[i];
+		queue->msgs[i].msg_hdr.msg_namelen = salen;
+		return size;
+	}
+#endif
+	network_stats.sent_syscalls++;
+	int d = sendto(sockfd, (const char *)data, size, 0, sa, salen);
+	if(d >= 0)
+	{
+		network_stats.sent_bytes += size;
+		network_stats.sent_packets++;
+	}
+	return d;
+}
+
+void net_udp_set_send_queue(NETSOCKET sock, int enabled)
+{
+	if(!enabled)
+		net_udp_flush(sock);
+#if defined(CONF_PLATFORM_LINUX)
+	sock->send_queue.enabled = enabled;
+#endif
+}
+
+int net_udp_flush(NETSOCKET sock)
+{
+	int sent = 0;
+#if defined(CONF_PLATFORM_LINUX)
+	NETSOCKET_SEND_QUEUE *queue = &sock->send_queue;
+	int start = 0;
+	while(start < queue->size)
+	{
+		/* the queue holds packets for the ipv4 and the ipv6 socket */
+		int end = start + 1;
+		while(end < queue->size && queue->socks[end] == queue->socks[start])
+			end++;
+
+		while(start < end)
+		{
+			int result = sendmmsg(queue->socks[start], &queue->msgs[start], end - start, 0);
+			network_stats.sent_syscalls++;
+			if(result <= 0)
+			{
+				/* drop the packet that failed, like a failed sendto */
+				start++;
+				continue;
+			}
+			for(int i = start; i < start + result; i++)
+				network_stats.sent_bytes += queue->iovecs[i].iov_len;
+			network_stats.sent_packets += result;
+			network_stats.sent_queued_packets += result;
+			sent += result;
+			start += result;
+		}
+	}
+	queue->size = 0;
+#endif
+	return sent;
+}
+
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
 {
 	int d = -1;
@@ -1614,7 +1773,8 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 			else
 				netaddr_to_sockaddr_in(addr, &sa);
 
-			d = sendto((int)sock->ipv4sock, (const char *)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			/* broadcasts are rare, send them right away */
+			d = priv_net_udp_send(sock, sock->ipv4sock, (struct sockaddr *)&sa, sizeof(sa), data, size, !(addr->type & NETTYPE_LINK_BROADCAST));
 		}
 		else
 			dbg_msg("net", "can't send ipv4 traffic to this socket");
@@ -1628,6 +1788,11 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 			char addr_str[NETADDR_MAXSTRSIZE];
 			str_format(addr_str, sizeof(addr_str), "%d.%d.%d.%d", addr->ip[0], addr->ip[1], addr->ip[2], addr->ip[3]);
 			d = websocket_send(sock->web_ipv4sock, (const unsigned char *)data, size, addr_str, addr->port);
+			if(d >= 0)
+			{
+				network_stats.sent_bytes += size;
+				network_stats.sent_packets++;
+			}
 		}
 
 		else
@@ -1652,7 +1817,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 			else
 				netaddr_to_sockaddr_in6(addr, &sa);
 
-			d = sendto((int)sock->ipv6sock, (const char *)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			d = priv_net_udp_send(sock, sock->ipv6sock, (struct sockaddr *)&sa, sizeof(sa), data, size, !(addr->type & NETTYPE_LINK_BROADCAST));
 		}
 		else
 			dbg_msg("net", "can't send ipv6 traffic to this socket");
@@ -1673,8 +1838,6 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 		dbg_msg("net", "\taddr = %s", addrstr);
 
 	}*/
-	network_stats.sent_bytes += size;
-	network_stats.sent_packets++;
 	return d;
 }
 
@@ -1800,6 +1963,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 
 int net_udp_close(NETSOCKET sock)
 {
+	net_udp_flush(sock);
 	return priv_net_close_all_sockets(sock);
 }
 
@@ -2504,6 +2668,9 @@ int net_socket_read_wait(NETSOCKET sock, int time)
 	}
 #endif
 
+	/* send what was queued before sleeping */
+	net_udp_flush(sock);
+
 	/* don't care about writefds and exceptfds */
 	if(time < 0)
 		select(sockid + 1, &readfds, NULL, NULL, NULL);
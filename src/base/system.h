@@ -376,6 +376,32 @@ int io_sync(IOHANDLE io);
  */
 int io_error(IOHANDLE io);
 
+/**
+ * Maps the whole file into memory for reading, without copying it.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file, it can be closed while the file is mapped.
+ * @param size Pointer to where the size of the file is written.
+ *
+ * @return Pointer to the contents of the file, @c nullptr if it couldn't be mapped or is empty.
+ *
+ * @remark The memory must be released with @link io_unmap @endlink.
+ * @remark Files that are replaced should be renamed over, accessing a mapping
+ *         of a file that was truncated in place can crash the process.
+ */
+void *io_map(IOHANDLE io, unsigned *size);
+
+/**
+ * Releases memory returned by @link io_map @endlink.
+ *
+ * @ingroup File-IO
+ *
+ * @param data The mapped memory, may be @c nullptr.
+ * @param size Size of the mapped file.
+ */
+void io_unmap(void *data, unsigned size);
+
 /**
  * @ingroup File-IO
  * @return An <IOHANDLE> to the standard input.
@@ -414,6 +440,40 @@ typedef struct ASYNCIO ASYNCIO;
  */
 ASYNCIO *aio_new(IOHANDLE io);
 
+/**
+ * Writes a chunk of queued data on the writing thread of an ASYNCIO.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file.
+ * @param buffer Pointer to the queued data, or null once before the
+ * file is closed.
+ * @param size Number of bytes in the buffer.
+ * @param user Pointer passed to @link aio_new_ex @endlink.
+ *
+ * @return 0 on success, nonzero on error.
+ */
+typedef int (*ASYNCIO_WRITE_CALLBACK)(IOHANDLE io, const void *buffer, unsigned size, void *user);
+
+/**
+ * Wraps a @link IOHANDLE @endlink for asynchronous writing, with a
+ * callback that writes the queued data instead of writing it as is.
+ * This allows transforming the data on the writing thread, e.g.
+ * compressing it.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file.
+ * @param write_callback Called on the writing thread for every chunk
+ * of queued data, and once more with no data when the file is closed
+ * or waited for.
+ * @param user Pointer passed to the callback.
+ *
+ * @return The handle for asynchronous writing.
+ *
+ */
+ASYNCIO *aio_new_ex(IOHANDLE io, ASYNCIO_WRITE_CALLBACK write_callback, void *user);
+
 /**
  * Locks the ASYNCIO structure so it can't be written into by
  * other threads.
@@ -970,6 +1030,32 @@ NETSOCKET net_udp_create(NETADDR bindaddr);
  */
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size);
 
+/**
+ * Makes net_udp_send queue the packets of an UDP socket instead of sending
+ * them right away. They are sent together with as few system calls as
+ * possible by net_udp_flush, once the queue is full, or before
+ * net_socket_read_wait waits for the socket. Only has an effect on Linux.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ * @param enabled Whether to queue the packets, disabling sends the queued ones.
+ */
+void net_udp_set_send_queue(NETSOCKET sock, int enabled);
+
+/**
+ * Sends the packets queued on an UDP socket.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ *
+ * @return The number of packets sent.
+ *
+ * @see net_udp_set_send_queue
+ */
+int net_udp_flush(NETSOCKET sock);
+
 /*
 	Function: net_udp_recv
 		Receives a packet over an UDP socket.
@@ -2022,6 +2108,8 @@ typedef struct
 	uint64_t sent_bytes;
 	uint64_t recv_packets;
 	uint64_t recv_bytes;
+	uint64_t sent_syscalls; // sendto and sendmmsg calls
+	uint64_t sent_queued_packets; // packets sent through a send queue
 } NETSTATS;
 
 void net_stats(NETSTATS *stats);
@@ -0,0 +1,54 @@
+#ifndef BASE_TL_SMALL_VECTOR_H
+#define BASE_TL_SMALL_VECTOR_H
+
+#include <vector>
+
+/*
+	Class: Small Vector
+		A vector that keeps its first N elements inline and only allocates
+		once it grows beyond them. Meant for short lists that are returned
+		by value from hot paths.
+*/
+template<typename T, int N>
+class CSmallVector
+{
+	T m_aInline[N];
+	std::vector<T> m_vHeap;
+	int m_Size = 0;
+
+public:
+	T *data() { return m_Size <= N ? m_aInline : m_vHeap.data(); }
+	const T *data() const { return m_Size <= N ? m_aInline : m_vHeap.data(); }
+	int size() const { return m_Size; }
+	bool empty() const { return m_Size == 0; }
+
+	T *begin() { return data(); }
+	T *end() { return data() + m_Size; }
+	const T *begin() const { return data(); }
+	const T *end() const { return data() + m_Size; }
+
+	T &operator[](int Index) { return data()[Index]; }
+	const T &operator[](int Index) const { return data()[Index]; }
+
+	void push_back(const T &Value)
+	{
+		if(m_Size < N)
+			m_aInline[m_Size] = Value;
+		else
+		{
+			// spill the inline elements the first time we grow beyond them
+			if(m_Size == N)
+				m_vHeap.assign(m_aInline, m_aInline + N);
+			m_vHeap.push_back(Value);
+		}
+		m_Size++;
+	}
+
+	void clear()
+	{
+		m_vHeap.clear();
+		m_Size = 0;
+	}
+};
+
+#endif
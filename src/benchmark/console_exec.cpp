@@ -0,0 +1,83 @@
+// Executes a large autoexec that sets every server config variable a
+// number of times, like map configs and vote lists do, and reports the
+// time per executed line.
+//
+// Usage: console_exec [lines]
+
+#include <base/logger.h>
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/config.h>
+#include <engine/console.h>
+#include <engine/kernel.h>
+#include <engine/shared/config.h>
+#include <engine/storage.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+enum
+{
+	NUM_ROUNDS = 5,
+};
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+
+	const int NumLines = argc > 1 ? maximum(str_toint(argv[1]), 1) : 100000;
+
+	std::unique_ptr<IKernel> pKernel(IKernel::Create());
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	IStorage *pStorage = CreateLocalStorage();
+	IConfigManager *pConfigManager = CreateConfigManager();
+	pKernel->RegisterInterface(pConsole);
+	pKernel->RegisterInterface(pStorage);
+	pKernel->RegisterInterface(pConfigManager);
+	pConfigManager->Init();
+	pConsole->Init();
+
+	std::vector<std::string> vLines;
+	for(const IConsole::CCommandInfo *pInfo = pConsole->FirstCommandInfo(IConsole::ACCESS_LEVEL_ADMIN, CFGFLAG_SERVER); pInfo; pInfo = pInfo->NextCommandInfo(IConsole::ACCESS_LEVEL_ADMIN, CFGFLAG_SERVER))
+	{
+		if(str_comp(pInfo->m_pParams, "?i") == 0)
+			vLines.push_back(std::string(pInfo->m_pName) + " 0");
+	}
+	if(vLines.empty())
+	{
+		dbg_msg("console_exec", "no config variables");
+		return -1;
+	}
+
+	char aFilename[IO_MAX_PATH_LENGTH];
+	str_format(aFilename, sizeof(aFilename), "console_exec-%d.cfg", pid());
+	IOHANDLE File = io_open(aFilename, IOFLAG_WRITE);
+	if(!File)
+	{
+		dbg_msg("console_exec", "failed to open '%s'", aFilename);
+		return -1;
+	}
+	for(int i = 0; i < NumLines; i++)
+	{
+		const std::string &Line = vLines[i % vLines.size()];
+		io_write(File, Line.c_str(), Line.size());
+		io_write_newline(File);
+	}
+	io_close(File);
+
+	int64_t Best = -1;
+	for(int Round = 0; Round < NUM_ROUNDS; Round++)
+	{
+		const int64_t Start = time_get();
+		pConsole->ExecuteFile(aFilename, -1, true, IStorage::TYPE_ABSOLUTE);
+		const int64_t Time = time_get() - Start;
+		Best = Best < 0 ? Time : minimum(Best, Time);
+	}
+	fs_remove(aFilename);
+
+	dbg_msg("console_exec", "lines: %d, variables: %d", NumLines, (int)vLines.size());
+	dbg_msg("console_exec", "exec: %8.3f ms, %6.3f us per line", Best * 1000.0 / time_freq(), Best * 1000000.0 / time_freq() / NumLines);
+	return 0;
+}
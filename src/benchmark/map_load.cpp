@@ -0,0 +1,109 @@
+// Loads all data of the maps in a directory, once one index after another
+// with GetData like before and once with LoadData, which decompresses them
+// in parallel on the job pool of an engine.
+//
+// Usage: map_load [directory] [jobs]
+
+#include <base/logger.h>
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/engine.h>
+#include <engine/shared/datafile.h>
+#include <engine/storage.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+enum
+{
+	NUM_ROUNDS = 5,
+};
+
+static int ListMaps(const char *pName, int IsDir, int DirType, void *pUser)
+{
+	if(!IsDir && str_endswith(pName, ".map"))
+		((std::vector<std::string> *)pUser)->emplace_back(pName);
+	return 0;
+}
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+
+	const char *pDirectory = argc > 1 ? argv[1] : "data/maps";
+	const int NumJobs = argc > 2 ? maximum(str_toint(argv[2]), 1) : 4;
+
+	std::vector<std::string> vMaps;
+	fs_listdir(pDirectory, ListMaps, 0, &vMaps);
+	if(vMaps.empty())
+	{
+		dbg_msg("map_load", "no maps in '%s'", pDirectory);
+		return -1;
+	}
+
+	std::unique_ptr<IStorage> pStorage(CreateLocalStorage());
+	std::unique_ptr<IEngine> pEngine(CreateTestEngine("map_load", NumJobs));
+	int64_t TotalSerialTime = 0;
+	int64_t TotalParallelTime = 0;
+	for(const auto &Map : vMaps)
+	{
+		char aPath[IO_MAX_PATH_LENGTH];
+		str_format(aPath, sizeof(aPath), "%s/%s", pDirectory, Map.c_str());
+
+		int64_t OpenTime = 0;
+		int64_t SerialTime = 0;
+		int64_t ParallelTime = 0;
+		int NumData = 0;
+		int64_t Bytes = 0;
+		for(int Round = 0; Round < NUM_ROUNDS; Round++)
+		{
+			CDataFileReader Serial;
+			CDataFileReader Parallel;
+			int64_t Start = time_get();
+			if(!Serial.Open(pStorage.get(), aPath, IStorage::TYPE_ABSOLUTE) || !Parallel.Open(pStorage.get(), aPath, IStorage::TYPE_ABSOLUTE))
+			{
+				dbg_msg("map_load", "failed to open '%s'", aPath);
+				return -1;
+			}
+			OpenTime += (time_get() - Start) / 2;
+
+			NumData = Serial.NumData();
+			Start = time_get();
+			for(int i = 0; i < NumData; i++)
+				Serial.GetData(i);
+			SerialTime += time_get() - Start;
+
+			std::vector<int> vIndices;
+			for(int i = 0; i < NumData; i++)
+				vIndices.push_back(i);
+			Start = time_get();
+			Parallel.LoadData(vIndices.data(), vIndices.size(), pEngine.get());
+			ParallelTime += time_get() - Start;
+
+			Bytes = 0;
+			for(int i = 0; i < NumData; i++)
+			{
+				const int Size = Serial.GetDataSize(i);
+				if(Size != Parallel.GetDataSize(i) || mem_comp(Serial.GetData(i), Parallel.GetData(i), Size) != 0)
+				{
+					dbg_msg("map_load", "data %d of '%s' differs", i, aPath);
+					return 1;
+				}
+				Bytes += Size;
+			}
+		}
+		TotalSerialTime += SerialTime;
+		TotalParallelTime += ParallelTime;
+
+		const double Ms = 1000.0 / time_freq() / NUM_ROUNDS;
+		dbg_msg("map_load", "%-24s %4d data %7d KiB  open %7.3fms  serial %8.3fms  parallel %8.3fms", Map.c_str(), NumData, (int)(Bytes / 1024), OpenTime * Ms, SerialTime * Ms, ParallelTime * Ms);
+	}
+
+	const double Ms = 1000.0 / time_freq() / NUM_ROUNDS;
+	dbg_msg("map_load", "maps: %d, jobs: %d", (int)vMaps.size(), NumJobs);
+	dbg_msg("map_load", "serial:   %8.3f ms", TotalSerialTime * Ms);
+	dbg_msg("map_load", "parallel: %8.3f ms", TotalParallelTime * Ms);
+	return 0;
+}
@@ -0,0 +1,204 @@
+// Replays a snapshot stream through the delta path for a number of clients,
+// once hashing both snapshots for every delta and once storing them in a
+// CSnapshotStorage per client like the server does, which hashes each
+// snapshot once. The stream comes from a demo or, without one, from a
+// synthetic 64 player game.
+//
+// Usage: snapshot_delta [demo] [clients]
+
+#include <base/logger.h>
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/network.h>
+#include <engine/shared/snapshot.h>
+#include <engine/storage.h>
+#include <game/generated/protocol.h>
+
+#include <memory>
+#include <vector>
+
+class CSnapshotRecorder : public CDemoPlayer::IListener
+{
+public:
+	std::vector<std::vector<char>> m_vvSnapshots;
+
+	void OnDemoPlayerSnapshot(void *pData, int Size) override
+	{
+		m_vvSnapshots.emplace_back((char *)pData, (char *)pData + Size);
+	}
+	void OnDemoPlayerMessage(void *pData, int Size) override {}
+};
+
+static bool LoadDemo(const char *pFilename, CSnapshotDelta *pDelta, std::vector<std::vector<char>> *pvvSnapshots)
+{
+	// demo chunks are huffman compressed
+	CNetBase::Init();
+
+	std::unique_ptr<IStorage> pStorage(CreateLocalStorage());
+	CSnapshotRecorder Recorder;
+	CDemoPlayer DemoPlayer(pDelta);
+	DemoPlayer.SetListener(&Recorder);
+	if(!pStorage || DemoPlayer.Load(pStorage.get(), nullptr, pFilename, IStorage::TYPE_ABSOLUTE) == -1)
+		return false;
+
+	DemoPlayer.Play();
+	while(DemoPlayer.IsPlaying() && !DemoPlayer.Info()->m_Info.m_Paused)
+		DemoPlayer.Update(false);
+	DemoPlayer.Stop();
+
+	*pvvSnapshots = std::move(Recorder.m_vvSnapshots);
+	return true;
+}
+
+enum
+{
+	NUM_PLAYERS = 64,
+};
+
+static unsigned s_Seed = 1;
+static int Random(int Max)
+{
+	s_Seed = s_Seed * 1103515245 + 12345;
+	return (s_Seed >> 8) % Max;
+}
+
+// characters that keep moving and projectiles that come and go
+static void GenerateSnapshots(int NumTicks, std::vector<std::vector<char>> *pvvSnapshots)
+{
+	static CSnapshotBuilder s_Builder;
+	static char s_aData[CSnapshot::MAX_SIZE];
+	CNetObj_Character aCharacters[NUM_PLAYERS] = {};
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+	{
+		s_Builder.Init();
+		for(int i = 0; i < NUM_PLAYERS; i++)
+		{
+			CNetObj_Character &Char = aCharacters[i];
+			Char.m_Tick = Tick;
+			Char.m_X += Random(9) - 4;
+			Char.m_Y += Random(9) - 4;
+			Char.m_VelX = Random(512) - 256;
+			Char.m_VelY = Random(512) - 256;
+			if(Random(20) == 0)
+				Char.m_Weapon = Random(6);
+			mem_copy(s_Builder.NewItem(NETOBJTYPE_CHARACTER, i, sizeof(Char)), &Char, sizeof(Char));
+
+			CNetObj_PlayerInfo *pInfo = (CNetObj_PlayerInfo *)s_Builder.NewItem(NETOBJTYPE_PLAYERINFO, i, sizeof(CNetObj_PlayerInfo));
+			pInfo->m_ClientID = i;
+			pInfo->m_Score = i;
+		}
+		for(int i = 0; i < 100; i++)
+		{
+			// ids are kept for a while, then replaced
+			const int ID = (Tick / 25 + i) % 200;
+			CNetObj_Projectile *pProj = (CNetObj_Projectile *)s_Builder.NewItem(NETOBJTYPE_PROJECTILE, ID, sizeof(CNetObj_Projectile));
+			pProj->m_X = ID * 32;
+			pProj->m_Y = ID * 16;
+			pProj->m_VelX = 1000;
+			pProj->m_StartTick = Tick / 25 * 25;
+		}
+		const int Size = s_Builder.Finish(s_aData);
+		pvvSnapshots->emplace_back(s_aData, s_aData + Size);
+	}
+}
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+
+	CSnapshotDelta Delta;
+	CNetObjHandler NetObjHandler;
+	for(int i = 0; i < NUM_NETOBJTYPES; i++)
+		Delta.SetStaticsize(i, NetObjHandler.GetObjSize(i));
+
+	std::vector<std::vector<char>> vvSnapshots;
+	if(argc > 1 && str_comp(argv[1], "-") != 0)
+	{
+		if(!LoadDemo(argv[1], &Delta, &vvSnapshots))
+		{
+			dbg_msg("snapshot_delta", "failed to load demo '%s'", argv[1]);
+			return -1;
+		}
+	}
+	else
+		GenerateSnapshots(3000, &vvSnapshots);
+	const int NumClients = argc > 2 ? maximum(str_toint(argv[2]), 1) : 64;
+	const int NumSnapshots = vvSnapshots.size();
+	if(NumSnapshots < 2)
+	{
+		dbg_msg("snapshot_delta", "need at least two snapshots");
+		return -1;
+	}
+
+	// every client got the previous snapshot and gets the current one,
+	// both ways store the snapshots like the server does
+	static char s_aDeltaData[CSnapshot::MAX_SIZE];
+	static char s_aCachedDeltaData[CSnapshot::MAX_SIZE];
+	static char s_aUnpacked[CSnapshot::MAX_SIZE];
+	std::vector<CSnapshotStorage> vHashedStorages(NumClients);
+	std::vector<CSnapshotStorage> vStorages(NumClients);
+	int64_t HashedTime = 0;
+	int64_t CachedTime = 0;
+	int64_t UnpackTime = 0;
+	int64_t DeltaBytes = 0;
+	for(int c = 0; c < NumClients; c++)
+	{
+		vHashedStorages[c].Add(0, 0, vvSnapshots[0].size(), vvSnapshots[0].data(), 0, nullptr);
+		vStorages[c].Add(0, 0, vvSnapshots[0].size(), vvSnapshots[0].data(), 0, nullptr);
+	}
+	for(int i = 1; i < NumSnapshots; i++)
+	{
+		CSnapshot *pFrom = (CSnapshot *)vvSnapshots[i - 1].data();
+		CSnapshot *pTo = (CSnapshot *)vvSnapshots[i].data();
+		const int ToSize = vvSnapshots[i].size();
+
+		int64_t Start = time_get();
+		int DeltaSize = 0;
+		for(auto &Storage : vHashedStorages)
+		{
+			Storage.PurgeUntil(i - 1);
+			Storage.Add(i, 0, ToSize, pTo, 0, nullptr);
+			DeltaSize = Delta.CreateDelta(pFrom, pTo, s_aDeltaData);
+		}
+		HashedTime += time_get() - Start;
+
+		Start = time_get();
+		int CachedDeltaSize = 0;
+		const CSnapshotItemHash *pFromHash = nullptr;
+		for(auto &Storage : vStorages)
+		{
+			Storage.PurgeUntil(i - 1);
+			Storage.Add(i, 0, ToSize, pTo, 0, nullptr);
+			Storage.Get(i - 1, nullptr, nullptr, nullptr, &pFromHash);
+			CachedDeltaSize = Delta.CreateDelta(pFrom, pTo, s_aCachedDeltaData, pFromHash, Storage.m_pLast->m_pSnapHash);
+		}
+		CachedTime += time_get() - Start;
+
+		if(DeltaSize != CachedDeltaSize || mem_comp(s_aDeltaData, s_aCachedDeltaData, DeltaSize) != 0)
+		{
+			dbg_msg("snapshot_delta", "deltas differ in snapshot %d", i);
+			return 1;
+		}
+
+		Start = time_get();
+		const int UnpackedSize = DeltaSize ?
+						 Delta.UnpackDelta(pFrom, (CSnapshot *)s_aUnpacked, s_aDeltaData, DeltaSize, pFromHash) :
+						 Delta.UnpackDelta(pFrom, (CSnapshot *)s_aUnpacked, Delta.EmptyDelta(), sizeof(int) * 3, pFromHash);
+		UnpackTime += time_get() - Start;
+		if(UnpackedSize != (int)vvSnapshots[i].size() || mem_comp(s_aUnpacked, pTo, UnpackedSize) != 0)
+		{
+			dbg_msg("snapshot_delta", "unpacked snapshot %d differs", i);
+			return 1;
+		}
+		DeltaBytes += DeltaSize;
+	}
+
+	const int NumDeltas = NumSnapshots - 1;
+	dbg_msg("snapshot_delta", "snapshots: %d, clients: %d, average delta: %d bytes", NumSnapshots, NumClients, (int)(DeltaBytes / NumDeltas));
+	dbg_msg("snapshot_delta", "hashed per delta: %8.3f us/client", HashedTime * 1000000.0 / time_freq() / NumDeltas / NumClients);
+	dbg_msg("snapshot_delta", "cached hashes:    %8.3f us/client", CachedTime * 1000000.0 / time_freq() / NumDeltas / NumClients);
+	dbg_msg("snapshot_delta", "unpack:           %8.3f us", UnpackTime * 1000000.0 / time_freq() / NumDeltas);
+	return 0;
+}
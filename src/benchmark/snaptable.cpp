@@ -0,0 +1,158 @@
+// Compares snapping client independent items per client against building
+// them once into a CSnapTable, on a synthetic map full of Marios.
+//
+// Usage: snaptable [players] [ticks]
+
+#include <base/logger.h>
+#include <base/system.h>
+#include <engine/shared/snapshot.h>
+#include <game/server/snaptable.h>
+
+#include <vector>
+
+enum
+{
+	ITEMTYPE_OUTLINE = 3, // NETOBJTYPE_LASER
+	OUTLINE_POINTS = 64,
+	MAP_SIZE = 500 * 32,
+};
+
+// same layout as CNetObj_Laser
+struct SOutlinePoint
+{
+	int m_X;
+	int m_Y;
+	int m_FromX;
+	int m_FromY;
+	int m_StartTick;
+};
+
+struct SPlayer
+{
+	vec2 m_Pos;
+	ivec2 m_aOutline[OUTLINE_POINTS];
+};
+
+static unsigned s_Seed = 1;
+static int Random(int Max)
+{
+	s_Seed = s_Seed * 1103515245 + 12345;
+	return (s_Seed >> 8) % Max;
+}
+
+static void FillPoint(SOutlinePoint *pPoint, const SPlayer &Player, int i, int Tick)
+{
+	pPoint->m_FromX = (int)Player.m_Pos.x + Player.m_aOutline[i].x;
+	pPoint->m_FromY = (int)Player.m_Pos.y + Player.m_aOutline[i].y;
+	pPoint->m_X = pPoint->m_FromX;
+	pPoint->m_Y = pPoint->m_FromY;
+	pPoint->m_StartTick = Tick;
+}
+
+static bool Clipped(const CSnapTable::SView &View, vec2 Pos)
+{
+	return absolute(View.m_ViewPos.x - Pos.x) > View.m_ShowDistance.x || absolute(View.m_ViewPos.y - Pos.y) > View.m_ShowDistance.y;
+}
+
+static CSnapshotBuilder s_Builder;
+static char s_aaPerClient[64][CSnapshot::MAX_SIZE];
+static int s_aPerClientSize[64];
+static char s_aShared[CSnapshot::MAX_SIZE];
+
+// what every entity's Snap does today: clip and fill its items again for each client
+static int SnapPerClient(const std::vector<SPlayer> &vPlayers, const CSnapTable::SView &View, int Tick, char *pOut)
+{
+	s_Builder.Init();
+	for(size_t p = 0; p < vPlayers.size(); p++)
+	{
+		if(Clipped(View, vPlayers[p].m_Pos))
+			continue;
+		for(int i = 0; i < OUTLINE_POINTS; i++)
+			FillPoint((SOutlinePoint *)s_Builder.NewItem(ITEMTYPE_OUTLINE, p * OUTLINE_POINTS + i, sizeof(SOutlinePoint)), vPlayers[p], i, Tick);
+	}
+	return s_Builder.Finish(pOut);
+}
+
+static void SnapTable(const CSnapTable &Table, int ClientID, const CSnapTable::SView &View)
+{
+	Table.Snap(
+		ClientID, View, [](int Type, int ID, int Size) { return s_Builder.NewItem(Type, ID, Size); },
+		[](const void *pItems, int Size, const int *pOffsets, int NumItems) { return s_Builder.NewItems(pItems, Size, pOffsets, NumItems); });
+}
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+
+	int NumPlayers = argc > 1 ? str_toint(argv[1]) : 64;
+	int NumTicks = argc > 2 ? str_toint(argv[2]) : 500;
+	NumPlayers = clamp(NumPlayers, 1, 64);
+
+	// players crowd a third of the map so that most of them see each other
+	std::vector<SPlayer> vPlayers(NumPlayers);
+	std::vector<CSnapTable::SView> vViews(NumPlayers);
+	for(int i = 0; i < NumPlayers; i++)
+	{
+		vPlayers[i].m_Pos = vec2(Random(MAP_SIZE / 3), Random(MAP_SIZE / 3));
+		for(auto &Point : vPlayers[i].m_aOutline)
+			Point = ivec2(Random(64) - 32, Random(96) - 80);
+		vViews[i] = {vPlayers[i].m_Pos, vec2(1000, 800), false};
+	}
+
+	CSnapTable Table;
+	int64_t PerClientTime = 0;
+	int64_t SharedTime = 0;
+	int64_t NumItems = 0;
+
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+	{
+		// players move a little every tick
+		for(auto &Player : vPlayers)
+			Player.m_Pos += vec2(Random(9) - 4, Random(9) - 4);
+		for(int c = 0; c < NumPlayers; c++)
+			vViews[c].m_ViewPos = vPlayers[c].m_Pos;
+
+		int64_t Start = time_get();
+		for(int c = 0; c < NumPlayers; c++)
+			s_aPerClientSize[c] = SnapPerClient(vPlayers, vViews[c], Tick, s_aaPerClient[c]);
+		PerClientTime += time_get() - Start;
+
+		Start = time_get();
+		Table.Clear();
+		for(int p = 0; p < NumPlayers; p++)
+		{
+			Table.AddGroup(vPlayers[p].m_Pos, -1);
+			for(int i = 0; i < OUTLINE_POINTS; i++)
+				FillPoint((SOutlinePoint *)Table.AddItem(ITEMTYPE_OUTLINE, p * OUTLINE_POINTS + i, sizeof(SOutlinePoint)), vPlayers[p], i, Tick);
+		}
+		for(int c = 0; c < NumPlayers; c++)
+		{
+			s_Builder.Init();
+			SnapTable(Table, c, vViews[c]);
+			s_Builder.Finish(s_aShared);
+		}
+		SharedTime += time_get() - Start;
+
+		// the shared pass only kept the last snapshot, check all of them outside the timing
+		for(int c = 0; c < NumPlayers; c++)
+		{
+			s_Builder.Init();
+			SnapTable(Table, c, vViews[c]);
+			int Size = s_Builder.Finish(s_aShared);
+			NumItems += ((CSnapshot *)s_aShared)->NumItems();
+			if(Size != s_aPerClientSize[c] || mem_comp(s_aaPerClient[c], s_aShared, Size) != 0)
+			{
+				dbg_msg("snaptable", "snapshots of client %d differ in tick %d", c, Tick);
+				return 1;
+			}
+		}
+	}
+
+	double PerClientMs = PerClientTime * 1000.0 / time_freq() / NumTicks;
+	double SharedMs = SharedTime * 1000.0 / time_freq() / NumTicks;
+	dbg_msg("snaptable", "players: %d, ticks: %d, items per snapshot: %.0f", NumPlayers, NumTicks, (double)NumItems / NumTicks / NumPlayers);
+	dbg_msg("snaptable", "per client: %8.3f ms/tick", PerClientMs);
+	dbg_msg("snaptable", "snap table: %8.3f ms/tick (%.2fx)", SharedMs, PerClientMs / SharedMs);
+	return 0;
+}
@@ -0,0 +1,431 @@
+// Replays a teehistorian file through the server's game code without
+// networking and as fast as possible: players join, send their messages
+// and inputs and run their rcon commands at the recorded ticks, the world
+// is ticked and snapshots are built, delta'd and compressed for everyone
+// in game. The time spent in each phase is reported, and the replayed
+// player positions are compared with the recorded ones.
+//
+// Usage: teehistorian_replay <teehistorian> [map]
+
+#include <base/logger.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/engine.h>
+#include <engine/map.h>
+#include <engine/server/antibot.h>
+#include <engine/server/server.h>
+#include <engine/shared/config.h>
+#include <engine/shared/json.h>
+#include <engine/shared/protocol_ex.h>
+#include <engine/storage.h>
+
+#include <game/server/entities/character.h>
+#include <game/server/gamecontext.h>
+#include <game/server/player.h>
+#include <game/server/teehistorian.h>
+#include <game/version.h>
+
+bool IsInterrupted()
+{
+	return false;
+}
+
+class CReplay
+{
+	CServer *m_pServer;
+	CGameContext *m_pGameServer;
+	IConsole *m_pConsole;
+
+	CServer::CSnapshotTimings m_SnapshotTimings;
+	int64_t m_InputTime = 0;
+	int64_t m_TickTime = 0;
+	int64_t m_SnapshotTime = 0;
+
+	int m_NumTicks = 0;
+	int m_NumChecked = 0;
+	int m_NumDesyncs = 0;
+	int m_FirstDesyncTick = -1;
+	int m_FirstDesyncClientID = -1;
+
+	bool m_aHasInput[MAX_CLIENTS] = {};
+	CNetObj_PlayerInput m_aInputs[MAX_CLIENTS];
+
+	void Enter(int ClientID);
+	void Desync(int Tick, int ClientID);
+	void RunTick();
+
+public:
+	CReplay(CServer *pServer, CGameContext *pGameServer, IConsole *pConsole) :
+		m_pServer(pServer), m_pGameServer(pGameServer), m_pConsole(pConsole)
+	{
+	}
+
+	bool Start();
+	void OnItem(const CTeeHistorianReader::CItem *pItem);
+	void Report(int64_t Time);
+};
+
+bool CReplay::Start()
+{
+	CServer *pServer = m_pServer;
+
+	// like CServer::Run, without the network and the databases
+	pServer->m_RunServer = CServer::RUNNING;
+	pServer->m_AuthManager.Init();
+	for(auto &Client : pServer->m_aClients)
+	{
+		Client.m_HasPersistentData = false;
+		Client.m_pPersistentData = malloc(m_pGameServer->PersistentClientDataSize());
+	}
+	pServer->InitSnapshotLanes();
+	pServer->m_pSnapshotTimings = &m_SnapshotTimings;
+
+	if(!pServer->LoadMap(g_Config.m_SvMap))
+	{
+		dbg_msg("teehistorian_replay", "failed to load map '%s'", g_Config.m_SvMap);
+		return false;
+	}
+
+	// the game sends to the players, nobody is connected
+	pServer->m_NetServer.OpenOffline(&pServer->m_ServerBan, MAX_CLIENTS, MAX_CLIENTS);
+	pServer->m_NetServer.SetCallbacks(CServer::NewClientCallback, CServer::NewClientNoAuthCallback, CServer::ClientRejoinCallback, CServer::DelClientCallback, pServer);
+
+	pServer->Antibot()->Init();
+	m_pGameServer->OnInit();
+	m_pConsole->StoreCommands(false);
+	return !pServer->ErrorShutdown();
+}
+
+void CReplay::Enter(int ClientID)
+{
+	CServer::CClient *pClient = &m_pServer->m_aClients[ClientID];
+	if(pClient->m_State != CServer::CClient::STATE_READY)
+		return;
+	pClient->m_State = CServer::CClient::STATE_INGAME;
+	m_pGameServer->OnClientEnter(ClientID);
+}
+
+void CReplay::Desync(int Tick, int ClientID)
+{
+	if(m_NumDesyncs++ == 0)
+	{
+		m_FirstDesyncTick = Tick;
+		m_FirstDesyncClientID = ClientID;
+	}
+}
+
+void CReplay::OnItem(const CTeeHistorianReader::CItem *pItem)
+{
+	CServer::CClient *pClient = pItem->m_ClientID >= 0 ? &m_pServer->m_aClients[pItem->m_ClientID] : nullptr;
+
+	int64_t Start = time_get();
+	switch(pItem->m_Type)
+	{
+	case CTeeHistorianReader::ITEM_TICK:
+		while(m_pServer->Tick() < pItem->m_Tick && !m_pServer->ErrorShutdown())
+			RunTick();
+		return;
+	case CTeeHistorianReader::ITEM_PLAYER:
+	case CTeeHistorianReader::ITEM_PLAYER_DEAD:
+	{
+		// recorded at the end of the tick
+		CPlayer *pPlayer = m_pGameServer->m_apPlayers[pItem->m_ClientID];
+		CCharacter *pChr = pPlayer ? pPlayer->GetCharacter() : nullptr;
+		m_NumChecked++;
+		if(pItem->m_Type == CTeeHistorianReader::ITEM_PLAYER_DEAD)
+		{
+			if(pChr)
+				Desync(pItem->m_Tick, pItem->m_ClientID);
+		}
+		else
+		{
+			CNetObj_CharacterCore Core;
+			if(pChr)
+				pChr->GetCore().Write(&Core);
+			if(!pChr || Core.m_X != pItem->m_X || Core.m_Y != pItem->m_Y)
+				Desync(pItem->m_Tick, pItem->m_ClientID);
+		}
+		return;
+	}
+	case CTeeHistorianReader::ITEM_JOIN:
+		// the handshake isn't recorded, the player is ready to join the game
+		CServer::NewClientCallback(pItem->m_ClientID, m_pServer, pItem->m_Protocol == CTeeHistorian::PROTOCOL_7);
+		pClient->m_State = CServer::CClient::STATE_READY;
+		m_pGameServer->OnClientConnected(pItem->m_ClientID, nullptr);
+		break;
+	case CTeeHistorianReader::ITEM_PLAYER_READY:
+		Enter(pItem->m_ClientID);
+		break;
+	case CTeeHistorianReader::ITEM_DDNET_VERSION:
+		// also recorded when the game got it from a legacy message
+		if(pClient->m_DDNetVersionSettled || pClient->m_State != CServer::CClient::STATE_INGAME)
+			break;
+		pClient->m_DDNetVersion = pItem->m_DDNetVersion;
+		pClient->m_DDNetVersionSettled = true;
+		if(pItem->m_pString)
+		{
+			pClient->m_GotDDNetVersionPacket = true;
+			str_copy(pClient->m_aDDNetVersionStr, pItem->m_pString);
+		}
+		m_pGameServer->OnClientDDNetVersionKnown(pItem->m_ClientID);
+		break;
+	case CTeeHistorianReader::ITEM_DROP:
+		// kicks by the game already dropped the player
+		if(pClient->m_State != CServer::CClient::STATE_EMPTY)
+			CServer::DelClientCallback(pItem->m_ClientID, pItem->m_pString, m_pServer);
+		break;
+	case CTeeHistorianReader::ITEM_MESSAGE:
+	{
+		if(pClient->m_State < CServer::CClient::STATE_READY)
+			break;
+		CUnpacker Unpacker;
+		Unpacker.Reset(pItem->m_pData, pItem->m_DataSize);
+		CMsgPacker Packer(NETMSG_EX, true);
+		int Msg;
+		bool Sys;
+		CUuid Uuid;
+		if(UnpackMessageID(&Msg, &Sys, &Uuid, &Unpacker, &Packer) != UNPACKMESSAGE_ERROR && !Sys)
+			m_pGameServer->OnMessage(Msg, &Unpacker, pItem->m_ClientID);
+		break;
+	}
+	case CTeeHistorianReader::ITEM_INPUT:
+		// older files don't record when players enter the game
+		Enter(pItem->m_ClientID);
+		m_aHasInput[pItem->m_ClientID] = true;
+		m_aInputs[pItem->m_ClientID] = pItem->m_Input;
+		if(pClient->m_State == CServer::CClient::STATE_INGAME)
+			m_pGameServer->OnClientDirectInput(pItem->m_ClientID, &m_aInputs[pItem->m_ClientID]);
+		break;
+	case CTeeHistorianReader::ITEM_CONSOLE_COMMAND:
+	{
+		// chat commands and votes are run again by the replayed messages,
+		// only rcon commands come from outside of the game
+		if(pItem->m_ClientID < 0 || pItem->m_FlagMask & CFGFLAG_CHAT)
+			break;
+		char aLine[1024];
+		str_copy(aLine, pItem->m_pString);
+		for(int i = 0; i < pItem->m_NumArgs; i++)
+		{
+			str_append(aLine, " \"", sizeof(aLine));
+			char *pDst = aLine + str_length(aLine);
+			str_escape(&pDst, pItem->m_apArgs[i], aLine + sizeof(aLine) - 1);
+			str_append(aLine, "\"", sizeof(aLine));
+		}
+		m_pConsole->ExecuteLineFlag(aLine, pItem->m_FlagMask, pItem->m_ClientID);
+		break;
+	}
+	default:
+		return;
+	}
+	m_InputTime += time_get() - Start;
+}
+
+void CReplay::RunTick()
+{
+	CServer *pServer = m_pServer;
+
+	// like CServer::Run, the recorded input of a tick is applied before the next one
+	int64_t Start = time_get();
+	for(int c = 0; c < MAX_CLIENTS; c++)
+	{
+		if(pServer->m_aClients[c].m_State == CServer::CClient::STATE_INGAME)
+			m_pGameServer->OnClientPredictedEarlyInput(c, m_aHasInput[c] ? &m_aInputs[c] : nullptr);
+	}
+	pServer->AdvanceTick();
+	for(int c = 0; c < MAX_CLIENTS; c++)
+	{
+		if(pServer->m_aClients[c].m_State == CServer::CClient::STATE_INGAME)
+			m_pGameServer->OnClientPredictedInput(c, m_aHasInput[c] ? &m_aInputs[c] : nullptr);
+		m_aHasInput[c] = false;
+	}
+	int64_t TickStart = time_get();
+	m_InputTime += TickStart - Start;
+
+	m_pGameServer->OnTick();
+	int64_t SnapshotStart = time_get();
+	m_TickTime += SnapshotStart - TickStart;
+	m_NumTicks++;
+
+	if(g_Config.m_SvHighBandwidth || (pServer->Tick() % 2) == 0)
+	{
+		// every player acked the last snapshot
+		for(auto &Client : pServer->m_aClients)
+		{
+			if(Client.m_State == CServer::CClient::STATE_INGAME && Client.m_Snapshots.m_pLast)
+			{
+				Client.m_LastAckedSnapshot = Client.m_Snapshots.m_pLast->m_Tick;
+				Client.m_SnapRate = CServer::CClient::SNAPRATE_FULL;
+			}
+		}
+		pServer->DoSnapshot();
+		m_SnapshotTime += time_get() - SnapshotStart;
+	}
+}
+
+void CReplay::Report(int64_t Time)
+{
+	const double Ms = 1000.0 / time_freq();
+	const double Seconds = (double)Time / time_freq();
+	dbg_msg("teehistorian_replay", "ticks: %d in %.3fs, %.0f ticks/s, %.1fx real time", m_NumTicks, Seconds, m_NumTicks / Seconds, m_NumTicks / Seconds / SERVER_TICK_SPEED);
+	dbg_msg("teehistorian_replay", "input apply:    %10.3f ms", m_InputTime * Ms);
+	dbg_msg("teehistorian_replay", "world tick:     %10.3f ms", m_TickTime * Ms);
+	dbg_msg("teehistorian_replay", "snapshots:      %10.3f ms, %d snapshots", m_SnapshotTime * Ms, m_SnapshotTimings.m_NumSnapshots);
+	dbg_msg("teehistorian_replay", "  build:        %10.3f ms", m_SnapshotTimings.m_Build * Ms);
+	// summed up over all lanes
+	dbg_msg("teehistorian_replay", "  delta:        %10.3f ms", m_SnapshotTimings.m_Delta.load() * Ms);
+	dbg_msg("teehistorian_replay", "  compress:     %10.3f ms", m_SnapshotTimings.m_Compress.load() * Ms);
+	if(m_NumDesyncs)
+		dbg_msg("teehistorian_replay", "desyncs: %d of %d recorded positions, first at tick %d, cid=%d", m_NumDesyncs, m_NumChecked, m_FirstDesyncTick, m_FirstDesyncClientID);
+	else
+		dbg_msg("teehistorian_replay", "no desyncs in %d recorded positions", m_NumChecked);
+}
+
+// the server settings that differ from the defaults are in the header
+static bool ApplyHeader(const char *pHeader, IConsole *pConsole)
+{
+	json_value *pJson = json_parse(pHeader, str_length(pHeader));
+	if(!pJson || pJson->type != json_object)
+	{
+		json_value_free(pJson);
+		return false;
+	}
+
+	char aLine[1024];
+	const json_value &Config = *json_object_get(pJson, "config");
+	if(Config.type == json_object)
+	{
+		for(unsigned i = 0; i < Config.u.object.length; i++)
+		{
+			if(Config.u.object.values[i].value->type != json_string)
+				continue;
+			str_format(aLine, sizeof(aLine), "%s \"", Config.u.object.values[i].name);
+			char *pDst = aLine + str_length(aLine);
+			str_escape(&pDst, json_string_get(Config.u.object.values[i].value), aLine + sizeof(aLine) - 1);
+			str_append(aLine, "\"", sizeof(aLine));
+			pConsole->ExecuteLine(aLine);
+		}
+	}
+	const json_value &Tuning = *json_object_get(pJson, "tuning");
+	if(Tuning.type == json_object)
+	{
+		for(unsigned i = 0; i < Tuning.u.object.length; i++)
+		{
+			if(Tuning.u.object.values[i].value->type != json_string)
+				continue;
+			str_format(aLine, sizeof(aLine), "tune %s %.2f", Tuning.u.object.values[i].name, str_toint(json_string_get(Tuning.u.object.values[i].value)) / 100.0f);
+			pConsole->ExecuteLine(aLine);
+		}
+	}
+	const json_value &MapName = *json_object_get(pJson, "map_name");
+	if(MapName.type == json_string)
+		str_copy(g_Config.m_SvMap, json_string_get(&MapName));
+	json_value_free(pJson);
+	return true;
+}
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+
+	if(argc < 2)
+	{
+		dbg_msg("usage", "%s <teehistorian> [map]", argv[0]);
+		return -1;
+	}
+
+	IOHANDLE File = io_open(argv[1], IOFLAG_READ);
+	if(!File)
+	{
+		dbg_msg("teehistorian_replay", "failed to open '%s'", argv[1]);
+		return -1;
+	}
+	void *pData;
+	unsigned DataSize;
+	io_read_all(File, &pData, &DataSize);
+	io_close(File);
+
+	CTeeHistorianReader Reader;
+	if(!Reader.Open(pData, DataSize))
+	{
+		dbg_msg("teehistorian_replay", "'%s' is not a teehistorian file", argv[1]);
+		free(pData);
+		return -1;
+	}
+
+	secure_random_init();
+
+	CServer *pServer = CreateServer();
+	IKernel *pKernel = IKernel::Create();
+	IEngine *pEngine = CreateEngine(GAME_NAME, nullptr, 3);
+	IEngineMap *pEngineMap = CreateEngineMap();
+	IGameServer *pGameServer = CreateGameServer();
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER | CFGFLAG_ECON);
+	IStorage *pStorage = CreateStorage(IStorage::STORAGETYPE_SERVER, argc, argv);
+	IConfigManager *pConfigManager = CreateConfigManager();
+	IEngineAntibot *pEngineAntibot = CreateEngineAntibot();
+
+	bool RegisterFail = false;
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(pServer);
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(pEngine);
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(pEngineMap); // register as both
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IMap *>(pEngineMap), false);
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(pGameServer);
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(pConsole);
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(pStorage);
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(pConfigManager);
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(pEngineAntibot);
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IAntibot *>(pEngineAntibot), false);
+	if(RegisterFail)
+	{
+		delete pKernel;
+		free(pData);
+		return -1;
+	}
+
+	pEngine->Init();
+	pConfigManager->Init();
+	pConsole->Init();
+	pServer->RegisterCommands();
+
+	if(!ApplyHeader(Reader.Header(), pConsole))
+	{
+		dbg_msg("teehistorian_replay", "invalid header");
+		delete pKernel;
+		free(pData);
+		return -1;
+	}
+	if(argc > 2)
+		str_copy(g_Config.m_SvMap, argv[2]);
+	// don't record the replay
+	g_Config.m_SvTeeHistorian = 0;
+	log_set_loglevel(LEVEL_WARN);
+
+	int Ret = 0;
+	CReplay Replay(pServer, (CGameContext *)pGameServer, pConsole);
+	if(Replay.Start())
+	{
+		int64_t Start = time_get();
+		CTeeHistorianReader::CItem Item;
+		while(Reader.Read(&Item) && !pServer->ErrorShutdown())
+			Replay.OnItem(&Item);
+		int64_t Time = time_get() - Start;
+
+		log_set_loglevel(LEVEL_INFO);
+		if(Reader.Error())
+		{
+			dbg_msg("teehistorian_replay", "broken teehistorian file");
+			Ret = 1;
+		}
+		Replay.Report(Time);
+	}
+	else
+	{
+		Ret = -1;
+	}
+
+	delete pKernel;
+	free(pData);
+	return Ret;
+}
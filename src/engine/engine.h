@@ -35,7 +35,11 @@ public:
 	virtual ~IEngine() = default;
 
 	virtual void Init() = 0;
-	virtual void AddJob(std::shared_ptr<IJob> pJob) = 0;
+	// most jobs wait for the network or the disk, jobs the game waits for
+	// should be added with CJobPool::PRIORITY_INTERACTIVE
+	virtual void AddJob(std::shared_ptr<IJob> pJob, int Priority = CJobPool::PRIORITY_BACKGROUND) = 0;
+	// see CJobPool::ParallelFor
+	virtual void ParallelFor(int Num, const std::function<void(int)> &Func) = 0;
 	virtual void SetAdditionalLogger(std::unique_ptr<ILogger> &&pLogger) = 0;
 	static void RunJobBlocking(IJob *pJob);
 };
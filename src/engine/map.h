@@ -19,6 +19,8 @@ public:
 	virtual int GetDataSize(int Index) = 0;
 	virtual void *GetDataSwapped(int Index) = 0;
 	virtual void UnloadData(int Index) = 0;
+	// loads the data of several indices at once, in parallel if possible
+	virtual void LoadData(const int *pIndices, int NumIndices) = 0;
 	virtual void *GetItem(int Index, int *pType, int *pID) = 0;
 	virtual int GetItemSize(int Index) = 0;
 	virtual void GetType(int Type, int *pStart, int *pNum) = 0;
@@ -213,6 +213,7 @@ public:
 	virtual int SnapNewID() = 0;
 	virtual void SnapFreeID(int ID) = 0;
 	virtual void *SnapNewItem(int Type, int ID, int Size) = 0;
+	virtual bool SnapNewItems(const void *pItems, int Size, const int *pOffsets, int NumItems) = 0;
 
 	virtual void SnapSetStaticsize(int ItemType, int Size) = 0;
 
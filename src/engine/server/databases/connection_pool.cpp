@@ -1,11 +1,15 @@
 #include "connection_pool.h"
 #include "connection.h"
 
+#include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
+#include <engine/console.h>
 
 #include <chrono>
 #include <iterator>
 #include <memory>
+#include <mutex>
 #include <thread>
 
 using namespace std::chrono_literals;
@@ -36,6 +40,7 @@ struct CSqlExecData
 
 	std::unique_ptr<const ISqlData> m_pThreadData;
 	const char *m_pName;
+	int64_t m_QueueTime;
 };
 
 CSqlExecData::CSqlExecData(
@@ -44,7 +49,8 @@ CSqlExecData::CSqlExecData(
 	const char *pName) :
 	m_Mode(READ_ACCESS),
 	m_pThreadData(std::move(pThreadData)),
-	m_pName(pName)
+	m_pName(pName),
+	m_QueueTime(time_get())
 {
 	m_Ptr.m_pReadFunc = pFunc;
 }
@@ -55,17 +61,129 @@ CSqlExecData::CSqlExecData(
 	const char *pName) :
 	m_Mode(WRITE_ACCESS),
 	m_pThreadData(std::move(pThreadData)),
-	m_pName(pName)
+	m_pName(pName),
+	m_QueueTime(time_get())
 {
 	m_Ptr.m_pWriteFunc = pFunc;
 }
 
-CDbConnectionPool::CDbConnectionPool() :
+static void UpdateMax(std::atomic<int64_t> &Max, int64_t Value)
+{
+	int64_t Prev = Max.load();
+	while(Prev < Value && !Max.compare_exchange_weak(Prev, Value))
+	{
+	}
+}
 
-	m_FirstElem(0),
-	m_LastElem(0)
+// requests waiting for a worker, they are only added by the main thread
+class CDbConnectionPool::CLane
+{
+public:
+	CLane(const char *pName) :
+		m_pName(pName)
+	{
+	}
+
+	void Push(std::unique_ptr<CSqlExecData> pData)
+	{
+		m_aTasks[m_FirstElem++] = std::move(pData);
+		m_FirstElem %= std::size(m_aTasks);
+		UpdateMax(m_MaxDepth, m_NumElem.GetApproximateValue() + 1);
+		m_NumElem.Signal();
+	}
+
+	std::unique_ptr<CSqlExecData> Pop()
+	{
+		m_NumElem.Wait();
+		// several workers can take from the same lane
+		std::lock_guard<std::mutex> Lock(m_Lock);
+		auto pData = std::move(m_aTasks[m_LastElem++]);
+		m_LastElem %= std::size(m_aTasks);
+		return pData;
+	}
+
+	void Done(const CSqlExecData *pData, int64_t StartTime)
+	{
+		const int64_t Now = time_get();
+		m_NumDone.fetch_add(1);
+		m_WaitTime.fetch_add(StartTime - pData->m_QueueTime);
+		UpdateMax(m_MaxWaitTime, StartTime - pData->m_QueueTime);
+		m_RunTime.fetch_add(Now - StartTime);
+		UpdateMax(m_MaxRunTime, Now - StartTime);
+	}
+
+	void Print(IConsole *pConsole, int NumWorkers)
+	{
+		const int NumDone = m_NumDone.load();
+		const double Ms = 1000.0 / time_freq() / maximum(NumDone, 1);
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf),
+			"%s queue: %d workers, %d pending (max %d), %d done, wait avg %.2fms max %.2fms, run avg %.2fms max %.2fms",
+			m_pName, NumWorkers, m_NumElem.GetApproximateValue(), (int)m_MaxDepth.load(), NumDone,
+			m_WaitTime.load() * Ms, m_MaxWaitTime.load() * 1000.0 / time_freq(),
+			m_RunTime.load() * Ms, m_MaxRunTime.load() * 1000.0 / time_freq());
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
+
+	const char *m_pName;
+	CSemaphore m_NumElem;
+	std::mutex m_Lock;
+	int m_FirstElem = 0;
+	int m_LastElem = 0;
+	std::unique_ptr<CSqlExecData> m_aTasks[512];
+
+	// enter fail mode when a sql request fails, skip read request during it and
+	// write to the backup database until all requests of the lane are handled
+	std::atomic_bool m_FailMode{false};
+
+	std::atomic<int64_t> m_MaxDepth{0};
+	std::atomic_int m_NumDone{0};
+	std::atomic<int64_t> m_WaitTime{0};
+	std::atomic<int64_t> m_MaxWaitTime{0};
+	std::atomic<int64_t> m_RunTime{0};
+	std::atomic<int64_t> m_MaxRunTime{0};
+};
+
+// a thread with its own connections to the databases of its lane
+class CDbConnectionPool::CWorker
+{
+public:
+	CWorker(CDbConnectionPool *pPool, CLane *pLane, bool Read) :
+		m_pPool(pPool),
+		m_pLane(pLane),
+		m_Read(Read)
+	{
+	}
+
+	bool Uses(int DatabaseMode) const { return m_Read == (DatabaseMode == Mode::READ); }
+
+	// takes the databases registered since the last request
+	void TakeRegistered()
+	{
+		std::lock_guard<std::mutex> Lock(m_RegisterLock);
+		for(int DatabaseMode = 0; DatabaseMode < NUM_MODES; DatabaseMode++)
+		{
+			for(auto &pDatabase : m_vvpRegistered[DatabaseMode])
+				m_vvpDbConnections[DatabaseMode].push_back(std::move(pDatabase));
+			m_vvpRegistered[DatabaseMode].clear();
+		}
+	}
+
+	CDbConnectionPool *m_pPool;
+	CLane *m_pLane;
+	bool m_Read;
+	// only used by the worker thread
+	std::vector<std::unique_ptr<IDbConnection>> m_vvpDbConnections[NUM_MODES];
+	// databases registered while the worker runs, so registering doesn't
+	// wait for the request the worker is working on
+	std::mutex m_RegisterLock;
+	std::vector<std::unique_ptr<IDbConnection>> m_vvpRegistered[NUM_MODES];
+};
+
+CDbConnectionPool::CDbConnectionPool() :
+	m_pReadLane(std::make_unique<CLane>("Read")),
+	m_pWriteLane(std::make_unique<CLane>("Write"))
 {
-	thread_init_and_detach(CDbConnectionPool::Worker, this, "database worker thread");
 }
 
 CDbConnectionPool::~CDbConnectionPool() = default;
@@ -77,23 +195,60 @@ void CDbConnectionPool::Print(IConsole *pConsole, Mode DatabaseMode)
 	{
 		m_vvpDbConnections[DatabaseMode][i]->Print(pConsole, s_apModeDesc[DatabaseMode]);
 	}
+
+	if(DatabaseMode == Mode::WRITE_BACKUP)
+		return;
+	int NumWorkers = 0;
+	for(auto &pWorker : m_vpWorkers)
+	{
+		if(pWorker->Uses(DatabaseMode))
+			NumWorkers++;
+	}
+	(DatabaseMode == Mode::READ ? m_pReadLane : m_pWriteLane)->Print(pConsole, NumWorkers);
 }
 
 void CDbConnectionPool::RegisterDatabase(std::unique_ptr<IDbConnection> pDatabase, Mode DatabaseMode)
 {
 	if(DatabaseMode < 0 || NUM_MODES <= DatabaseMode)
 		return;
+	for(auto &pWorker : m_vpWorkers)
+	{
+		if(pWorker->Uses(DatabaseMode))
+		{
+			std::lock_guard<std::mutex> Lock(pWorker->m_RegisterLock);
+			pWorker->m_vvpRegistered[DatabaseMode].emplace_back(pDatabase->Copy());
+		}
+	}
 	m_vvpDbConnections[DatabaseMode].push_back(std::move(pDatabase));
 }
 
+void CDbConnectionPool::Start(int NumReadWorkers)
+{
+	dbg_assert(m_vpWorkers.empty(), "database workers already started");
+	m_vpWorkers.push_back(std::make_unique<CWorker>(this, m_pWriteLane.get(), false));
+	for(int i = 0; i < NumReadWorkers; i++)
+		m_vpWorkers.push_back(std::make_unique<CWorker>(this, m_pReadLane.get(), true));
+
+	for(auto &pWorker : m_vpWorkers)
+	{
+		for(int DatabaseMode = 0; DatabaseMode < NUM_MODES; DatabaseMode++)
+		{
+			if(!pWorker->Uses(DatabaseMode))
+				continue;
+			for(auto &pDatabase : m_vvpDbConnections[DatabaseMode])
+				pWorker->m_vvpDbConnections[DatabaseMode].emplace_back(pDatabase->Copy());
+		}
+		m_NumRunning.fetch_add(1);
+		thread_init_and_detach(CDbConnectionPool::Worker, pWorker.get(), pWorker->m_Read ? "database read worker" : "database write worker");
+	}
+}
+
 void CDbConnectionPool::Execute(
 	FRead pFunc,
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_aTasks[m_FirstElem++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_FirstElem %= std::size(m_aTasks);
-	m_NumElem.Signal();
+	m_pReadLane->Push(std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName));
 }
 
 void CDbConnectionPool::ExecuteWrite(
@@ -101,17 +256,17 @@ void CDbConnectionPool::ExecuteWrite(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_aTasks[m_FirstElem++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_FirstElem %= std::size(m_aTasks);
-	m_NumElem.Signal();
+	m_pWriteLane->Push(std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName));
 }
 
 void CDbConnectionPool::OnShutdown()
 {
 	m_Shutdown.store(true);
-	m_NumElem.Signal();
+	// each worker exits on an empty request after the queued ones
+	for(auto &pWorker : m_vpWorkers)
+		pWorker->m_pLane->Push(nullptr);
 	int i = 0;
-	while(m_Shutdown.load())
+	while(m_NumRunning.load() > 0)
 	{
 		// print a log about every two seconds
 		if(i % 20 == 0 && i > 0)
@@ -125,52 +280,51 @@ void CDbConnectionPool::OnShutdown()
 
 void CDbConnectionPool::Worker(void *pUser)
 {
-	CDbConnectionPool *pThis = (CDbConnectionPool *)pUser;
-	pThis->Worker();
+	CWorker *pWorker = (CWorker *)pUser;
+	pWorker->m_pPool->Worker(pWorker);
 }
 
-void CDbConnectionPool::Worker()
+void CDbConnectionPool::Worker(CWorker *pWorker)
 {
+	CLane *pLane = pWorker->m_pLane;
+	auto &vvpDbConnections = pWorker->m_vvpDbConnections;
 	// remember last working server and try to connect to it first
 	int ReadServer = 0;
 	int WriteServer = 0;
-	// enter fail mode when a sql request fails, skip read request during it and
-	// write to the backup database until all requests are handled
-	bool FailMode = false;
 	while(true)
 	{
-		if(FailMode && m_NumElem.GetApproximateValue() == 0)
+		if(pLane->m_FailMode && pLane->m_NumElem.GetApproximateValue() == 0)
 		{
-			FailMode = false;
+			pLane->m_FailMode = false;
 		}
-		m_NumElem.Wait();
-		auto pThreadData = std::move(m_aTasks[m_LastElem++]);
+		auto pThreadData = pLane->Pop();
 		// work through all database jobs after OnShutdown is called before exiting the thread
 		if(pThreadData == nullptr)
 		{
-			m_Shutdown.store(false);
+			m_NumRunning.fetch_sub(1);
 			return;
 		}
-		m_LastElem %= std::size(m_aTasks);
+		const int64_t StartTime = time_get();
+		pWorker->TakeRegistered();
 		bool Success = false;
 		switch(pThreadData->m_Mode)
 		{
 		case CSqlExecData::READ_ACCESS:
 		{
-			for(int i = 0; i < (int)m_vvpDbConnections[Mode::READ].size(); i++)
+			for(int i = 0; i < (int)vvpDbConnections[Mode::READ].size(); i++)
 			{
 				if(m_Shutdown)
 				{
 					dbg_msg("sql", "%s dismissed read request during shutdown", pThreadData->m_pName);
 					break;
 				}
-				if(FailMode)
+				if(pLane->m_FailMode)
 				{
 					dbg_msg("sql", "%s dismissed read request during FailMode", pThreadData->m_pName);
 					break;
 				}
-				int CurServer = (ReadServer + i) % (int)m_vvpDbConnections[Mode::READ].size();
-				if(ExecSqlFunc(m_vvpDbConnections[Mode::READ][CurServer].get(), pThreadData.get(), false))
+				int CurServer = (ReadServer + i) % (int)vvpDbConnections[Mode::READ].size();
+				if(ExecSqlFunc(vvpDbConnections[Mode::READ][CurServer].get(), pThreadData.get(), false))
 				{
 					ReadServer = CurServer;
 					dbg_msg("sql", "%s done on read database %d", pThreadData->m_pName, CurServer);
@@ -180,26 +334,26 @@ void CDbConnectionPool::Worker()
 			}
 			if(!Success)
 			{
-				FailMode = true;
+				pLane->m_FailMode = true;
 			}
 		}
 		break;
 		case CSqlExecData::WRITE_ACCESS:
 		{
-			for(int i = 0; i < (int)m_vvpDbConnections[Mode::WRITE].size(); i++)
+			for(int i = 0; i < (int)vvpDbConnections[Mode::WRITE].size(); i++)
 			{
-				if(m_Shutdown && !m_vvpDbConnections[Mode::WRITE_BACKUP].empty())
+				if(m_Shutdown && !vvpDbConnections[Mode::WRITE_BACKUP].empty())
 				{
 					dbg_msg("sql", "%s skipped to backup database during shutdown", pThreadData->m_pName);
 					break;
 				}
-				if(FailMode && !m_vvpDbConnections[Mode::WRITE_BACKUP].empty())
+				if(pLane->m_FailMode && !vvpDbConnections[Mode::WRITE_BACKUP].empty())
 				{
 					dbg_msg("sql", "%s skipped to backup database during FailMode", pThreadData->m_pName);
 					break;
 				}
-				int CurServer = (WriteServer + i) % (int)m_vvpDbConnections[Mode::WRITE].size();
-				if(ExecSqlFunc(m_vvpDbConnections[Mode::WRITE][i].get(), pThreadData.get(), false))
+				int CurServer = (WriteServer + i) % (int)vvpDbConnections[Mode::WRITE].size();
+				if(ExecSqlFunc(vvpDbConnections[Mode::WRITE][i].get(), pThreadData.get(), false))
 				{
 					WriteServer = CurServer;
 					dbg_msg("sql", "%s done on write database %d", pThreadData->m_pName, CurServer);
@@ -209,10 +363,10 @@ void CDbConnectionPool::Worker()
 			}
 			if(!Success)
 			{
-				FailMode = true;
-				for(int i = 0; i < (int)m_vvpDbConnections[Mode::WRITE_BACKUP].size(); i++)
+				pLane->m_FailMode = true;
+				for(int i = 0; i < (int)vvpDbConnections[Mode::WRITE_BACKUP].size(); i++)
 				{
-					if(ExecSqlFunc(m_vvpDbConnections[Mode::WRITE_BACKUP][i].get(), pThreadData.get(), true))
+					if(ExecSqlFunc(vvpDbConnections[Mode::WRITE_BACKUP][i].get(), pThreadData.get(), true))
 					{
 						dbg_msg("sql", "%s done on write backup database %d", pThreadData->m_pName, i);
 						Success = true;
@@ -225,6 +379,7 @@ void CDbConnectionPool::Worker()
 		}
 		if(!Success)
 			dbg_msg("sql", "%s failed on all databases", pThreadData->m_pName);
+		pLane->Done(pThreadData.get(), StartTime);
 		if(pThreadData->m_pThreadData->m_pResult != nullptr)
 		{
 			pThreadData->m_pThreadData->m_pResult->m_Success = Success;
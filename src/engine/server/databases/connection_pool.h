@@ -2,7 +2,6 @@
 #define ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
 
 #include <atomic>
-#include <base/tl/threading.h>
 #include <memory>
 #include <vector>
 
@@ -52,10 +51,16 @@ public:
 		NUM_MODES,
 	};
 
+	// prints the databases and the queue of the mode
 	void Print(IConsole *pConsole, Mode DatabaseMode);
 
 	void RegisterDatabase(std::unique_ptr<IDbConnection> pDatabase, Mode DatabaseMode);
 
+	// starts the write worker and NumReadWorkers read workers, each with
+	// their own copies of the registered databases. Requests queued before
+	// are kept.
+	void Start(int NumReadWorkers);
+
 	void Execute(
 		FRead pFunc,
 		std::unique_ptr<const ISqlData> pSqlRequestData,
@@ -69,17 +74,22 @@ public:
 	void OnShutdown();
 
 private:
+	class CLane;
+	class CWorker;
+
+	// the registered databases, workers get copies of them
 	std::vector<std::unique_ptr<IDbConnection>> m_vvpDbConnections[NUM_MODES];
 
 	static void Worker(void *pUser);
-	void Worker();
+	void Worker(CWorker *pWorker);
 	bool ExecSqlFunc(IDbConnection *pConnection, struct CSqlExecData *pData, bool Failure);
 
 	std::atomic_bool m_Shutdown{false};
-	CSemaphore m_NumElem;
-	int m_FirstElem;
-	int m_LastElem;
-	std::unique_ptr<struct CSqlExecData> m_aTasks[512];
+	std::atomic_int m_NumRunning{0};
+	// reads are spread over several workers, writes are done in order
+	std::unique_ptr<CLane> m_pReadLane;
+	std::unique_ptr<CLane> m_pWriteLane;
+	std::vector<std::unique_ptr<CWorker>> m_vpWorkers;
 };
 
 #endif // ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
@@ -35,6 +35,7 @@
 
 // DDRace
 #include <engine/shared/linereader.h>
+#include <thread>
 #include <vector>
 #include <zlib.h>
 
@@ -321,17 +322,23 @@ CServer::CServer()
 	m_CurrentGameTick = 0;
 	m_RunServer = UNINITIALIZED;
 
+	m_NumSnapshotLanes = 0;
+	m_pSnapshotTimings = nullptr;
+	m_NumSnapshotClients = 0;
+
 	m_aShutdownReason[0] = 0;
 
 	for(int i = 0; i < NUM_MAP_TYPES; i++)
 	{
 		m_apCurrentMapData[i] = 0;
 		m_aCurrentMapSize[i] = 0;
+		m_aCurrentMapMapped[i] = false;
 	}
 
 	m_MapReload = false;
 	m_ReloadedWhenEmpty = false;
 	m_aCurrentMap[0] = '\0';
+	m_aPreparedMap[0] = '\0';
 
 	m_RconClientID = IServer::RCON_CID_SERV;
 	m_RconAuthLevel = AUTHED_ADMIN;
@@ -354,9 +361,9 @@ CServer::CServer()
 
 CServer::~CServer()
 {
-	for(auto &pCurrentMapData : m_apCurrentMapData)
+	for(int i = 0; i < NUM_MAP_TYPES; i++)
 	{
-		free(pCurrentMapData);
+		FreeMapData(i);
 	}
 
 	if(m_RunServer != UNINITIALIZED)
@@ -882,6 +889,15 @@ void CServer::SendMsgRaw(int ClientID, const void *pData, int Size, int Flags)
 	m_NetServer.Send(&Packet);
 }
 
+void CServer::InitSnapshotLanes()
+{
+	m_NumSnapshotLanes = Config()->m_SvSnapshotThreads ? Config()->m_SvSnapshotThreads : std::thread::hardware_concurrency();
+	m_NumSnapshotLanes = clamp(m_NumSnapshotLanes, 1, (int)MAX_SNAPSHOT_LANES);
+	m_pSnapshotLanes = std::make_unique<CSnapshotLane[]>(m_NumSnapshotLanes);
+	m_pSnapshotResults.reset(new CSnapshotResult[MAX_CLIENTS]); // left uninitialized, most of each buffer is never touched
+	m_SnapshotJobPool.Init(m_NumSnapshotLanes - 1);
+}
+
 void CServer::DoSnapshot()
 {
 	GameServer()->OnPreSnap();
@@ -900,7 +916,8 @@ void CServer::DoSnapshot()
 		m_aDemoRecorder[MAX_CLIENTS].RecordSnapshot(Tick(), aData, SnapshotSize);
 	}
 
-	// create snapshots for all clients
+	// build the snapshots for all clients, the game's snap code isn't thread safe
+	m_NumSnapshotClients = 0;
 	for(int i = 0; i < MaxClients(); i++)
 	{
 		// client must be ingame to receive snapshots
@@ -915,104 +932,179 @@ void CServer::DoSnapshot()
 		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_INIT && (Tick() % 10) != 0)
 			continue;
 
+		const int64_t BuildStart = m_pSnapshotTimings ? time_get() : 0;
+		m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
+
+		GameServer()->OnSnap(i);
+
+		// finish snapshot
+		CSnapshotResult *pResult = &m_pSnapshotResults[i];
+		pResult->m_SnapshotSize = m_SnapshotBuilder.Finish(pResult->m_aData);
+		pResult->m_Crc = ((CSnapshot *)pResult->m_aData)->Crc();
+		if(m_pSnapshotTimings)
 		{
-			m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
+			m_pSnapshotTimings->m_Build += time_get() - BuildStart;
+			m_pSnapshotTimings->m_NumSnapshots++;
+		}
 
-			GameServer()->OnSnap(i);
+		if(m_aDemoRecorder[i].IsRecording())
+		{
+			// write snapshot
+			m_aDemoRecorder[i].RecordSnapshot(Tick(), pResult->m_aData, pResult->m_SnapshotSize);
+		}
 
-			// finish snapshot
-			char aData[CSnapshot::MAX_SIZE];
-			CSnapshot *pData = (CSnapshot *)aData; // Fix compiler warning for strict-aliasing
-			int SnapshotSize = m_SnapshotBuilder.Finish(pData);
+		PrepareDelta(i, m_NumSnapshotClients);
+		m_aSnapshotClients[m_NumSnapshotClients++] = i;
+	}
 
-			if(m_aDemoRecorder[i].IsRecording())
-			{
-				// write snapshot
-				m_aDemoRecorder[i].RecordSnapshot(Tick(), aData, SnapshotSize);
-			}
+	// delta and compress them on all lanes, the main thread works on one of them
+	m_NextSnapshotClient = 0;
+	m_SnapshotJobPool.ParallelFor(minimum(m_NumSnapshotLanes, m_NumSnapshotClients), [this](int Lane) { CompressSnapshots(Lane); });
 
-			int Crc = pData->Crc();
+	// and send them in client order, no matter which lane finished first
+	for(int n = 0; n < m_NumSnapshotClients; n++)
+		SendSnapshot(m_aSnapshotClients[n]);
 
-			// remove old snapshots
-			// keep 3 seconds worth of snapshots
-			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick - SERVER_TICK_SPEED * 3);
+	GameServer()->OnPostSnap();
+}
 
-			// save the snapshot
-			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0, nullptr);
+void CServer::CompressSnapshots(int Lane)
+{
+	// clients are handed out one by one, so a lane that got small snapshots takes more of them
+	int n;
+	while((n = m_NextSnapshotClient.fetch_add(1)) < m_NumSnapshotClients)
+		CompressSnapshot(m_aSnapshotClients[n], &m_pSnapshotLanes[Lane]);
+}
 
-			// find snapshot that we can perform delta against
-			static CSnapshot s_EmptySnap;
-			s_EmptySnap.Clear();
+void CServer::PrepareDelta(int ClientID, int NumPrepared)
+{
+	CClient *pClient = &m_aClients[ClientID];
+	CSnapshotResult *pResult = &m_pSnapshotResults[ClientID];
 
-			int DeltaTick = -1;
-			CSnapshot *pDeltashot = &s_EmptySnap;
-			{
-				int DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
-				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
-				else
-				{
-					// no acked package found, force client to recover rate
-					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
-						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
-				}
-			}
+	// remove old snapshots
+	// keep 3 seconds worth of snapshots
+	pClient->m_Snapshots.PurgeUntil(m_CurrentGameTick - SERVER_TICK_SPEED * 3);
 
-			// create delta
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, m_aClients[i].m_Sixup);
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, m_aClients[i].m_Sixup);
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			int DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+	// find snapshot that we can perform delta against
+	m_EmptySnap.Clear();
 
-			if(DeltaSize)
-			{
-				// compress it
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+	pResult->m_DeltaTick = -1;
+	pResult->m_pDeltashot = &m_EmptySnap;
+	pResult->m_pDeltashotHash = nullptr;
+	{
+		int DeltashotSize = pClient->m_Snapshots.Get(pClient->m_LastAckedSnapshot, 0, &pResult->m_pDeltashot, 0, &pResult->m_pDeltashotHash);
+		if(DeltashotSize >= 0)
+		{
+			pResult->m_DeltaTick = pClient->m_LastAckedSnapshot;
+			pResult->m_DeltashotSize = DeltashotSize;
+		}
+		else
+		{
+			pResult->m_DeltashotSize = sizeof(CSnapshot);
 
-				char aCompData[CSnapshot::MAX_SIZE];
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
+			// no acked package found, force client to recover rate
+			if(pClient->m_SnapRate == CClient::SNAPRATE_FULL)
+				pClient->m_SnapRate = CClient::SNAPRATE_RECOVER;
+		}
+	}
 
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
+	// reuse the delta of an earlier client if it would come out the same
+	pResult->m_DeltaSource = ClientID;
+	for(int n = 0; n < NumPrepared; n++)
+	{
+		const int Other = m_aSnapshotClients[n];
+		const CSnapshotResult *pOther = &m_pSnapshotResults[Other];
+		if(pOther->m_DeltaSource != Other ||
+			m_aClients[Other].m_Sixup != pClient->m_Sixup ||
+			pOther->m_Crc != pResult->m_Crc ||
+			pOther->m_SnapshotSize != pResult->m_SnapshotSize ||
+			pOther->m_DeltashotSize != pResult->m_DeltashotSize)
+			continue;
+		if(mem_comp(pOther->m_aData, pResult->m_aData, pResult->m_SnapshotSize) == 0 &&
+			mem_comp(pOther->m_pDeltashot, pResult->m_pDeltashot, pResult->m_DeltashotSize) == 0)
+		{
+			pResult->m_DeltaSource = Other;
+			break;
+		}
+	}
+}
 
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-				}
+void CServer::CompressSnapshot(int ClientID, CSnapshotLane *pLane)
+{
+	CClient *pClient = &m_aClients[ClientID];
+	CSnapshotResult *pResult = &m_pSnapshotResults[ClientID];
+	CSnapshot *pData = (CSnapshot *)pResult->m_aData;
+
+	// save the snapshot
+	pClient->m_Snapshots.Add(m_CurrentGameTick, time_get(), pResult->m_SnapshotSize, pData, 0, nullptr);
+	if(pResult->m_DeltaSource != ClientID)
+		return;
+
+	// create delta, the stored snapshot already has its items hashed
+	pLane->m_Delta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, pClient->m_Sixup);
+	pLane->m_Delta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, pClient->m_Sixup);
+	const int64_t DeltaStart = m_pSnapshotTimings ? time_get() : 0;
+	int DeltaSize = pLane->m_Delta.CreateDelta(pResult->m_pDeltashot, pData, pLane->m_aDeltaData, pResult->m_pDeltashotHash, pClient->m_Snapshots.m_pLast->m_pSnapHash);
+
+	// compress it
+	const int64_t CompressStart = m_pSnapshotTimings ? time_get() : 0;
+	pResult->m_CompSize = 0;
+	if(DeltaSize)
+		pResult->m_CompSize = CVariableInt::Compress(pLane->m_aDeltaData, DeltaSize, pResult->m_aCompData, sizeof(pResult->m_aCompData));
+
+	if(m_pSnapshotTimings)
+	{
+		m_pSnapshotTimings->m_Delta += CompressStart - DeltaStart;
+		m_pSnapshotTimings->m_Compress += time_get() - CompressStart;
+	}
+}
+
+void CServer::SendSnapshot(int ClientID)
+{
+	const int DeltaTick = m_pSnapshotResults[ClientID].m_DeltaTick;
+	const CSnapshotResult *pResult = &m_pSnapshotResults[m_pSnapshotResults[ClientID].m_DeltaSource];
+
+	if(pResult->m_CompSize)
+	{
+		const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+		int NumPackets = (pResult->m_CompSize + MaxSize - 1) / MaxSize;
+
+		for(int n = 0, Left = pResult->m_CompSize; Left > 0; n++)
+		{
+			int Chunk = Left < MaxSize ? Left : MaxSize;
+			Left -= Chunk;
+
+			if(NumPackets == 1)
+			{
+				CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick - DeltaTick);
+				Msg.AddInt(pResult->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pResult->m_aCompData[n * MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientID);
 			}
 			else
 			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+				CMsgPacker Msg(NETMSG_SNAP, true);
 				Msg.AddInt(m_CurrentGameTick);
 				Msg.AddInt(m_CurrentGameTick - DeltaTick);
-				SendMsg(&Msg, MSGFLAG_FLUSH, i);
+				Msg.AddInt(NumPackets);
+				Msg.AddInt(n);
+				Msg.AddInt(pResult->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pResult->m_aCompData[n * MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientID);
 			}
 		}
 	}
-
-	GameServer()->OnPostSnap();
+	else
+	{
+		CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+		Msg.AddInt(m_CurrentGameTick);
+		Msg.AddInt(m_CurrentGameTick - DeltaTick);
+		SendMsg(&Msg, MSGFLAG_FLUSH, ClientID);
+	}
 }
 
 int CServer::ClientRejoinCallback(int ClientID, void *pUser)
@@ -1183,6 +1275,7 @@ void CServer::SendRconType(int ClientID, bool UsernameReq)
 
 void CServer::GetMapInfo(char *pMapName, int MapNameSize, int *pMapSize, SHA256_DIGEST *pMapSha256, int *pMapCrc)
 {
+	WaitMapHashes();
 	str_copy(pMapName, GetMapName(), MapNameSize);
 	*pMapSize = m_aCurrentMapSize[MAP_TYPE_SIX];
 	*pMapSha256 = m_aCurrentMapSha256[MAP_TYPE_SIX];
@@ -1199,6 +1292,7 @@ void CServer::SendCapabilities(int ClientID)
 
 void CServer::SendMap(int ClientID)
 {
+	WaitMapHashes();
 	int MapType = IsSixup(ClientID) ? MAP_TYPE_SIXUP : MAP_TYPE_SIX;
 	{
 		CMsgPacker Msg(NETMSG_MAP_DETAILS, true);
@@ -1854,6 +1948,8 @@ void CServer::CCache::Clear()
 
 void CServer::CacheServerInfo(CCache *pCache, int Type, bool SendClients)
 {
+	// the extended info contains the map crc
+	WaitMapHashes();
 	pCache->Clear();
 
 	// One chance to improve the protocol!
@@ -2113,6 +2209,7 @@ void CServer::CacheServerInfoSixup(CCache *pCache, bool SendClients)
 
 void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool SendClients)
 {
+	WaitMapHashes();
 	CPacker p;
 	char aBuf[128];
 	p.Reset();
@@ -2187,6 +2284,10 @@ void CServer::ExpireServerInfo()
 
 void CServer::UpdateRegisterServerInfo()
 {
+	// not registered without the network, e.g. in the teehistorian replay
+	if(!m_pRegister)
+		return;
+
 	// count the players
 	int PlayerCount = 0, ClientCount = 0;
 	for(int i = 0; i < MAX_CLIENTS; i++)
@@ -2273,6 +2374,7 @@ void CServer::UpdateServerInfo(bool Resend)
 	if(m_RunServer == UNINITIALIZED)
 		return;
 
+	WaitMapHashes();
 	UpdateRegisterServerInfo();
 
 	for(int i = 0; i < 3; i++)
@@ -2426,8 +2528,17 @@ int CServer::LoadMap(const char *pMapName)
 	m_MapReload = false;
 
 	char aBuf[IO_MAX_PATH_LENGTH];
-	str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
-	GameServer()->OnMapChange(aBuf, sizeof(aBuf));
+	if(str_comp(m_aPreparedMap, pMapName) == 0)
+	{
+		// the game already added its settings when the map was prepared
+		str_copy(aBuf, m_aPreparedMapPath);
+	}
+	else
+	{
+		str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
+		GameServer()->OnMapChange(aBuf, sizeof(aBuf));
+	}
+	m_aPreparedMap[0] = '\0';
 
 	if(!m_pMap->Load(aBuf))
 		return 0;
@@ -2452,57 +2563,32 @@ int CServer::LoadMap(const char *pMapName)
 	// reinit snapshot ids
 	m_IDPool.TimeoutIDs();
 
-	// get the crc of the map
-	m_aCurrentMapSha256[MAP_TYPE_SIX] = m_pMap->Sha256();
-	m_aCurrentMapCrc[MAP_TYPE_SIX] = m_pMap->Crc();
-	char aBufMsg[256];
-	char aSha256[SHA256_MAXSTRSIZE];
-	sha256_str(m_aCurrentMapSha256[MAP_TYPE_SIX], aSha256, sizeof(aSha256));
-	str_format(aBufMsg, sizeof(aBufMsg), "%s sha256 is %s", aBuf, aSha256);
-	Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBufMsg);
-
 	str_copy(m_aCurrentMap, pMapName);
 
-	// load complete map into memory for download
-	{
-		free(m_apCurrentMapData[MAP_TYPE_SIX]);
-		void *pData;
-		Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &m_aCurrentMapSize[MAP_TYPE_SIX]);
-		m_apCurrentMapData[MAP_TYPE_SIX] = (unsigned char *)pData;
-	}
+	// map the files for download, their checksums are computed in the
+	// background until the first client or the game needs them
+	LoadMapData(MAP_TYPE_SIX, aBuf);
 
 	// load sixup version of the map
 	if(Config()->m_SvSixup)
 	{
 		str_format(aBuf, sizeof(aBuf), "maps7/%s.map", pMapName);
-		void *pData;
-		if(!Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &m_aCurrentMapSize[MAP_TYPE_SIXUP]))
+		if(!LoadMapData(MAP_TYPE_SIXUP, aBuf))
 		{
 			Config()->m_SvSixup = 0;
 			if(m_pRegister)
 			{
 				m_pRegister->OnConfigChange();
 			}
+			char aBufMsg[256];
 			str_format(aBufMsg, sizeof(aBufMsg), "couldn't load map %s", aBuf);
 			Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "sixup", aBufMsg);
 			Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "sixup", "disabling 0.7 compatibility");
 		}
-		else
-		{
-			free(m_apCurrentMapData[MAP_TYPE_SIXUP]);
-			m_apCurrentMapData[MAP_TYPE_SIXUP] = (unsigned char *)pData;
-
-			m_aCurrentMapSha256[MAP_TYPE_SIXUP] = sha256(m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
-			m_aCurrentMapCrc[MAP_TYPE_SIXUP] = crc32(0, m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
-			sha256_str(m_aCurrentMapSha256[MAP_TYPE_SIXUP], aSha256, sizeof(aSha256));
-			str_format(aBufMsg, sizeof(aBufMsg), "%s sha256 is %s", aBuf, aSha256);
-			Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "sixup", aBufMsg);
-		}
 	}
 	if(!Config()->m_SvSixup)
 	{
-		free(m_apCurrentMapData[MAP_TYPE_SIXUP]);
-		m_apCurrentMapData[MAP_TYPE_SIXUP] = 0;
+		FreeMapData(MAP_TYPE_SIXUP);
 	}
 
 	for(int i = 0; i < MAX_CLIENTS; i++)
@@ -2511,6 +2597,208 @@ int CServer::LoadMap(const char *pMapName)
 	return 1;
 }
 
+static void FreeMapFileData(unsigned char *pData, unsigned Size, bool Mapped)
+{
+	if(Mapped)
+		io_unmap(pData, Size);
+	else
+		free(pData);
+}
+
+// maps the file, reads it into memory if that isn't possible
+static unsigned char *MapFileData(IStorage *pStorage, const char *pPath, char *pFullPath, int FullPathSize, unsigned *pSize, bool *pMapped)
+{
+	IOHANDLE File = pStorage->OpenFile(pPath, IOFLAG_READ, IStorage::TYPE_ALL, pFullPath, FullPathSize);
+	if(!File)
+		return nullptr;
+	void *pData = io_map(File, pSize);
+	*pMapped = pData != nullptr;
+	if(!pData)
+		io_read_all(File, &pData, pSize);
+	io_close(File);
+	return (unsigned char *)pData;
+}
+
+class CMapHashJob : public IJob
+{
+	void Run() override
+	{
+		m_Sha256 = sha256(m_pData, m_Size);
+		m_Crc = crc32(0, m_pData, m_Size);
+	}
+
+public:
+	CMapHashJob(const char *pPath, const char *pFullPath, bool HasModified, time_t Modified, unsigned char *pData, unsigned Size) :
+		m_FullPath(pFullPath), m_HasModified(HasModified), m_Modified(Modified), m_pData(pData), m_Size(Size)
+	{
+		str_copy(m_aPath, pPath);
+	}
+
+	~CMapHashJob()
+	{
+		if(m_OwnsData)
+			FreeMapFileData(m_pData, m_Size, m_Mapped);
+	}
+
+	char m_aPath[IO_MAX_PATH_LENGTH];
+	std::string m_FullPath;
+	bool m_HasModified;
+	time_t m_Modified;
+	unsigned char *m_pData;
+	unsigned m_Size;
+	// set if nothing else uses the data anymore, it's freed with the job
+	bool m_OwnsData = false;
+	bool m_Mapped = false;
+
+	SHA256_DIGEST m_Sha256;
+	unsigned m_Crc;
+};
+
+void CServer::PrepareMap(const char *pMapName)
+{
+	// the jobs of a map that isn't wanted anymore free their data when
+	// they're done
+	for(auto &pJob : m_apPreparedMapHashJobs)
+		pJob = nullptr;
+
+	str_format(m_aPreparedMapPath, sizeof(m_aPreparedMapPath), "maps/%s.map", pMapName);
+	GameServer()->OnMapChange(m_aPreparedMapPath, sizeof(m_aPreparedMapPath));
+	HashMapFile(MAP_TYPE_SIX, m_aPreparedMapPath);
+	if(Config()->m_SvSixup)
+	{
+		char aBuf[IO_MAX_PATH_LENGTH];
+		str_format(aBuf, sizeof(aBuf), "maps7/%s.map", pMapName);
+		HashMapFile(MAP_TYPE_SIXUP, aBuf);
+	}
+	str_copy(m_aPreparedMap, pMapName);
+}
+
+bool CServer::PreparedMapReady()
+{
+	for(auto &pJob : m_apPreparedMapHashJobs)
+	{
+		if(!pJob)
+			continue;
+		if(pJob->Status() != IJob::STATE_DONE)
+			return false;
+
+		// LoadMapData finds them in the cache
+		if(pJob->m_HasModified)
+			m_MapHashes[pJob->m_FullPath] = {pJob->m_Modified, pJob->m_Size, pJob->m_Sha256, pJob->m_Crc};
+		pJob = nullptr;
+	}
+	return true;
+}
+
+void CServer::HashMapFile(int MapType, const char *pPath)
+{
+	char aFullPath[IO_MAX_PATH_LENGTH];
+	unsigned Size;
+	bool Mapped;
+	unsigned char *pData = MapFileData(Storage(), pPath, aFullPath, sizeof(aFullPath), &Size, &Mapped);
+	if(!pData)
+	{
+		// LoadMap reports the missing file
+		return;
+	}
+
+	bool HasModified;
+	time_t Modified;
+	if(FindMapHash(aFullPath, Size, &HasModified, &Modified))
+	{
+		FreeMapFileData(pData, Size, Mapped);
+		return;
+	}
+
+	m_apPreparedMapHashJobs[MapType] = std::make_shared<CMapHashJob>(pPath, aFullPath, HasModified, Modified, pData, Size);
+	m_apPreparedMapHashJobs[MapType]->m_OwnsData = true;
+	m_apPreparedMapHashJobs[MapType]->m_Mapped = Mapped;
+	Kernel()->RequestInterface<IEngine>()->AddJob(m_apPreparedMapHashJobs[MapType]);
+}
+
+const CServer::CMapHash *CServer::FindMapHash(const char *pFullPath, unsigned Size, bool *pHasModified, time_t *pModified) const
+{
+	time_t Created;
+	*pHasModified = !fs_file_time(pFullPath, &Created, pModified);
+	auto Cached = m_MapHashes.find(pFullPath);
+	if(*pHasModified && Cached != m_MapHashes.end() && Cached->second.m_Modified == *pModified && Cached->second.m_Size == Size)
+		return &Cached->second;
+	return nullptr;
+}
+
+bool CServer::LoadMapData(int MapType, const char *pPath)
+{
+	FreeMapData(MapType);
+
+	char aFullPath[IO_MAX_PATH_LENGTH];
+	m_apCurrentMapData[MapType] = MapFileData(Storage(), pPath, aFullPath, sizeof(aFullPath), &m_aCurrentMapSize[MapType], &m_aCurrentMapMapped[MapType]);
+	if(!m_apCurrentMapData[MapType])
+		return false;
+
+	bool HasModified;
+	time_t Modified;
+	const CMapHash *pCached = FindMapHash(aFullPath, m_aCurrentMapSize[MapType], &HasModified, &Modified);
+	if(pCached)
+	{
+		m_aCurrentMapSha256[MapType] = pCached->m_Sha256;
+		m_aCurrentMapCrc[MapType] = pCached->m_Crc;
+
+		char aSha256[SHA256_MAXSTRSIZE];
+		char aBuf[256];
+		sha256_str(m_aCurrentMapSha256[MapType], aSha256, sizeof(aSha256));
+		str_format(aBuf, sizeof(aBuf), "%s sha256 is %s (cached)", pPath, aSha256);
+		Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, MapType == MAP_TYPE_SIX ? "server" : "sixup", aBuf);
+		return true;
+	}
+
+	m_apMapHashJobs[MapType] = std::make_shared<CMapHashJob>(pPath, aFullPath, HasModified, Modified, m_apCurrentMapData[MapType], m_aCurrentMapSize[MapType]);
+	Kernel()->RequestInterface<IEngine>()->AddJob(m_apMapHashJobs[MapType]);
+	return true;
+}
+
+void CServer::FreeMapData(int MapType)
+{
+	std::shared_ptr<CMapHashJob> &pJob = m_apMapHashJobs[MapType];
+	if(pJob && pJob->Status() != IJob::STATE_DONE)
+	{
+		// the checksum job still reads the data, it frees it when it's done
+		pJob->m_OwnsData = true;
+		pJob->m_Mapped = m_aCurrentMapMapped[MapType];
+	}
+	else if(m_apCurrentMapData[MapType])
+	{
+		FreeMapFileData(m_apCurrentMapData[MapType], m_aCurrentMapSize[MapType], m_aCurrentMapMapped[MapType]);
+	}
+	pJob = nullptr;
+	m_apCurrentMapData[MapType] = 0;
+	m_aCurrentMapSize[MapType] = 0;
+	m_aCurrentMapMapped[MapType] = false;
+}
+
+void CServer::WaitMapHashes()
+{
+	for(int MapType = 0; MapType < NUM_MAP_TYPES; MapType++)
+	{
+		std::shared_ptr<CMapHashJob> &pJob = m_apMapHashJobs[MapType];
+		if(!pJob)
+			continue;
+		while(pJob->Status() != IJob::STATE_DONE)
+			thread_yield();
+
+		m_aCurrentMapSha256[MapType] = pJob->m_Sha256;
+		m_aCurrentMapCrc[MapType] = pJob->m_Crc;
+		if(pJob->m_HasModified)
+			m_MapHashes[pJob->m_FullPath] = {pJob->m_Modified, pJob->m_Size, pJob->m_Sha256, pJob->m_Crc};
+
+		char aSha256[SHA256_MAXSTRSIZE];
+		char aBuf[256];
+		sha256_str(m_aCurrentMapSha256[MapType], aSha256, sizeof(aSha256));
+		str_format(aBuf, sizeof(aBuf), "%s sha256 is %s", pJob->m_aPath, aSha256);
+		Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, MapType == MAP_TYPE_SIX ? "server" : "sixup", aBuf);
+		pJob = nullptr;
+	}
+}
+
 int CServer::Run()
 {
 	if(m_RunServer == UNINITIALIZED)
@@ -2532,6 +2820,9 @@ int CServer::Run()
 		}
 	}
 
+	// snapshot lanes, their deltas get the static sizes from the game's OnInit
+	InitSnapshotLanes();
+
 	// load map
 	if(!LoadMap(Config()->m_SvMap))
 	{
@@ -2554,6 +2845,7 @@ int CServer::Run()
 			DbPool()->RegisterDatabase(std::move(pCopy), CDbConnectionPool::WRITE);
 		}
 	}
+	DbPool()->Start(Config()->m_SvSqlReadWorkers);
 
 	// start server
 	NETADDR BindAddr;
@@ -2666,15 +2958,11 @@ int CServer::Run()
 		}
 		else */
 		{
-			// Mario texture is 704x64 RGBA (it won't be used)
-			uint8_t *texture = (uint8_t*)malloc(4 * SM64_TEXTURE_WIDTH * SM64_TEXTURE_HEIGHT);
-
-			// load libsm64
+			// load libsm64, the server doesn't need Mario's texture or any audio
 			sm64_global_terminate();
-			sm64_global_init(romBuffer, texture, [](const char *msg) {dbg_msg("libsm64", "%s", msg);});
+			sm64_global_init_ex(romBuffer, nullptr, [](const char *msg) {dbg_msg("libsm64", "%s", msg);}, SM64_INIT_HEADLESS);
 			dbg_msg("libsm64", "Super Mario 64 US ROM loaded!");
 			free(romBuffer);
-			free(texture);
 		}
 	}
 
@@ -2699,50 +2987,57 @@ int CServer::Run()
 			// load new map
 			if(m_MapReload || m_CurrentGameTick >= 0x6FFFFFFF) // force reload to make sure the ticks stay within a valid range
 			{
-				// load map
-				if(LoadMap(Config()->m_SvMap))
+				// keep the clients on the current map until the checksums of the
+				// new one are known, so sending it to them doesn't stall the tick
+				if(str_comp(m_aPreparedMap, Config()->m_SvMap) != 0)
+					PrepareMap(Config()->m_SvMap);
+				if(PreparedMapReady())
 				{
-					// new map loaded
-
-					// ask the game to for the data it wants to persist past a map change
-					for(int i = 0; i < MAX_CLIENTS; i++)
+					// load map
+					if(LoadMap(Config()->m_SvMap))
 					{
-						if(m_aClients[i].m_State == CClient::STATE_INGAME)
+						// new map loaded
+
+						// ask the game to for the data it wants to persist past a map change
+						for(int i = 0; i < MAX_CLIENTS; i++)
 						{
-							m_aClients[i].m_HasPersistentData = GameServer()->OnClientDataPersist(i, m_aClients[i].m_pPersistentData);
+							if(m_aClients[i].m_State == CClient::STATE_INGAME)
+							{
+								m_aClients[i].m_HasPersistentData = GameServer()->OnClientDataPersist(i, m_aClients[i].m_pPersistentData);
+							}
 						}
-					}
 
-					GameServer()->OnShutdown();
+						GameServer()->OnShutdown();
 
-					for(int ClientID = 0; ClientID < MAX_CLIENTS; ClientID++)
-					{
-						if(m_aClients[ClientID].m_State <= CClient::STATE_AUTH)
-							continue;
+						for(int ClientID = 0; ClientID < MAX_CLIENTS; ClientID++)
+						{
+							if(m_aClients[ClientID].m_State <= CClient::STATE_AUTH)
+								continue;
+
+							SendMap(ClientID);
+							bool HasPersistentData = m_aClients[ClientID].m_HasPersistentData;
+							m_aClients[ClientID].Reset();
+							m_aClients[ClientID].m_HasPersistentData = HasPersistentData;
+							m_aClients[ClientID].m_State = CClient::STATE_CONNECTING;
+						}
 
-						SendMap(ClientID);
-						bool HasPersistentData = m_aClients[ClientID].m_HasPersistentData;
-						m_aClients[ClientID].Reset();
-						m_aClients[ClientID].m_HasPersistentData = HasPersistentData;
-						m_aClients[ClientID].m_State = CClient::STATE_CONNECTING;
+						m_GameStartTime = time_get();
+						m_CurrentGameTick = 0;
+						m_ServerInfoFirstRequest = 0;
+						Kernel()->ReregisterInterface(GameServer());
+						GameServer()->OnInit();
+						if(ErrorShutdown())
+						{
+							break;
+						}
+						UpdateServerInfo(true);
 					}
-
-					m_GameStartTime = time_get();
-					m_CurrentGameTick = 0;
-					m_ServerInfoFirstRequest = 0;
-					Kernel()->ReregisterInterface(GameServer());
-					GameServer()->OnInit();
-					if(ErrorShutdown())
+					else
 					{
-						break;
+						str_format(aBuf, sizeof(aBuf), "failed to load map. mapname='%s'", Config()->m_SvMap);
+						Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+						str_copy(Config()->m_SvMap, m_aCurrentMap);
 					}
-					UpdateServerInfo(true);
-				}
-				else
-				{
-					str_format(aBuf, sizeof(aBuf), "failed to load map. mapname='%s'", Config()->m_SvMap);
-					Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
-					str_copy(Config()->m_SvMap, m_aCurrentMap);
 				}
 			}
 
@@ -2843,6 +3138,7 @@ int CServer::Run()
 			{
 				if(Config()->m_SvHighBandwidth || (m_CurrentGameTick % 2) == 0)
 					DoSnapshot();
+				m_NetServer.Flush();
 
 				UpdateClientRconCommands();
 
@@ -3319,6 +3615,7 @@ void CServer::DemoRecorder_HandleAutoStart()
 		char aDate[20];
 		str_timestamp(aDate, sizeof(aDate));
 		str_format(aFilename, sizeof(aFilename), "demos/%s_%s.demo", "auto/autorecord", aDate);
+		WaitMapHashes();
 		m_aDemoRecorder[MAX_CLIENTS].Start(Storage(), m_pConsole, aFilename, GameServer()->NetVersion(), m_aCurrentMap, &m_aCurrentMapSha256[MAP_TYPE_SIX], m_aCurrentMapCrc[MAP_TYPE_SIX], "server", m_aCurrentMapSize[MAP_TYPE_SIX], m_apCurrentMapData[MAP_TYPE_SIX]);
 		if(Config()->m_SvAutoDemoMax)
 		{
@@ -3350,6 +3647,7 @@ void CServer::StartRecord(int ClientID)
 	{
 		char aFilename[IO_MAX_PATH_LENGTH];
 		str_format(aFilename, sizeof(aFilename), "demos/%s_%d_%d_tmp.demo", m_aCurrentMap, m_NetServer.Address().port, ClientID);
+		WaitMapHashes();
 		m_aDemoRecorder[ClientID].Start(Storage(), Console(), aFilename, GameServer()->NetVersion(), m_aCurrentMap, &m_aCurrentMapSha256[MAP_TYPE_SIX], m_aCurrentMapCrc[MAP_TYPE_SIX], "server", m_aCurrentMapSize[MAP_TYPE_SIX], m_apCurrentMapData[MAP_TYPE_SIX]);
 	}
 }
@@ -3384,6 +3682,7 @@ void CServer::ConRecord(IConsole::IResult *pResult, void *pUser)
 		str_timestamp(aDate, sizeof(aDate));
 		str_format(aFilename, sizeof(aFilename), "demos/demo_%s.demo", aDate);
 	}
+	pServer->WaitMapHashes();
 	pServer->m_aDemoRecorder[MAX_CLIENTS].Start(pServer->Storage(), pServer->Console(), aFilename, pServer->GameServer()->NetVersion(), pServer->m_aCurrentMap, &pServer->m_aCurrentMapSha256[MAP_TYPE_SIX], pServer->m_aCurrentMapCrc[MAP_TYPE_SIX], "server", pServer->m_aCurrentMapSize[MAP_TYPE_SIX], pServer->m_apCurrentMapData[MAP_TYPE_SIX]);
 }
 
@@ -3768,9 +4067,16 @@ void *CServer::SnapNewItem(int Type, int ID, int Size)
 	return ID < 0 ? 0 : m_SnapshotBuilder.NewItem(Type, ID, Size);
 }
 
+bool CServer::SnapNewItems(const void *pItems, int Size, const int *pOffsets, int NumItems)
+{
+	return m_SnapshotBuilder.NewItems(pItems, Size, pOffsets, NumItems);
+}
+
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
+	for(int i = 0; i < m_NumSnapshotLanes; i++)
+		m_pSnapshotLanes[i].m_Delta.SetStaticsize(ItemType, Size);
 }
 
 CServer *CreateServer() { return new CServer(); }
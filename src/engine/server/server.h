@@ -11,14 +11,18 @@
 #include <engine/shared/demo.h>
 #include <engine/shared/econ.h>
 #include <engine/shared/fifo.h>
+#include <engine/shared/jobs.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/protocol.h>
 #include <engine/shared/snapshot.h>
 #include <engine/shared/uuid_manager.h>
 
+#include <atomic>
 #include <list>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "antibot.h"
@@ -32,6 +36,7 @@
 class CConfig;
 class CHostLookup;
 class CLogMessage;
+class CMapHashJob;
 class CMsgPacker;
 class CPacker;
 class IEngineMap;
@@ -218,6 +223,58 @@ public:
 
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
+
+	enum
+	{
+		MAX_SNAPSHOT_LANES = 16,
+	};
+
+	// one client's snapshot on its way through DoSnapshot
+	class CSnapshotResult
+	{
+	public:
+		char m_aData[CSnapshot::MAX_SIZE];
+		int m_SnapshotSize;
+		int m_Crc;
+		int m_DeltaTick;
+		CSnapshot *m_pDeltashot;
+		int m_DeltashotSize;
+		const CSnapshotItemHash *m_pDeltashotHash;
+		// client whose compressed delta is sent, another one if both
+		// snapshots and their delta bases are the same, e.g. spectators
+		int m_DeltaSource;
+		char m_aCompData[CSnapshot::MAX_SIZE];
+		int m_CompSize;
+	};
+
+	// state of one thread delta compressing snapshots, the main thread is lane 0
+	class CSnapshotLane
+	{
+	public:
+		CSnapshotDelta m_Delta;
+		char m_aDeltaData[CSnapshot::MAX_SIZE];
+	};
+
+	std::unique_ptr<CSnapshotResult[]> m_pSnapshotResults;
+	std::unique_ptr<CSnapshotLane[]> m_pSnapshotLanes;
+	int m_NumSnapshotLanes;
+	CJobPool m_SnapshotJobPool;
+	int m_aSnapshotClients[MAX_CLIENTS];
+	int m_NumSnapshotClients;
+	std::atomic<int> m_NextSnapshotClient;
+	CSnapshot m_EmptySnap;
+
+	// time spent in the phases of DoSnapshot, only measured if set
+	class CSnapshotTimings
+	{
+	public:
+		int64_t m_Build = 0;
+		// the lanes delta and compress in parallel
+		std::atomic<int64_t> m_Delta{0};
+		std::atomic<int64_t> m_Compress{0};
+		int m_NumSnapshots = 0;
+	};
+	CSnapshotTimings *m_pSnapshotTimings;
 	CSnapIDPool m_IDPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -257,8 +314,28 @@ public:
 	char m_aCurrentMap[IO_MAX_PATH_LENGTH];
 	SHA256_DIGEST m_aCurrentMapSha256[NUM_MAP_TYPES];
 	unsigned m_aCurrentMapCrc[NUM_MAP_TYPES];
+	// mapped from the map files, read into memory if that isn't possible
 	unsigned char *m_apCurrentMapData[NUM_MAP_TYPES];
 	unsigned int m_aCurrentMapSize[NUM_MAP_TYPES];
+	bool m_aCurrentMapMapped[NUM_MAP_TYPES];
+
+	// checksums of the maps loaded before by their path, reused as long as
+	// the file keeps its modification time and size
+	struct CMapHash
+	{
+		time_t m_Modified;
+		unsigned m_Size;
+		SHA256_DIGEST m_Sha256;
+		unsigned m_Crc;
+	};
+	std::unordered_map<std::string, CMapHash> m_MapHashes;
+	// computes the checksums of the current maps that weren't known yet
+	std::shared_ptr<CMapHashJob> m_apMapHashJobs[NUM_MAP_TYPES];
+	// the map Run() changes to once the checksums of its files are known,
+	// the clients stay on the current map until then
+	char m_aPreparedMap[IO_MAX_PATH_LENGTH];
+	char m_aPreparedMapPath[IO_MAX_PATH_LENGTH];
+	std::shared_ptr<CMapHashJob> m_apPreparedMapHashJobs[NUM_MAP_TYPES];
 
 	CDemoRecorder m_aDemoRecorder[MAX_CLIENTS + 1];
 	CAuthManager m_AuthManager;
@@ -291,6 +368,8 @@ public:
 	//int Tick()
 	int64_t TickStartTime(int Tick);
 	//int TickSpeed()
+	// starts the next tick without waiting for it, for replays
+	void AdvanceTick() { m_CurrentGameTick++; }
 
 	int Init();
 
@@ -315,7 +394,12 @@ public:
 	int GetClientVersion(int ClientID) const override;
 	int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID) override;
 
+	void InitSnapshotLanes();
 	void DoSnapshot();
+	void CompressSnapshots(int Lane);
+	void PrepareDelta(int ClientID, int NumPrepared);
+	void CompressSnapshot(int ClientID, CSnapshotLane *pLane);
+	void SendSnapshot(int ClientID);
 
 	static int NewClientCallback(int ClientID, void *pUser, bool Sixup);
 	static int NewClientNoAuthCallback(int ClientID, void *pUser);
@@ -377,6 +461,16 @@ public:
 	void ChangeMap(const char *pMap) override;
 	const char *GetMapName() const override;
 	int LoadMap(const char *pMapName);
+	// starts computing the checksums of the map files in the background
+	void PrepareMap(const char *pMapName);
+	// whether the checksums of the prepared map are known, doesn't block
+	bool PreparedMapReady();
+	void HashMapFile(int MapType, const char *pPath);
+	const CMapHash *FindMapHash(const char *pFullPath, unsigned Size, bool *pHasModified, time_t *pModified) const;
+	bool LoadMapData(int MapType, const char *pPath);
+	void FreeMapData(int MapType);
+	// blocks until the checksums of the current maps are known
+	void WaitMapHashes();
 
 	void SaveDemo(int ClientID, float Time) override;
 	void StartRecord(int ClientID) override;
@@ -435,6 +529,7 @@ public:
 	int SnapNewID() override;
 	void SnapFreeID(int ID) override;
 	void *SnapNewItem(int Type, int ID, int Size) override;
+	bool SnapNewItems(const void *pItems, int Size, const int *pOffsets, int NumItems) override;
 	void SnapSetStaticsize(int ItemType, int Size) override;
 
 	// DDRace
@@ -14,6 +14,7 @@
 #include "console.h"
 #include "linereader.h"
 
+#include <algorithm>
 #include <iterator> // std::size
 #include <new>
 
@@ -579,9 +580,27 @@ int CConsole::PossibleCommands(const char *pStr, int FlagMask, bool Temp, FPossi
 	return Index;
 }
 
+unsigned CConsole::HashCommandName(const char *pName)
+{
+	// FNV-1a over the lowercase name, like str_comp_nocase compares them
+	unsigned Hash = 2166136261u;
+	for(; *pName; pName++)
+	{
+		unsigned char c = *pName;
+		if(c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		Hash = (Hash ^ c) * 16777619u;
+	}
+	return Hash;
+}
+
 CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	auto It = m_CommandIndex.find(HashCommandName(pName));
+	if(It == m_CommandIndex.end())
+		return 0x0;
+
+	for(CCommand *pCommand : It->second)
 	{
 		if(pCommand->m_Flags & FlagMask)
 		{
@@ -1075,12 +1094,16 @@ void CConsole::ParseArguments(int NumArgs, const char **ppArguments)
 
 void CConsole::AddCommandSorted(CCommand *pCommand)
 {
+	// keep the index in the order of the list
+	std::vector<CCommand *> &vIndex = m_CommandIndex[HashCommandName(pCommand->m_pName)];
+	auto It = vIndex.begin();
+	while(It != vIndex.end() && str_comp(pCommand->m_pName, (*It)->m_pName) > 0)
+		++It;
+	vIndex.insert(It, pCommand);
+
 	if(!m_pFirstCommand || str_comp(pCommand->m_pName, m_pFirstCommand->m_pName) <= 0)
 	{
-		if(m_pFirstCommand && m_pFirstCommand->m_pNext)
-			pCommand->m_pNext = m_pFirstCommand;
-		else
-			pCommand->m_pNext = 0;
+		pCommand->m_pNext = m_pFirstCommand;
 		m_pFirstCommand = pCommand;
 	}
 	else
@@ -1097,6 +1120,17 @@ void CConsole::AddCommandSorted(CCommand *pCommand)
 	}
 }
 
+void CConsole::RemoveCommandIndex(CCommand *pCommand)
+{
+	auto It = m_CommandIndex.find(HashCommandName(pCommand->m_pName));
+	if(It == m_CommandIndex.end())
+		return;
+	std::vector<CCommand *> &vIndex = It->second;
+	vIndex.erase(std::remove(vIndex.begin(), vIndex.end(), pCommand), vIndex.end());
+	if(vIndex.empty())
+		m_CommandIndex.erase(It);
+}
+
 void CConsole::Register(const char *pName, const char *pParams,
 	int Flags, FCommandCallback pfnFunc, void *pUser, const char *pHelp)
 {
@@ -1185,6 +1219,7 @@ void CConsole::DeregisterTemp(const char *pName)
 	// add to recycle list
 	if(pRemoved)
 	{
+		RemoveCommandIndex(pRemoved);
 		pRemoved->m_pNext = m_pRecycleList;
 		m_pRecycleList = pRemoved;
 	}
@@ -1208,6 +1243,16 @@ void CConsole::DeregisterTempAll()
 		}
 	}
 
+	for(auto It = m_CommandIndex.begin(); It != m_CommandIndex.end();)
+	{
+		std::vector<CCommand *> &vIndex = It->second;
+		vIndex.erase(std::remove_if(vIndex.begin(), vIndex.end(), [](CCommand *pCommand) { return pCommand->m_Temp; }), vIndex.end());
+		if(vIndex.empty())
+			It = m_CommandIndex.erase(It);
+		else
+			++It;
+	}
+
 	m_TempCommands.Reset();
 	m_pRecycleList = 0;
 }
@@ -1256,7 +1301,11 @@ void CConsole::StoreCommands(bool Store)
 
 const IConsole::CCommandInfo *CConsole::GetCommandInfo(const char *pName, int FlagMask, bool Temp)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	auto It = m_CommandIndex.find(HashCommandName(pName));
+	if(It == m_CommandIndex.end())
+		return 0;
+
+	for(CCommand *pCommand : It->second)
 	{
 		if(pCommand->m_Flags & FlagMask && pCommand->m_Temp == Temp)
 		{
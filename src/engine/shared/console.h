@@ -8,6 +8,9 @@
 #include <engine/console.h>
 #include <engine/storage.h>
 
+#include <unordered_map>
+#include <vector>
+
 class CConsole : public IConsole
 {
 	class CCommand : public CCommandInfo
@@ -38,6 +41,10 @@ class CConsole : public IConsole
 	const char *m_apStrokeStr[2];
 	CCommand *m_pFirstCommand;
 
+	// the commands by the hash of their lowercase name, in the order of the
+	// list, so lines are executed without walking all commands
+	std::unordered_map<unsigned, std::vector<CCommand *>> m_CommandIndex;
+
 	class CExecFile
 	{
 	public:
@@ -187,7 +194,9 @@ class CConsole : public IConsole
 		}
 	} m_ExecutionQueue;
 
+	static unsigned HashCommandName(const char *pName);
 	void AddCommandSorted(CCommand *pCommand);
+	void RemoveCommandIndex(CCommand *pCommand);
 	CCommand *FindCommand(const char *pName, int FlagMask);
 
 public:
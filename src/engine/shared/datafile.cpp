@@ -5,12 +5,17 @@
 
 #include <base/hash_ctxt.h>
 #include <base/log.h>
+#include <base/math.h>
 #include <base/system.h>
+#include <engine/engine.h>
 #include <engine/storage.h>
 
 #include "uuid_manager.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
+#include <vector>
 
 static const int DEBUG = 0;
 
@@ -90,6 +95,11 @@ struct CDatafileInfo
 struct CDatafile
 {
 	IOHANDLE m_File;
+	// the whole file if it could be mapped, data is loaded from here
+	unsigned char *m_pMapped;
+	unsigned m_MappedSize;
+	// the checksums are only computed when they are first asked for
+	bool m_HashesComputed;
 	SHA256_DIGEST m_Sha256;
 	unsigned m_Crc;
 	CDatafileInfo m_Info;
@@ -109,38 +119,17 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		dbg_msg("datafile", "could not open '%s'", pFilename);
 		return false;
 	}
+	const int64_t StartTime = time_get();
 
-	// take the CRC of the file and store it
-	unsigned Crc = 0;
-	SHA256_DIGEST Sha256;
-	{
-		enum
-		{
-			BUFFER_SIZE = 64 * 1024
-		};
-
-		SHA256_CTX Sha256Ctxt;
-		sha256_init(&Sha256Ctxt);
-		unsigned char aBuffer[BUFFER_SIZE];
-
-		while(true)
-		{
-			unsigned Bytes = io_read(File, aBuffer, BUFFER_SIZE);
-			if(Bytes <= 0)
-				break;
-			Crc = crc32(Crc, aBuffer, Bytes);
-			sha256_update(&Sha256Ctxt, aBuffer, Bytes);
-		}
-		Sha256 = sha256_finish(&Sha256Ctxt);
-
-		io_seek(File, 0, IOSEEK_START);
-	}
+	unsigned MappedSize;
+	unsigned char *pMapped = (unsigned char *)io_map(File, &MappedSize);
 
 	// TODO: change this header
 	CDatafileHeader Header;
 	if(sizeof(Header) != io_read(File, &Header, sizeof(Header)))
 	{
 		dbg_msg("datafile", "couldn't load header");
+		io_unmap(pMapped, MappedSize);
 		return false;
 	}
 	if(Header.m_aID[0] != 'A' || Header.m_aID[1] != 'T' || Header.m_aID[2] != 'A' || Header.m_aID[3] != 'D')
@@ -148,6 +137,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		if(Header.m_aID[0] != 'D' || Header.m_aID[1] != 'A' || Header.m_aID[2] != 'T' || Header.m_aID[3] != 'A')
 		{
 			dbg_msg("datafile", "wrong signature. %x %x %x %x", Header.m_aID[0], Header.m_aID[1], Header.m_aID[2], Header.m_aID[3]);
+			io_unmap(pMapped, MappedSize);
 			return false;
 		}
 	}
@@ -158,6 +148,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if(Header.m_Version != 3 && Header.m_Version != 4)
 	{
 		dbg_msg("datafile", "wrong version. version=%x", Header.m_Version);
+		io_unmap(pMapped, MappedSize);
 		return false;
 	}
 
@@ -179,8 +170,9 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	pTmpDataFile->m_ppDataPtrs = (char **)(pTmpDataFile + 1);
 	pTmpDataFile->m_pData = (char *)(pTmpDataFile + 1) + Header.m_NumRawData * sizeof(char *);
 	pTmpDataFile->m_File = File;
-	pTmpDataFile->m_Sha256 = Sha256;
-	pTmpDataFile->m_Crc = Crc;
+	pTmpDataFile->m_pMapped = pMapped;
+	pTmpDataFile->m_MappedSize = MappedSize;
+	pTmpDataFile->m_HashesComputed = false;
 
 	// clear the data pointers
 	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData * sizeof(void *));
@@ -190,6 +182,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if(ReadSize != Size)
 	{
 		io_close(pTmpDataFile->m_File);
+		io_unmap(pMapped, MappedSize);
 		free(pTmpDataFile);
 		pTmpDataFile = 0;
 		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
@@ -222,7 +215,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		m_pDataFile->m_Info.m_pItemStart = (char *)&m_pDataFile->m_Info.m_pDataOffsets[m_pDataFile->m_Header.m_NumRawData];
 	m_pDataFile->m_Info.m_pDataStart = m_pDataFile->m_Info.m_pItemStart + m_pDataFile->m_Header.m_ItemSize;
 
-	log_trace("datafile", "loading done. datafile='%s'", pFilename);
+	log_trace("datafile", "loading done. datafile='%s' mapped=%d time=%.2fms", pFilename, pMapped != nullptr, (time_get() - StartTime) * 1000.0 / time_freq());
 
 	return true;
 }
@@ -263,6 +256,48 @@ int CDataFileReader::GetDataSize(int Index)
 		return GetFileDataSize(Index);
 }
 
+// decompresses data of a v4 datafile, returns null if the data is corrupt
+static char *DecompressData(int Index, const void *pData, int DataSize, unsigned long UncompressedSize, int *pSize)
+{
+	log_trace("datafile", "loading data index=%d size=%d uncompressed=%lu", Index, DataSize, UncompressedSize);
+	char *pResult = (char *)malloc(UncompressedSize);
+	unsigned long Size = UncompressedSize;
+	const int Result = uncompress((Bytef *)pResult, &Size, (const Bytef *)pData, DataSize);
+	if(Result != Z_OK)
+	{
+		log_error("datafile", "failed to decompress data index=%d, error=%d", Index, Result);
+		free(pResult);
+		*pSize = 0;
+		return nullptr;
+	}
+	*pSize = Size;
+	return pResult;
+}
+
+bool CDataFileReader::LoadMappedData(int Index, int *pSize)
+{
+	const int DataSize = GetFileDataSize(Index);
+	const unsigned Offset = m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index];
+	if(!m_pDataFile->m_pMapped || DataSize < 0 || Offset > m_pDataFile->m_MappedSize || (unsigned)DataSize > m_pDataFile->m_MappedSize - Offset)
+		return false;
+
+	const unsigned char *pSource = m_pDataFile->m_pMapped + Offset;
+	if(m_pDataFile->m_Header.m_Version == 4)
+	{
+		// v4 has compressed data, decompress it right out of the mapping
+		m_pDataFile->m_ppDataPtrs[Index] = DecompressData(Index, pSource, DataSize, m_pDataFile->m_Info.m_pDataSizes[Index], pSize);
+	}
+	else
+	{
+		log_trace("datafile", "loading data index=%d size=%d", Index, DataSize);
+		char *pData = (char *)malloc(DataSize);
+		mem_copy(pData, pSource, DataSize);
+		m_pDataFile->m_ppDataPtrs[Index] = pData;
+		*pSize = DataSize;
+	}
+	return true;
+}
+
 void *CDataFileReader::GetDataImpl(int Index, int Swap)
 {
 	if(!m_pDataFile)
@@ -276,43 +311,35 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 	// load it if needed
 	if(!m_pDataFile->m_ppDataPtrs[Index])
 	{
-		// fetch the data size
-		int DataSize = GetFileDataSize(Index);
-#if defined(CONF_ARCH_ENDIAN_BIG)
-		int SwapSize = DataSize;
-#endif
-
-		if(m_pDataFile->m_Header.m_Version == 4)
+		int SwapSize;
+		if(!LoadMappedData(Index, &SwapSize))
 		{
-			// v4 has compressed data
-			void *pTemp = malloc(DataSize);
-			unsigned long UncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
-			unsigned long s;
+			// fetch the data size
+			int DataSize = GetFileDataSize(Index);
+			SwapSize = DataSize;
 
-			log_trace("datafile", "loading data index=%d size=%d uncompressed=%lu", Index, DataSize, UncompressedSize);
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(UncompressedSize);
+			if(m_pDataFile->m_Header.m_Version == 4)
+			{
+				// v4 has compressed data
+				void *pTemp = malloc(DataSize);
 
-			// read the compressed data
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, pTemp, DataSize);
+				// read the compressed data
+				io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
+				io_read(m_pDataFile->m_File, pTemp, DataSize);
 
-			// decompress the data, TODO: check for errors
-			s = UncompressedSize;
-			uncompress((Bytef *)m_pDataFile->m_ppDataPtrs[Index], &s, (Bytef *)pTemp, DataSize);
-#if defined(CONF_ARCH_ENDIAN_BIG)
-			SwapSize = s;
-#endif
+				m_pDataFile->m_ppDataPtrs[Index] = DecompressData(Index, pTemp, DataSize, m_pDataFile->m_Info.m_pDataSizes[Index], &SwapSize);
 
-			// clean up the temporary buffers
-			free(pTemp);
-		}
-		else
-		{
-			// load the data
-			log_trace("datafile", "loading data index=%d size=%d", Index, DataSize);
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(DataSize);
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize);
+				// clean up the temporary buffers
+				free(pTemp);
+			}
+			else
+			{
+				// load the data
+				log_trace("datafile", "loading data index=%d size=%d", Index, DataSize);
+				m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(DataSize);
+				io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
+				io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize);
+			}
 		}
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
@@ -324,6 +351,52 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 	return m_pDataFile->m_ppDataPtrs[Index];
 }
 
+void CDataFileReader::LoadData(const int *pIndices, int NumIndices, IEngine *pEngine)
+{
+	if(!m_pDataFile)
+		return;
+
+	const int64_t StartTime = time_get();
+	std::vector<int> vIndices;
+	for(int i = 0; i < NumIndices; i++)
+	{
+		if(pIndices[i] >= 0 && pIndices[i] < m_pDataFile->m_Header.m_NumRawData && !m_pDataFile->m_ppDataPtrs[pIndices[i]])
+			vIndices.push_back(pIndices[i]);
+	}
+	std::sort(vIndices.begin(), vIndices.end());
+	vIndices.erase(std::unique(vIndices.begin(), vIndices.end()), vIndices.end());
+	const int NumLoad = vIndices.size();
+	if(NumLoad == 0)
+		return;
+
+	int64_t FileDataSize = 0;
+	for(int Index : vIndices)
+		FileDataSize += GetFileDataSize(Index);
+
+	// without a mapping all data has to be read through the one file handle,
+	// and small maps are loaded faster than the jobs are started
+	if(!m_pDataFile->m_pMapped || !pEngine || NumLoad == 1 || FileDataSize < MIN_PARALLEL_LOAD_SIZE)
+	{
+		for(int Index : vIndices)
+			GetData(Index);
+		log_debug("datafile", "loaded %d data in %.2fms", NumLoad, (time_get() - StartTime) * 1000.0 / time_freq());
+		return;
+	}
+
+	std::atomic<int64_t> Bytes{0};
+	pEngine->ParallelFor(NumLoad, [&](int i) {
+		int Size = 0;
+		LoadMappedData(vIndices[i], &Size);
+		Bytes.fetch_add(Size);
+	});
+
+	// data outside of the mapping is read like before
+	for(int Index : vIndices)
+		GetData(Index);
+
+	log_debug("datafile", "loaded %d data, %d KiB in %.2fms", NumLoad, (int)(Bytes.load() / 1024), (time_get() - StartTime) * 1000.0 / time_freq());
+}
+
 void *CDataFileReader::GetData(int Index)
 {
 	return GetDataImpl(Index, 0);
@@ -486,11 +559,50 @@ bool CDataFileReader::Close()
 		free(m_pDataFile->m_ppDataPtrs[i]);
 
 	io_close(m_pDataFile->m_File);
+	io_unmap(m_pDataFile->m_pMapped, m_pDataFile->m_MappedSize);
 	free(m_pDataFile);
 	m_pDataFile = 0;
 	return true;
 }
 
+void CDataFileReader::ComputeHashes() const
+{
+	if(m_pDataFile->m_HashesComputed)
+		return;
+
+	if(m_pDataFile->m_pMapped)
+	{
+		m_pDataFile->m_Sha256 = sha256(m_pDataFile->m_pMapped, m_pDataFile->m_MappedSize);
+		m_pDataFile->m_Crc = crc32(0, m_pDataFile->m_pMapped, m_pDataFile->m_MappedSize);
+		m_pDataFile->m_HashesComputed = true;
+		return;
+	}
+
+	enum
+	{
+		BUFFER_SIZE = 64 * 1024
+	};
+
+	unsigned Crc = 0;
+	SHA256_CTX Sha256Ctxt;
+	sha256_init(&Sha256Ctxt);
+	unsigned char aBuffer[BUFFER_SIZE];
+
+	io_seek(m_pDataFile->m_File, 0, IOSEEK_START);
+	while(true)
+	{
+		unsigned Bytes = io_read(m_pDataFile->m_File, aBuffer, BUFFER_SIZE);
+		if(Bytes <= 0)
+			break;
+		Crc = crc32(Crc, aBuffer, Bytes);
+		sha256_update(&Sha256Ctxt, aBuffer, Bytes);
+	}
+
+	m_pDataFile->m_Sha256 = sha256_finish(&Sha256Ctxt);
+	m_pDataFile->m_Crc = Crc;
+	m_pDataFile->m_HashesComputed = true;
+}
+
 SHA256_DIGEST CDataFileReader::Sha256() const
 {
 	if(!m_pDataFile)
@@ -502,6 +614,7 @@ SHA256_DIGEST CDataFileReader::Sha256() const
 		}
 		return Result;
 	}
+	ComputeHashes();
 	return m_pDataFile->m_Sha256;
 }
 
@@ -509,6 +622,7 @@ unsigned CDataFileReader::Crc() const
 {
 	if(!m_pDataFile)
 		return 0xFFFFFFFF;
+	ComputeHashes();
 	return m_pDataFile->m_Crc;
 }
 
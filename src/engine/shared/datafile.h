@@ -15,16 +15,29 @@ enum
 	ITEMTYPE_EX = 0xffff,
 };
 
+class IEngine;
+
 // raw datafile access
 class CDataFileReader
 {
+	enum
+	{
+		MIN_PARALLEL_LOAD_SIZE = 256 * 1024,
+	};
+
 	struct CDatafile *m_pDataFile;
 	void *GetDataImpl(int Index, int Swap);
+	// loads the data from the file mapping, several threads can load
+	// different indices at once. Returns false if the data isn't mapped.
+	bool LoadMappedData(int Index, int *pSize);
 	int GetFileDataSize(int Index);
 
 	int GetExternalItemType(int InternalType);
 	int GetInternalItemType(int ExternalType);
 
+	// reads the whole file once, callers that never need the checksums skip that
+	void ComputeHashes() const;
+
 public:
 	CDataFileReader() :
 		m_pDataFile(nullptr) {}
@@ -37,6 +50,9 @@ public:
 
 	void *GetData(int Index);
 	void *GetDataSwapped(int Index); // makes sure that the data is 32bit LE ints when saved
+	// loads the data of all indices like GetData, decompressing them in
+	// parallel on the job pool of the engine if the file is mapped
+	void LoadData(const int *pIndices, int NumIndices, IEngine *pEngine);
 	int GetDataSize(int Index);
 	void UnloadData(int Index);
 	void *GetItem(int Index, int *pType, int *pID);
@@ -106,11 +106,16 @@ public:
 		m_pConsole->Register("dbg_lognetwork", "", CFGFLAG_SERVER | CFGFLAG_CLIENT, Con_DbgLognetwork, this, "Log the network");
 	}
 
-	void AddJob(std::shared_ptr<IJob> pJob) override
+	void AddJob(std::shared_ptr<IJob> pJob, int Priority) override
 	{
 		if(g_Config.m_Debug)
 			dbg_msg("engine", "job added");
-		m_JobPool.Add(std::move(pJob));
+		m_JobPool.Add(std::move(pJob), Priority);
+	}
+
+	void ParallelFor(int Num, const std::function<void(int)> &Func) override
+	{
+		m_JobPool.ParallelFor(Num, Func);
 	}
 
 	void SetAdditionalLogger(std::unique_ptr<ILogger> &&pLogger) override
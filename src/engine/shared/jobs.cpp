@@ -3,20 +3,28 @@
 #include "jobs.h"
 
 #include <base/lock_scope.h>
+#include <base/math.h>
+
+// the worker of the current thread, so jobs it adds go to its own queue
+static thread_local CJobPool *s_pCurrentPool = nullptr;
+static thread_local int s_CurrentWorker = -1;
 
 IJob::IJob() :
-	m_Status(STATE_PENDING)
+	m_Status(STATE_PENDING),
+	m_Priority(CJobPool::PRIORITY_INTERACTIVE)
 {
 }
 
 IJob::IJob(const IJob &Other) :
-	m_Status(STATE_PENDING)
+	m_Status(STATE_PENDING),
+	m_Priority(Other.m_Priority)
 {
 }
 
 IJob &IJob::operator=(const IJob &Other)
 {
 	m_Status = STATE_PENDING;
+	m_Priority = Other.m_Priority;
 	return *this;
 }
 
@@ -27,15 +35,79 @@ int IJob::Status()
 	return m_Status.load();
 }
 
+// a fixed size work stealing deque (Chase and Lev). Only the owning worker
+// pushes and pops at the bottom, other workers steal from the top.
+class CJobPool::CWorkerQueue
+{
+	enum
+	{
+		CAPACITY = 4096,
+	};
+
+	std::atomic<int64_t> m_Top{0};
+	std::atomic<int64_t> m_Bottom{0};
+	std::atomic<IJob *> m_apJobs[CAPACITY];
+
+public:
+	// returns false if the queue is full
+	bool Push(IJob *pJob)
+	{
+		const int64_t Bottom = m_Bottom.load(std::memory_order_relaxed);
+		const int64_t Top = m_Top.load(std::memory_order_acquire);
+		if(Bottom - Top >= CAPACITY)
+			return false;
+		m_apJobs[Bottom % CAPACITY].store(pJob, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_Bottom.store(Bottom + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	IJob *Pop()
+	{
+		const int64_t Bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+		m_Bottom.store(Bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t Top = m_Top.load(std::memory_order_relaxed);
+		if(Top > Bottom)
+		{
+			m_Bottom.store(Bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		IJob *pJob = m_apJobs[Bottom % CAPACITY].load(std::memory_order_relaxed);
+		if(Top == Bottom)
+		{
+			// the last job, a thief might take it at the same time
+			if(!m_Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				pJob = nullptr;
+			m_Bottom.store(Bottom + 1, std::memory_order_relaxed);
+		}
+		return pJob;
+	}
+
+	IJob *Steal()
+	{
+		int64_t Top = m_Top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t Bottom = m_Bottom.load(std::memory_order_acquire);
+		if(Top >= Bottom)
+			return nullptr;
+
+		IJob *pJob = m_apJobs[Top % CAPACITY].load(std::memory_order_relaxed);
+		if(!m_Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+		return pJob;
+	}
+};
+
 CJobPool::CJobPool()
 {
 	// empty the pool
-	m_NumThreads = 0;
 	m_Shutdown = false;
 	m_Lock = lock_create();
 	sphore_init(&m_Semaphore);
-	m_pFirstJob = 0;
-	m_pLastJob = 0;
+	m_NumBackgroundRunning = 0;
+	m_MaxBackgroundRunning = 0;
 }
 
 CJobPool::~CJobPool()
@@ -48,65 +120,131 @@ CJobPool::~CJobPool()
 
 void CJobPool::WorkerThread(void *pUser)
 {
-	CJobPool *pPool = (CJobPool *)pUser;
+	CWorker *pWorker = (CWorker *)pUser;
+	CJobPool *pPool = pWorker->m_pPool;
+	s_pCurrentPool = pPool;
+	s_CurrentWorker = pWorker->m_Index;
 
 	while(!pPool->m_Shutdown)
 	{
-		std::shared_ptr<IJob> pJob = 0;
+		// look for work before sleeping, jobs can be taken without
+		// waiting for the semaphore
+		IJob *pJob = pPool->FindJob(pWorker);
+		if(pJob)
+			pPool->RunJob(pJob);
+		else
+			sphore_wait(&pPool->m_Semaphore);
+	}
+}
 
-		// fetch job from queue
-		sphore_wait(&pPool->m_Semaphore);
+IJob *CJobPool::FindJob(CWorker *pWorker)
+{
+	IJob *pJob = pWorker->m_pQueue->Pop();
+	if(pJob)
+		return pJob;
+
+	{
+		CLockScope ls(m_Lock);
+		if(!m_apQueues[PRIORITY_INTERACTIVE].empty())
 		{
-			CLockScope ls(pPool->m_Lock);
-			if(pPool->m_pFirstJob)
-			{
-				pJob = pPool->m_pFirstJob;
-				pPool->m_pFirstJob = pPool->m_pFirstJob->m_pNext;
-				if(!pPool->m_pFirstJob)
-					pPool->m_pLastJob = 0;
-			}
+			pJob = m_apQueues[PRIORITY_INTERACTIVE].front();
+			m_apQueues[PRIORITY_INTERACTIVE].pop_front();
+			return pJob;
 		}
+	}
 
-		// do the job if we have one
+	const int NumWorkers = m_vpWorkers.size();
+	for(int i = 1; i < NumWorkers; i++)
+	{
+		pJob = m_vpWorkers[(pWorker->m_Index + i) % NumWorkers]->m_pQueue->Steal();
 		if(pJob)
-		{
-			RunBlocking(pJob.get());
-		}
+			return pJob;
+	}
+
+	CLockScope ls(m_Lock);
+	if(!m_apQueues[PRIORITY_BACKGROUND].empty() && m_NumBackgroundRunning < m_MaxBackgroundRunning)
+	{
+		pJob = m_apQueues[PRIORITY_BACKGROUND].front();
+		m_apQueues[PRIORITY_BACKGROUND].pop_front();
+		m_NumBackgroundRunning++;
+		return pJob;
+	}
+	return nullptr;
+}
+
+void CJobPool::RunJob(IJob *pJob)
+{
+	// the pool's reference is the last one if nobody else waits for the job
+	std::shared_ptr<IJob> pKeep = std::move(pJob->m_pSelf);
+	RunBlocking(pJob);
+	if(pJob->m_Priority == PRIORITY_BACKGROUND)
+	{
+		CLockScope ls(m_Lock);
+		m_NumBackgroundRunning--;
 	}
 }
 
 void CJobPool::Init(int NumThreads)
 {
+	// keep one worker free for interactive jobs
+	m_MaxBackgroundRunning = maximum(NumThreads - 1, 1);
+
 	// start threads
-	m_NumThreads = NumThreads > MAX_THREADS ? MAX_THREADS : NumThreads;
 	for(int i = 0; i < NumThreads; i++)
-		m_apThreads[i] = thread_init(WorkerThread, this, "CJobPool worker");
+	{
+		auto pWorker = std::make_unique<CWorker>();
+		pWorker->m_pPool = this;
+		pWorker->m_Index = i;
+		pWorker->m_pQueue = std::make_unique<CWorkerQueue>();
+		m_vpWorkers.push_back(std::move(pWorker));
+	}
+	for(auto &pWorker : m_vpWorkers)
+		pWorker->m_pThread = thread_init(WorkerThread, pWorker.get(), "CJobPool worker");
 }
 
 void CJobPool::Destroy()
 {
 	m_Shutdown = true;
-	for(int i = 0; i < m_NumThreads; i++)
+	for(size_t i = 0; i < m_vpWorkers.size(); i++)
 		sphore_signal(&m_Semaphore);
-	for(int i = 0; i < m_NumThreads; i++)
+	for(auto &pWorker : m_vpWorkers)
+	{
+		if(pWorker->m_pThread)
+			thread_wait(pWorker->m_pThread);
+	}
+
+	// drop the jobs that didn't run
+	for(auto &pWorker : m_vpWorkers)
 	{
-		if(m_apThreads[i])
-			thread_wait(m_apThreads[i]);
+		while(IJob *pJob = pWorker->m_pQueue->Pop())
+			pJob->m_pSelf = nullptr;
 	}
+	{
+		CLockScope ls(m_Lock);
+		for(auto &Queue : m_apQueues)
+		{
+			for(IJob *pJob : Queue)
+				pJob->m_pSelf = nullptr;
+			Queue.clear();
+		}
+	}
+	m_vpWorkers.clear();
+
 	lock_destroy(m_Lock);
 	sphore_destroy(&m_Semaphore);
 }
 
-void CJobPool::Add(std::shared_ptr<IJob> pJob)
+void CJobPool::Add(std::shared_ptr<IJob> pJob, int Priority)
 {
+	IJob *pAdded = pJob.get();
+	pAdded->m_Priority = Priority;
+	pAdded->m_pSelf = std::move(pJob);
+
+	if(Priority != PRIORITY_INTERACTIVE || s_pCurrentPool != this || !m_vpWorkers[s_CurrentWorker]->m_pQueue->Push(pAdded))
 	{
 		CLockScope ls(m_Lock);
 		// add job to queue
-		if(m_pLastJob)
-			m_pLastJob->m_pNext = pJob;
-		m_pLastJob = std::move(pJob);
-		if(!m_pFirstJob)
-			m_pFirstJob = m_pLastJob;
+		m_apQueues[Priority].push_back(pAdded);
 	}
 
 	sphore_signal(&m_Semaphore);
@@ -118,3 +256,52 @@ void CJobPool::RunBlocking(IJob *pJob)
 	pJob->Run();
 	pJob->m_Status = IJob::STATE_DONE;
 }
+
+// the calls are handed out to the jobs and the calling thread one by one
+struct CParallelFor
+{
+	const std::function<void(int)> *m_pFunc;
+	int m_Num;
+	std::atomic<int> m_Next{0};
+	std::atomic<int> m_NumDone{0};
+
+	void Work()
+	{
+		int i;
+		while((i = m_Next.fetch_add(1)) < m_Num)
+		{
+			(*m_pFunc)(i);
+			m_NumDone.fetch_add(1);
+		}
+	}
+};
+
+class CParallelForJob : public IJob
+{
+	// keeps the state alive for jobs that only start after all calls are done
+	std::shared_ptr<CParallelFor> m_pState;
+
+	void Run() override { m_pState->Work(); }
+
+public:
+	CParallelForJob(std::shared_ptr<CParallelFor> pState) :
+		m_pState(std::move(pState))
+	{
+	}
+};
+
+void CJobPool::ParallelFor(int Num, const std::function<void(int)> &Func)
+{
+	if(Num <= 0)
+		return;
+
+	auto pState = std::make_shared<CParallelFor>();
+	pState->m_pFunc = &Func;
+	pState->m_Num = Num;
+	const int NumJobs = minimum(Num - 1, NumThreads());
+	for(int i = 0; i < NumJobs; i++)
+		Add(std::make_shared<CParallelForJob>(pState));
+	pState->Work();
+	while(pState->m_NumDone.load() < Num)
+		thread_yield();
+}
@@ -6,7 +6,10 @@
 #include <base/system.h>
 
 #include <atomic>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <vector>
 
 class CJobPool;
 
@@ -15,9 +18,11 @@ class IJob
 	friend CJobPool;
 
 private:
-	std::shared_ptr<IJob> m_pNext;
+	// held by the pool while the job is queued
+	std::shared_ptr<IJob> m_pSelf;
 
 	std::atomic<int> m_Status;
+	int m_Priority;
 	virtual void Run() = 0;
 
 public:
@@ -35,22 +40,51 @@ public:
 	};
 };
 
+/*
+	Class: Job Pool
+		Runs jobs on a number of worker threads. Jobs added by a worker go
+		to its own queue and are taken back in reverse order while they are
+		still in the cache, idle workers steal the oldest jobs from the
+		queues of the others. Jobs added by other threads are shared by all
+		workers.
+
+		Background jobs, like network requests or hashing files, never
+		take up all workers, so interactive jobs that the game waits for
+		are started right away.
+*/
 class CJobPool
 {
+public:
 	enum
 	{
-		MAX_THREADS = 32
+		PRIORITY_INTERACTIVE = 0,
+		PRIORITY_BACKGROUND,
+		NUM_PRIORITIES
+	};
+
+private:
+	class CWorkerQueue;
+
+	struct CWorker
+	{
+		CJobPool *m_pPool;
+		int m_Index;
+		void *m_pThread;
+		std::unique_ptr<CWorkerQueue> m_pQueue;
 	};
-	int m_NumThreads;
-	void *m_apThreads[MAX_THREADS];
+
+	std::vector<std::unique_ptr<CWorker>> m_vpWorkers;
 	std::atomic<bool> m_Shutdown;
 
 	LOCK m_Lock;
 	SEMAPHORE m_Semaphore;
-	std::shared_ptr<IJob> m_pFirstJob GUARDED_BY(m_Lock);
-	std::shared_ptr<IJob> m_pLastJob GUARDED_BY(m_Lock);
+	std::deque<IJob *> m_apQueues[NUM_PRIORITIES] GUARDED_BY(m_Lock);
+	int m_NumBackgroundRunning GUARDED_BY(m_Lock);
+	int m_MaxBackgroundRunning;
 
 	static void WorkerThread(void *pUser) NO_THREAD_SAFETY_ANALYSIS;
+	IJob *FindJob(CWorker *pWorker) REQUIRES(!m_Lock);
+	void RunJob(IJob *pJob) REQUIRES(!m_Lock);
 
 public:
 	CJobPool();
@@ -58,7 +92,18 @@ public:
 
 	void Init(int NumThreads);
 	void Destroy();
-	void Add(std::shared_ptr<IJob> pJob) REQUIRES(!m_Lock);
+	void Add(std::shared_ptr<IJob> pJob, int Priority = PRIORITY_INTERACTIVE) REQUIRES(!m_Lock);
 	static void RunBlocking(IJob *pJob);
+
+	int NumThreads() const { return m_vpWorkers.size(); }
+
+	/*
+		Function: ParallelFor
+			Calls Func for each index from 0 to Num - 1 on the workers and
+			the calling thread, and returns when all calls are done.
+			Indices are handed out one by one, so calls can take
+			different amounts of time.
+	*/
+	void ParallelFor(int Num, const std::function<void(int)> &Func) REQUIRES(!m_Lock);
 };
 #endif
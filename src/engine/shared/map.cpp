@@ -1,6 +1,7 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include "map.h"
+#include <engine/engine.h>
 #include <engine/storage.h>
 
 CMap::CMap() = default;
@@ -21,6 +22,10 @@ void CMap::UnloadData(int Index)
 {
 	m_DataFile.UnloadData(Index);
 }
+void CMap::LoadData(const int *pIndices, int NumIndices)
+{
+	m_DataFile.LoadData(pIndices, NumIndices, Kernel()->RequestInterface<IEngine>());
+}
 void *CMap::GetItem(int Index, int *pType, int *pID)
 {
 	return m_DataFile.GetItem(Index, pType, pID);
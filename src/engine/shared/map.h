@@ -19,6 +19,7 @@ public:
 	int GetDataSize(int Index) override;
 	void *GetDataSwapped(int Index) override;
 	void UnloadData(int Index) override;
+	void LoadData(const int *pIndices, int NumIndices) override;
 	void *GetItem(int Index, int *pType, int *pID) override;
 	int GetItemSize(int Index) override;
 	void GetType(int Type, int *pStart, int *pNum) override;
@@ -404,12 +404,20 @@ public:
 
 	//
 	bool Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int MaxClientsPerIP);
+	// without a socket, nothing is sent or received, e.g. to replay a game
+	void OpenOffline(CNetBan *pNetBan, int MaxClients, int MaxClientsPerIP);
 	int Close();
 
 	//
 	int Recv(CNetChunk *pChunk, SECURITY_TOKEN *pResponseToken);
 	int Send(CNetChunk *pChunk);
 	int Update();
+	// sends the queued packets
+	void Flush()
+	{
+		if(m_Socket)
+			net_udp_flush(m_Socket);
+	}
 
 	//
 	int Drop(int ClientID, const char *pReason);
@@ -45,15 +45,29 @@ static SECURITY_TOKEN ToSecurityToken(const unsigned char *pData)
 
 bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int MaxClientsPerIP)
 {
-	// zero out the whole structure
-	mem_zero(this, sizeof(*this));
-
 	// open socket
-	m_Socket = net_udp_create(BindAddr);
-	if(!m_Socket)
+	NETSOCKET Socket = net_udp_create(BindAddr);
+	if(!Socket)
 		return false;
 
+	// the snapshots of all clients are sent at once every tick, the queue
+	// is sent before the server waits for the next one
+	net_udp_set_send_queue(Socket, 1);
+
+	OpenOffline(pNetBan, MaxClients, MaxClientsPerIP);
+	m_Socket = Socket;
 	m_Address = BindAddr;
+	for(auto &Slot : m_aSlots)
+		Slot.m_Connection.Init(m_Socket, true);
+
+	return true;
+}
+
+void CNetServer::OpenOffline(CNetBan *pNetBan, int MaxClients, int MaxClientsPerIP)
+{
+	// zero out the whole structure
+	mem_zero(this, sizeof(*this));
+
 	m_pNetBan = pNetBan;
 
 	m_MaxClients = clamp(MaxClients, 1, (int)NET_MAX_CLIENTS);
@@ -69,8 +83,6 @@ bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int Ma
 
 	for(auto &Slot : m_aSlots)
 		Slot.m_Connection.Init(m_Socket, true);
-
-	return true;
 }
 
 int CNetServer::SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser)
@@ -728,6 +740,8 @@ int CNetServer::Send(CNetChunk *pChunk)
 	if(pChunk->m_Flags & NETSENDFLAG_CONNLESS)
 	{
 		// send connectionless packet
+		if(!m_Socket)
+			return -1;
 		CNetBase::SendPacketConnless(m_Socket, &pChunk->m_Address, pChunk->m_pData, pChunk->m_DataSize,
 			pChunk->m_Flags & NETSENDFLAG_EXTENDED, pChunk->m_aExtraData);
 	}
@@ -764,7 +778,7 @@ void CNetServer::SendTokenSixup(NETADDR &Addr, SECURITY_TOKEN Token)
 
 int CNetServer::SendConnlessSixup(CNetChunk *pChunk, SECURITY_TOKEN ResponseToken)
 {
-	if(pChunk->m_DataSize > NET_MAX_PACKETSIZE - 9)
+	if(pChunk->m_DataSize > NET_MAX_PACKETSIZE - 9 || !m_Socket)
 		return -1;
 
 	unsigned char aBuffer[NET_MAX_PACKETSIZE];
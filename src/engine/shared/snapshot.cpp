@@ -142,96 +142,63 @@ bool CSnapshot::IsValid(size_t ActualSize) const
 	return true;
 }
 
-// CSnapshotDelta
-
-enum
-{
-	HASHLIST_SIZE = 256,
-	HASHLIST_BUCKET_SIZE = 64,
-};
+// CSnapshotItemHash
 
-struct CItemList
+void CSnapshotItemHash::Generate(const CSnapshot *pSnapshot)
 {
-	int m_Num;
-	int m_aKeys[HASHLIST_BUCKET_SIZE];
-	int m_aIndex[HASHLIST_BUCKET_SIZE];
-};
+	const int NumItems = pSnapshot->NumItems();
+	m_Mask = NumSlots(NumItems) - 1;
 
-inline size_t CalcHashID(int Key)
-{
-	// djb2 (http://www.cse.yorku.ca/~oz/hash.html)
-	unsigned Hash = 5381;
-	for(unsigned Shift = 0; Shift < sizeof(int); Shift++)
-		Hash = ((Hash << 5) + Hash) + ((Key >> (Shift * 8)) & 0xFF);
-	return Hash % HASHLIST_SIZE;
-}
+	CSlot *pSlots = Slots();
+	for(int i = 0; i <= m_Mask; i++)
+		pSlots[i].m_Key = -1;
 
-static void GenerateHash(CItemList *pHashlist, CSnapshot *pSnapshot)
-{
-	for(int i = 0; i < HASHLIST_SIZE; i++)
-		pHashlist[i].m_Num = 0;
-
-	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	// linear probing in item order, a key that's in the snapshot more than
+	// once resolves to its first item like CSnapshot::GetItemIndex
+	for(int Index = 0; Index < NumItems; Index++)
 	{
-		int Key = pSnapshot->GetItem(i)->Key();
-		size_t HashID = CalcHashID(Key);
-		if(pHashlist[HashID].m_Num < HASHLIST_BUCKET_SIZE)
+		const int Key = pSnapshot->GetItem(Index)->Key();
+		unsigned i = SlotOf(Key) & m_Mask;
+		while(pSlots[i].m_Key != -1 && pSlots[i].m_Key != Key)
+			i = (i + 1) & m_Mask;
+		if(pSlots[i].m_Key == -1)
 		{
-			pHashlist[HashID].m_aIndex[pHashlist[HashID].m_Num] = i;
-			pHashlist[HashID].m_aKeys[pHashlist[HashID].m_Num] = Key;
-			pHashlist[HashID].m_Num++;
+			pSlots[i].m_Key = Key;
+			pSlots[i].m_Index = Index;
 		}
 	}
 }
 
-static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
-{
-	size_t HashID = CalcHashID(Key);
-	for(int i = 0; i < pHashlist[HashID].m_Num; i++)
-	{
-		if(pHashlist[HashID].m_aKeys[i] == Key)
-			return pHashlist[HashID].m_aIndex[i];
-	}
-
-	return -1;
-}
+// CSnapshotDelta
 
 int CSnapshotDelta::DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
 {
+	// no early exit and no loop carried dependency other than the OR,
+	// so that the compiler can vectorize it
 	int Needed = 0;
-	while(Size)
+	for(int i = 0; i < Size; i++)
 	{
-		*pOut = *pCurrent - *pPast;
-		Needed |= *pOut;
-		pOut++;
-		pPast++;
-		pCurrent++;
-		Size--;
+		const int Diff = pCurrent[i] - pPast[i];
+		pOut[i] = Diff;
+		Needed |= Diff;
 	}
-
 	return Needed;
 }
 
 void CSnapshotDelta::UndiffItem(int *pPast, int *pDiff, int *pOut, int Size, int *pDataRate)
 {
-	while(Size)
+	int DataRate = 0;
+	for(int i = 0; i < Size; i++)
 	{
-		*pOut = *pPast + *pDiff;
-
-		if(*pDiff == 0)
-			*pDataRate += 1;
-		else
-		{
-			unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
-			unsigned char *pEnd = CVariableInt::Pack(aBuf, *pDiff, sizeof(aBuf));
-			*pDataRate += (int)(pEnd - (unsigned char *)aBuf) * 8;
-		}
+		const int Diff = pDiff[i];
+		pOut[i] = pPast[i] + Diff;
 
-		pOut++;
-		pPast++;
-		pDiff++;
-		Size--;
+		// bits CVariableInt::Pack would need for the diff, zeros count as one bit
+		const unsigned Bits = (unsigned)(Diff ^ (Diff >> 31)) >> 6;
+		const int Bytes = 1 + (Bits != 0) + (Bits >= (1u << 7)) + (Bits >= (1u << 14)) + (Bits >= (1u << 21));
+		DataRate += Diff == 0 ? 1 : Bytes * 8;
 	}
+	*pDataRate += DataRate;
 }
 
 CSnapshotDelta::CSnapshotDelta()
@@ -262,8 +229,7 @@ const CSnapshotDelta::CData *CSnapshotDelta::EmptyDelta() const
 	return &m_Empty;
 }
 
-// TODO: OPT: this should be made much faster
-int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData)
+int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData, const CSnapshotItemHash *pFromHash, const CSnapshotItemHash *pToHash)
 {
 	CData *pDelta = (CData *)pDstData;
 	int *pData = (int *)pDelta->m_aData;
@@ -272,14 +238,22 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
-	CItemList aHashlist[HASHLIST_SIZE];
-	GenerateHash(aHashlist, pTo);
+	if(!pFromHash)
+	{
+		((CSnapshotItemHash *)m_aFromHash)->Generate(pFrom);
+		pFromHash = (CSnapshotItemHash *)m_aFromHash;
+	}
+	if(!pToHash)
+	{
+		((CSnapshotItemHash *)m_aToHash)->Generate(pTo);
+		pToHash = (CSnapshotItemHash *)m_aToHash;
+	}
 
 	// pack deleted stuff
 	for(int i = 0; i < pFrom->NumItems(); i++)
 	{
 		const CSnapshotItem *pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), aHashlist) == -1)
+		if(pToHash->GetItemIndex(pFromItem->Key()) == -1)
 		{
 			// deleted
 			pDelta->m_NumDeletedItems++;
@@ -288,8 +262,6 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 		}
 	}
 
-	GenerateHash(aHashlist, pFrom);
-
 	// fetch previous indices
 	// we do this as a separate pass because it helps the cache
 	int aPastIndices[CSnapshot::MAX_ITEMS];
@@ -297,7 +269,7 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 	for(int i = 0; i < NumItems; i++)
 	{
 		const CSnapshotItem *pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndices[i] = GetItemIndexHashed(pCurItem->Key(), aHashlist); // O(n) .. O(n^n)
+		aPastIndices[i] = pFromHash->GetItemIndex(pCurItem->Key());
 	}
 
 	for(int i = 0; i < NumItems; i++)
@@ -353,7 +325,7 @@ static int RangeCheck(void *pEnd, void *pPtr, int Size)
 	return 0;
 }
 
-int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, const void *pSrcData, int DataSize)
+int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, const void *pSrcData, int DataSize, const CSnapshotItemHash *pFromHash)
 {
 	CData *pDelta = (CData *)pSrcData;
 	int *pData = (int *)pDelta->m_aData;
@@ -370,6 +342,18 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, const void *pS
 	if(pData > pEnd)
 		return -1;
 
+	alignas(CSnapshotItemHash) char aFromHash[CSnapshotItemHash::TotalSize(CSnapshot::MAX_ITEMS)];
+	if(!pFromHash)
+	{
+		if(pFrom->NumItems() < 0 || pFrom->NumItems() > CSnapshot::MAX_ITEMS)
+			return -1;
+		((CSnapshotItemHash *)aFromHash)->Generate(pFrom);
+		pFromHash = (CSnapshotItemHash *)aFromHash;
+	}
+
+	// where the items of pFrom ended up in the builder, saves searching it
+	int *apFromItemData[CSnapshot::MAX_ITEMS];
+
 	// copy all non deleted stuff
 	for(int i = 0; i < pFrom->NumItems(); i++)
 	{
@@ -385,6 +369,7 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, const void *pS
 			}
 		}
 
+		apFromItemData[i] = nullptr;
 		if(Keep)
 		{
 			void *pObj = Builder.NewItem(pFromItem->Type(), pFromItem->ID(), ItemSize);
@@ -393,6 +378,7 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, const void *pS
 
 			// keep it
 			mem_copy(pObj, pFromItem->Data(), ItemSize);
+			apFromItemData[i] = (int *)pObj;
 		}
 	}
 
@@ -428,14 +414,20 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, const void *pS
 		const int Key = (Type << 16) | ID;
 
 		// create the item if needed
-		int *pNewData = Builder.GetItemData(Key);
+		const int FromIndex = pFromHash->GetItemIndex(Key);
+		int *pNewData = FromIndex != -1 ? apFromItemData[FromIndex] : nullptr;
 		if(!pNewData)
+			pNewData = Builder.GetItemData(Key);
+		if(!pNewData)
+		{
 			pNewData = (int *)Builder.NewItem(Type, ID, ItemSize);
+			if(FromIndex != -1)
+				apFromItemData[FromIndex] = pNewData;
+		}
 
 		if(!pNewData)
 			return -4;
 
-		const int FromIndex = pFrom->GetItemIndex(Key);
 		if(FromIndex != -1)
 		{
 			// we got an update so we need to apply the diff
@@ -507,8 +499,10 @@ void CSnapshotStorage::PurgeUntil(int Tick)
 
 void CSnapshotStorage::Add(int Tick, int64_t Tagtime, int DataSize, void *pData, int AltDataSize, void *pAltData)
 {
-	// allocate memory for holder + snapshot_data
-	int TotalSize = sizeof(CHolder) + DataSize;
+	// allocate memory for holder + snapshot_data + item hash
+	const int NumItems = ((CSnapshot *)pData)->NumItems();
+	const int HashSize = CSnapshotItemHash::TotalSize(NumItems);
+	int TotalSize = sizeof(CHolder) + HashSize + DataSize;
 
 	if(AltDataSize > 0)
 	{
@@ -520,9 +514,11 @@ void CSnapshotStorage::Add(int Tick, int64_t Tagtime, int DataSize, void *pData,
 	// set data
 	pHolder->m_Tick = Tick;
 	pHolder->m_Tagtime = Tagtime;
+	pHolder->m_pSnapHash = (CSnapshotItemHash *)(pHolder + 1);
 	pHolder->m_SnapSize = DataSize;
-	pHolder->m_pSnap = (CSnapshot *)(pHolder + 1);
+	pHolder->m_pSnap = (CSnapshot *)(((char *)pHolder->m_pSnapHash) + HashSize);
 	mem_copy(pHolder->m_pSnap, pData, DataSize);
+	pHolder->m_pSnapHash->Generate(pHolder->m_pSnap);
 
 	if(AltDataSize > 0) // create alternative if wanted
 	{
@@ -546,7 +542,7 @@ void CSnapshotStorage::Add(int Tick, int64_t Tagtime, int DataSize, void *pData,
 	m_pLast = pHolder;
 }
 
-int CSnapshotStorage::Get(int Tick, int64_t *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData)
+int CSnapshotStorage::Get(int Tick, int64_t *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData, const CSnapshotItemHash **ppDataHash)
 {
 	CHolder *pHolder = m_pFirst;
 
@@ -560,6 +556,8 @@ int CSnapshotStorage::Get(int Tick, int64_t *pTagtime, CSnapshot **ppData, CSnap
 				*ppData = pHolder->m_pSnap;
 			if(ppAltData)
 				*ppAltData = pHolder->m_pAltSnap;
+			if(ppDataHash)
+				*ppDataHash = pHolder->m_pSnapHash;
 			return pHolder->m_SnapSize;
 		}
 
@@ -690,3 +688,20 @@ void *CSnapshotBuilder::NewItem(int Type, int ID, int Size)
 
 	return pObj->Data();
 }
+
+bool CSnapshotBuilder::NewItems(const void *pItems, int Size, const int *pOffsets, int NumItems)
+{
+	if(m_Sixup ||
+		m_DataSize + Size >= CSnapshot::MAX_SIZE ||
+		m_NumItems + NumItems >= CSnapshot::MAX_ITEMS)
+	{
+		return false;
+	}
+
+	mem_copy(m_aData + m_DataSize, pItems, Size);
+	for(int i = 0; i < NumItems; i++)
+		m_aOffsets[m_NumItems + i] = m_DataSize + pOffsets[i];
+	m_DataSize += Size;
+	m_NumItems += NumItems;
+	return true;
+}
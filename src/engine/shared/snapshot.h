@@ -60,6 +60,49 @@ public:
 	bool IsValid(size_t ActualSize) const;
 };
 
+// CSnapshotItemHash
+
+// Maps item keys of one snapshot to item indices, an open addressing hash
+// table with at least twice as many slots as items. The slots follow the
+// object like the offsets of a CSnapshot.
+class CSnapshotItemHash
+{
+	struct CSlot
+	{
+		int m_Key; // -1 if empty
+		int m_Index;
+	};
+
+	int m_Mask;
+
+	CSlot *Slots() const { return (CSlot *)(this + 1); }
+
+	static constexpr int NumSlots(int NumItems)
+	{
+		int Num = 16;
+		while(Num < NumItems * 2)
+			Num *= 2;
+		return Num;
+	}
+	static unsigned SlotOf(int Key) { return ((unsigned)Key * 0x9E3779B1u) >> 16; }
+
+public:
+	static constexpr size_t TotalSize(int NumItems) { return sizeof(CSnapshotItemHash) + sizeof(CSlot) * NumSlots(NumItems); }
+	// the memory must hold TotalSize(pSnapshot->NumItems()) bytes
+	void Generate(const CSnapshot *pSnapshot);
+	int GetItemIndex(int Key) const
+	{
+		const CSlot *pSlots = Slots();
+		for(unsigned i = SlotOf(Key) & m_Mask;; i = (i + 1) & m_Mask)
+		{
+			if(pSlots[i].m_Key == Key)
+				return pSlots[i].m_Index;
+			if(pSlots[i].m_Key == -1)
+				return -1;
+		}
+	}
+};
+
 // CSnapshotDelta
 
 class CSnapshotDelta
@@ -83,6 +126,10 @@ private:
 	int m_aSnapshotDataRate[CSnapshot::MAX_TYPE + 1];
 	int m_aSnapshotDataUpdates[CSnapshot::MAX_TYPE + 1];
 	CData m_Empty;
+	// the hashes CreateDelta generates when they aren't given, kept here
+	// rather than on the stack of every call
+	alignas(CSnapshotItemHash) char m_aFromHash[CSnapshotItemHash::TotalSize(CSnapshot::MAX_ITEMS)];
+	alignas(CSnapshotItemHash) char m_aToHash[CSnapshotItemHash::TotalSize(CSnapshot::MAX_ITEMS)];
 
 	static void UndiffItem(int *pPast, int *pDiff, int *pOut, int Size, int *pDataRate);
 
@@ -94,8 +141,10 @@ public:
 	int GetDataUpdates(int Index) const { return m_aSnapshotDataUpdates[Index]; }
 	void SetStaticsize(int ItemType, int Size);
 	const CData *EmptyDelta() const;
-	int CreateDelta(class CSnapshot *pFrom, class CSnapshot *pTo, void *pDstData);
-	int UnpackDelta(class CSnapshot *pFrom, class CSnapshot *pTo, const void *pSrcData, int DataSize);
+	// the hashes are generated on the fly when they aren't given, which
+	// uses memory of the object, so one call at a time
+	int CreateDelta(class CSnapshot *pFrom, class CSnapshot *pTo, void *pDstData, const CSnapshotItemHash *pFromHash = nullptr, const CSnapshotItemHash *pToHash = nullptr);
+	int UnpackDelta(class CSnapshot *pFrom, class CSnapshot *pTo, const void *pSrcData, int DataSize, const CSnapshotItemHash *pFromHash = nullptr);
 };
 
 // CSnapshotStorage
@@ -117,6 +166,9 @@ public:
 
 		CSnapshot *m_pSnap;
 		CSnapshot *m_pAltSnap;
+
+		// of m_pSnap, kept so that deltas against it don't hash it again
+		CSnapshotItemHash *m_pSnapHash;
 	};
 
 	CHolder *m_pFirst;
@@ -128,7 +180,7 @@ public:
 	void PurgeAll();
 	void PurgeUntil(int Tick);
 	void Add(int Tick, int64_t Tagtime, int DataSize, void *pData, int AltDataSize, void *pAltData);
-	int Get(int Tick, int64_t *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData);
+	int Get(int Tick, int64_t *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData, const CSnapshotItemHash **ppDataHash = nullptr);
 };
 
 class CSnapshotBuilder
@@ -159,6 +211,10 @@ public:
 	void Init(bool Sixup = false);
 
 	void *NewItem(int Type, int ID, int Size);
+	// appends items that are already laid out like in a snapshot, their
+	// types can't be extended ones. Offsets are relative to pItems. Fails
+	// for 0.7 snapshots and when the items don't fit.
+	bool NewItems(const void *pItems, int Size, const int *pOffsets, int NumItems);
 
 	CSnapshotItem *GetItem(int Index);
 	int *GetItemData(int Key);
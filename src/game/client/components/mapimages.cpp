@@ -104,6 +104,21 @@ void CMapImages::OnMapLoadImpl(class CLayers *pLayers, IMap *pMap)
 	// load new textures
 	for(int i = 0; i < m_Count; i++)
 	{
+		// decompress the next few embedded images at once, not all of them
+		// to keep the memory use low
+		if(i % IMAGE_LOAD_BATCH == 0)
+		{
+			int aDataIndices[IMAGE_LOAD_BATCH];
+			int NumDataIndices = 0;
+			for(int j = i; j < minimum(i + (int)IMAGE_LOAD_BATCH, m_Count); j++)
+			{
+				const CMapItemImage *pImg = (CMapItemImage *)pMap->GetItem(Start + j, 0, 0);
+				if(!pImg->m_External)
+					aDataIndices[NumDataIndices++] = pImg->m_ImageData;
+			}
+			pMap->LoadData(aDataIndices, NumDataIndices);
+		}
+
 		int LoadFlag = (((m_aTextureUsedByTileOrQuadLayerFlag[i] & 1) != 0) ? TextureLoadFlag : 0) | (((m_aTextureUsedByTileOrQuadLayerFlag[i] & 2) != 0) ? 0 : (Graphics()->IsTileBufferingEnabled() ? IGraphics::TEXLOAD_NO_2D_TEXTURE : 0));
 		CMapItemImage *pImg = (CMapItemImage *)pMap->GetItem(Start + i, 0, 0);
 		if(pImg->m_External)
@@ -39,6 +39,11 @@ class CMapImages : public CComponent
 	friend class CBackground;
 	friend class CMenuBackground;
 
+	enum
+	{
+		IMAGE_LOAD_BATCH = 8,
+	};
+
 	IGraphics::CTextureHandle m_aTextures[64];
 	int m_aTextureUsedByTileOrQuadLayerFlag[64]; // 0: nothing, 1(as flag): tile layer, 2(as flag): quad layer
 	int m_Count;
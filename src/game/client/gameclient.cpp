@@ -514,6 +514,7 @@ void CGameClient::OnConnected()
 
 	m_GameWorld.Clear();
 	m_GameWorld.m_WorldConfig.m_InfiniteAmmo = true;
+	InvalidatePrediction();
 	mem_zero(&m_GameInfo, sizeof(m_GameInfo));
 	m_PredictedDummyID = -1;
 	LoadMapSettings();
@@ -526,6 +527,7 @@ void CGameClient::OnReset()
 {
 	m_aLastNewPredictedTick[0] = -1;
 	m_aLastNewPredictedTick[1] = -1;
+	InvalidatePrediction();
 
 	m_aLocalTuneZone[0] = 0;
 	m_aLocalTuneZone[1] = 0;
@@ -844,6 +846,7 @@ void CGameClient::OnMessage(int MsgId, CUnpacker *pUnpacker, int Conn, bool Dumm
 			if(CCharacter *pChar = m_GameWorld.GetCharacterByID(pMsg->m_Victim))
 				pChar->ResetPrediction();
 			m_GameWorld.ReleaseHooked(pMsg->m_Victim);
+			InvalidatePrediction();
 		}
 	}
 }
@@ -1138,6 +1141,8 @@ void CGameClient::InvalidateSnapshot()
 
 void CGameClient::OnNewSnapshot()
 {
+	InvalidatePrediction();
+
 	auto &&Evolve = [this](CNetObj_Character *pCharacter, int Tick) {
 		CWorldCore TempWorld;
 		CCharacterCore TempCore = CCharacterCore();
@@ -1736,11 +1741,15 @@ void CGameClient::OnPredict()
 
 	// we can't predict without our own id or own character
 	if(m_Snap.m_LocalClientID == -1 || !m_Snap.m_aCharacters[m_Snap.m_LocalClientID].m_Active)
+	{
+		InvalidatePrediction();
 		return;
+	}
 
 	// don't predict anything if we are paused
 	if(m_Snap.m_pGameInfoObj && m_Snap.m_pGameInfoObj->m_GameStateFlags & GAMESTATEFLAG_PAUSED)
 	{
+		InvalidatePrediction();
 		if(m_Snap.m_pLocalCharacter)
 		{
 			m_PredictedChar.Read(m_Snap.m_pLocalCharacter);
@@ -1760,33 +1769,44 @@ void CGameClient::OnPredict()
 
 	// init
 	bool Dummy = g_Config.m_ClDummy ^ m_IsDummySwapping;
-	m_PredictedWorld.CopyWorld(&m_GameWorld);
+	const int DummyID = PredictDummy() ? m_PredictedDummyID : -1;
+	int StartTick = CachedPredictionTick(Dummy, DummyID);
+	if(StartTick < 0)
+	{
+		m_PredictedWorld.CopyWorld(&m_GameWorld);
 
-	// don't predict inactive players, or entities from other teams
-	for(int i = 0; i < MAX_CLIENTS; i++)
-		if(CCharacter *pChar = m_PredictedWorld.GetCharacterByID(i))
-			if((!m_Snap.m_aCharacters[i].m_Active && pChar->m_SnapTicks > 10) || IsOtherTeam(i))
-				pChar->Destroy();
+		// don't predict inactive players, or entities from other teams
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			if(CCharacter *pChar = m_PredictedWorld.GetCharacterByID(i))
+				if((!m_Snap.m_aCharacters[i].m_Active && pChar->m_SnapTicks > 10) || IsOtherTeam(i))
+					pChar->Destroy();
 
-	CProjectile *pProjNext = 0;
-	for(CProjectile *pProj = (CProjectile *)m_PredictedWorld.FindFirst(CGameWorld::ENTTYPE_PROJECTILE); pProj; pProj = pProjNext)
-	{
-		pProjNext = (CProjectile *)pProj->TypeNext();
-		if(IsOtherTeam(pProj->GetOwner()))
+		CProjectile *pProjNext = 0;
+		for(CProjectile *pProj = (CProjectile *)m_PredictedWorld.FindFirst(CGameWorld::ENTTYPE_PROJECTILE); pProj; pProj = pProjNext)
 		{
-			pProj->Destroy();
+			pProjNext = (CProjectile *)pProj->TypeNext();
+			if(IsOtherTeam(pProj->GetOwner()))
+			{
+				pProj->Destroy();
+			}
 		}
+
+		StartTick = Client()->GameTick(g_Config.m_ClDummy);
+		m_PredictionBaseTick = StartTick;
+		m_PredictionDummy = Dummy;
+		m_PredictionDummyID = DummyID;
 	}
+	InvalidatePrediction();
 
 	CCharacter *pLocalChar = m_PredictedWorld.GetCharacterByID(m_Snap.m_LocalClientID);
 	if(!pLocalChar)
 		return;
 	CCharacter *pDummyChar = 0;
-	if(PredictDummy())
-		pDummyChar = m_PredictedWorld.GetCharacterByID(m_PredictedDummyID);
+	if(DummyID >= 0)
+		pDummyChar = m_PredictedWorld.GetCharacterByID(DummyID);
 
 	// predict
-	for(int Tick = Client()->GameTick(g_Config.m_ClDummy) + 1; Tick <= Client()->PredGameTick(g_Config.m_ClDummy); Tick++)
+	for(int Tick = StartTick + 1; Tick <= Client()->PredGameTick(g_Config.m_ClDummy); Tick++)
 	{
 		// fetch the previous characters
 		if(Tick == Client()->PredGameTick(g_Config.m_ClDummy))
@@ -1807,6 +1827,16 @@ void CGameClient::OnPredict()
 		CNetObj_PlayerInput *pDummyInputData = !pDummyChar ? 0 : (CNetObj_PlayerInput *)Client()->GetInput(Tick, m_IsDummySwapping ^ 1);
 		bool DummyFirst = pInputData && pDummyInputData && pDummyChar->GetCID() < pLocalChar->GetCID();
 
+		// remember the inputs to detect when they change
+		CPredictionInput &PredictionInput = m_aPredictionInputs[Tick % 200];
+		PredictionInput.m_Tick = Tick;
+		PredictionInput.m_aHasInput[0] = pInputData != 0;
+		PredictionInput.m_aHasInput[1] = pDummyInputData != 0;
+		if(pInputData)
+			PredictionInput.m_aInputs[0] = *pInputData;
+		if(pDummyInputData)
+			PredictionInput.m_aInputs[1] = *pDummyInputData;
+
 		if(DummyFirst)
 			pDummyChar->OnDirectInput(pDummyInputData);
 		if(pInputData)
@@ -1869,6 +1899,8 @@ void CGameClient::OnPredict()
 		}
 	}
 
+	m_PredictionWorldTick = maximum(StartTick, Client()->PredGameTick(g_Config.m_ClDummy));
+
 	// detect mispredictions of other players and make corrections smoother when possible
 	static vec2 s_aLastPos[MAX_CLIENTS] = {{0, 0}};
 	static bool s_aLastActive[MAX_CLIENTS] = {false};
@@ -1967,6 +1999,42 @@ void CGameClient::OnPredict()
 		m_Ghost.OnNewPredictedSnapshot();
 }
 
+int CGameClient::CachedPredictionTick(bool Dummy, int DummyID)
+{
+	// a new snapshot or other changes to the game world need a new prediction
+	if(m_PredictionWorldTick < 0 || !m_PredictedWorld.m_IsValidCopy || m_PredictedWorld.m_pParent != &m_GameWorld || m_GameWorld.m_pChild != &m_PredictedWorld)
+		return -1;
+	if(m_PredictionBaseTick != Client()->GameTick(g_Config.m_ClDummy) || m_PredictionWorldTick > Client()->PredGameTick(g_Config.m_ClDummy))
+		return -1;
+	if(m_PredictionDummy != Dummy || m_PredictionDummyID != DummyID)
+		return -1;
+
+	// the ticks that allow movement in freeze depend on the last predicted tick
+	if(g_Config.m_ClPredictFreeze == 2)
+		return -1;
+
+	if(!m_PredictedWorld.GetCharacterByID(m_Snap.m_LocalClientID))
+		return -1;
+	const bool HasDummy = DummyID >= 0 && m_PredictedWorld.GetCharacterByID(DummyID);
+
+	// the predicted ticks have to be predicted again if one of their inputs changed
+	for(int Tick = m_PredictionBaseTick + 1; Tick <= m_PredictionWorldTick; Tick++)
+	{
+		const CPredictionInput &PredictionInput = m_aPredictionInputs[Tick % 200];
+		if(PredictionInput.m_Tick != Tick)
+			return -1;
+		for(int i = 0; i < NUM_DUMMIES; i++)
+		{
+			const CNetObj_PlayerInput *pInput = (i == 0 || HasDummy) ? (CNetObj_PlayerInput *)Client()->GetInput(Tick, m_IsDummySwapping ^ i) : 0;
+			if(PredictionInput.m_aHasInput[i] != (pInput != 0))
+				return -1;
+			if(pInput && mem_comp(&PredictionInput.m_aInputs[i], pInput, sizeof(*pInput)) != 0)
+				return -1;
+		}
+	}
+	return m_PredictionWorldTick;
+}
+
 void CGameClient::OnActivateEditor()
 {
 	OnRelease();
@@ -712,6 +712,24 @@ private:
 
 	int m_PredictedDummyID;
 	int m_IsDummySwapping;
+
+	// m_PredictedWorld is kept between predictions and only the new ticks
+	// are predicted, as long as there is no new snapshot and the inputs
+	// of the predicted ticks didn't change
+	struct CPredictionInput
+	{
+		int m_Tick;
+		bool m_aHasInput[NUM_DUMMIES];
+		CNetObj_PlayerInput m_aInputs[NUM_DUMMIES];
+	};
+	CPredictionInput m_aPredictionInputs[200];
+	int m_PredictionBaseTick;
+	int m_PredictionWorldTick = -1;
+	bool m_PredictionDummy;
+	int m_PredictionDummyID;
+	int CachedPredictionTick(bool Dummy, int DummyID);
+	void InvalidatePrediction() { m_PredictionWorldTick = -1; }
+
 	CCharOrder m_CharOrder;
 	int m_aSwitchStateTeam[NUM_DUMMIES];
 
@@ -27,6 +27,7 @@ class CEntity
 	friend class CGameWorld; // entity list handling
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
+	CSpatialHash<CEntity>::CNode m_SpatialNode;
 
 protected:
 	class CGameWorld *m_pGameWorld;
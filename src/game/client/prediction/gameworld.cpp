@@ -55,23 +55,41 @@ CEntity *CGameWorld::FindLast(int Type)
 	return pLast;
 }
 
+template<typename TFunc>
+void CGameWorld::QueryEntities(int Type, vec2 Min, vec2 Max, TFunc &&Func)
+{
+	CSmallVector<CEntity *, 32> vpFound;
+	if(m_SpatialHashActive && m_aSpatialHashes[Type].Query(Min, Max, vpFound))
+	{
+		for(CEntity *pEnt : vpFound)
+			if(!Func(pEnt))
+				return;
+	}
+	else
+	{
+		for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			if(!Func(pEnt))
+				return;
+	}
+}
+
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
 {
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
-	{
+	QueryEntities(Type, Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), [&](CEntity *pEnt) {
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
 			if(ppEnts)
 				ppEnts[Num] = pEnt;
 			Num++;
 			if(Num == Max)
-				break;
+				return false;
 		}
-	}
+		return true;
+	});
 
 	return Num;
 }
@@ -106,6 +124,7 @@ void CGameWorld::InsertEntity(CEntity *pEnt, bool Last)
 		pEnt->m_pPrevTypeEntity = pLast;
 		pEnt->m_pNextTypeEntity = 0x0;
 	}
+	m_aSpatialHashes[pEnt->m_ObjType].Insert(&pEnt->m_SpatialNode, pEnt, pEnt->m_Pos, pEnt->m_ProximityRadius, Last);
 
 	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
 	{
@@ -122,6 +141,10 @@ void CGameWorld::InsertEntity(CEntity *pEnt, bool Last)
 
 void CGameWorld::RemoveEntity(CEntity *pEnt)
 {
+	// it might not live to be updated after its tick
+	if(m_pTraverseEntity == pEnt)
+		m_pTraverseEntity = nullptr;
+
 	// not in the list
 	if(!pEnt->m_pNextTypeEntity && !pEnt->m_pPrevTypeEntity && m_apFirstEntityTypes[pEnt->m_ObjType] != pEnt)
 		return;
@@ -141,6 +164,8 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = 0;
 	pEnt->m_pPrevTypeEntity = 0;
 
+	m_aSpatialHashes[pEnt->m_ObjType].Remove(&pEnt->m_SpatialNode);
+
 	if(pEnt->m_pParent)
 	{
 		if(m_IsValidCopy && m_pParent && m_pParent->m_pChild == this)
@@ -155,6 +180,18 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 	}
 }
 
+void CGameWorld::UpdateSpatialHash()
+{
+	for(auto *pEnt : m_apFirstEntityTypes)
+		for(; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			UpdateSpatialHash(pEnt);
+}
+
+void CGameWorld::UpdateSpatialHash(CEntity *pEnt)
+{
+	m_aSpatialHashes[pEnt->m_ObjType].Move(&pEnt->m_SpatialNode, pEnt->m_Pos);
+}
+
 void CGameWorld::RemoveCharacter(CCharacter *pChar)
 {
 	int ID = pChar->GetCID();
@@ -187,6 +224,10 @@ bool distCompare(std::pair<float, int> a, std::pair<float, int> b)
 
 void CGameWorld::Tick()
 {
+	// entities were read from snapshots since the last tick
+	m_SpatialHashActive = true;
+	UpdateSpatialHash();
+
 	// update all objects
 	if(m_WorldConfig.m_NoWeakHookAndBounce)
 	{
@@ -194,7 +235,10 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pTraverseEntity = pEnt;
 				pEnt->PreTick();
+				if(m_pTraverseEntity)
+					UpdateSpatialHash(m_pTraverseEntity);
 				pEnt = m_pNextTraverseEntity;
 			}
 	}
@@ -203,7 +247,10 @@ void CGameWorld::Tick()
 		for(; pEnt;)
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			m_pTraverseEntity = pEnt;
 			pEnt->Tick();
+			if(m_pTraverseEntity)
+				UpdateSpatialHash(m_pTraverseEntity);
 			pEnt = m_pNextTraverseEntity;
 		}
 
@@ -211,11 +258,17 @@ void CGameWorld::Tick()
 		for(; pEnt;)
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			m_pTraverseEntity = pEnt;
 			pEnt->TickDeferred();
 			pEnt->m_SnapTicks++;
+			if(m_pTraverseEntity)
+				UpdateSpatialHash(m_pTraverseEntity);
 			pEnt = m_pNextTraverseEntity;
 		}
 
+	m_pTraverseEntity = nullptr;
+	m_SpatialHashActive = false;
+
 	RemoveEntities();
 
 	// update switch state
@@ -248,17 +301,18 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
-	{
+	const vec2 Min = vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius);
+	const vec2 Max = vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius);
+	QueryEntities(ENTTYPE_CHARACTER, Min, Max, [&](CEntity *pEnt) {
+		CCharacter *p = (CCharacter *)pEnt;
 		if(p == pNotThis)
-			continue;
+			return true;
 
 		if(pThisOnly && p != pThisOnly)
-			continue;
+			return true;
 
 		if(CollideWith != -1 && !p->CanCollide(CollideWith))
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, p->m_Pos, IntersectPos))
@@ -275,20 +329,22 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 				}
 			}
 		}
-	}
+		return true;
+	});
 
 	return pClosest;
 }
 
-std::list<class CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, class CEntity *pNotThis)
+CSmallVector<CCharacter *, 8> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, class CEntity *pNotThis)
 {
-	std::list<CCharacter *> listOfChars;
+	CSmallVector<CCharacter *, 8> vpChars;
 
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
-	{
+	const vec2 Min = vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius);
+	const vec2 Max = vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius);
+	QueryEntities(ENTTYPE_CHARACTER, Min, Max, [&](CEntity *pEnt) {
+		CCharacter *pChr = (CCharacter *)pEnt;
 		if(pChr == pNotThis)
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, pChr->m_Pos, IntersectPos))
@@ -296,11 +352,12 @@ std::list<class CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2
 			float Len = distance(pChr->m_Pos, IntersectPos);
 			if(Len < pChr->m_ProximityRadius + Radius)
 			{
-				listOfChars.push_back(pChr);
+				vpChars.push_back(pChr);
 			}
 		}
-	}
-	return listOfChars;
+		return true;
+	});
+	return vpChars;
 }
 
 void CGameWorld::ReleaseHooked(int ClientID)
@@ -3,10 +3,13 @@
 #ifndef GAME_CLIENT_PREDICTION_GAMEWORLD_H
 #define GAME_CLIENT_PREDICTION_GAMEWORLD_H
 
+#include <base/tl/small_vector.h>
 #include <game/gamecore.h>
+#include <game/spatial_hash.h>
 #include <game/teamscore.h>
 
 #include <list>
+#include <vector>
 
 class CCollision;
 class CCharacter;
@@ -44,7 +47,7 @@ public:
 
 	// DDRace
 	void ReleaseHooked(int ClientID);
-	std::list<CCharacter *> IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, CEntity *pNotThis = nullptr);
+	CSmallVector<CCharacter *, 8> IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, CEntity *pNotThis = nullptr);
 
 	int m_GameTick;
 	int m_GameTickSpeed;
@@ -103,6 +106,17 @@ private:
 	CEntity *m_pNextTraverseEntity = nullptr;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// like in the server's world, queries only use the spatial hash
+	// while the world ticks
+	CSpatialHash<CEntity> m_aSpatialHashes[NUM_ENTTYPES];
+	bool m_SpatialHashActive = false;
+	CEntity *m_pTraverseEntity = nullptr;
+
+	void UpdateSpatialHash();
+	void UpdateSpatialHash(CEntity *pEnt);
+	template<typename TFunc>
+	void QueryEntities(int Type, vec2 Min, vec2 Max, TFunc &&Func);
+
 	CCharacter *m_apCharacters[MAX_CLIENTS];
 };
 
@@ -1,5 +1,4 @@
 #include <cctype>
-#include <list>
 
 #include <game/client/gameclient.h>
 #include <game/mapitems.h>
@@ -76,7 +75,7 @@ bool CRaceHelper::IsStart(CGameClient *pClient, vec2 Prev, vec2 Pos)
 	}
 	else
 	{
-		std::list<int> Indices = pCollision->GetMapIndices(Prev, Pos);
+		CMapIndices Indices = pCollision->GetMapIndices(Prev, Pos);
 		if(!Indices.empty())
 			for(int &Indice : Indices)
 			{
@@ -274,6 +274,32 @@ int CCollision::GetMoveRestrictions(CALLBACK_SWITCHACTIVE pfnSwitchActive, void
 	return Restrictions;
 }
 
+// Line queries sample the line about once per pixel and only care about
+// the tile a sample lands in. Returns how many of the samples following
+// the one at Pos, Step apart, certainly land in the same tile as it,
+// Pixel being Pos rounded (or truncated) to the pixel that was looked up.
+// Sample positions only ever move towards Pos1, so only the side of the
+// tile the line leaves through matters.
+static int SamplesInTile(vec2 Pos, vec2 Step, ivec2 Pixel, bool Rounded)
+{
+	if(Pixel.x < 0 || Pixel.y < 0)
+		return 0;
+
+	// pixels round to the nearest one, keep clear of the float error
+	const float Bias = Rounded ? 0.5f : 0.0f;
+	const float Margin = 1.0f + (absolute(Pos.x) + absolute(Pos.y)) / 65536.0f;
+	float Samples = 1e6f;
+	if(Step.x > 0)
+		Samples = minimum(Samples, ((Pixel.x / 32 + 1) * 32 - Bias - Margin - Pos.x) / Step.x);
+	else if(Step.x < 0)
+		Samples = minimum(Samples, (Pos.x - (Pixel.x / 32 * 32 - Bias + Margin)) / -Step.x);
+	if(Step.y > 0)
+		Samples = minimum(Samples, ((Pixel.y / 32 + 1) * 32 - Bias - Margin - Pos.y) / Step.y);
+	else if(Step.y < 0)
+		Samples = minimum(Samples, (Pos.y - (Pixel.y / 32 * 32 - Bias + Margin)) / -Step.y);
+	return Samples < 1.0f ? 0 : (int)Samples;
+}
+
 int CCollision::GetTile(int x, int y) const
 {
 	if(!m_pTiles)
@@ -288,11 +314,11 @@ int CCollision::GetTile(int x, int y) const
 	return 0;
 }
 
-// TODO: rewrite this smarter!
 int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
+	vec2 Step = (Pos1 - Pos0) / (float)End;
 	vec2 Last = Pos0;
 	int ix = 0, iy = 0; // Temporary position for checking collision
 	for(int i = 0; i <= End; i++)
@@ -312,6 +338,9 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 		}
 
 		Last = Pos;
+		// jump to the last sample that's still in this tile, it becomes
+		// the last position before the next tile
+		i += maximum(minimum(SamplesInTile(Pos, Step, ivec2(ix, iy), true), End - i) - 1, 0);
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -324,6 +353,7 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
+	vec2 Step = (Pos1 - Pos0) / (float)End;
 	vec2 Last = Pos0;
 	int ix = 0, iy = 0; // Temporary position for checking collision
 	int dx = 0, dy = 0; // Offset for checking the "through" tile
@@ -369,6 +399,9 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 		}
 
 		Last = Pos;
+		// jump to the last sample that's still in this tile, it becomes
+		// the last position before the next tile
+		i += maximum(minimum(SamplesInTile(Pos, Step, ivec2(ix, iy), true), End - i) - 1, 0);
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -381,6 +414,7 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
+	vec2 Step = (Pos1 - Pos0) / (float)End;
 	vec2 Last = Pos0;
 	int ix = 0, iy = 0; // Temporary position for checking collision
 	for(int i = 0; i <= End; i++)
@@ -414,6 +448,9 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 		}
 
 		Last = Pos;
+		// jump to the last sample that's still in this tile, it becomes
+		// the last position before the next tile
+		i += maximum(minimum(SamplesInTile(Pos, Step, ivec2(ix, iy), true), End - i) - 1, 0);
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -892,9 +929,9 @@ int CCollision::GetMapIndex(vec2 Pos) const
 		return -1;
 }
 
-std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices) const
+CMapIndices CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices) const
 {
-	std::list<int> Indices;
+	CMapIndices Indices;
 	float d = distance(PrevPos, Pos);
 	int End(d + 1);
 	if(!d)
@@ -915,6 +952,7 @@ std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxInd
 	{
 		float a = 0.0f;
 		vec2 Tmp = vec2(0, 0);
+		vec2 Step = (Pos - PrevPos) / d;
 		int Nx = 0;
 		int Ny = 0;
 		int Index, LastIndex = 0;
@@ -927,11 +965,13 @@ std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxInd
 			Index = Ny * m_Width + Nx;
 			if(TileExists(Index) && LastIndex != Index)
 			{
-				if(MaxIndices && Indices.size() > MaxIndices)
+				if(MaxIndices && (unsigned)Indices.size() > MaxIndices)
 					return Indices;
 				Indices.push_back(Index);
 				LastIndex = Index;
 			}
+			// the following samples in this tile can't add an index
+			i += minimum(SamplesInTile(Tmp, Step, ivec2((int)Tmp.x, (int)Tmp.y), false), End - 1 - i);
 		}
 
 		return Indices;
@@ -1167,6 +1207,7 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 {
 	float d = distance(Pos0, Pos1);
 	vec2 Last = Pos0;
+	vec2 Step = (Pos1 - Pos0) / d;
 
 	for(int i = 0, id = (int)ceilf(d); i < id; i++)
 	{
@@ -1186,6 +1227,7 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 				return GetCollisionAt(Pos.x, Pos.y);
 		}
 		Last = Pos;
+		i += maximum(minimum(SamplesInTile(Pos, Step, ivec2(round_to_int(Pos.x), round_to_int(Pos.y)), true), id - 1 - i) - 1, 0);
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -1198,6 +1240,7 @@ int CCollision::IntersectNoLaserNW(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, ve
 {
 	float d = distance(Pos0, Pos1);
 	vec2 Last = Pos0;
+	vec2 Step = (Pos1 - Pos0) / d;
 
 	for(int i = 0, id = (int)ceilf(d); i < id; i++)
 	{
@@ -1215,6 +1258,7 @@ int CCollision::IntersectNoLaserNW(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, ve
 				return GetFCollisionAt(Pos.x, Pos.y);
 		}
 		Last = Pos;
+		i += maximum(minimum(SamplesInTile(Pos, Step, ivec2(round_to_int(Pos.x), round_to_int(Pos.y)), true), id - 1 - i) - 1, 0);
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -1227,6 +1271,7 @@ int CCollision::IntersectAir(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pO
 {
 	float d = distance(Pos0, Pos1);
 	vec2 Last = Pos0;
+	vec2 Step = (Pos1 - Pos0) / d;
 
 	for(int i = 0, id = (int)ceilf(d); i < id; i++)
 	{
@@ -1246,6 +1291,7 @@ int CCollision::IntersectAir(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pO
 				return GetFTile(round_to_int(Pos.x), round_to_int(Pos.y));
 		}
 		Last = Pos;
+		i += maximum(minimum(SamplesInTile(Pos, Step, ivec2(round_to_int(Pos.x), round_to_int(Pos.y)), true), id - 1 - i) - 1, 0);
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
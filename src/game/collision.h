@@ -3,11 +3,10 @@
 #ifndef GAME_COLLISION_H
 #define GAME_COLLISION_H
 
+#include <base/tl/small_vector.h>
 #include <base/vmath.h>
 #include <engine/shared/protocol.h>
 
-#include <list>
-
 enum
 {
 	CANTMOVE_LEFT = 1 << 0,
@@ -18,6 +17,9 @@ enum
 
 vec2 ClampVel(int MoveRestriction, vec2 Vel);
 
+// a move rarely crosses more than a handful of tiles
+typedef CSmallVector<int, 16> CMapIndices;
+
 typedef bool (*CALLBACK_SWITCHACTIVE)(int Number, void *pUser);
 struct CAntibotMapData;
 
@@ -73,7 +75,7 @@ public:
 	int Entity(int x, int y, int Layer) const;
 	int GetPureMapIndex(float x, float y) const;
 	int GetPureMapIndex(vec2 Pos) const { return GetPureMapIndex(Pos.x, Pos.y); }
-	std::list<int> GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices = 0) const;
+	CMapIndices GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices = 0) const;
 	int GetMapIndex(vec2 Pos) const;
 	bool TileExists(int Index) const;
 	bool TileExistsNext(int Index) const;
@@ -7,6 +7,8 @@
 
 #include <engine/map.h>
 
+#include <vector>
+
 CLayers::CLayers()
 {
 	m_GroupsNum = 0;
@@ -186,6 +188,31 @@ void CLayers::InitBackground(class IMap *pMap)
 
 void CLayers::InitTilemapSkip()
 {
+	// decompress the tiles of all layers at once, the collision needs the
+	// ones of the other physics layers as well
+	std::vector<int> vDataIndices;
+	for(int g = 0; g < NumGroups(); g++)
+	{
+		const CMapItemGroup *pGroup = GetGroup(g);
+		for(int l = 0; l < pGroup->m_NumLayers; l++)
+		{
+			const CMapItemLayer *pLayer = GetLayer(pGroup->m_StartLayer + l);
+			if(pLayer->m_Type == LAYERTYPE_TILES)
+				vDataIndices.push_back(((CMapItemLayerTilemap *)pLayer)->m_Data);
+		}
+	}
+	if(m_pTeleLayer)
+		vDataIndices.push_back(m_pTeleLayer->m_Tele);
+	if(m_pSpeedupLayer)
+		vDataIndices.push_back(m_pSpeedupLayer->m_Speedup);
+	if(m_pFrontLayer)
+		vDataIndices.push_back(m_pFrontLayer->m_Front);
+	if(m_pSwitchLayer)
+		vDataIndices.push_back(m_pSwitchLayer->m_Switch);
+	if(m_pTuneLayer)
+		vDataIndices.push_back(m_pTuneLayer->m_Tune);
+	m_pMap->LoadData(vDataIndices.data(), vDataIndices.size());
+
 	for(int g = 0; g < NumGroups(); g++)
 	{
 		const CMapItemGroup *pGroup = GetGroup(g);
@@ -5,6 +5,8 @@ extern "C" {
 	#include <decomp/include/surface_terrains.h>
 }
 
+#include <algorithm>
+
 #include <stdlib.h>
 #include <string.h>
 
@@ -21,6 +23,7 @@ CMario::CMario(CGameWorld *pGameWorld, vec2 Pos, int owner) : CEntity(pGameWorld
 	GameWorld()->InsertEntity(this);
 	m_Owner = owner;
 	m_Scale = g_Config.m_MarioScale/100.f;
+	m_PrevPhysPos = m_PhysPos = Pos;
 
 	// on teeworlds, up coordinate is Y-, SM64 is Y+. flip the Y coordinate
 	// scale conversions:
@@ -39,8 +42,11 @@ CMario::CMario(CGameWorld *pGameWorld, vec2 Pos, int owner) : CEntity(pGameWorld
 
 	//exportMap(spawnX, spawnY);
 
-	memset(m_currSurfaces, -1, sizeof(uint32_t) * MAX_SURFACES);
-	loadNewBlocks(Pos.x/32, -Pos.y/32);
+	m_SurfaceWindowLoaded = false;
+	deleteBlocks();
+	m_StreamSurfaces = GameServer()->m_MarioMeshScale != g_Config.m_MarioScale;
+	if (m_StreamSurfaces)
+		loadNewBlocks(Pos.x/32, -Pos.y/32);
 
 	marioId = sm64_mario_create(spawnX, spawnY, 0, 0,0,0,0);
 	if (marioId == -1)
@@ -51,6 +57,10 @@ CMario::CMario(CGameWorld *pGameWorld, vec2 Pos, int owner) : CEntity(pGameWorld
 		return;
 	}
 
+	// reserve the laser IDs once, reusing them every snapshot keeps the deltas small
+	for (int &id : m_aSnapIDs)
+		id = Server()->SnapNewID();
+
 	//GameServer()->m_apPlayers[m_Owner]->Pause(CPlayer::PAUSE_SPEC, true);
 	//GameServer()->m_apPlayers[m_Owner]->m_SpectatorID = m_Owner;
 
@@ -84,6 +94,10 @@ void CMario::Destroy()
 		deleteBlocks();
 		sm64_mario_delete(marioId);
 		marioId = -1;
+
+		for (int id : m_aSnapIDs)
+			Server()->SnapFreeID(id);
+		m_vOutline.clear();
 	}
 	m_MarkedForDestroy = true;
 	if (GameServer()->m_apPlayers[m_Owner])
@@ -119,40 +133,104 @@ void CMario::Tick()
 	input.buttonB = character->GetLatestInput()->m_Fire & 1;
 	input.buttonZ = character->GetLatestInput()->m_Hook;
 
-	m_Tick += 1.f/Server()->TickSpeed();
-	while (m_Tick >= 1.f/30)
-	{
-		m_Tick -= 1.f/30;
+	// the physics steps run in CGameWorld::TickMarios, for all Marios at once
+}
 
-		sm64_reset_mario_z(marioId);
-		sm64_mario_tick(marioId, &input, &state, &geometry);
+bool CMario::BeginStep()
+{
+	if (marioId == -1) return false;
 
-		vec2 newPos(state.position[0]*m_Scale, -state.position[1]*m_Scale);
-		if ((int)(newPos.x/32) != (int)(m_Pos.x/32) || (int)(newPos.y/32) != (int)(m_Pos.y/32))
-			loadNewBlocks(newPos.x/32, newPos.y/32);
+	sm64_reset_mario_z(marioId);
+	return true;
+}
 
-		m_Pos = newPos;
+void CMario::EndStep(bool LastStep)
+{
+	vec2 newPos(state.position[0]*m_Scale, -state.position[1]*m_Scale);
+	if (m_StreamSurfaces && ((int)(newPos.x/32) != (int)(m_PhysPos.x/32) || (int)(newPos.y/32) != (int)(m_PhysPos.y/32)))
+		loadNewBlocks(newPos.x/32, newPos.y/32);
 
-		player->m_ViewPos = vec2(m_Pos.x, m_Pos.y-48);
-	}
+	m_PrevPhysPos = m_PhysPos;
+	m_PhysPos = newPos;
+
+	// the outline is shared by all snapping clients, so only rebuild it when Mario moved
+	if (LastStep)
+		updateOutline();
+}
+
+void CMario::Interpolate(float Alpha)
+{
+	if (marioId == -1 || m_MarkedForDestroy) return;
+
+	CPlayer *player = GameServer()->m_apPlayers[m_Owner];
+	CCharacter *character = GameServer()->GetPlayerChar(m_Owner);
+	if (!player || !character) return;
+
+	m_Pos = mix(m_PrevPhysPos, m_PhysPos, Alpha);
+	player->m_ViewPos = vec2(m_Pos.x, m_Pos.y-48);
 
 	character->Core()->m_Pos = character->m_Pos = m_Pos;
 	character->Core()->m_Vel = vec2(0,0);
 	character->ResetHook();
 }
 
-void CMario::Snap(int SnappingClient)
+void CMario::SnapShared()
 {
 	if (marioId == -1) return;
 	if (!GameServer()->m_apPlayers[m_Owner] || !GameServer()->GetPlayerChar(m_Owner)) return;
-	if (NetworkClipped(SnappingClient, m_Pos)) return;
 
-	float drawScale = g_Config.m_MarioDrawScale / 100.f;
+	// only changes once per second so the lasers don't show up in every delta
+	int startTick = (Server()->Tick() / Server()->TickSpeed() + 2) * Server()->TickSpeed();
+
+	// every client sees the same outline, clipped by Mario's position
+	GameWorld()->SnapTable()->AddGroup(m_Pos, CmaskAll());
+	for (size_t i=0; i<m_vOutline.size(); i++)
+	{
+		CNetObj_Laser *pObj = static_cast<CNetObj_Laser *>(GameWorld()->SnapTable()->AddItem(NETOBJTYPE_LASER, m_aSnapIDs[i], sizeof(CNetObj_Laser)));
+		pObj->m_FromX = (int)m_Pos.x + m_vOutline[i].x;
+		pObj->m_FromY = (int)m_Pos.y + m_vOutline[i].y;
+		pObj->m_X = pObj->m_FromX;
+		pObj->m_Y = pObj->m_FromY;
+		pObj->m_StartTick = startTick;
+	}
+}
+
+bool CMario::SaveState(char *pBuf, int BufSize)
+{
+	if (marioId == -1) return false;
+
+	std::vector<unsigned char> vSnapshot(sm64_mario_snapshot_size());
+	if (!sm64_mario_snapshot(marioId, vSnapshot.data(), vSnapshot.size()))
+		return false;
 
-	std::vector<ivec2> verticesSnapped;
-	for (int id : vertexIDs)
-		Server()->SnapFreeID(id);
-	vertexIDs.clear();
+	// base64 grows the data by a third, don't write a truncated snapshot
+	if (((int)vSnapshot.size() + 2) / 3 * 4 >= BufSize)
+		return false;
+
+	str_base64(pBuf, BufSize, vSnapshot.data(), vSnapshot.size());
+	return true;
+}
+
+bool CMario::LoadState(const char *pState)
+{
+	if (marioId == -1) return false;
+
+	std::vector<unsigned char> vSnapshot(sm64_mario_snapshot_size());
+	int Size = str_base64_decode(vSnapshot.data(), vSnapshot.size(), pState);
+	if (Size < 0 || !sm64_mario_restore(marioId, vSnapshot.data(), Size, &state))
+		return false;
+
+	// no interpolation from where Mario was before the restore
+	m_PhysPos = m_PrevPhysPos = m_Pos = vec2(state.position[0]*m_Scale, -state.position[1]*m_Scale);
+	if (m_StreamSurfaces)
+		loadNewBlocks(m_Pos.x/32, m_Pos.y/32);
+	return true;
+}
+
+void CMario::updateOutline()
+{
+	float drawScale = g_Config.m_MarioDrawScale / 100.f;
+	m_vOutline.clear();
 
 	// QuickHull
 	std::vector<size_t> indexBuffer;
@@ -189,91 +267,89 @@ void CMario::Snap(int SnappingClient)
 
 				Polygon polygon(polygonPoints);
 				convexHull = polygon.ComputeConvexHull();
-				end = convexHull.size()-1;
+				end = convexHull.empty() ? 0 : convexHull.size()-1;
 			}
 			break;
+
+		case 3:
+			// low detail outline from Mario's hitbox, doesn't need any geometry
+			end = 8;
+			break;
 	}
 
 	for (size_t i=0; i<end; i++)
 	{
-		ivec2 vertex, vertexTo;
+		ivec2 vertex;
 		switch(g_Config.m_MarioDrawMode)
 		{
 			case 0:
 				vertex = ivec2((int)geometry.position[i*3+0], -(int)geometry.position[i*3+1]);
-				vertexTo = vertex;
 				break;
 
 			case 1:
 				vertex = ivec2((int)vertexBuffer[indexBuffer[i]].x, -(int)vertexBuffer[indexBuffer[i]].y);
-				vertexTo = ivec2((int)vertexBuffer[indexBuffer[i+1]].x, -(int)vertexBuffer[indexBuffer[i+1]].y);
 				break;
 
 			case 2:
 				vertex = ivec2((int)convexHull[i].GetX(), -(int)convexHull[i].GetY());
-				vertexTo = ivec2((int)convexHull[i+1].GetX(), -(int)convexHull[i+1].GetY());
 				break;
-		}
 
-		vertex.x = ((vertex.x * m_Scale) - m_Pos.x) * drawScale + m_Pos.x;
-		vertex.y = ((vertex.y * m_Scale) - m_Pos.y) * drawScale + m_Pos.y;
-		vertexTo.x = ((vertexTo.x * m_Scale) - m_Pos.x) * drawScale + m_Pos.x;
-		vertexTo.y = ((vertexTo.y * m_Scale) - m_Pos.y) * drawScale + m_Pos.y;
-
-		vertex.y += 8;
-		vertexTo.y += 8;
-
-		bool repeated = false;
-
-		for (size_t j=0; j<verticesSnapped.size(); j++)
-		{
-			if (verticesSnapped[j] == vertex)
-			{
-				repeated = true;
+			case 3:
+				{
+					// corners and edge midpoints of a 74x160 box standing on Mario's position
+					static const int s_aHitbox[8][2] = {{-37, 0}, {0, 0}, {37, 0}, {37, 80}, {37, 160}, {0, 160}, {-37, 160}, {-37, 80}};
+					vertex = ivec2((int)state.position[0] + s_aHitbox[i][0], -((int)state.position[1] + s_aHitbox[i][1]));
+				}
 				break;
-			}
 		}
 
-		if (repeated) continue;
-		verticesSnapped.push_back(vertex);
-		int id = Server()->SnapNewID();
-		vertexIDs.push_back(id);
+		vertex.x = ((vertex.x * m_Scale) - m_PhysPos.x) * drawScale;
+		vertex.y = ((vertex.y * m_Scale) - m_PhysPos.y) * drawScale;
+		vertex.y += 8;
 
-		CNetObj_Laser *pObj = static_cast<CNetObj_Laser *>(Server()->SnapNewItem(NETOBJTYPE_LASER, id, sizeof(CNetObj_Laser)));
-		if(!pObj)
-			continue;
+		m_vOutline.push_back(vertex);
+	}
+
+	// drop repeated vertices
+	std::sort(m_vOutline.begin(), m_vOutline.end(), [](const ivec2 &a, const ivec2 &b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+	m_vOutline.erase(std::unique(m_vOutline.begin(), m_vOutline.end()), m_vOutline.end());
 
-		pObj->m_FromX = vertex.x;
-		pObj->m_FromY = vertex.y;
-		pObj->m_X = vertex.x;
-		pObj->m_Y = vertex.y;
-		pObj->m_StartTick = Server()->Tick() + Server()->TickSpeed();
+	// keep within the snap ID budget, evenly thinning out the outline
+	if (m_vOutline.size() > MARIO_MAX_OUTLINE_POINTS)
+	{
+		for (int i=0; i<MARIO_MAX_OUTLINE_POINTS; i++)
+			m_vOutline[i] = m_vOutline[i * m_vOutline.size() / MARIO_MAX_OUTLINE_POINTS];
+		m_vOutline.resize(MARIO_MAX_OUTLINE_POINTS);
 	}
 }
 
 void CMario::deleteBlocks()
 {
-	for (int j=0; j<MAX_SURFACES; j++)
+	for (int c=0; c<SURFACE_WINDOW_COLUMNS; c++)
 	{
-		if (m_currSurfaces[j] == (uint32_t)(-1)) continue;
-		sm64_surface_object_delete(m_currSurfaces[j]);
-		m_currSurfaces[j] = -1;
+		SSurfaceColumn *pColumn = &m_aSurfaceColumns[c];
+		for (int j=0; j<pColumn->m_NumTiles; j++)
+		{
+			if (pColumn->m_aTiles[j].m_ObjectID != (uint32_t)(-1))
+				sm64_surface_object_delete(pColumn->m_aTiles[j].m_ObjectID);
+		}
+		pColumn->m_NumTiles = 0;
+		pColumn->m_FloorScanY = 1;
+		pColumn->m_FloorY = 0;
 	}
+	m_SurfaceWindowLoaded = false;
 }
 
-bool CMario::addBlock(int x, int y, int *i)
+uint32_t CMario::addBlock(int x, int y)
 {
-	if ((*i) >= MAX_SURFACES) return false;
-	bool block = GameServer()->Collision()->CheckPoint(x*32, y*32);
-	if (!block) return false;
-
+	struct SM64Surface aSurfaces[4*2];
 	struct SM64SurfaceObject obj;
 	memset(&obj.transform, 0, sizeof(struct SM64ObjectTransform));
 	obj.transform.position[0] = x*32 / m_Scale;
 	obj.transform.position[1] = (-y*32-16) / m_Scale;
 	obj.transform.position[2] = 0;
 	obj.surfaceCount = 0;
-	obj.surfaces = (struct SM64Surface*)malloc(sizeof(struct SM64Surface) * 4*2);
+	obj.surfaces = aSurfaces;
 
 	bool up =		GameServer()->Collision()->CheckPoint(x*32, y*32-32);
 	bool down =		GameServer()->Collision()->CheckPoint(x*32, y*32+32);
@@ -343,32 +419,92 @@ bool CMario::addBlock(int x, int y, int *i)
 		obj.surfaces[ind].terrain = TERRAIN_STONE;
 	}
 
-	if (obj.surfaceCount)
-		m_currSurfaces[(*i)++] = sm64_surface_object_create(&obj);
-
-	free(obj.surfaces);
-	return true;
+	if (!obj.surfaceCount)
+		return -1;
+	return sm64_surface_object_create(&obj);
 }
 
-void CMario::loadNewBlocks(int x, int y)
+void CMario::loadColumn(SSurfaceColumn *pColumn, int x, int y)
 {
-	deleteBlocks();
-	int yadd = 0;
+	CCollision *pCollision = GameServer()->Collision();
+
+	// get block at floor, the previous scan still holds as long as Mario didn't move below it
+	if (y < pColumn->m_FloorScanY || y > pColumn->m_FloorY)
+	{
+		int floorY = y;
+		while (floorY <= pCollision->GetHeight() && !pCollision->CheckPoint(x*32, floorY*32))
+			floorY++;
+		pColumn->m_FloorScanY = y;
+		pColumn->m_FloorY = floorY;
+	}
+
+	int aWanted[SURFACE_COLUMN_MAX_TILES];
+	int numWanted = 0;
+	if (pColumn->m_FloorY <= pCollision->GetHeight() && pColumn->m_FloorY != y)
+		aWanted[numWanted++] = pColumn->m_FloorY;
+	for (int yadd=SURFACE_WINDOW_ABOVE; yadd>=0; yadd--)
+	{
+		if (pCollision->CheckPoint(x*32, (y-yadd)*32))
+			aWanted[numWanted++] = y-yadd;
+	}
 
-	int arrayInd = 0;
-	for (int xadd=-7; xadd<=7; xadd++)
+	// evict the tiles that left the window
+	for (int j=0; j<pColumn->m_NumTiles;)
 	{
-		// get block at floor
-		for (yadd=0; y+yadd<=GameServer()->Collision()->GetHeight(); yadd++)
+		bool wanted = false;
+		for (int k=0; k<numWanted && !wanted; k++)
+			wanted = pColumn->m_aTiles[j].m_Y == aWanted[k];
+
+		if (wanted)
 		{
-			if (addBlock(x+xadd, y+yadd, &arrayInd)) break;
+			j++;
+			continue;
 		}
 
-		for (yadd=6; yadd>=0; yadd--)
+		if (pColumn->m_aTiles[j].m_ObjectID != (uint32_t)(-1))
+			sm64_surface_object_delete(pColumn->m_aTiles[j].m_ObjectID);
+		pColumn->m_aTiles[j] = pColumn->m_aTiles[--pColumn->m_NumTiles];
+	}
+
+	// and only create the ones that entered it
+	for (int k=0; k<numWanted; k++)
+	{
+		bool loaded = false;
+		for (int j=0; j<pColumn->m_NumTiles && !loaded; j++)
+			loaded = pColumn->m_aTiles[j].m_Y == aWanted[k];
+		if (loaded)
+			continue;
+
+		SSurfaceTile *pTile = &pColumn->m_aTiles[pColumn->m_NumTiles++];
+		pTile->m_Y = aWanted[k];
+		pTile->m_ObjectID = addBlock(x, aWanted[k]);
+	}
+}
+
+void CMario::loadNewBlocks(int x, int y)
+{
+	for (int xadd=-SURFACE_WINDOW_RADIUS; xadd<=SURFACE_WINDOW_RADIUS; xadd++)
+	{
+		int cx = x+xadd;
+		SSurfaceColumn *pColumn = &m_aSurfaceColumns[((cx % SURFACE_WINDOW_COLUMNS) + SURFACE_WINDOW_COLUMNS) % SURFACE_WINDOW_COLUMNS];
+
+		// the slot still holds a column that scrolled out of the window, recycle it
+		if (!m_SurfaceWindowLoaded || pColumn->m_X != cx)
 		{
-			addBlock(x+xadd, y-yadd, &arrayInd);
+			for (int j=0; j<pColumn->m_NumTiles; j++)
+			{
+				if (pColumn->m_aTiles[j].m_ObjectID != (uint32_t)(-1))
+					sm64_surface_object_delete(pColumn->m_aTiles[j].m_ObjectID);
+			}
+			pColumn->m_X = cx;
+			pColumn->m_NumTiles = 0;
+			pColumn->m_FloorScanY = 1;
+			pColumn->m_FloorY = 0;
 		}
+
+		loadColumn(pColumn, cx, y);
 	}
+	m_SurfaceWindowLoaded = true;
 }
 
 void CMario::exportMap(int spawnX, int spawnY)
@@ -1,7 +1,18 @@
 #ifndef GAME_SERVER_ENTITIES_MARIO_H
 #define GAME_SERVER_ENTITIES_MARIO_H
 
-#define MAX_SURFACES 128
+// surfaces around Mario are loaded in a window of tile columns
+#define SURFACE_WINDOW_RADIUS 7
+#define SURFACE_WINDOW_COLUMNS (SURFACE_WINDOW_RADIUS*2+1)
+#define SURFACE_WINDOW_ABOVE 6
+// the rows above Mario plus his own row and the floor below him
+#define SURFACE_COLUMN_MAX_TILES (SURFACE_WINDOW_ABOVE+2)
+
+// lasers used to draw one Mario
+#define MARIO_MAX_OUTLINE_POINTS 64
+
+// libsm64 physics steps per second, CGameWorld::TickMarios schedules them
+#define MARIO_TICK_SPEED 30
 
 #include <inttypes.h>
 
@@ -14,12 +25,37 @@ extern "C" {
 
 class CMario : public CEntity
 {
+	struct SSurfaceTile
+	{
+		int m_Y;
+		uint32_t m_ObjectID; // (uint32_t)-1 if the tile has no exposed faces
+	};
+
+	// one column of the surface window, columns are stored in a ring indexed by their x position
+	struct SSurfaceColumn
+	{
+		int m_X;
+		int m_NumTiles;
+		SSurfaceTile m_aTiles[SURFACE_COLUMN_MAX_TILES];
+
+		// first solid tile at or below m_FloorScanY, stays valid for any y in [m_FloorScanY, m_FloorY]
+		int m_FloorScanY;
+		int m_FloorY;
+	};
+
 	int marioId;
-	float m_Tick;
 	float m_Scale;
-	std::vector<int> vertexIDs;
+	int m_aSnapIDs[MARIO_MAX_OUTLINE_POINTS];
+	// outline relative to m_PhysPos, rebuilt after every physics step
+	std::vector<ivec2> m_vOutline;
+	// positions after the last two physics steps, m_Pos is interpolated between them
+	vec2 m_PrevPhysPos;
+	vec2 m_PhysPos;
 	int m_Owner;
-	uint32_t m_currSurfaces[MAX_SURFACES];
+	SSurfaceColumn m_aSurfaceColumns[SURFACE_WINDOW_COLUMNS];
+	bool m_SurfaceWindowLoaded;
+	// false if the map's static mesh was built for this Mario's scale
+	bool m_StreamSurfaces;
 
 public:
 	SM64MarioState state;
@@ -34,10 +70,24 @@ public:
 	void Destroy() override;
 	void Reset() override;
 	void Tick() override;
-	void Snap(int SnappingClient) override;
+	void SnapShared() override;
+
+	// CGameWorld::StepMarios steps all Marios in one libsm64 batch with the input gathered in Tick.
+	// BeginStep returns false if Mario can't step, EndStep applies the new state and only the
+	// last step of a tick builds the outline.
+	bool BeginStep();
+	void EndStep(bool LastStep);
+	// places Mario and his tee Alpha of the way from the previous to the current step
+	void Interpolate(float Alpha);
+	// base64 encoded libsm64 snapshot, used by /save and the rescue tee
+	bool SaveState(char *pBuf, int BufSize);
+	bool LoadState(const char *pState);
+
+	void updateOutline();
 
 	void deleteBlocks();
-	bool addBlock(int x, int y, int *i);
+	uint32_t addBlock(int x, int y);
+	void loadColumn(SSurfaceColumn *pColumn, int x, int y);
 	void loadNewBlocks(int x, int y);
 
 	void exportMap(int spawnX, int spawnY);
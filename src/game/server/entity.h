@@ -23,6 +23,7 @@ private:
 	friend CGameWorld; // entity list handling
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
+	CSpatialHash<CEntity>::CNode m_SpatialNode;
 
 	/* Identity */
 	CGameWorld *m_pGameWorld;
@@ -125,6 +126,14 @@ public: // TODO: Maybe make protected
 	*/
 	virtual void Snap(int SnappingClient) {}
 
+	/*
+		Function: SnapShared
+			Called once per snapshot, before any Snap call. Adds the
+			items that are the same for every client to the world's
+			snap table, CGameWorld::SnapTable.
+	*/
+	virtual void SnapShared() {}
+
 	/*
 		Function: SwapClients
 			Called when two players have swapped their client ids.
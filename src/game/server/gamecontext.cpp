@@ -29,6 +29,7 @@
 #include "entities/character.h"
 #include "entities/mario.h"
 #include "gamemodes/DDRace.h"
+#include "mariomesh.h"
 #include "player.h"
 #include "score.h"
 
@@ -107,6 +108,7 @@ void CGameContext::Construct(int Resetting)
 
 	m_aDeleteTempfile[0] = 0;
 	m_TeeHistorianActive = false;
+	m_MarioMeshScale = 0;
 }
 
 void CGameContext::Destruct(int Resetting)
@@ -162,6 +164,7 @@ void CGameContext::TeeHistorianWrite(const void *pData, int DataSize, void *pUse
 {
 	CGameContext *pSelf = (CGameContext *)pUser;
 	aio_write(pSelf->m_pTeeHistorianFile, pData, DataSize);
+	pSelf->m_TeeHistorianWritten += DataSize;
 }
 
 void CGameContext::CommandCallback(int ClientID, int FlagMask, const char *pCmd, IConsole::IResult *pResult, void *pUser)
@@ -186,6 +189,17 @@ class CCharacter *CGameContext::GetPlayerChar(int ClientID)
 	return m_apPlayers[ClientID]->GetCharacter();
 }
 
+class CMario *CGameContext::GetPlayerMario(int ClientID)
+{
+	for(CEntity *pEnt = m_World.FindFirst(CGameWorld::ENTTYPE_MARIO); pEnt; pEnt = pEnt->TypeNext())
+	{
+		CMario *pMario = (CMario *)pEnt;
+		if(pMario->Owner() == ClientID && pMario->ID() != -1)
+			return pMario;
+	}
+	return 0;
+}
+
 bool CGameContext::EmulateBug(int Bug)
 {
 	return m_MapBugs.Contains(Bug);
@@ -849,6 +863,15 @@ void CGameContext::OnTick()
 			m_TeeHistorian.EndInputs();
 			m_TeeHistorian.EndTick();
 		}
+		if(m_pTeeHistorianCompressor && Server()->Tick() - m_TeeHistorianBlockTick >= CTeeHistorianCompressor::BLOCK_TICKS)
+		{
+			// the compression runs on the file's thread, only pass the
+			// state the new block starts with
+			std::vector<unsigned char> vState;
+			m_TeeHistorian.PackState(vState);
+			m_pTeeHistorianCompressor->BeginBlock(m_TeeHistorianWritten, Server()->Tick() - 1, std::move(vState));
+			m_TeeHistorianBlockTick = Server()->Tick();
+		}
 		m_TeeHistorian.BeginTick(Server()->Tick());
 		m_TeeHistorian.BeginPlayers();
 	}
@@ -3365,7 +3388,7 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 		FormatUuid(m_GameUuid, aGameUuid, sizeof(aGameUuid));
 
 		char aFilename[IO_MAX_PATH_LENGTH];
-		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian", aGameUuid);
+		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.%s", aGameUuid, g_Config.m_SvTeeHistorianCompress ? "teehistorianz" : "teehistorian");
 
 		IOHANDLE THFile = Storage()->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 		if(!THFile)
@@ -3378,7 +3401,17 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 		{
 			dbg_msg("teehistorian", "recording to '%s'", aFilename);
 		}
-		m_pTeeHistorianFile = aio_new(THFile);
+		m_TeeHistorianWritten = 0;
+		m_TeeHistorianBlockTick = Server()->Tick();
+		if(g_Config.m_SvTeeHistorianCompress)
+		{
+			m_pTeeHistorianCompressor = std::make_unique<CTeeHistorianCompressor>();
+			m_pTeeHistorianFile = aio_new_ex(THFile, CTeeHistorianCompressor::Write, m_pTeeHistorianCompressor.get());
+		}
+		else
+		{
+			m_pTeeHistorianFile = aio_new(THFile);
+		}
 
 		char aVersion[128];
 		if(GIT_SHORTREV_HASH)
@@ -3532,10 +3565,19 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "git-revision", GIT_SHORTREV_HASH);
 
 	// SM64
-	uint32_t surfaceCount = 2;
-	SM64Surface surfaces[surfaceCount];
+	std::vector<SM64Surface> surfaces;
+	m_MarioMeshScale = 0;
+	if (g_Config.m_MarioStaticMesh)
+	{
+		BuildMarioCollisionMesh(Collision(), g_Config.m_MarioScale/100.f, surfaces);
+		m_MarioMeshScale = g_Config.m_MarioScale;
+	}
+
+	// two giant floor triangles below the map
+	uint32_t surfaceCount = surfaces.size() + 2;
+	surfaces.resize(surfaceCount);
 
-	for (uint32_t i=0; i<surfaceCount; i++)
+	for (uint32_t i=surfaceCount-2; i<surfaceCount; i++)
 	{
 		surfaces[i].type = SURFACE_DEFAULT;
 		surfaces[i].force = 0;
@@ -3554,7 +3596,7 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 	surfaces[surfaceCount-1].vertices[1][0] = spawnX + width + (400*32);	surfaces[surfaceCount-1].vertices[1][1] = spawnY;	surfaces[surfaceCount-1].vertices[1][2] = +128;
 	surfaces[surfaceCount-1].vertices[2][0] = spawnX + width + (400*32);	surfaces[surfaceCount-1].vertices[2][1] = spawnY;	surfaces[surfaceCount-1].vertices[2][2] = -128;
 
-	sm64_static_surfaces_load(surfaces, surfaceCount);
+	sm64_static_surfaces_load(surfaces.data(), surfaceCount);
 
 #ifdef CONF_DEBUG
 	if(g_Config.m_DbgDummies)
@@ -3718,6 +3760,7 @@ void CGameContext::OnShutdown()
 			Server()->SetErrorShutdown("teehistorian close error");
 		}
 		aio_free(m_pTeeHistorianFile);
+		m_pTeeHistorianCompressor = nullptr;
 	}
 
 	DeleteTempfile();
@@ -3791,7 +3834,10 @@ void CGameContext::OnSnap(int ClientID)
 	m_World.Snap(ClientID);
 	m_Events.Snap(ClientID);
 }
-void CGameContext::OnPreSnap() {}
+void CGameContext::OnPreSnap()
+{
+	m_World.PreSnap();
+}
 void CGameContext::OnPostSnap()
 {
 	m_Events.Clear();
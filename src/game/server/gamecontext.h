@@ -78,6 +78,9 @@ class CGameContext : public IGameServer
 	bool m_TeeHistorianActive;
 	CTeeHistorian m_TeeHistorian;
 	ASYNCIO *m_pTeeHistorianFile;
+	std::unique_ptr<CTeeHistorianCompressor> m_pTeeHistorianCompressor;
+	int64_t m_TeeHistorianWritten;
+	int m_TeeHistorianBlockTick;
 	CUuid m_GameUuid;
 	CMapBugs m_MapBugs;
 	CPrng m_Prng;
@@ -155,6 +158,9 @@ public:
 	CNetObj_PlayerInput m_aLastPlayerInput[MAX_CLIENTS];
 	bool m_aPlayerHasInput[MAX_CLIENTS];
 
+	// mario_scale the static SM64 map mesh was built with, 0 if Marios stream the tiles around them
+	int m_MarioMeshScale;
+
 	// returns last input if available otherwise nulled PlayerInput object
 	// ClientID has to be valid
 	CNetObj_PlayerInput GetLastPlayerInput(int ClientID) const;
@@ -164,6 +170,7 @@ public:
 
 	// helper functions
 	class CCharacter *GetPlayerChar(int ClientID);
+	class CMario *GetPlayerMario(int ClientID);
 	bool EmulateBug(int Bug);
 	std::vector<SSwitchers> &Switchers() { return m_World.m_Core.m_vSwitchers; }
 
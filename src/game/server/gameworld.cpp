@@ -3,6 +3,7 @@
 
 #include "gameworld.h"
 #include "entities/character.h"
+#include "entities/mario.h"
 #include "entity.h"
 #include "gamecontext.h"
 #include "gamecontroller.h"
@@ -24,6 +25,8 @@ CGameWorld::CGameWorld()
 
 	m_Paused = false;
 	m_ResetRequested = false;
+	m_MarioStepTime = 0;
+	m_MarioWorkers = 0;
 	for(auto &pFirstEntityType : m_apFirstEntityTypes)
 		pFirstEntityType = 0;
 }
@@ -48,23 +51,42 @@ CEntity *CGameWorld::FindFirst(int Type)
 	return Type < 0 || Type >= NUM_ENTTYPES ? 0 : m_apFirstEntityTypes[Type];
 }
 
+template<typename TFunc>
+void CGameWorld::QueryEntities(int Type, vec2 Min, vec2 Max, TFunc &&Func)
+{
+	CSmallVector<CEntity *, 32> vpFound;
+	if(m_SpatialHashActive && m_aSpatialHashes[Type].Query(Min, Max, vpFound))
+	{
+		for(CEntity *pEnt : vpFound)
+			if(!Func(pEnt))
+				return;
+	}
+	else
+	{
+		// entities can be moved by anything outside of the tick, walk them all
+		for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			if(!Func(pEnt))
+				return;
+	}
+}
+
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
 {
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
-	{
+	QueryEntities(Type, Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), [&](CEntity *pEnt) {
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
 			if(ppEnts)
 				ppEnts[Num] = pEnt;
 			Num++;
 			if(Num == Max)
-				break;
+				return false;
 		}
-	}
+		return true;
+	});
 
 	return Num;
 }
@@ -82,10 +104,16 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = 0x0;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+
+	m_aSpatialHashes[pEnt->m_ObjType].Insert(&pEnt->m_SpatialNode, pEnt, pEnt->m_Pos, pEnt->m_ProximityRadius);
 }
 
 void CGameWorld::RemoveEntity(CEntity *pEnt)
 {
+	// it might not live to be updated after its tick
+	if(m_pTraverseEntity == pEnt)
+		m_pTraverseEntity = nullptr;
+
 	// not in the list
 	if(!pEnt->m_pNextTypeEntity && !pEnt->m_pPrevTypeEntity && m_apFirstEntityTypes[pEnt->m_ObjType] != pEnt)
 		return;
@@ -104,11 +132,53 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 
 	pEnt->m_pNextTypeEntity = 0;
 	pEnt->m_pPrevTypeEntity = 0;
+
+	m_aSpatialHashes[pEnt->m_ObjType].Remove(&pEnt->m_SpatialNode);
+}
+
+void CGameWorld::UpdateSpatialHash()
+{
+	for(auto *pEnt : m_apFirstEntityTypes)
+		for(; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			UpdateSpatialHash(pEnt);
+}
+
+void CGameWorld::UpdateSpatialHash(CEntity *pEnt)
+{
+	m_aSpatialHashes[pEnt->m_ObjType].Move(&pEnt->m_SpatialNode, pEnt->m_Pos);
 }
 
 //
+void CGameWorld::PreSnap()
+{
+	m_SnapTable.Clear();
+	for(auto *pEnt : m_apFirstEntityTypes)
+		for(; pEnt;)
+		{
+			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			pEnt->SnapShared();
+			pEnt = m_pNextTraverseEntity;
+		}
+}
+
 void CGameWorld::Snap(int SnappingClient)
 {
+	CSnapTable::SView View = {vec2(0, 0), vec2(0, 0), true};
+	if(SnappingClient != SERVER_DEMO_CLIENT)
+	{
+		CPlayer *pPlayer = GameServer()->m_apPlayers[SnappingClient];
+		View.m_ViewPos = pPlayer->m_ViewPos;
+		View.m_ShowDistance = pPlayer->m_ShowDistance;
+		View.m_ShowAll = pPlayer->m_ShowAll;
+	}
+	m_SnapTable.Snap(
+		SnappingClient, View, [this](int Type, int ID, int Size) {
+			return Server()->SnapNewItem(Type, ID, Size);
+		},
+		[this](const void *pItems, int Size, const int *pOffsets, int NumItems) {
+			return Server()->SnapNewItems(pItems, Size, pOffsets, NumItems);
+		});
+
 	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt;)
 	{
 		m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
@@ -267,6 +337,10 @@ void CGameWorld::Tick()
 	{
 		if(GameServer()->m_pController->IsForceBalanced())
 			GameServer()->SendChat(-1, CGameContext::CHAT_ALL, "Teams have been balanced");
+
+		m_SpatialHashActive = g_Config.m_SvSpatialHash;
+		UpdateSpatialHash();
+
 		// update all objects
 		if(g_Config.m_SvNoWeakHookAndBounce)
 		{
@@ -274,7 +348,10 @@ void CGameWorld::Tick()
 				for(; pEnt;)
 				{
 					m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+					m_pTraverseEntity = pEnt;
 					pEnt->PreTick();
+					if(m_pTraverseEntity)
+						UpdateSpatialHash(m_pTraverseEntity);
 					pEnt = m_pNextTraverseEntity;
 				}
 		}
@@ -283,17 +360,30 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pTraverseEntity = pEnt;
 				pEnt->Tick();
+				if(m_pTraverseEntity)
+					UpdateSpatialHash(m_pTraverseEntity);
 				pEnt = m_pNextTraverseEntity;
 			}
 
+		TickMarios();
+		// marios move their characters
+		UpdateSpatialHash();
+
 		for(auto *pEnt : m_apFirstEntityTypes)
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pTraverseEntity = pEnt;
 				pEnt->TickDeferred();
+				if(m_pTraverseEntity)
+					UpdateSpatialHash(m_pTraverseEntity);
 				pEnt = m_pNextTraverseEntity;
 			}
+
+		m_pTraverseEntity = nullptr;
+		m_SpatialHashActive = false;
 	}
 	else
 	{
@@ -320,6 +410,63 @@ void CGameWorld::Tick()
 	}
 }
 
+void CGameWorld::TickMarios()
+{
+	// libsm64 runs at a fixed rate that doesn't divide the server's. All Marios step on the same
+	// ticks, and in between they are interpolated so snapshots move evenly at any tick speed.
+	m_MarioStepTime += MARIO_TICK_SPEED;
+	int Steps = m_MarioStepTime / Server()->TickSpeed();
+	m_MarioStepTime %= Server()->TickSpeed();
+	float Alpha = m_MarioStepTime / (float)Server()->TickSpeed();
+
+	// the pool is shared by all worlds, it's only rebuilt when the setting changes
+	if(m_MarioWorkers != g_Config.m_MarioWorkers)
+	{
+		m_MarioWorkers = g_Config.m_MarioWorkers;
+		sm64_set_worker_count(m_MarioWorkers);
+	}
+
+	for(int i = 0; i < Steps; i++)
+		StepMarios(i == Steps - 1);
+
+	for(CMario *pMario = (CMario *)FindFirst(ENTTYPE_MARIO); pMario; pMario = (CMario *)pMario->TypeNext())
+		pMario->Interpolate(Alpha);
+}
+
+void CGameWorld::StepMarios(bool LastStep)
+{
+	m_vpMarioBatch.clear();
+	m_vMarioBatchIDs.clear();
+	m_vMarioBatchInputs.clear();
+	m_vMarioBatchGeometry.clear();
+	for(CMario *pMario = (CMario *)FindFirst(ENTTYPE_MARIO); pMario; pMario = (CMario *)pMario->TypeNext())
+	{
+		if(!pMario->BeginStep())
+			continue;
+		m_vpMarioBatch.push_back(pMario);
+		m_vMarioBatchIDs.push_back(pMario->ID());
+		m_vMarioBatchInputs.push_back(pMario->input);
+		m_vMarioBatchGeometry.push_back(pMario->geometry);
+	}
+	if(m_vpMarioBatch.empty())
+		return;
+
+	// only the geometry of the last step gets drawn, and the hitbox mode needs none at all
+	const bool NeedGeometry = LastStep && g_Config.m_MarioDrawMode != 3;
+	m_vMarioBatchStates.resize(m_vpMarioBatch.size());
+	sm64_mario_tick_many(m_vpMarioBatch.size(), m_vMarioBatchIDs.data(), m_vMarioBatchInputs.data(), m_vMarioBatchStates.data(), NeedGeometry ? m_vMarioBatchGeometry.data() : nullptr);
+
+	// surfaces are only streamed in after the whole batch, the workers read them while stepping
+	for(size_t i = 0; i < m_vpMarioBatch.size(); i++)
+	{
+		CMario *pMario = m_vpMarioBatch[i];
+		pMario->state = m_vMarioBatchStates[i];
+		if(NeedGeometry)
+			pMario->geometry.numTrianglesUsed = m_vMarioBatchGeometry[i].numTrianglesUsed;
+		pMario->EndStep(LastStep);
+	}
+}
+
 void CGameWorld::SwapClients(int Client1, int Client2)
 {
 	// update all objects
@@ -340,17 +487,18 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
-	{
+	const vec2 Min = vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius);
+	const vec2 Max = vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius);
+	QueryEntities(ENTTYPE_CHARACTER, Min, Max, [&](CEntity *pEnt) {
+		CCharacter *p = (CCharacter *)pEnt;
 		if(p == pNotThis)
-			continue;
+			return true;
 
 		if(pThisOnly && p != pThisOnly)
-			continue;
+			return true;
 
 		if(CollideWith != -1 && !p->CanCollide(CollideWith))
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, p->m_Pos, IntersectPos))
@@ -367,7 +515,8 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 				}
 			}
 		}
-	}
+		return true;
+	});
 
 	return pClosest;
 }
@@ -378,11 +527,10 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, CEntity *pNotTh
 	float ClosestRange = Radius * 2;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)GameServer()->m_World.FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
-	{
+	QueryEntities(ENTTYPE_CHARACTER, Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), [&](CEntity *pEnt) {
+		CCharacter *p = (CCharacter *)pEnt;
 		if(p == pNotThis)
-			continue;
+			return true;
 
 		float Len = distance(Pos, p->m_Pos);
 		if(Len < p->m_ProximityRadius + Radius)
@@ -393,20 +541,22 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, CEntity *pNotTh
 				pClosest = p;
 			}
 		}
-	}
+		return true;
+	});
 
 	return pClosest;
 }
 
-std::list<class CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, class CEntity *pNotThis)
+CSmallVector<CCharacter *, 8> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, class CEntity *pNotThis)
 {
-	std::list<CCharacter *> listOfChars;
+	CSmallVector<CCharacter *, 8> vpChars;
 
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
-	{
+	const vec2 Min = vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius);
+	const vec2 Max = vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius);
+	QueryEntities(ENTTYPE_CHARACTER, Min, Max, [&](CEntity *pEnt) {
+		CCharacter *pChr = (CCharacter *)pEnt;
 		if(pChr == pNotThis)
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, pChr->m_Pos, IntersectPos))
@@ -415,11 +565,12 @@ std::list<class CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2
 			if(Len < pChr->m_ProximityRadius + Radius)
 			{
 				pChr->m_Intersection = IntersectPos;
-				listOfChars.push_back(pChr);
+				vpChars.push_back(pChr);
 			}
 		}
-	}
-	return listOfChars;
+		return true;
+	});
+	return vpChars;
 }
 
 void CGameWorld::ReleaseHooked(int ClientID)
@@ -3,12 +3,21 @@
 #ifndef GAME_SERVER_GAMEWORLD_H
 #define GAME_SERVER_GAMEWORLD_H
 
+#include <base/tl/small_vector.h>
 #include <game/gamecore.h>
+#include <game/spatial_hash.h>
 
-#include <list>
+#include "snaptable.h"
+
+#include <vector>
+
+extern "C" {
+	#include <libsm64.h>
+}
 
 class CEntity;
 class CCharacter;
+class CMario;
 
 /*
 	Class: Game World
@@ -36,16 +45,47 @@ private:
 	CEntity *m_pNextTraverseEntity = nullptr;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// Queries only use the spatial hash while the world ticks. It's
+	// updated for all entities between the tick phases and for each
+	// entity after its own PreTick, Tick and TickDeferred.
+	CSpatialHash<CEntity> m_aSpatialHashes[NUM_ENTTYPES];
+	bool m_SpatialHashActive = false;
+	CEntity *m_pTraverseEntity = nullptr;
+
+	void UpdateSpatialHash();
+	void UpdateSpatialHash(CEntity *pEnt);
+	// calls Func with the entities of the type that might be in the box, in
+	// list order, until it returns false. Without an answer from the grid,
+	// the entity list is walked directly
+	template<typename TFunc>
+	void QueryEntities(int Type, vec2 Min, vec2 Max, TFunc &&Func);
+
 	class CGameContext *m_pGameServer;
 	class CConfig *m_pConfig;
 	class IServer *m_pServer;
 
 	void UpdatePlayerMaps();
 
+	CSnapTable m_SnapTable;
+
+	// MARIO_TICK_SPEED per server tick, a step is due every TickSpeed
+	int m_MarioStepTime;
+	// the libsm64 worker threads mario_workers was applied with
+	int m_MarioWorkers;
+	// one sm64_mario_tick_many batch, kept between steps to not allocate
+	std::vector<CMario *> m_vpMarioBatch;
+	std::vector<int32_t> m_vMarioBatchIDs;
+	std::vector<SM64MarioInputs> m_vMarioBatchInputs;
+	std::vector<SM64MarioState> m_vMarioBatchStates;
+	std::vector<SM64MarioGeometryBuffers> m_vMarioBatchGeometry;
+	void TickMarios();
+	void StepMarios(bool LastStep);
+
 public:
 	class CGameContext *GameServer() { return m_pGameServer; }
 	class CConfig *Config() { return m_pConfig; }
 	class IServer *Server() { return m_pServer; }
+	CSnapTable *SnapTable() { return &m_SnapTable; }
 
 	bool m_ResetRequested;
 	bool m_Paused;
@@ -123,10 +163,17 @@ public:
 	*/
 	void RemoveEntity(CEntity *pEntity);
 
+	/*
+		Function: PreSnap
+			Calls SnapShared on all the entities in the world to
+			build the snap table for the coming snapshots.
+	*/
+	void PreSnap();
+
 	/*
 		Function: Snap
-			Calls Snap on all the entities in the world to create
-			the snapshot.
+			Copies the visible part of the snap table and calls Snap
+			on all the entities in the world to create the snapshot.
 
 		Arguments:
 			SnappingClient - ID of the client which snapshot
@@ -164,7 +211,7 @@ public:
 		Returns:
 			Returns list with all Characters on line.
 	*/
-	std::list<CCharacter *> IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, class CEntity *pNotThis = 0);
+	CSmallVector<CCharacter *, 8> IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, class CEntity *pNotThis = 0);
 };
 
 #endif
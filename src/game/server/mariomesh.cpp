@@ -0,0 +1,152 @@
+#include "mariomesh.h"
+
+extern "C" {
+	#include <decomp/include/surface_terrains.h>
+}
+
+#include <base/math.h>
+
+#include <game/collision.h>
+
+// Longer runs are split, so the triangles stay small enough for libsm64's spatial partition
+static const int MAX_RUN_TILES = 64;
+
+namespace {
+
+class CMeshBuilder
+{
+	const CCollision *m_pCollision;
+	float m_Scale;
+	int m_Width;
+	int m_Height;
+	std::vector<bool> m_vSolid;
+	std::vector<SM64Surface> &m_vSurfaces;
+
+	// out of range tiles repeat the border, like CCollision::CheckPoint does
+	bool Solid(int x, int y) const
+	{
+		x = clamp(x, 0, m_Width - 1);
+		y = clamp(y, 0, m_Height - 1);
+		return m_vSolid[y * m_Width + x];
+	}
+
+	int32_t ToSm64(float Value) const { return Value / m_Scale; }
+
+	// tile x spans [x*32, x*32+32], tile y spans [-y*32-16, -y*32+16] in SM64 space before scaling
+	int32_t Left(int x) const { return ToSm64(x * 32); }
+	int32_t Right(int x) const { return ToSm64(x * 32 + 32); }
+	int32_t Top(int y) const { return ToSm64(-y * 32 + 16); }
+	int32_t Bottom(int y) const { return ToSm64(-y * 32 - 16); }
+
+	void AddTriangle(int32_t x0, int32_t y0, int32_t z0, int32_t x1, int32_t y1, int32_t z1, int32_t x2, int32_t y2, int32_t z2)
+	{
+		SM64Surface Surface;
+		Surface.type = SURFACE_DEFAULT;
+		Surface.force = 0;
+		Surface.terrain = TERRAIN_STONE;
+		Surface.vertices[0][0] = x0; Surface.vertices[0][1] = y0; Surface.vertices[0][2] = z0;
+		Surface.vertices[1][0] = x1; Surface.vertices[1][1] = y1; Surface.vertices[1][2] = z1;
+		Surface.vertices[2][0] = x2; Surface.vertices[2][1] = y2; Surface.vertices[2][2] = z2;
+		m_vSurfaces.push_back(Surface);
+	}
+
+	// same windings as the faces in CMario::addBlock
+	void AddFloor(int32_t x0, int32_t x1, int32_t y, int32_t z)
+	{
+		AddTriangle(x1, y, z, x0, y, -z, x0, y, z);
+		AddTriangle(x0, y, -z, x1, y, z, x1, y, -z);
+	}
+
+	void AddCeiling(int32_t x0, int32_t x1, int32_t y, int32_t z)
+	{
+		AddTriangle(x0, y, z, x0, y, -z, x1, y, z);
+		AddTriangle(x1, y, -z, x1, y, z, x0, y, -z);
+	}
+
+	void AddLeftWall(int32_t x, int32_t y0, int32_t y1, int32_t z)
+	{
+		AddTriangle(x, y0, -z, x, y1, z, x, y1, -z);
+		AddTriangle(x, y1, z, x, y0, -z, x, y0, z);
+	}
+
+	void AddRightWall(int32_t x, int32_t y0, int32_t y1, int32_t z)
+	{
+		AddTriangle(x, y0, z, x, y1, -z, x, y1, z);
+		AddTriangle(x, y1, -z, x, y0, z, x, y0, -z);
+	}
+
+public:
+	CMeshBuilder(const CCollision *pCollision, float Scale, std::vector<SM64Surface> &vSurfaces) :
+		m_pCollision(pCollision), m_Scale(Scale), m_vSurfaces(vSurfaces)
+	{
+		m_Width = m_pCollision->GetWidth();
+		m_Height = m_pCollision->GetHeight();
+		m_vSolid.resize(m_Width * m_Height);
+		for(int y = 0; y < m_Height; y++)
+			for(int x = 0; x < m_Width; x++)
+				m_vSolid[y * m_Width + x] = m_pCollision->CheckPoint(x * 32, y * 32);
+	}
+
+	void Build()
+	{
+		const int32_t Depth = ToSm64(64);
+
+		// floors and ceilings, merged along each row
+		for(int y = 0; y < m_Height; y++)
+		{
+			for(int Dir = -1; Dir <= 1; Dir += 2)
+			{
+				for(int x = 0; x < m_Width;)
+				{
+					if(!Solid(x, y) || Solid(x, y + Dir))
+					{
+						x++;
+						continue;
+					}
+
+					int Start = x;
+					while(x < m_Width && x - Start < MAX_RUN_TILES && Solid(x, y) && !Solid(x, y + Dir))
+						x++;
+
+					if(Dir < 0)
+						AddFloor(Left(Start), Right(x - 1), Top(y), Depth);
+					else
+						AddCeiling(Left(Start), Right(x - 1), Bottom(y), Depth);
+				}
+			}
+		}
+
+		// walls, merged along each column
+		for(int x = 0; x < m_Width; x++)
+		{
+			for(int Dir = -1; Dir <= 1; Dir += 2)
+			{
+				for(int y = 0; y < m_Height;)
+				{
+					if(!Solid(x, y) || Solid(x + Dir, y))
+					{
+						y++;
+						continue;
+					}
+
+					int Start = y;
+					while(y < m_Height && y - Start < MAX_RUN_TILES && Solid(x, y) && !Solid(x + Dir, y))
+						y++;
+
+					if(Dir < 0)
+						AddLeftWall(Left(x), Bottom(y - 1), Top(Start), Depth);
+					else
+						AddRightWall(Right(x), Bottom(y - 1), Top(Start), Depth);
+				}
+			}
+		}
+	}
+};
+
+} // namespace
+
+void BuildMarioCollisionMesh(const CCollision *pCollision, float Scale, std::vector<SM64Surface> &vSurfaces)
+{
+	CMeshBuilder Builder(pCollision, Scale, vSurfaces);
+	Builder.Build();
+}
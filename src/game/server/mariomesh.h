@@ -0,0 +1,18 @@
+#ifndef GAME_SERVER_MARIOMESH_H
+#define GAME_SERVER_MARIOMESH_H
+
+#include <vector>
+
+extern "C" {
+	#include <libsm64.h>
+}
+
+class CCollision;
+
+// Converts the solid tiles of the game layer into SM64 collision surfaces.
+// Exposed tile faces are merged into runs along the tile grid, so a flat floor
+// made of many tiles ends up as a single quad instead of one per tile.
+// The geometry matches what CMario::addBlock streams for single tiles.
+void BuildMarioCollisionMesh(const CCollision *pCollision, float Scale, std::vector<SM64Surface> &vSurfaces);
+
+#endif // GAME_SERVER_MARIOMESH_H
@@ -0,0 +1,329 @@
+#include "rankcache.h"
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/server/databases/connection.h>
+
+#include <algorithm>
+
+// the time as the database stores it
+static float StoredTime(float Time)
+{
+	char aBuf[32];
+	str_format(aBuf, sizeof(aBuf), "%.2f", Time);
+	return str_tofloat(aBuf);
+}
+
+static float PercentRank(int Rank, int NumRanks)
+{
+	return NumRanks > 1 ? (Rank - 1) / (double)(NumRanks - 1) : 0.0f;
+}
+
+void CRankCache::CRanking::Add(const std::string &Name, float Time)
+{
+	auto It = m_BestTimes.find(Name);
+	if(It != m_BestTimes.end())
+	{
+		if(It->second <= Time)
+			return;
+		m_vSorted.erase(std::lower_bound(m_vSorted.begin(), m_vSorted.end(), std::make_pair(It->second, Name)));
+		It->second = Time;
+	}
+	else
+	{
+		m_BestTimes.emplace(Name, Time);
+	}
+	auto Entry = std::make_pair(Time, Name);
+	m_vSorted.insert(std::lower_bound(m_vSorted.begin(), m_vSorted.end(), Entry), Entry);
+}
+
+void CRankCache::CRanking::Set(const std::string &Name, float Time)
+{
+	auto Result = m_BestTimes.emplace(Name, Time);
+	if(!Result.second)
+		Result.first->second = minimum(Result.first->second, Time);
+}
+
+void CRankCache::CRanking::Sort()
+{
+	m_vSorted.clear();
+	m_vSorted.reserve(m_BestTimes.size());
+	for(const auto &BestTime : m_BestTimes)
+		m_vSorted.emplace_back(BestTime.second, BestTime.first);
+	std::sort(m_vSorted.begin(), m_vSorted.end());
+}
+
+int CRankCache::CRanking::RankOf(float Time) const
+{
+	// players with the same time share their rank
+	auto It = std::lower_bound(m_vSorted.begin(), m_vSorted.end(), Time, [](const std::pair<float, std::string> &Entry, float Value) { return Entry.first < Value; });
+	return It - m_vSorted.begin() + 1;
+}
+
+bool CRankCache::CRanking::Rank(const char *pName, int *pRank, float *pTime, float *pPercentRank) const
+{
+	auto It = m_BestTimes.find(pName);
+	if(It == m_BestTimes.end())
+		return false;
+	*pRank = RankOf(It->second);
+	*pTime = It->second;
+	*pPercentRank = PercentRank(*pRank, m_vSorted.size());
+	return true;
+}
+
+int CRankCache::CRanking::Top(int Offset, CRank *pRanks, int Num) const
+{
+	const int Size = m_vSorted.size();
+	int Count = 0;
+	for(int i = maximum(absolute(Offset) - 1, 0); i < Size && Count < Num; i++, Count++)
+	{
+		const auto &Entry = m_vSorted[Offset >= 0 ? i : Size - 1 - i];
+		pRanks[Count].m_Rank = RankOf(Entry.first);
+		pRanks[Count].m_Time = Entry.first;
+		str_copy(pRanks[Count].m_aName, Entry.second.c_str(), sizeof(pRanks[Count].m_aName));
+	}
+	return Count;
+}
+
+void CRankCache::CTeamRanking::Add(const CTeam &Team)
+{
+	auto It = std::find_if(m_vTeams.begin(), m_vTeams.end(), [&](const CTeam &Other) { return Other.m_ID == Team.m_ID; });
+	if(It != m_vTeams.end())
+	{
+		if(It->m_Time <= Team.m_Time)
+			return;
+		m_vTeams.erase(It);
+	}
+	m_vTeams.insert(std::upper_bound(m_vTeams.begin(), m_vTeams.end(), Team, [](const CTeam &a, const CTeam &b) { return a.m_Time < b.m_Time; }), Team);
+}
+
+void CRankCache::CTeamRanking::Set(const CTeam &Team)
+{
+	m_vTeams.push_back(Team);
+}
+
+void CRankCache::CTeamRanking::Sort()
+{
+	std::stable_sort(m_vTeams.begin(), m_vTeams.end(), [](const CTeam &a, const CTeam &b) { return a.m_Time < b.m_Time; });
+}
+
+int CRankCache::CTeamRanking::RankOf(float Time) const
+{
+	auto It = std::lower_bound(m_vTeams.begin(), m_vTeams.end(), Time, [](const CTeam &Team, float Value) { return Team.m_Time < Value; });
+	return It - m_vTeams.begin() + 1;
+}
+
+bool CRankCache::CTeamRanking::Rank(const char *pName, CTeamRank *pRank, float *pPercentRank) const
+{
+	// the best team of the player comes first
+	for(const CTeam &Team : m_vTeams)
+	{
+		if(std::find(Team.m_vNames.begin(), Team.m_vNames.end(), pName) == Team.m_vNames.end())
+			continue;
+		pRank->m_Rank = RankOf(Team.m_Time);
+		pRank->m_Time = Team.m_Time;
+		pRank->m_vNames = Team.m_vNames;
+		*pPercentRank = PercentRank(pRank->m_Rank, m_vTeams.size());
+		return true;
+	}
+	return false;
+}
+
+int CRankCache::CTeamRanking::Top(int Offset, CTeamRank *pRanks, int Num) const
+{
+	const int Size = m_vTeams.size();
+	int Count = 0;
+	for(int i = maximum(absolute(Offset) - 1, 0); i < Size && Count < Num; i++, Count++)
+	{
+		const CTeam &Team = m_vTeams[Offset >= 0 ? i : Size - 1 - i];
+		pRanks[Count].m_Rank = RankOf(Team.m_Time);
+		pRanks[Count].m_Time = Team.m_Time;
+		pRanks[Count].m_vNames = Team.m_vNames;
+	}
+	return Count;
+}
+
+CRankCache::CRankCache(const char *pMap, const char *pRegion)
+{
+	str_copy(m_aMap, pMap, sizeof(m_aMap));
+	str_copy(m_aRegion, pRegion, sizeof(m_aRegion));
+}
+
+bool CRankCache::Update(IDbConnection *pSqlServer, const char *pMap, const char *pRegion, int MaxAge)
+{
+	if(MaxAge <= 0 || str_comp(pMap, m_aMap) != 0 || str_comp(pRegion, m_aRegion) != 0)
+		return false;
+	const int64_t MaxAgeTicks = (int64_t)MaxAge * time_freq();
+	{
+		std::lock_guard<std::mutex> Lock(m_Lock);
+		if(m_Loaded && time_get() - m_LoadTime < MaxAgeTicks)
+			return true;
+	}
+
+	std::lock_guard<std::mutex> LoadLock(m_LoadLock);
+	{
+		std::lock_guard<std::mutex> Lock(m_Lock);
+		// another worker might have loaded them in the meantime
+		if(m_Loaded && time_get() - m_LoadTime < MaxAgeTicks)
+			return true;
+		m_Loading = true;
+	}
+
+	const int64_t LoadTime = time_get();
+	CRanking Global;
+	CRanking Regional;
+	CTeamRanking Teams;
+	const bool Failed = Load(pSqlServer, &Global, &Regional, &Teams);
+
+	std::lock_guard<std::mutex> Lock(m_Lock);
+	m_Loading = false;
+	if(!Failed)
+	{
+		// adding a score twice doesn't change the ranks
+		for(const CPendingScore &Score : m_vPendingScores)
+			Apply(Score, &Global, &Regional);
+		for(const CTeam &Team : m_vPendingTeams)
+			Teams.Add(Team);
+		m_Global = std::move(Global);
+		m_Regional = std::move(Regional);
+		m_Teams = std::move(Teams);
+		m_Loaded = true;
+		m_LoadTime = LoadTime;
+	}
+	m_vPendingScores.clear();
+	m_vPendingTeams.clear();
+	return !Failed;
+}
+
+bool CRankCache::Load(IDbConnection *pSqlServer, CRanking *pGlobal, CRanking *pRegional, CTeamRanking *pTeams)
+{
+	char aError[256] = "";
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT Name, Server, MIN(Time) "
+		"FROM %s_race "
+		"WHERE Map = ? "
+		"GROUP BY Name, Server",
+		pSqlServer->GetPrefix());
+	if(pSqlServer->PrepareStatement(aBuf, aError, sizeof(aError)))
+	{
+		dbg_msg("sql", "failed to load ranks: %s", aError);
+		return true;
+	}
+	pSqlServer->BindString(1, m_aMap);
+
+	bool End = false;
+	while(!pSqlServer->Step(&End, aError, sizeof(aError)) && !End)
+	{
+		char aName[MAX_NAME_LENGTH];
+		char aServer[8];
+		pSqlServer->GetString(1, aName, sizeof(aName));
+		pSqlServer->GetString(2, aServer, sizeof(aServer));
+		const float Time = pSqlServer->GetFloat(3);
+		pGlobal->Set(aName, Time);
+		// like `Server LIKE %Region%`
+		if(str_find_nocase(aServer, m_aRegion))
+			pRegional->Set(aName, Time);
+	}
+	if(!End)
+	{
+		dbg_msg("sql", "failed to load ranks: %s", aError);
+		return true;
+	}
+	pGlobal->Sort();
+	pRegional->Sort();
+
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT ID, Name, Time "
+		"FROM %s_teamrace "
+		"WHERE Map = ? "
+		"ORDER BY ID, Name COLLATE %s",
+		pSqlServer->GetPrefix(), pSqlServer->BinaryCollate());
+	if(pSqlServer->PrepareStatement(aBuf, aError, sizeof(aError)))
+	{
+		dbg_msg("sql", "failed to load team ranks: %s", aError);
+		return true;
+	}
+	pSqlServer->BindString(1, m_aMap);
+
+	CTeam Team;
+	End = false;
+	while(!pSqlServer->Step(&End, aError, sizeof(aError)) && !End)
+	{
+		CUuid TeamID;
+		pSqlServer->GetBlob(1, TeamID.m_aData, sizeof(TeamID.m_aData));
+		char aName[MAX_NAME_LENGTH];
+		pSqlServer->GetString(2, aName, sizeof(aName));
+		const float Time = pSqlServer->GetFloat(3);
+		if(Team.m_vNames.empty() || Team.m_ID != TeamID)
+		{
+			if(!Team.m_vNames.empty())
+				pTeams->Set(Team);
+			Team.m_ID = TeamID;
+			Team.m_Time = Time;
+			Team.m_vNames.clear();
+		}
+		Team.m_Time = minimum(Team.m_Time, Time);
+		Team.m_vNames.emplace_back(aName);
+	}
+	if(!End)
+	{
+		dbg_msg("sql", "failed to load team ranks: %s", aError);
+		return true;
+	}
+	if(!Team.m_vNames.empty())
+		pTeams->Set(Team);
+	pTeams->Sort();
+	return false;
+}
+
+void CRankCache::Apply(const CPendingScore &Score, CRanking *pGlobal, CRanking *pRegional)
+{
+	pGlobal->Add(Score.m_Name, Score.m_Time);
+	if(str_find_nocase(Score.m_Server.c_str(), m_aRegion))
+		pRegional->Add(Score.m_Name, Score.m_Time);
+}
+
+void CRankCache::AddScore(const char *pName, const char *pServer, float Time)
+{
+	CPendingScore Score{pName, pServer, StoredTime(Time)};
+	std::lock_guard<std::mutex> Lock(m_Lock);
+	if(m_Loading)
+		m_vPendingScores.push_back(Score);
+	if(m_Loaded)
+		Apply(Score, &m_Global, &m_Regional);
+}
+
+void CRankCache::AddTeamScore(const CUuid &TeamID, const std::vector<std::string> &vSortedNames, float Time)
+{
+	CTeam Team{StoredTime(Time), TeamID, vSortedNames};
+	std::lock_guard<std::mutex> Lock(m_Lock);
+	if(m_Loading)
+		m_vPendingTeams.push_back(Team);
+	if(m_Loaded)
+		m_Teams.Add(Team);
+}
+
+bool CRankCache::Rank(bool Regional, const char *pName, int *pRank, float *pTime, float *pPercentRank)
+{
+	std::lock_guard<std::mutex> Lock(m_Lock);
+	return (Regional ? m_Regional : m_Global).Rank(pName, pRank, pTime, pPercentRank);
+}
+
+int CRankCache::Top(bool Regional, int Offset, CRank *pRanks, int Num)
+{
+	std::lock_guard<std::mutex> Lock(m_Lock);
+	return (Regional ? m_Regional : m_Global).Top(Offset, pRanks, Num);
+}
+
+bool CRankCache::TeamRank(const char *pName, CTeamRank *pRank, float *pPercentRank)
+{
+	std::lock_guard<std::mutex> Lock(m_Lock);
+	return m_Teams.Rank(pName, pRank, pPercentRank);
+}
+
+int CRankCache::TeamTop(int Offset, CTeamRank *pRanks, int Num)
+{
+	std::lock_guard<std::mutex> Lock(m_Lock);
+	return m_Teams.Top(Offset, pRanks, Num);
+}
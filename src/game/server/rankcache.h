@@ -0,0 +1,139 @@
+#ifndef GAME_SERVER_RANKCACHE_H
+#define GAME_SERVER_RANKCACHE_H
+
+#include <engine/map.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/uuid_manager.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class IDbConnection;
+
+/*
+	Class: Rank Cache
+		The ranks of the current map, so rank and top requests don't have
+		to rank the whole race table for every chat command. It is loaded
+		from the database by the first request and updated by the scores
+		saved by this server. Finishes on other servers sharing the
+		database are only seen once it is reloaded, see <Update>.
+
+		Used by the database workers, so all functions are thread safe.
+*/
+class CRankCache
+{
+public:
+	struct CRank
+	{
+		int m_Rank;
+		float m_Time;
+		char m_aName[MAX_NAME_LENGTH];
+	};
+
+	struct CTeamRank
+	{
+		int m_Rank;
+		float m_Time;
+		std::vector<std::string> m_vNames;
+	};
+
+	CRankCache(const char *pMap, const char *pRegion);
+
+	/*
+		Function: Update
+			Loads the ranks if they weren't loaded in the last MaxAge
+			seconds.
+
+		Returns:
+			Whether the request for pMap from a server in pRegion can be
+			answered from the cache, false if it has to ask the database.
+	*/
+	bool Update(IDbConnection *pSqlServer, const char *pMap, const char *pRegion, int MaxAge);
+
+	void AddScore(const char *pName, const char *pServer, float Time);
+	// vSortedNames are the names of the team sorted like the database does
+	void AddTeamScore(const CUuid &TeamID, const std::vector<std::string> &vSortedNames, float Time);
+
+	// like the window functions in the database, the percent rank is
+	// (Rank - 1) / (NumRanks - 1). Returns false if the player has no rank.
+	bool Rank(bool Regional, const char *pName, int *pRank, float *pTime, float *pPercentRank);
+	// the ranks from Offset on, from the end for negative offsets
+	int Top(bool Regional, int Offset, CRank *pRanks, int Num);
+
+	bool TeamRank(const char *pName, CTeamRank *pRank, float *pPercentRank);
+	int TeamTop(int Offset, CTeamRank *pRanks, int Num);
+
+private:
+	// players sorted by their best time
+	class CRanking
+	{
+	public:
+		void Add(const std::string &Name, float Time);
+		// adds many times at once, Sort has to be called afterwards
+		void Set(const std::string &Name, float Time);
+		void Sort();
+		bool Rank(const char *pName, int *pRank, float *pTime, float *pPercentRank) const;
+		int Top(int Offset, CRank *pRanks, int Num) const;
+
+	private:
+		int RankOf(float Time) const;
+
+		std::unordered_map<std::string, float> m_BestTimes;
+		std::vector<std::pair<float, std::string>> m_vSorted;
+	};
+
+	struct CTeam
+	{
+		float m_Time;
+		CUuid m_ID;
+		std::vector<std::string> m_vNames;
+	};
+
+	// teams sorted by their time
+	class CTeamRanking
+	{
+	public:
+		void Add(const CTeam &Team);
+		void Set(const CTeam &Team);
+		void Sort();
+		bool Rank(const char *pName, CTeamRank *pRank, float *pPercentRank) const;
+		int Top(int Offset, CTeamRank *pRanks, int Num) const;
+
+	private:
+		int RankOf(float Time) const;
+
+		std::vector<CTeam> m_vTeams;
+	};
+
+	struct CPendingScore
+	{
+		std::string m_Name;
+		std::string m_Server;
+		float m_Time;
+	};
+
+	bool Load(IDbConnection *pSqlServer, CRanking *pGlobal, CRanking *pRegional, CTeamRanking *pTeams);
+	void Apply(const CPendingScore &Score, CRanking *pGlobal, CRanking *pRegional);
+
+	char m_aMap[MAX_MAP_LENGTH];
+	char m_aRegion[8];
+
+	// held while loading, so only one worker loads at a time
+	std::mutex m_LoadLock;
+
+	std::mutex m_Lock;
+	bool m_Loaded = false;
+	int64_t m_LoadTime = 0;
+	CRanking m_Global;
+	CRanking m_Regional;
+	CTeamRanking m_Teams;
+
+	// scores saved while loading, added again afterwards
+	bool m_Loading = false;
+	std::vector<CPendingScore> m_vPendingScores;
+	std::vector<CTeam> m_vPendingTeams;
+};
+
+#endif // GAME_SERVER_RANKCACHE_H
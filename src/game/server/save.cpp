@@ -3,6 +3,7 @@
 #include <cstdio>
 
 #include "entities/character.h"
+#include "entities/mario.h"
 #include "gamemodes/DDRace.h"
 #include "player.h"
 #include "teams.h"
@@ -110,6 +111,11 @@ void CSaveTee::Save(CCharacter *pChr)
 	m_ReloadTimer = pChr->m_ReloadTimer;
 
 	FormatUuid(pChr->GameServer()->GameUuid(), m_aGameUuid, sizeof(m_aGameUuid));
+
+	m_aMarioState[0] = '\0';
+	CMario *pMario = pChr->GameServer()->GetPlayerMario(m_ClientID);
+	if(pMario && !pMario->SaveState(m_aMarioState, sizeof(m_aMarioState)))
+		m_aMarioState[0] = '\0';
 }
 
 void CSaveTee::Load(CCharacter *pChr, int Team, bool IsSwap)
@@ -215,6 +221,20 @@ void CSaveTee::Load(CCharacter *pChr, int Team, bool IsSwap)
 
 	pChr->SetSolo(m_IsSolo);
 
+	// restore the Mario as it was, no respawn
+	CMario *pMario = pChr->GameServer()->GetPlayerMario(pChr->m_pPlayer->GetCID());
+	if(m_aMarioState[0])
+	{
+		if(!pMario)
+			pMario = new CMario(&pChr->GameServer()->m_World, m_Pos, pChr->m_pPlayer->GetCID());
+		if(!pMario->LoadState(m_aMarioState))
+			dbg_msg("load", "failed to restore mario state");
+	}
+	else if(pMario)
+	{
+		pMario->Destroy();
+	}
+
 	if(!IsSwap)
 	{
 		// Always create a rescue tee at the exact location we loaded from so that
@@ -271,7 +291,8 @@ char *CSaveTee::GetString(const CSaveTeam *pTeam)
 		"%d\t%d\t%d\t%d\t" // input stuff
 		"%d\t" // m_ReloadTimer
 		"%d\t" // m_TeeStarted
-		"%d", //m_LiveFreeze
+		"%d" //m_LiveFreeze
+		"%s%s", // m_aMarioState
 		m_aName, m_Alive, m_Paused, m_NeededFaketuning, m_TeeFinished, m_IsSolo,
 		// weapons
 		m_aWeapons[0].m_AmmoRegenStart, m_aWeapons[0].m_Ammo, m_aWeapons[0].m_Ammocost, m_aWeapons[0].m_Got,
@@ -304,7 +325,8 @@ char *CSaveTee::GetString(const CSaveTeam *pTeam)
 		m_InputDirection, m_InputJump, m_InputFire, m_InputHook,
 		m_ReloadTimer,
 		m_TeeStarted,
-		m_LiveFrozen);
+		m_LiveFrozen,
+		m_aMarioState[0] ? "\t" : "", m_aMarioState);
 	return m_aString;
 }
 
@@ -344,7 +366,8 @@ int CSaveTee::FromString(const char *pString)
 		"%d\t%d\t%d\t%d\t" // input stuff
 		"%d\t" // m_ReloadTimer
 		"%d\t" // m_TeeStarted
-		"%d", // m_LiveFreeze
+		"%d\t" // m_LiveFreeze
+		"%2047s", // m_aMarioState
 		m_aName, &m_Alive, &m_Paused, &m_NeededFaketuning, &m_TeeFinished, &m_IsSolo,
 		// weapons
 		&m_aWeapons[0].m_AmmoRegenStart, &m_aWeapons[0].m_Ammo, &m_aWeapons[0].m_Ammocost, &m_aWeapons[0].m_Got,
@@ -377,7 +400,8 @@ int CSaveTee::FromString(const char *pString)
 		&m_InputDirection, &m_InputJump, &m_InputFire, &m_InputHook,
 		&m_ReloadTimer,
 		&m_TeeStarted,
-		&m_LiveFrozen);
+		&m_LiveFrozen,
+		m_aMarioState);
 	switch(Num) // Don't forget to update this when you save / load more / less.
 	{
 	case 96:
@@ -407,6 +431,9 @@ int CSaveTee::FromString(const char *pString)
 		m_LiveFrozen = false;
 		[[fallthrough]];
 	case 110:
+		m_aMarioState[0] = '\0';
+		[[fallthrough]];
+	case 111:
 		return 0;
 	default:
 		dbg_msg("load", "failed to load tee-string");
@@ -432,6 +459,7 @@ CSaveTeam::CSaveTeam(IGameController *pController)
 	m_pController = pController;
 	m_pSwitchers = 0;
 	m_pSavedTees = 0;
+	m_StringComplete = true;
 }
 
 CSaveTeam::~CSaveTeam()
@@ -492,6 +520,11 @@ int CSaveTeam::Save(int Team)
 				m_pSwitchers[i].m_Type = m_pController->GameServer()->Switchers()[i].m_aType[Team];
 			}
 		}
+
+		// saves are stored and loaded through buffers of that size, don't store a cut off one
+		GetString();
+		if(!m_StringComplete)
+			return 5;
 		return 0;
 	}
 	else
@@ -516,6 +549,9 @@ bool CSaveTeam::HandleSaveError(int Result, int ClientID, CGameContext *pGameCon
 	case 4:
 		pGameContext->SendChatTarget(ClientID, "Your team has not started yet");
 		break;
+	case 5:
+		pGameContext->SendChatTarget(ClientID, "Your team is too large to save");
+		break;
 	default: // this state should never be reached
 		pGameContext->SendChatTarget(ClientID, "Unknown error while saving");
 		break;
@@ -566,13 +602,14 @@ CCharacter *CSaveTeam::MatchCharacter(int ClientID, int SaveID, bool KeepCurrent
 
 char *CSaveTeam::GetString()
 {
-	str_format(m_aString, sizeof(m_aString), "%d\t%d\t%d\t%d\t%d", m_TeamState, m_MembersCount, m_HighestSwitchNumber, m_TeamLocked, m_Practice);
+	int Length = str_format(m_aString, sizeof(m_aString), "%d\t%d\t%d\t%d\t%d", m_TeamState, m_MembersCount, m_HighestSwitchNumber, m_TeamLocked, m_Practice);
 
 	for(int i = 0; i < m_MembersCount; i++)
 	{
-		char aBuf[1024];
-		str_format(aBuf, sizeof(aBuf), "\n%s", m_pSavedTees[i].GetString(this));
-		str_append(m_aString, aBuf, sizeof(m_aString));
+		const char *pTee = m_pSavedTees[i].GetString(this);
+		Length += 1 + str_length(pTee);
+		str_append(m_aString, "\n", sizeof(m_aString));
+		str_append(m_aString, pTee, sizeof(m_aString));
 	}
 
 	if(m_pSwitchers && m_HighestSwitchNumber)
@@ -580,11 +617,12 @@ char *CSaveTeam::GetString()
 		for(int i = 1; i < m_HighestSwitchNumber + 1; i++)
 		{
 			char aBuf[64];
-			str_format(aBuf, sizeof(aBuf), "\n%d\t%d\t%d", m_pSwitchers[i].m_Status, m_pSwitchers[i].m_EndTime, m_pSwitchers[i].m_Type);
+			Length += str_format(aBuf, sizeof(aBuf), "\n%d\t%d\t%d", m_pSwitchers[i].m_Status, m_pSwitchers[i].m_EndTime, m_pSwitchers[i].m_Type);
 			str_append(m_aString, aBuf, sizeof(m_aString));
 		}
 	}
 
+	m_StringComplete = Length < (int)sizeof(m_aString);
 	return m_aString;
 }
 
@@ -592,7 +630,7 @@ int CSaveTeam::FromString(const char *pString)
 {
 	char aTeamStats[MAX_CLIENTS];
 	char aSwitcher[64];
-	char aSaveTee[1024];
+	char aSaveTee[4096];
 
 	char *pCopyPos;
 	unsigned int Pos = 0;
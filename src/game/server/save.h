@@ -39,7 +39,7 @@ public:
 private:
 	int m_ClientID;
 
-	char m_aString[2048];
+	char m_aString[4096];
 	char m_aName[16];
 
 	int m_Alive;
@@ -118,6 +118,9 @@ private:
 	int m_ReloadTimer;
 
 	char m_aGameUuid[UUID_MAXSTRSIZE];
+
+	// libsm64 snapshot of the tee's Mario, empty if there was none
+	char m_aMarioState[2048];
 };
 
 class CSaveTeam
@@ -144,6 +147,8 @@ private:
 	IGameController *m_pController;
 
 	char m_aString[65536];
+	// false if the last GetString didn't fit into m_aString
+	bool m_StringComplete;
 
 	struct SSimpleSwitchers
 	{
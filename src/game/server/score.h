@@ -15,6 +15,8 @@ class CScore
 {
 	CPlayerData m_aPlayerData[MAX_CLIENTS];
 	CDbConnectionPool *m_pPool;
+	// shared with the requests, they can outlive this
+	std::shared_ptr<CRankCache> m_pRankCache;
 
 	CGameContext *GameServer() const { return m_pGameServer; }
 	IServer *Server() const { return m_pServer; }
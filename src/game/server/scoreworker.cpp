@@ -118,6 +118,10 @@ bool CScoreWorker::Init(IDbConnection *pSqlServer, const ISqlData *pGameData, ch
 		pResult->m_CurrentRecord = pSqlServer->GetFloat(1);
 	}
 
+	// load the ranks along with the map
+	if(pData->m_pRankCache)
+		pData->m_pRankCache->Update(pSqlServer, pData->m_aMap, g_Config.m_SvSqlServerName, g_Config.m_SvRankCache);
+
 	return false;
 }
 
@@ -477,7 +481,13 @@ bool CScoreWorker::SaveScore(IDbConnection *pSqlServer, const ISqlData *pGameDat
 	pSqlServer->BindString(5, pData->m_aGameUuid);
 	pSqlServer->Print();
 	int NumInserted;
-	return pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize);
+	if(pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(pData->m_pRankCache)
+		pData->m_pRankCache->AddScore(pData->m_aName, g_Config.m_SvSqlServerName, pData->m_Time);
+	return false;
 }
 
 bool CScoreWorker::SaveTeamScore(IDbConnection *pSqlServer, const ISqlData *pGameData, bool Failure, char *pError, int ErrorSize)
@@ -554,6 +564,8 @@ bool CScoreWorker::SaveTeamScore(IDbConnection *pSqlServer, const ISqlData *pGam
 			{
 				return true;
 			}
+			if(pData->m_pRankCache)
+				pData->m_pRankCache->AddTeamScore(Teamrank.m_TeamID, vNames, pData->m_Time);
 		}
 	}
 	else
@@ -583,6 +595,8 @@ bool CScoreWorker::SaveTeamScore(IDbConnection *pSqlServer, const ISqlData *pGam
 				return true;
 			}
 		}
+		if(pData->m_pRankCache)
+			pData->m_pRankCache->AddTeamScore(GameID, vNames, pData->m_Time);
 	}
 	return false;
 }
@@ -592,69 +606,94 @@ bool CScoreWorker::ShowRank(IDbConnection *pSqlServer, const ISqlData *pGameData
 	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
 	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
 
-	char aServerLike[16];
-	str_format(aServerLike, sizeof(aServerLike), "%%%s%%", pData->m_aServer);
-
-	// check sort method
-	char aBuf[600];
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT Ranking, Time, PercentRank "
-		"FROM ("
-		"  SELECT RANK() OVER w AS Ranking, PERCENT_RANK() OVER w as PercentRank, MIN(Time) AS Time, Name "
-		"  FROM %s_race "
-		"  WHERE Map = ? "
-		"  AND Server LIKE ? "
-		"  GROUP BY Name "
-		"  WINDOW w AS (ORDER BY MIN(Time))"
-		") as a "
-		"WHERE Name = ?",
-		pSqlServer->GetPrefix());
-
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_aMap);
-	pSqlServer->BindString(2, aServerLike);
-	pSqlServer->BindString(3, pData->m_aName);
-
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-
 	char aRegionalRank[16];
-	if(End)
-	{
-		str_copy(aRegionalRank, "unranked", sizeof(aRegionalRank));
+	bool Ranked;
+	int Rank;
+	float Time;
+	float PercentRank;
+	char aBuf[600];
+	CRankCache *pRankCache = pData->m_pRankCache.get();
+	if(pRankCache && pRankCache->Update(pSqlServer, pData->m_aMap, pData->m_aServer, g_Config.m_SvRankCache))
+	{
+		int RegionalRank;
+		float RegionalTime;
+		float RegionalPercentRank;
+		if(pRankCache->Rank(true, pData->m_aName, &RegionalRank, &RegionalTime, &RegionalPercentRank))
+			str_format(aRegionalRank, sizeof(aRegionalRank), "rank %d", RegionalRank);
+		else
+			str_copy(aRegionalRank, "unranked", sizeof(aRegionalRank));
+		Ranked = pRankCache->Rank(false, pData->m_aName, &Rank, &Time, &PercentRank);
 	}
 	else
 	{
-		str_format(aRegionalRank, sizeof(aRegionalRank), "rank %d", pSqlServer->GetInt(1));
-	}
+		char aServerLike[16];
+		str_format(aServerLike, sizeof(aServerLike), "%%%s%%", pData->m_aServer);
 
-	const char *pAny = "%";
+		// check sort method
+		str_format(aBuf, sizeof(aBuf),
+			"SELECT Ranking, Time, PercentRank "
+			"FROM ("
+			"  SELECT RANK() OVER w AS Ranking, PERCENT_RANK() OVER w as PercentRank, MIN(Time) AS Time, Name "
+			"  FROM %s_race "
+			"  WHERE Map = ? "
+			"  AND Server LIKE ? "
+			"  GROUP BY Name "
+			"  WINDOW w AS (ORDER BY MIN(Time))"
+			") as a "
+			"WHERE Name = ?",
+			pSqlServer->GetPrefix());
 
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_aMap);
-	pSqlServer->BindString(2, pAny);
-	pSqlServer->BindString(3, pData->m_aName);
+		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+		{
+			return true;
+		}
+		pSqlServer->BindString(1, pData->m_aMap);
+		pSqlServer->BindString(2, aServerLike);
+		pSqlServer->BindString(3, pData->m_aName);
 
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
+		bool End;
+		if(pSqlServer->Step(&End, pError, ErrorSize))
+		{
+			return true;
+		}
+
+		if(End)
+		{
+			str_copy(aRegionalRank, "unranked", sizeof(aRegionalRank));
+		}
+		else
+		{
+			str_format(aRegionalRank, sizeof(aRegionalRank), "rank %d", pSqlServer->GetInt(1));
+		}
+
+		const char *pAny = "%";
+
+		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+		{
+			return true;
+		}
+		pSqlServer->BindString(1, pData->m_aMap);
+		pSqlServer->BindString(2, pAny);
+		pSqlServer->BindString(3, pData->m_aName);
+
+		if(pSqlServer->Step(&End, pError, ErrorSize))
+		{
+			return true;
+		}
+
+		Ranked = !End;
+		if(Ranked)
+		{
+			Rank = pSqlServer->GetInt(1);
+			Time = pSqlServer->GetFloat(2);
+			PercentRank = pSqlServer->GetFloat(3);
+		}
 	}
 
-	if(!End)
+	if(Ranked)
 	{
-		int Rank = pSqlServer->GetInt(1);
-		float Time = pSqlServer->GetFloat(2);
 		// CEIL and FLOOR are not supported in SQLite
-		int BetterThanPercent = std::floor(100.0f - 100.0f * pSqlServer->GetFloat(3));
+		int BetterThanPercent = std::floor(100.0f - 100.0f * PercentRank);
 		str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
 		if(g_Config.m_SvHideScore)
 		{
@@ -699,57 +738,77 @@ bool CScoreWorker::ShowTeamRank(IDbConnection *pSqlServer, const ISqlData *pGame
 	// check sort method
 	char aBuf[2400];
 
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT l.ID, Name, Time, Ranking, PercentRank "
-		"FROM (" // teamrank score board
-		"  SELECT RANK() OVER w AS Ranking, PERCENT_RANK() OVER w AS PercentRank, ID "
-		"  FROM %s_teamrace "
-		"  WHERE Map = ? "
-		"  GROUP BY ID "
-		"  WINDOW w AS (ORDER BY Min(Time))"
-		") AS TeamRank INNER JOIN (" // select rank with Name in team
-		"  SELECT ID "
-		"  FROM %s_teamrace "
-		"  WHERE Map = ? AND Name = ? "
-		"  ORDER BY Time "
-		"  LIMIT 1"
-		") AS l ON TeamRank.ID = l.ID "
-		"INNER JOIN %s_teamrace AS r ON l.ID = r.ID ",
-		pSqlServer->GetPrefix(), pSqlServer->GetPrefix(), pSqlServer->GetPrefix());
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_aMap);
-	pSqlServer->BindString(2, pData->m_aMap);
-	pSqlServer->BindString(3, pData->m_aName);
-
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
+	bool Ranked;
+	float PercentRank;
+	CRankCache::CTeamRank TeamRank;
+	CRankCache *pRankCache = pData->m_pRankCache.get();
+	if(pRankCache && pRankCache->Update(pSqlServer, pData->m_aMap, pData->m_aServer, g_Config.m_SvRankCache))
 	{
-		return true;
+		Ranked = pRankCache->TeamRank(pData->m_aName, &TeamRank, &PercentRank);
 	}
-	if(!End)
+	else
 	{
-		float Time = pSqlServer->GetFloat(3);
-		str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
-		int Rank = pSqlServer->GetInt(4);
-		// CEIL and FLOOR are not supported in SQLite
-		int BetterThanPercent = std::floor(100.0f - 100.0f * pSqlServer->GetFloat(5));
-		CTeamrank Teamrank;
-		if(Teamrank.NextSqlResult(pSqlServer, &End, pError, ErrorSize))
+		str_format(aBuf, sizeof(aBuf),
+			"SELECT l.ID, Name, Time, Ranking, PercentRank "
+			"FROM (" // teamrank score board
+			"  SELECT RANK() OVER w AS Ranking, PERCENT_RANK() OVER w AS PercentRank, ID "
+			"  FROM %s_teamrace "
+			"  WHERE Map = ? "
+			"  GROUP BY ID "
+			"  WINDOW w AS (ORDER BY Min(Time))"
+			") AS TeamRank INNER JOIN (" // select rank with Name in team
+			"  SELECT ID "
+			"  FROM %s_teamrace "
+			"  WHERE Map = ? AND Name = ? "
+			"  ORDER BY Time "
+			"  LIMIT 1"
+			") AS l ON TeamRank.ID = l.ID "
+			"INNER JOIN %s_teamrace AS r ON l.ID = r.ID ",
+			pSqlServer->GetPrefix(), pSqlServer->GetPrefix(), pSqlServer->GetPrefix());
+		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
 		{
 			return true;
 		}
+		pSqlServer->BindString(1, pData->m_aMap);
+		pSqlServer->BindString(2, pData->m_aMap);
+		pSqlServer->BindString(3, pData->m_aName);
 
+		bool End;
+		if(pSqlServer->Step(&End, pError, ErrorSize))
+		{
+			return true;
+		}
+		Ranked = !End;
+		if(Ranked)
+		{
+			TeamRank.m_Time = pSqlServer->GetFloat(3);
+			TeamRank.m_Rank = pSqlServer->GetInt(4);
+			PercentRank = pSqlServer->GetFloat(5);
+			CTeamrank Teamrank;
+			if(Teamrank.NextSqlResult(pSqlServer, &End, pError, ErrorSize))
+			{
+				return true;
+			}
+			for(unsigned int Name = 0; Name < Teamrank.m_NumNames; Name++)
+				TeamRank.m_vNames.emplace_back(Teamrank.m_aaNames[Name]);
+		}
+	}
+
+	if(Ranked)
+	{
+		str_time_float(TeamRank.m_Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
+		// CEIL and FLOOR are not supported in SQLite
+		int BetterThanPercent = std::floor(100.0f - 100.0f * PercentRank);
+
+		const int NumNames = TeamRank.m_vNames.size();
 		char aFormattedNames[512] = "";
-		for(unsigned int Name = 0; Name < Teamrank.m_NumNames; Name++)
+		for(int Name = 0; Name < NumNames; Name++)
 		{
-			str_append(aFormattedNames, Teamrank.m_aaNames[Name], sizeof(aFormattedNames));
+			str_append(aFormattedNames, TeamRank.m_vNames[Name].c_str(), sizeof(aFormattedNames));
 
-			if(Name < Teamrank.m_NumNames - 2)
+			if(Name < NumNames - 2)
 				str_append(aFormattedNames, ", ", sizeof(aFormattedNames));
-			else if(Name < Teamrank.m_NumNames - 1)
+			else if(Name < NumNames - 1)
 				str_append(aFormattedNames, " & ", sizeof(aFormattedNames));
 		}
 
@@ -763,7 +822,7 @@ bool CScoreWorker::ShowTeamRank(IDbConnection *pSqlServer, const ISqlData *pGame
 			pResult->m_MessageKind = CScorePlayerResult::ALL;
 			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
 				"%d. %s Team time: %s, better than %d%%, requested by %s",
-				Rank, aFormattedNames, aBuf, BetterThanPercent, pData->m_aRequestingPlayer);
+				TeamRank.m_Rank, aFormattedNames, aBuf, BetterThanPercent, pData->m_aRequestingPlayer);
 		}
 	}
 	else
@@ -783,6 +842,39 @@ bool CScoreWorker::ShowTop(IDbConnection *pSqlServer, const ISqlData *pGameData,
 	const char *pOrder = pData->m_Offset >= 0 ? "ASC" : "DESC";
 	const char *pAny = "%";
 
+	char aTime[32];
+	CRankCache *pRankCache = pData->m_pRankCache.get();
+	if(pRankCache && pRankCache->Update(pSqlServer, pData->m_aMap, pData->m_aServer, g_Config.m_SvRankCache))
+	{
+		int Line = 0;
+		str_copy(pResult->m_Data.m_aaMessages[Line], "------------ Global Top ------------", sizeof(pResult->m_Data.m_aaMessages[Line]));
+		Line++;
+
+		CRankCache::CRank aRanks[5];
+		int NumRanks = pRankCache->Top(false, pData->m_Offset, aRanks, 5);
+		for(int i = 0; i < NumRanks; i++)
+		{
+			str_time_float(aRanks[i].m_Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+			str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
+				"%d. %s Time: %s", aRanks[i].m_Rank, aRanks[i].m_aName, aTime);
+			Line++;
+		}
+
+		str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
+			"------------ %s Top ------------", pData->m_aServer);
+		Line++;
+
+		NumRanks = pRankCache->Top(true, pData->m_Offset, aRanks, 3);
+		for(int i = 0; i < NumRanks; i++)
+		{
+			str_time_float(aRanks[i].m_Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+			str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
+				"%d. %s Time: %s", aRanks[i].m_Rank, aRanks[i].m_aName, aTime);
+			Line++;
+		}
+		return false;
+	}
+
 	// check sort method
 	char aBuf[512];
 	str_format(aBuf, sizeof(aBuf),
@@ -814,7 +906,6 @@ bool CScoreWorker::ShowTop(IDbConnection *pSqlServer, const ISqlData *pGameData,
 	str_copy(pResult->m_Data.m_aaMessages[Line], "------------ Global Top ------------", sizeof(pResult->m_Data.m_aaMessages[Line]));
 	Line++;
 
-	char aTime[32];
 	bool End = false;
 
 	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
@@ -873,6 +964,37 @@ bool CScoreWorker::ShowTeamTop5(IDbConnection *pSqlServer, const ISqlData *pGame
 	// check sort method
 	char aBuf[512];
 
+	CRankCache *pRankCache = pData->m_pRankCache.get();
+	if(pRankCache && pRankCache->Update(pSqlServer, pData->m_aMap, pData->m_aServer, g_Config.m_SvRankCache))
+	{
+		int Line = 0;
+		str_copy(paMessages[Line], "------- Team Top 5 -------", sizeof(paMessages[Line]));
+		Line++;
+
+		CRankCache::CTeamRank aRanks[5];
+		const int NumRanks = pRankCache->TeamTop(pData->m_Offset, aRanks, 5);
+		for(int i = 0; i < NumRanks; i++)
+		{
+			str_time_float(aRanks[i].m_Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
+			const int TeamSize = aRanks[i].m_vNames.size();
+			char aNames[2300] = {0};
+			for(int j = 0; j < TeamSize; j++)
+			{
+				str_append(aNames, aRanks[i].m_vNames[j].c_str(), sizeof(aNames));
+				if(j < TeamSize - 2)
+					str_append(aNames, ", ", sizeof(aNames));
+				else if(j == TeamSize - 2)
+					str_append(aNames, " & ", sizeof(aNames));
+			}
+			str_format(paMessages[Line], sizeof(paMessages[Line]), "%d. %s Team Time: %s",
+				aRanks[i].m_Rank, aNames, aBuf);
+			Line++;
+		}
+
+		str_copy(paMessages[Line], "-------------------------------", sizeof(paMessages[Line]));
+		return false;
+	}
+
 	str_format(aBuf, sizeof(aBuf),
 		"SELECT Name, Time, Ranking, TeamSize "
 		"FROM (" // limit to 5
@@ -10,6 +10,7 @@
 #include <engine/server/databases/connection_pool.h>
 #include <engine/shared/protocol.h>
 #include <engine/shared/uuid_manager.h>
+#include <game/server/rankcache.h>
 #include <game/server/save.h>
 #include <game/voting.h>
 
@@ -80,6 +81,7 @@ struct CSqlInitData : ISqlData
 
 	// current map
 	char m_aMap[MAX_MAP_LENGTH];
+	std::shared_ptr<CRankCache> m_pRankCache;
 };
 
 struct CSqlPlayerRequest : ISqlData
@@ -97,6 +99,8 @@ struct CSqlPlayerRequest : ISqlData
 	// relevant for /top5 kind of requests
 	int m_Offset;
 	char m_aServer[5];
+	// ranks of the current map, answers rank and top requests if set
+	std::shared_ptr<CRankCache> m_pRankCache;
 };
 
 struct CScoreRandomMapResult : ISqlResult
@@ -145,6 +149,7 @@ struct CSqlScoreData : ISqlData
 	int m_Num;
 	bool m_Search;
 	char m_aRequestingPlayer[MAX_NAME_LENGTH];
+	std::shared_ptr<CRankCache> m_pRankCache;
 };
 
 struct CScoreSaveResult : ISqlResult
@@ -185,6 +190,7 @@ struct CSqlTeamScoreData : ISqlData
 	char m_aTimestamp[TIMESTAMP_STR_LENGTH];
 	unsigned int m_Size;
 	char m_aaNames[MAX_CLIENTS][MAX_NAME_LENGTH];
+	std::shared_ptr<CRankCache> m_pRankCache;
 };
 
 struct CSqlTeamSave : ISqlData
@@ -0,0 +1,52 @@
+#include "snaptable.h"
+
+#include <base/system.h>
+#include <engine/shared/snapshot.h>
+#include <engine/shared/uuid_manager.h>
+
+void CSnapTable::Clear()
+{
+	m_vGroups.clear();
+	m_vItems.clear();
+	m_vOffsets.clear();
+	m_vData.clear();
+}
+
+void CSnapTable::AddGroup(vec2 Pos, int64_t Mask)
+{
+	SGroup Group;
+	Group.m_Pos = Pos;
+	Group.m_Mask = Mask;
+	Group.m_FirstItem = m_vItems.size();
+	Group.m_NumItems = 0;
+	Group.m_DataStart = m_vData.size();
+	Group.m_DataSize = 0;
+	Group.m_Plain = true;
+	m_vGroups.push_back(Group);
+}
+
+void *CSnapTable::AddItem(int Type, int ID, int Size)
+{
+	dbg_assert(!m_vGroups.empty(), "snap table item added without a group");
+	dbg_assert(ID >= 0 && ID <= CSnapshot::MAX_ID, "incorrect id");
+	dbg_assert(Size % sizeof(int) == 0, "snap table item size isn't a multiple of int");
+
+	SGroup &Group = m_vGroups.back();
+	SItem Item;
+	Item.m_Type = Type;
+	Item.m_ID = ID;
+	Item.m_Size = Size;
+	m_vItems.push_back(Item);
+	m_vOffsets.push_back(Group.m_DataSize);
+	Group.m_NumItems++;
+	Group.m_DataSize += sizeof(CSnapshotItem) + Size;
+	// extended types are translated per snapshot, see CSnapshotBuilder::NewItem
+	if(Type >= OFFSET_UUID)
+		Group.m_Plain = false;
+
+	const int Start = m_vData.size();
+	m_vData.resize(Start + (sizeof(CSnapshotItem) + Size) / sizeof(int), 0);
+	CSnapshotItem *pItem = (CSnapshotItem *)&m_vData[Start];
+	pItem->m_TypeAndID = Group.m_Plain ? (Type << 16) | ID : 0;
+	return pItem->Data();
+}
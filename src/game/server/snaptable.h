@@ -0,0 +1,122 @@
+#ifndef GAME_SERVER_SNAPTABLE_H
+#define GAME_SERVER_SNAPTABLE_H
+
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <cstdint>
+#include <vector>
+
+/*
+	Class: Snap Table
+		Snapshot items that look the same to every client, built once per
+		snapshot instead of once per snapping client. Items come in groups
+		that share a position and a mask of the clients that may see them,
+		the per-client pass only clips the groups and copies their items.
+*/
+class CSnapTable
+{
+	struct SGroup
+	{
+		vec2 m_Pos;
+		int64_t m_Mask;
+		int m_FirstItem;
+		int m_NumItems;
+		int m_DataStart; // in ints into m_vData
+		int m_DataSize; // in bytes
+		bool m_Plain; // no extended item types, can be copied in one go
+	};
+
+	struct SItem
+	{
+		int m_Type;
+		int m_ID;
+		int m_Size;
+	};
+
+	std::vector<SGroup> m_vGroups;
+	std::vector<SItem> m_vItems;
+	// item offsets in bytes, relative to the data of their group
+	std::vector<int> m_vOffsets;
+	// items laid out like in a snapshot: key followed by the item data
+	std::vector<int> m_vData;
+
+public:
+	// what a client sees, see NetworkClipped
+	struct SView
+	{
+		vec2 m_ViewPos;
+		vec2 m_ShowDistance;
+		bool m_ShowAll;
+	};
+
+	void Clear();
+
+	/*
+		Function: AddGroup
+			Starts a group of items, AddItem adds to the last one.
+
+		Arguments:
+			Pos - Position the group is clipped by.
+			Mask - Clients that may see the group.
+	*/
+	void AddGroup(vec2 Pos, int64_t Mask);
+
+	/*
+		Function: AddItem
+			Adds an item to the last group.
+
+		Returns:
+			Zeroed item data of Size bytes. Only valid until the next
+			AddItem call.
+	*/
+	void *AddItem(int Type, int ID, int Size);
+
+	int NumItems() const { return m_vItems.size(); }
+
+	/*
+		Function: Snap
+			Copies the items the client can see.
+
+		Arguments:
+			SnappingClient - ID of the client, or SERVER_DEMO_CLIENT
+				which sees everything.
+			View - The client's view, ignored for the demo client.
+			NewItem - Allocates an item like IServer::SnapNewItem, a
+				null result stops the copying.
+			NewItems - Appends a group of prepared items like
+				IServer::SnapNewItems, NewItem is used if it fails.
+	*/
+	template<typename TNewItem, typename TNewItems>
+	void Snap(int SnappingClient, const SView &View, TNewItem &&NewItem, TNewItems &&NewItems) const
+	{
+		for(const SGroup &Group : m_vGroups)
+		{
+			if(SnappingClient >= 0)
+			{
+				if(!(Group.m_Mask & (1LL << SnappingClient)))
+					continue;
+				if(!View.m_ShowAll &&
+					(absolute(View.m_ViewPos.x - Group.m_Pos.x) > View.m_ShowDistance.x ||
+						absolute(View.m_ViewPos.y - Group.m_Pos.y) > View.m_ShowDistance.y))
+					continue;
+			}
+
+			if(Group.m_Plain && NewItems(&m_vData[Group.m_DataStart], Group.m_DataSize, &m_vOffsets[Group.m_FirstItem], Group.m_NumItems))
+				continue;
+
+			for(int i = Group.m_FirstItem; i < Group.m_FirstItem + Group.m_NumItems; i++)
+			{
+				const SItem &Item = m_vItems[i];
+				void *pData = NewItem(Item.m_Type, Item.m_ID, Item.m_Size);
+				if(!pData)
+					return;
+				// skip the key
+				const char *pItem = (const char *)&m_vData[Group.m_DataStart] + m_vOffsets[i];
+				mem_copy(pData, pItem + sizeof(int), Item.m_Size);
+			}
+		}
+	}
+};
+
+#endif
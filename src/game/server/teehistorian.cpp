@@ -1,15 +1,52 @@
 #include "teehistorian.h"
 
+#include <base/lock_scope.h>
 #include <engine/shared/config.h>
 #include <engine/shared/json.h>
 #include <engine/shared/snapshot.h>
 #include <game/gamecore.h>
 
+#include <algorithm>
+#include <limits>
+
 static const char TEEHISTORIAN_NAME[] = "teehistorian@ddnet.tw";
 static const CUuid TEEHISTORIAN_UUID = CalculateUuid(TEEHISTORIAN_NAME);
 static const char TEEHISTORIAN_VERSION[] = "2";
 static const char TEEHISTORIAN_VERSION_MINOR[] = "4";
 
+// Compressed files start with their own uuid, followed by frames that are
+// either a block of the teehistorian data or an index of the blocks before.
+// The frame header is the type, followed by:
+//   block: the tick before it, compressed size, raw size, state size
+//   index: number of entries, size, offset of the previous index (64 bit)
+// A block decompresses to the state of the writer followed by the data, an
+// index entry is the tick of the block followed by its offset (64 bit). All
+// numbers are big endian. After the last index the offset of it and the
+// uuid are repeated, so readers can find the indices.
+static const CUuid TEEHISTORIAN_COMPRESSED_UUID = CalculateUuid("teehistorian-compressed@ddnet.tw");
+
+enum
+{
+	FRAME_BLOCK = 1,
+	FRAME_INDEX,
+
+	FRAME_HEADER_SIZE = 20,
+	INDEX_ENTRY_SIZE = 12,
+	TRAILER_SIZE = 8 + sizeof(CUuid),
+	MAX_BLOCK_SIZE = 256 * 1024 * 1024,
+};
+
+static void Int64ToBytesBe(unsigned char *pBytes, int64_t Value)
+{
+	uint_to_bytes_be(pBytes, (uint64_t)Value >> 32);
+	uint_to_bytes_be(pBytes + 4, (uint64_t)Value & 0xffffffff);
+}
+
+static int64_t BytesBeToInt64(const unsigned char *pBytes)
+{
+	return (int64_t)(((uint64_t)bytes_be_to_uint(pBytes) << 32) | bytes_be_to_uint(pBytes + 4));
+}
+
 #define UUID(id, name) static const CUuid UUID_##id = CalculateUuid(name);
 #include <engine/shared/teehistorian_ex_chunks.h>
 #undef UUID
@@ -753,6 +790,46 @@ void CTeeHistorian::RecordAuthLogout(int ClientID)
 	WriteExtra(UUID_TEEHISTORIAN_AUTH_LOGOUT, Buffer.Data(), Buffer.Size());
 }
 
+void CTeeHistorian::PackState(std::vector<unsigned char> &vState) const
+{
+	dbg_assert(m_State == STATE_START || m_State == STATE_BEFORE_TICK, "invalid teehistorian state");
+
+	CPacker Buffer;
+	Buffer.Reset();
+	Buffer.AddInt(m_LastWrittenTick);
+	Buffer.AddInt(m_MaxClientID);
+	vState.assign(Buffer.Data(), Buffer.Data() + Buffer.Size());
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		const CTeehistorianPlayer &Player = m_aPrevPlayers[i];
+		// the next input of players without id is written whole
+		const bool HasInput = Player.m_UniqueClientID != 0;
+		if(!Player.m_Alive && !HasInput)
+		{
+			continue;
+		}
+
+		Buffer.Reset();
+		Buffer.AddInt(i);
+		Buffer.AddInt(Player.m_Alive);
+		if(Player.m_Alive)
+		{
+			Buffer.AddInt(Player.m_X);
+			Buffer.AddInt(Player.m_Y);
+		}
+		Buffer.AddInt(HasInput);
+		if(HasInput)
+		{
+			for(int j = 0; j < (int)(sizeof(Player.m_Input) / sizeof(int)); j++)
+			{
+				Buffer.AddInt(((const int *)&Player.m_Input)[j]);
+			}
+		}
+		vState.insert(vState.end(), Buffer.Data(), Buffer.Data() + Buffer.Size());
+	}
+}
+
 void CTeeHistorian::Finish()
 {
 	dbg_assert(m_State == STATE_START || m_State == STATE_INPUTS || m_State == STATE_BEFORE_ENDTICK || m_State == STATE_BEFORE_TICK, "invalid teehistorian state");
@@ -777,3 +854,713 @@ void CTeeHistorian::Finish()
 
 	Write(Buffer.Data(), Buffer.Size());
 }
+
+CTeeHistorianCompressor::CTeeHistorianCompressor()
+{
+	m_Lock = lock_create();
+	mem_zero(&m_Stream, sizeof(m_Stream));
+	m_StreamInitialized = false;
+	m_InBlock = false;
+	m_BlockTick = 0;
+	m_BlockRawSize = 0;
+	m_BlockStateSize = 0;
+	m_Read = 0;
+	m_FileOffset = 0;
+	m_LastIndexOffset = 0;
+}
+
+CTeeHistorianCompressor::~CTeeHistorianCompressor()
+{
+	if(m_StreamInitialized)
+	{
+		deflateEnd(&m_Stream);
+	}
+	lock_destroy(m_Lock);
+}
+
+void CTeeHistorianCompressor::BeginBlock(int64_t Offset, int Tick, std::vector<unsigned char> &&vState)
+{
+	CLockScope ls(m_Lock);
+	m_BlockStarts.push_back({Offset, Tick, std::move(vState)});
+}
+
+int CTeeHistorianCompressor::Write(IOHANDLE File, const void *pData, unsigned Size, void *pUser)
+{
+	CTeeHistorianCompressor *pSelf = (CTeeHistorianCompressor *)pUser;
+	if(!pData)
+	{
+		return pSelf->Finish(File);
+	}
+	return pSelf->WriteData(File, (const unsigned char *)pData, Size);
+}
+
+int CTeeHistorianCompressor::WriteData(IOHANDLE File, const unsigned char *pData, unsigned Size)
+{
+	int Error = 0;
+	if(m_FileOffset == 0)
+	{
+		// the first block starts with the header of the teehistorian data
+		Error |= WriteFile(File, &TEEHISTORIAN_COMPRESSED_UUID, sizeof(TEEHISTORIAN_COMPRESSED_UUID));
+		Error |= StartBlock(0, {});
+	}
+
+	while(Size > 0 && !Error)
+	{
+		// split the data at the starts of the next blocks
+		bool Begin = false;
+		CBlockStart Start;
+		int64_t NextOffset = -1;
+		{
+			CLockScope ls(m_Lock);
+			if(!m_BlockStarts.empty())
+			{
+				if(m_BlockStarts.front().m_Offset <= m_Read)
+				{
+					Start = std::move(m_BlockStarts.front());
+					m_BlockStarts.pop_front();
+					Begin = true;
+				}
+				else
+				{
+					NextOffset = m_BlockStarts.front().m_Offset;
+				}
+			}
+		}
+		if(Begin)
+		{
+			Error |= FinishBlock(File);
+			Error |= StartBlock(Start.m_Tick, Start.m_vState);
+			continue;
+		}
+
+		unsigned Length = Size;
+		if(NextOffset >= 0 && NextOffset - m_Read < Length)
+		{
+			Length = NextOffset - m_Read;
+		}
+		Error |= Compress(pData, Length, Z_NO_FLUSH);
+		pData += Length;
+		Size -= Length;
+		m_Read += Length;
+	}
+	return Error;
+}
+
+int CTeeHistorianCompressor::Finish(IOHANDLE File)
+{
+	if(m_FileOffset == 0)
+	{
+		return 0;
+	}
+
+	int Error = FinishBlock(File);
+	Error |= WriteIndex(File);
+
+	unsigned char aTrailer[TRAILER_SIZE];
+	Int64ToBytesBe(aTrailer, m_LastIndexOffset);
+	mem_copy(aTrailer + 8, &TEEHISTORIAN_COMPRESSED_UUID, sizeof(TEEHISTORIAN_COMPRESSED_UUID));
+	Error |= WriteFile(File, aTrailer, sizeof(aTrailer));
+	return Error;
+}
+
+int CTeeHistorianCompressor::StartBlock(int Tick, const std::vector<unsigned char> &vState)
+{
+	if(!m_StreamInitialized)
+	{
+		if(deflateInit(&m_Stream, Z_DEFAULT_COMPRESSION) != Z_OK)
+		{
+			return 1;
+		}
+		m_StreamInitialized = true;
+	}
+	else if(deflateReset(&m_Stream) != Z_OK)
+	{
+		return 1;
+	}
+
+	m_InBlock = true;
+	m_BlockTick = Tick;
+	m_BlockRawSize = 0;
+	m_BlockStateSize = vState.size();
+	m_vCompressed.clear();
+	return Compress(vState.data(), vState.size(), Z_NO_FLUSH);
+}
+
+int CTeeHistorianCompressor::FinishBlock(IOHANDLE File)
+{
+	if(!m_InBlock)
+	{
+		return 0;
+	}
+	m_InBlock = false;
+
+	int Error = Compress(nullptr, 0, Z_FINISH);
+
+	unsigned char aHeader[FRAME_HEADER_SIZE];
+	uint_to_bytes_be(aHeader, FRAME_BLOCK);
+	uint_to_bytes_be(aHeader + 4, m_BlockTick);
+	uint_to_bytes_be(aHeader + 8, m_vCompressed.size());
+	uint_to_bytes_be(aHeader + 12, m_BlockRawSize);
+	uint_to_bytes_be(aHeader + 16, m_BlockStateSize);
+	m_vIndex.push_back({m_BlockTick, m_FileOffset});
+	Error |= WriteFile(File, aHeader, sizeof(aHeader));
+	Error |= WriteFile(File, m_vCompressed.data(), m_vCompressed.size());
+
+	if(m_vIndex.size() >= INDEX_BLOCKS)
+	{
+		Error |= WriteIndex(File);
+	}
+	return Error;
+}
+
+int CTeeHistorianCompressor::WriteIndex(IOHANDLE File)
+{
+	std::vector<unsigned char> vIndex(FRAME_HEADER_SIZE + m_vIndex.size() * INDEX_ENTRY_SIZE);
+	uint_to_bytes_be(vIndex.data(), FRAME_INDEX);
+	uint_to_bytes_be(vIndex.data() + 4, m_vIndex.size());
+	uint_to_bytes_be(vIndex.data() + 8, m_vIndex.size() * INDEX_ENTRY_SIZE);
+	Int64ToBytesBe(vIndex.data() + 12, m_LastIndexOffset);
+	unsigned char *pEntry = vIndex.data() + FRAME_HEADER_SIZE;
+	for(const auto &Entry : m_vIndex)
+	{
+		uint_to_bytes_be(pEntry, Entry.m_Tick);
+		Int64ToBytesBe(pEntry + 4, Entry.m_Offset);
+		pEntry += INDEX_ENTRY_SIZE;
+	}
+	m_vIndex.clear();
+
+	m_LastIndexOffset = m_FileOffset;
+	return WriteFile(File, vIndex.data(), vIndex.size());
+}
+
+int CTeeHistorianCompressor::Compress(const void *pData, unsigned Size, int Flush)
+{
+	m_Stream.next_in = (Bytef *)pData;
+	m_Stream.avail_in = Size;
+	m_BlockRawSize += Size;
+	do
+	{
+		unsigned char aBuffer[16 * 1024];
+		m_Stream.next_out = aBuffer;
+		m_Stream.avail_out = sizeof(aBuffer);
+		if(deflate(&m_Stream, Flush) == Z_STREAM_ERROR)
+		{
+			return 1;
+		}
+		m_vCompressed.insert(m_vCompressed.end(), aBuffer, aBuffer + sizeof(aBuffer) - m_Stream.avail_out);
+	} while(m_Stream.avail_out == 0);
+	return 0;
+}
+
+int CTeeHistorianCompressor::WriteFile(IOHANDLE File, const void *pData, unsigned Size)
+{
+	m_FileOffset += Size;
+	return Size > 0 && io_write(File, pData, Size) != Size;
+}
+
+CTeeHistorianReader::CTeeHistorianReader()
+{
+	m_pData = nullptr;
+	m_Size = 0;
+	m_pHeader = nullptr;
+	m_Error = false;
+	m_Finished = false;
+	m_NumPending = 0;
+	m_NextBlock = 0;
+}
+
+void CTeeHistorianReader::ResetState()
+{
+	m_Error = false;
+	m_Finished = false;
+	m_Tick = 0;
+	// Tick 0 is implicit at the start, like in the writer.
+	m_LastPlayerID = MAX_CLIENTS;
+	m_JoinProtocol = CTeeHistorian::PROTOCOL_6;
+	m_NumPending = 0;
+	for(auto &Player : m_aPlayers)
+	{
+		Player.m_Alive = false;
+		mem_zero(&Player.m_Input, sizeof(Player.m_Input));
+	}
+}
+
+bool CTeeHistorianReader::Open(const void *pData, int64_t Size)
+{
+	m_pData = (const unsigned char *)pData;
+	m_Size = Size;
+	m_pHeader = nullptr;
+	m_vBlocks.clear();
+	m_NextBlock = 0;
+	ResetState();
+
+	if(Size >= (int64_t)sizeof(TEEHISTORIAN_COMPRESSED_UUID) && mem_comp(pData, &TEEHISTORIAN_COMPRESSED_UUID, sizeof(TEEHISTORIAN_COMPRESSED_UUID)) == 0)
+	{
+		if(!FindBlocks() || !LoadBlock(0))
+		{
+			m_vBlocks.clear();
+			m_pHeader = nullptr;
+			return false;
+		}
+		return true;
+	}
+
+	if(Size < (int)sizeof(TEEHISTORIAN_UUID) || Size > std::numeric_limits<int>::max() || mem_comp(pData, &TEEHISTORIAN_UUID, sizeof(TEEHISTORIAN_UUID)) != 0)
+		return false;
+
+	const char *pHeader = (const char *)pData + sizeof(TEEHISTORIAN_UUID);
+	const char *pEnd = (const char *)pData + Size;
+	if(!mem_has_null(pHeader, pEnd - pHeader))
+		return false;
+	m_pHeader = pHeader;
+	return Restart(0);
+}
+
+bool CTeeHistorianReader::Restart(int Block)
+{
+	ResetState();
+	if(Compressed())
+	{
+		return LoadBlock(Block);
+	}
+	const char *pData = m_pHeader + str_length(m_pHeader) + 1;
+	m_Unpacker.Reset(pData, (const char *)m_pData + m_Size - pData);
+	return true;
+}
+
+bool CTeeHistorianReader::FindBlocks()
+{
+	// follow the indices from the end, unless the server crashed before
+	// writing the last one
+	if(m_Size >= (int64_t)(sizeof(TEEHISTORIAN_COMPRESSED_UUID) + TRAILER_SIZE) && mem_comp(m_pData + m_Size - sizeof(TEEHISTORIAN_COMPRESSED_UUID), &TEEHISTORIAN_COMPRESSED_UUID, sizeof(TEEHISTORIAN_COMPRESSED_UUID)) == 0)
+	{
+		int64_t IndexOffset = BytesBeToInt64(m_pData + m_Size - TRAILER_SIZE);
+		bool Ok = true;
+		while(IndexOffset != 0)
+		{
+			if(IndexOffset < (int64_t)sizeof(TEEHISTORIAN_COMPRESSED_UUID) || IndexOffset > m_Size - FRAME_HEADER_SIZE)
+			{
+				Ok = false;
+				break;
+			}
+			const unsigned char *pIndex = m_pData + IndexOffset;
+			const unsigned NumEntries = bytes_be_to_uint(pIndex + 4);
+			const unsigned IndexSize = bytes_be_to_uint(pIndex + 8);
+			// in 64 bits, so a huge number of entries can't wrap around
+			if(bytes_be_to_uint(pIndex) != FRAME_INDEX || IndexSize != (int64_t)NumEntries * INDEX_ENTRY_SIZE || IndexSize > m_Size - IndexOffset - FRAME_HEADER_SIZE)
+			{
+				Ok = false;
+				break;
+			}
+			const unsigned char *pEntry = pIndex + FRAME_HEADER_SIZE;
+			for(unsigned i = 0; i < NumEntries; i++, pEntry += INDEX_ENTRY_SIZE)
+			{
+				m_vBlocks.push_back({(int)bytes_be_to_uint(pEntry), BytesBeToInt64(pEntry + 4)});
+			}
+			// the indices only point backwards
+			const int64_t PrevOffset = BytesBeToInt64(pIndex + 12);
+			if(PrevOffset >= IndexOffset)
+			{
+				Ok = false;
+				break;
+			}
+			IndexOffset = PrevOffset;
+		}
+		if(Ok && !m_vBlocks.empty())
+		{
+			std::sort(m_vBlocks.begin(), m_vBlocks.end(), [](const CBlock &a, const CBlock &b) { return a.m_Offset < b.m_Offset; });
+			return true;
+		}
+		m_vBlocks.clear();
+	}
+	return ScanBlocks();
+}
+
+bool CTeeHistorianReader::ScanBlocks()
+{
+	int64_t Offset = sizeof(TEEHISTORIAN_COMPRESSED_UUID);
+	while(Offset <= m_Size - FRAME_HEADER_SIZE)
+	{
+		const unsigned char *pFrame = m_pData + Offset;
+		const unsigned Type = bytes_be_to_uint(pFrame);
+		const unsigned Size = bytes_be_to_uint(pFrame + 8);
+		if((Type != FRAME_BLOCK && Type != FRAME_INDEX) || Size > m_Size - Offset - FRAME_HEADER_SIZE)
+		{
+			// cut off, the server probably crashed while writing
+			break;
+		}
+		if(Type == FRAME_BLOCK)
+		{
+			m_vBlocks.push_back({(int)bytes_be_to_uint(pFrame + 4), Offset});
+		}
+		Offset += FRAME_HEADER_SIZE + Size;
+	}
+	return !m_vBlocks.empty();
+}
+
+bool CTeeHistorianReader::LoadBlock(int Block)
+{
+	const int64_t Offset = m_vBlocks[Block].m_Offset;
+	if(Offset < (int64_t)sizeof(TEEHISTORIAN_COMPRESSED_UUID) || Offset > m_Size - FRAME_HEADER_SIZE)
+		return false;
+	const unsigned char *pFrame = m_pData + Offset;
+	const unsigned CompressedSize = bytes_be_to_uint(pFrame + 8);
+	const unsigned RawSize = bytes_be_to_uint(pFrame + 12);
+	const unsigned StateSize = bytes_be_to_uint(pFrame + 16);
+	if(bytes_be_to_uint(pFrame) != FRAME_BLOCK || CompressedSize > m_Size - Offset - FRAME_HEADER_SIZE || RawSize == 0 || RawSize > MAX_BLOCK_SIZE || StateSize > RawSize)
+		return false;
+
+	m_vBlockData.resize(RawSize);
+	uLongf DecompressedSize = RawSize;
+	if(uncompress(m_vBlockData.data(), &DecompressedSize, pFrame + FRAME_HEADER_SIZE, CompressedSize) != Z_OK || DecompressedSize != RawSize)
+		return false;
+	if(StateSize > 0 && !ReadState(m_vBlockData.data(), StateSize))
+		return false;
+
+	const unsigned char *pData = m_vBlockData.data() + StateSize;
+	const unsigned char *pEnd = m_vBlockData.data() + RawSize;
+	if(Block == 0)
+	{
+		// the first block starts with the uncompressed file
+		if(pEnd - pData < (int)sizeof(TEEHISTORIAN_UUID) || mem_comp(pData, &TEEHISTORIAN_UUID, sizeof(TEEHISTORIAN_UUID)) != 0)
+			return false;
+		pData += sizeof(TEEHISTORIAN_UUID);
+		if(!mem_has_null(pData, pEnd - pData))
+			return false;
+		const int HeaderSize = str_length((const char *)pData) + 1;
+		m_vHeader.assign(pData, pData + HeaderSize);
+		m_pHeader = m_vHeader.data();
+		pData += HeaderSize;
+	}
+	m_Unpacker.Reset(pData, pEnd - pData);
+	m_NextBlock = Block + 1;
+	return true;
+}
+
+bool CTeeHistorianReader::ReadState(const unsigned char *pState, int Size)
+{
+	CUnpacker State;
+	State.Reset(pState, Size);
+	const int Tick = State.GetInt();
+	const int LastPlayerID = State.GetInt();
+	for(auto &Player : m_aPlayers)
+	{
+		Player.m_Alive = false;
+		mem_zero(&Player.m_Input, sizeof(Player.m_Input));
+	}
+	while(!State.Error() && State.RemainingSize() > 0)
+	{
+		const int ClientID = State.GetInt();
+		if(ClientID < 0 || ClientID >= MAX_CLIENTS)
+			return false;
+		CPlayer &Player = m_aPlayers[ClientID];
+		Player.m_Alive = State.GetInt() != 0;
+		if(Player.m_Alive)
+		{
+			Player.m_X = State.GetInt();
+			Player.m_Y = State.GetInt();
+		}
+		if(State.GetInt())
+		{
+			for(int i = 0; i < (int)(sizeof(Player.m_Input) / sizeof(int)); i++)
+			{
+				((int *)&Player.m_Input)[i] = State.GetInt();
+			}
+		}
+	}
+	if(State.Error() || Tick < 0 || LastPlayerID < -1 || LastPlayerID > MAX_CLIENTS)
+		return false;
+	m_Tick = Tick;
+	m_LastPlayerID = LastPlayerID;
+	return true;
+}
+
+void CTeeHistorianReader::AddPending(const CItem &Item, bool Front)
+{
+	dbg_assert(m_NumPending < MAX_PENDING, "too many pending teehistorian items");
+	if(Front)
+	{
+		for(int i = m_NumPending; i > 0; i--)
+			m_aPending[i] = m_aPending[i - 1];
+		m_aPending[0] = Item;
+	}
+	else
+	{
+		m_aPending[m_NumPending] = Item;
+	}
+	m_NumPending++;
+}
+
+bool CTeeHistorianReader::Seek(int Tick)
+{
+	if(!m_pHeader)
+		return false;
+
+	// blocks start between two ticks, so the tick is in the last block
+	// that starts before it
+	int Block = 0;
+	if(Compressed())
+	{
+		auto It = std::lower_bound(m_vBlocks.begin(), m_vBlocks.end(), Tick, [](const CBlock &Other, int OtherTick) { return Other.m_Tick < OtherTick; });
+		Block = maximum((int)(It - m_vBlocks.begin()) - 1, 0);
+	}
+	if(!Restart(Block))
+	{
+		m_Error = true;
+		return false;
+	}
+
+	CItem Item;
+	while(Read(&Item))
+	{
+		if(Item.m_Tick >= Tick)
+		{
+			AddPending(Item, true);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool CTeeHistorianReader::ReadPlayer(int ClientID, CItem *pItem)
+{
+	if(ClientID < 0 || ClientID >= MAX_CLIENTS)
+	{
+		m_Error = true;
+		return false;
+	}
+	if(ClientID <= m_LastPlayerID)
+	{
+		// player data with a lower id than the last one starts the next tick
+		m_Tick++;
+		m_LastPlayerID = ClientID;
+		pItem->m_Tick = m_Tick;
+		AddPending(*pItem, false);
+		pItem->m_Type = ITEM_TICK;
+		pItem->m_ClientID = -1;
+		pItem->m_Tick = m_Tick;
+		return true;
+	}
+	m_LastPlayerID = ClientID;
+	return true;
+}
+
+bool CTeeHistorianReader::ReadEx(CItem *pItem)
+{
+	const unsigned char *pUuid = m_Unpacker.GetRaw(sizeof(CUuid));
+	const int Size = m_Unpacker.GetInt();
+	const unsigned char *pData = m_Unpacker.GetRaw(Size);
+	if(m_Unpacker.Error() || Size < 0)
+		return false;
+
+	mem_copy(&pItem->m_Uuid, pUuid, sizeof(pItem->m_Uuid));
+	pItem->m_pData = pData;
+	pItem->m_DataSize = Size;
+
+	CUnpacker Ex;
+	Ex.Reset(pData, Size);
+	if(pItem->m_Uuid == UUID_TEEHISTORIAN_JOINVER6 || pItem->m_Uuid == UUID_TEEHISTORIAN_JOINVER7)
+	{
+		// only remembered for the join that follows
+		m_JoinProtocol = pItem->m_Uuid == UUID_TEEHISTORIAN_JOINVER6 ? CTeeHistorian::PROTOCOL_6 : CTeeHistorian::PROTOCOL_7;
+		pItem->m_Type = ITEM_EX;
+	}
+	else if(pItem->m_Uuid == UUID_TEEHISTORIAN_PLAYER_READY)
+	{
+		pItem->m_Type = ITEM_PLAYER_READY;
+		pItem->m_ClientID = Ex.GetInt();
+	}
+	else if(pItem->m_Uuid == UUID_TEEHISTORIAN_DDNETVER_OLD)
+	{
+		pItem->m_Type = ITEM_DDNET_VERSION;
+		pItem->m_ClientID = Ex.GetInt();
+		pItem->m_DDNetVersion = Ex.GetInt();
+		pItem->m_pString = nullptr;
+	}
+	else if(pItem->m_Uuid == UUID_TEEHISTORIAN_DDNETVER)
+	{
+		pItem->m_Type = ITEM_DDNET_VERSION;
+		pItem->m_ClientID = Ex.GetInt();
+		Ex.GetRaw(sizeof(CUuid));
+		pItem->m_DDNetVersion = Ex.GetInt();
+		pItem->m_pString = Ex.GetString(0);
+	}
+	else
+	{
+		pItem->m_Type = ITEM_EX;
+	}
+	if(Ex.Error() || (pItem->m_Type != ITEM_EX && (pItem->m_ClientID < 0 || pItem->m_ClientID >= MAX_CLIENTS)))
+		return false;
+	return true;
+}
+
+bool CTeeHistorianReader::Read(CItem *pItem)
+{
+	if(m_NumPending > 0)
+	{
+		*pItem = m_aPending[0];
+		m_NumPending--;
+		for(int i = 0; i < m_NumPending; i++)
+			m_aPending[i] = m_aPending[i + 1];
+		return true;
+	}
+	if(m_Error || m_Finished || !m_pHeader)
+		return false;
+	while(m_Unpacker.RemainingSize() <= 0)
+	{
+		if(m_NextBlock >= (int)m_vBlocks.size())
+		{
+			// not finished, the server probably crashed
+			m_Finished = true;
+			return false;
+		}
+		if(!LoadBlock(m_NextBlock))
+		{
+			m_Error = true;
+			return false;
+		}
+	}
+
+	pItem->m_Tick = m_Tick;
+	pItem->m_ClientID = -1;
+	pItem->m_pString = nullptr;
+	pItem->m_pData = nullptr;
+	pItem->m_DataSize = 0;
+
+	bool Ok = true;
+	const int Type = m_Unpacker.GetInt();
+	if(Type >= 0)
+	{
+		// PLAYER_DIFF
+		const int ClientID = Type;
+		const int dx = m_Unpacker.GetInt();
+		const int dy = m_Unpacker.GetInt();
+		pItem->m_Type = ITEM_PLAYER;
+		pItem->m_ClientID = ClientID;
+		if(m_Unpacker.Error() || ClientID >= MAX_CLIENTS || !m_aPlayers[ClientID].m_Alive)
+		{
+			m_Error = true;
+			return false;
+		}
+		m_aPlayers[ClientID].m_X += dx;
+		m_aPlayers[ClientID].m_Y += dy;
+		pItem->m_X = m_aPlayers[ClientID].m_X;
+		pItem->m_Y = m_aPlayers[ClientID].m_Y;
+		return ReadPlayer(ClientID, pItem);
+	}
+
+	switch(-Type)
+	{
+	case TEEHISTORIAN_FINISH:
+		pItem->m_Type = ITEM_FINISH;
+		m_Finished = true;
+		break;
+	case TEEHISTORIAN_TICK_SKIP:
+	{
+		const int Dt = m_Unpacker.GetInt();
+		Ok = Dt >= 0;
+		m_Tick += Dt + 1;
+		m_LastPlayerID = -1;
+		pItem->m_Type = ITEM_TICK;
+		pItem->m_Tick = m_Tick;
+		break;
+	}
+	case TEEHISTORIAN_PLAYER_NEW:
+	case TEEHISTORIAN_PLAYER_OLD:
+	{
+		const int ClientID = m_Unpacker.GetInt();
+		if(m_Unpacker.Error() || ClientID < 0 || ClientID >= MAX_CLIENTS)
+		{
+			Ok = false;
+			break;
+		}
+		pItem->m_ClientID = ClientID;
+		if(-Type == TEEHISTORIAN_PLAYER_NEW)
+		{
+			pItem->m_Type = ITEM_PLAYER;
+			m_aPlayers[ClientID].m_Alive = true;
+			m_aPlayers[ClientID].m_X = pItem->m_X = m_Unpacker.GetInt();
+			m_aPlayers[ClientID].m_Y = pItem->m_Y = m_Unpacker.GetInt();
+		}
+		else
+		{
+			pItem->m_Type = ITEM_PLAYER_DEAD;
+			m_aPlayers[ClientID].m_Alive = false;
+		}
+		Ok = ReadPlayer(ClientID, pItem);
+		break;
+	}
+	case TEEHISTORIAN_INPUT_DIFF:
+	case TEEHISTORIAN_INPUT_NEW:
+	{
+		const int ClientID = m_Unpacker.GetInt();
+		if(m_Unpacker.Error() || ClientID < 0 || ClientID >= MAX_CLIENTS)
+		{
+			Ok = false;
+			break;
+		}
+		int *pInput = (int *)&m_aPlayers[ClientID].m_Input;
+		for(int i = 0; i < (int)(sizeof(CNetObj_PlayerInput) / sizeof(int)); i++)
+		{
+			const int Value = m_Unpacker.GetInt();
+			pInput[i] = -Type == TEEHISTORIAN_INPUT_DIFF ? pInput[i] + Value : Value;
+		}
+		pItem->m_Type = ITEM_INPUT;
+		pItem->m_ClientID = ClientID;
+		pItem->m_Input = m_aPlayers[ClientID].m_Input;
+		break;
+	}
+	case TEEHISTORIAN_MESSAGE:
+	{
+		pItem->m_Type = ITEM_MESSAGE;
+		pItem->m_ClientID = m_Unpacker.GetInt();
+		pItem->m_DataSize = m_Unpacker.GetInt();
+		pItem->m_pData = m_Unpacker.GetRaw(pItem->m_DataSize);
+		Ok = pItem->m_ClientID >= 0 && pItem->m_DataSize >= 0;
+		break;
+	}
+	case TEEHISTORIAN_JOIN:
+		pItem->m_Type = ITEM_JOIN;
+		pItem->m_ClientID = m_Unpacker.GetInt();
+		pItem->m_Protocol = m_JoinProtocol;
+		m_JoinProtocol = CTeeHistorian::PROTOCOL_6;
+		Ok = pItem->m_ClientID >= 0;
+		break;
+	case TEEHISTORIAN_DROP:
+		pItem->m_Type = ITEM_DROP;
+		pItem->m_ClientID = m_Unpacker.GetInt();
+		pItem->m_pString = m_Unpacker.GetString(0);
+		Ok = pItem->m_ClientID >= 0;
+		break;
+	case TEEHISTORIAN_CONSOLE_COMMAND:
+	{
+		pItem->m_Type = ITEM_CONSOLE_COMMAND;
+		pItem->m_ClientID = m_Unpacker.GetInt();
+		pItem->m_FlagMask = m_Unpacker.GetInt();
+		pItem->m_pString = m_Unpacker.GetString(0);
+		const int NumArgs = m_Unpacker.GetInt();
+		pItem->m_NumArgs = 0;
+		for(int i = 0; i < NumArgs && !m_Unpacker.Error(); i++)
+		{
+			const char *pArg = m_Unpacker.GetString(0);
+			if(i < MAX_ARGS)
+				pItem->m_apArgs[pItem->m_NumArgs++] = pArg;
+		}
+		// rcon commands are recorded with the player, the others with -1
+		Ok = NumArgs >= 0 && pItem->m_ClientID >= -1 && pItem->m_ClientID < MAX_CLIENTS;
+		break;
+	}
+	case TEEHISTORIAN_EX:
+		Ok = ReadEx(pItem);
+		break;
+	default:
+		Ok = false;
+	}
+
+	if(!Ok || m_Unpacker.Error() || (pItem->m_Type != ITEM_CONSOLE_COMMAND && pItem->m_ClientID >= MAX_CLIENTS))
+	{
+		m_Error = true;
+		return false;
+	}
+	return true;
+}
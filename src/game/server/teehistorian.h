@@ -3,11 +3,17 @@
 
 #include <base/hash.h>
 #include <engine/console.h>
+#include <engine/shared/packer.h>
 #include <engine/shared/protocol.h>
 #include <game/generated/protocol.h>
 
 #include <time.h>
 
+#include <deque>
+#include <vector>
+
+#include <zlib.h>
+
 class CConfig;
 class CTuningParams;
 class CUuidManager;
@@ -84,6 +90,10 @@ public:
 	void RecordAuthLogin(int ClientID, int Level, const char *pAuthName);
 	void RecordAuthLogout(int ClientID);
 
+	// what a reader needs to continue reading at the next tick, see
+	// <CTeeHistorianCompressor>. Only valid between two ticks.
+	void PackState(std::vector<unsigned char> &vState) const;
+
 	int m_Debug; // Possible values: 0, 1, 2.
 
 private:
@@ -138,4 +148,213 @@ private:
 	CTeam m_aPrevTeams[MAX_CLIENTS];
 };
 
+/*
+	Class: Teehistorian Compressor
+		Writes teehistorian data as zlib compressed blocks that start
+		between two ticks, with the state of the writer at the start of
+		each block and an index of the blocks every few blocks and at the
+		end, so readers can seek to a tick without decompressing the
+		blocks before it.
+
+		The compression runs on the writing thread of the ASYNCIO the data
+		is queued to, the game thread only queues the raw data and the
+		starts of the blocks.
+*/
+class CTeeHistorianCompressor
+{
+public:
+	enum
+	{
+		// ticks between the starts of two blocks, 10 seconds
+		BLOCK_TICKS = 500,
+		// number of blocks between two indices
+		INDEX_BLOCKS = 32,
+	};
+
+	CTeeHistorianCompressor();
+	~CTeeHistorianCompressor();
+
+	// Called on the game thread between two ticks after Offset bytes of
+	// teehistorian data were queued. Tick is the last tick before the
+	// block and vState from <CTeeHistorian::PackState>.
+	void BeginBlock(int64_t Offset, int Tick, std::vector<unsigned char> &&vState) REQUIRES(!m_Lock);
+
+	// the ASYNCIO_WRITE_CALLBACK, pUser is the compressor
+	static int Write(IOHANDLE File, const void *pData, unsigned Size, void *pUser);
+
+private:
+	struct CBlockStart
+	{
+		int64_t m_Offset;
+		int m_Tick;
+		std::vector<unsigned char> m_vState;
+	};
+
+	struct CIndexEntry
+	{
+		int m_Tick;
+		int64_t m_Offset;
+	};
+
+	int WriteData(IOHANDLE File, const unsigned char *pData, unsigned Size) REQUIRES(!m_Lock);
+	int Finish(IOHANDLE File);
+	int StartBlock(int Tick, const std::vector<unsigned char> &vState);
+	int FinishBlock(IOHANDLE File);
+	int WriteIndex(IOHANDLE File);
+	int Compress(const void *pData, unsigned Size, int Flush);
+	int WriteFile(IOHANDLE File, const void *pData, unsigned Size);
+
+	LOCK m_Lock;
+	std::deque<CBlockStart> m_BlockStarts GUARDED_BY(m_Lock);
+
+	// only used on the writing thread
+	z_stream m_Stream;
+	bool m_StreamInitialized;
+	bool m_InBlock;
+	int m_BlockTick;
+	unsigned m_BlockRawSize;
+	unsigned m_BlockStateSize;
+	std::vector<unsigned char> m_vCompressed;
+	int64_t m_Read;
+	int64_t m_FileOffset;
+	int64_t m_LastIndexOffset;
+	std::vector<CIndexEntry> m_vIndex;
+};
+
+/*
+	Class: Teehistorian Reader
+		Reads back the items written by <CTeeHistorian>. Ticks that are
+		implicit in the file are returned as ITEM_TICK items too, and
+		inputs are returned whole instead of as difference to the last one.
+
+		Files written through <CTeeHistorianCompressor> are read the same
+		way, their blocks are decompressed one at a time.
+*/
+class CTeeHistorianReader
+{
+public:
+	enum
+	{
+		ITEM_TICK,
+		ITEM_PLAYER,
+		ITEM_PLAYER_DEAD,
+		ITEM_INPUT,
+		ITEM_MESSAGE,
+		ITEM_JOIN,
+		ITEM_DROP,
+		ITEM_CONSOLE_COMMAND,
+		ITEM_PLAYER_READY,
+		ITEM_DDNET_VERSION,
+		// other extra items, the join versions are in ITEM_JOIN
+		ITEM_EX,
+		ITEM_FINISH,
+
+		MAX_ARGS = 16,
+	};
+
+	struct CItem
+	{
+		int m_Type;
+		int m_Tick;
+		int m_ClientID;
+
+		// ITEM_PLAYER
+		int m_X;
+		int m_Y;
+
+		// ITEM_INPUT
+		CNetObj_PlayerInput m_Input;
+
+		// ITEM_JOIN, CTeeHistorian::PROTOCOL_*
+		int m_Protocol;
+
+		// ITEM_DDNET_VERSION
+		int m_DDNetVersion;
+
+		// ITEM_MESSAGE and ITEM_EX
+		CUuid m_Uuid;
+		const void *m_pData;
+		int m_DataSize;
+
+		// the reason of ITEM_DROP, the command of ITEM_CONSOLE_COMMAND, the
+		// version string of ITEM_DDNET_VERSION or nullptr for old versions
+		const char *m_pString;
+
+		// ITEM_CONSOLE_COMMAND
+		int m_FlagMask;
+		int m_NumArgs;
+		const char *m_apArgs[MAX_ARGS];
+	};
+
+	CTeeHistorianReader();
+
+	// pData has to stay valid while reading. Returns false if it isn't a
+	// teehistorian file.
+	bool Open(const void *pData, int64_t Size);
+	// the json header of the file
+	const char *Header() const { return m_pHeader; }
+	bool Compressed() const { return !m_vBlocks.empty(); }
+
+	// Returns false at the end of the file or if it is broken, see Error.
+	// The data of the item stays valid until the next call.
+	bool Read(CItem *pItem);
+	bool Error() const { return m_Error; }
+
+	// Continues reading at the first tick that isn't before Tick. Only
+	// decompresses the block with the tick in compressed files, others
+	// are read from the start. Returns false if the file ends before.
+	bool Seek(int Tick);
+
+private:
+	enum
+	{
+		MAX_PENDING = 2,
+	};
+
+	void ResetState();
+	bool Restart(int Block);
+	bool FindBlocks();
+	bool ScanBlocks();
+	bool LoadBlock(int Block);
+	bool ReadState(const unsigned char *pState, int Size);
+	void AddPending(const CItem &Item, bool Front);
+	bool ReadEx(CItem *pItem);
+	bool ReadPlayer(int ClientID, CItem *pItem);
+
+	const unsigned char *m_pData;
+	int64_t m_Size;
+
+	CUnpacker m_Unpacker;
+	const char *m_pHeader;
+	bool m_Error;
+	bool m_Finished;
+
+	int m_Tick;
+	int m_LastPlayerID;
+	int m_JoinProtocol;
+
+	int m_NumPending;
+	CItem m_aPending[MAX_PENDING];
+
+	// compressed files only
+	struct CBlock
+	{
+		int m_Tick;
+		int64_t m_Offset;
+	};
+	std::vector<CBlock> m_vBlocks;
+	int m_NextBlock;
+	std::vector<unsigned char> m_vBlockData;
+	std::vector<char> m_vHeader;
+
+	struct CPlayer
+	{
+		bool m_Alive;
+		int m_X;
+		int m_Y;
+		CNetObj_PlayerInput m_Input;
+	};
+	CPlayer m_aPlayers[MAX_CLIENTS];
+};
+
 #endif // GAME_SERVER_TEEHISTORIAN_H
@@ -0,0 +1,202 @@
+#ifndef GAME_SPATIAL_HASH_H
+#define GAME_SPATIAL_HASH_H
+
+#include <base/math.h>
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+	Class: Spatial Hash
+		A uniform grid of entities for broadphase queries. Cells are hashed
+		into a fixed number of buckets, so the size doesn't depend on the
+		map. Each entity embeds a CNode that links it into the bucket of
+		its cell.
+
+		Queries return the entities in the order of the game world's
+		entity list. For that every entity gets an order when it's
+		inserted, higher at the front of the list and lower at the back.
+*/
+template<typename TEntity>
+class CSpatialHash
+{
+public:
+	enum
+	{
+		CELL_SIZE = 128,
+		NUM_BUCKETS = 1024,
+		// larger queries are cheaper as a walk over the entity list
+		MAX_QUERY_CELLS = 64,
+	};
+
+	class CNode
+	{
+		friend class CSpatialHash;
+
+	public:
+		CNode() = default;
+		// a copied entity isn't in any hash yet
+		CNode(const CNode &Other) {}
+		CNode &operator=(const CNode &Other) { return *this; }
+
+	private:
+		TEntity *m_pEntity;
+		CNode *m_pPrev;
+		CNode *m_pNext;
+		int m_Bucket = -1;
+		int m_CellX;
+		int m_CellY;
+		int64_t m_Order;
+	};
+
+private:
+	CNode *m_apBuckets[NUM_BUCKETS];
+	int64_t m_FrontOrder;
+	int64_t m_BackOrder;
+	float m_MaxRadius;
+	std::vector<std::pair<int64_t, TEntity *>> m_vFound;
+
+	static int Cell(float Coord)
+	{
+		// keep far away positions from overflowing
+		return (int)std::floor(clamp(Coord, -1e7f, 1e7f) / CELL_SIZE);
+	}
+
+	static int Bucket(int CellX, int CellY)
+	{
+		return ((unsigned)CellX * 0x9E3779B1u ^ (unsigned)CellY * 0x85EBCA77u) % NUM_BUCKETS;
+	}
+
+	void Link(CNode *pNode, vec2 Pos)
+	{
+		pNode->m_CellX = Cell(Pos.x);
+		pNode->m_CellY = Cell(Pos.y);
+		pNode->m_Bucket = Bucket(pNode->m_CellX, pNode->m_CellY);
+		pNode->m_pPrev = nullptr;
+		pNode->m_pNext = m_apBuckets[pNode->m_Bucket];
+		if(pNode->m_pNext)
+			pNode->m_pNext->m_pPrev = pNode;
+		m_apBuckets[pNode->m_Bucket] = pNode;
+	}
+
+	void Unlink(CNode *pNode)
+	{
+		if(pNode->m_pPrev)
+			pNode->m_pPrev->m_pNext = pNode->m_pNext;
+		else
+			m_apBuckets[pNode->m_Bucket] = pNode->m_pNext;
+		if(pNode->m_pNext)
+			pNode->m_pNext->m_pPrev = pNode->m_pPrev;
+		pNode->m_Bucket = -1;
+	}
+
+public:
+	CSpatialHash() { Clear(); }
+
+	void Clear()
+	{
+		for(auto &pBucket : m_apBuckets)
+			pBucket = nullptr;
+		m_FrontOrder = 0;
+		m_BackOrder = 0;
+		m_MaxRadius = 0.0f;
+	}
+
+	/*
+		Function: Insert
+			Adds an entity, the node's previous contents are ignored.
+
+		Arguments:
+			pNode - The node embedded in the entity.
+			pEntity - The entity.
+			Pos - Position of the entity.
+			Radius - How far the entity reaches beyond its position.
+			Back - Whether the entity was added to the back of the
+				entity list instead of the front.
+	*/
+	void Insert(CNode *pNode, TEntity *pEntity, vec2 Pos, float Radius, bool Back = false)
+	{
+		pNode->m_pEntity = pEntity;
+		pNode->m_Order = Back ? --m_BackOrder : ++m_FrontOrder;
+		m_MaxRadius = maximum(m_MaxRadius, Radius);
+		Link(pNode, Pos);
+	}
+
+	void Remove(CNode *pNode)
+	{
+		if(pNode->m_Bucket != -1)
+			Unlink(pNode);
+	}
+
+	/*
+		Function: Move
+			Moves an entity that's in the hash to its new position.
+	*/
+	void Move(CNode *pNode, vec2 Pos)
+	{
+		if(pNode->m_Bucket == -1 || (pNode->m_CellX == Cell(Pos.x) && pNode->m_CellY == Cell(Pos.y)))
+			return;
+		Unlink(pNode);
+		Link(pNode, Pos);
+	}
+
+	/*
+		Function: Query
+			Finds the entities whose cell is close enough to the box that
+			they might touch it.
+
+		Arguments:
+			Min - Top left corner of the box.
+			Max - Bottom right corner of the box.
+			Result - Filled with the entities, in the order of the
+				entity list. Any container with clear and push_back.
+
+		Returns:
+			False if the box spans too many cells, the caller has to walk
+			the entity list instead.
+	*/
+	template<typename TResult>
+	bool Query(vec2 Min, vec2 Max, TResult &Result)
+	{
+		Min -= vec2(m_MaxRadius, m_MaxRadius);
+		Max += vec2(m_MaxRadius, m_MaxRadius);
+		// also catches NaNs
+		const float Limit = (float)CELL_SIZE * MAX_QUERY_CELLS;
+		if(!(Max.x - Min.x <= Limit && Max.y - Min.y <= Limit))
+			return false;
+
+		const int MinX = Cell(Min.x);
+		const int MinY = Cell(Min.y);
+		const int MaxX = Cell(Max.x);
+		const int MaxY = Cell(Max.y);
+		if((MaxX - MinX + 1) * (MaxY - MinY + 1) > MAX_QUERY_CELLS)
+			return false;
+
+		m_vFound.clear();
+		for(int y = MinY; y <= MaxY; y++)
+		{
+			for(int x = MinX; x <= MaxX; x++)
+			{
+				// buckets are shared with other cells
+				for(CNode *pNode = m_apBuckets[Bucket(x, y)]; pNode; pNode = pNode->m_pNext)
+				{
+					if(pNode->m_CellX == x && pNode->m_CellY == y)
+						m_vFound.emplace_back(pNode->m_Order, pNode->m_pEntity);
+				}
+			}
+		}
+		std::sort(m_vFound.begin(), m_vFound.end(), [](const std::pair<int64_t, TEntity *> &a, const std::pair<int64_t, TEntity *> &b) { return a.first > b.first; });
+
+		Result.clear();
+		for(const auto &Found : m_vFound)
+			Result.push_back(Found.second);
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,431 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/shared/config.h>
+#include <game/collision.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// A map with a game, front and tele layer that only lives in memory
+class CTestMap : public IMap
+{
+	enum
+	{
+		DATA_GAME = 0,
+		DATA_FRONT,
+		DATA_TELE,
+		DATA_EMPTY,
+	};
+
+	CMapItemGroup m_Group;
+	CMapItemLayerTilemap m_aLayers[3];
+	std::vector<CTile> m_vGame;
+	std::vector<CTile> m_vFront;
+	std::vector<CTeleTile> m_vTele;
+	std::vector<CTile> m_vEmpty;
+
+public:
+	CTestMap(int Width, int Height, unsigned Seed)
+	{
+		mem_zero(&m_Group, sizeof(m_Group));
+		m_Group.m_Version = CMapItemGroup::CURRENT_VERSION;
+		m_Group.m_NumLayers = 3;
+
+		const int aFlags[] = {TILESLAYERFLAG_GAME, TILESLAYERFLAG_FRONT, TILESLAYERFLAG_TELE};
+		for(int i = 0; i < 3; i++)
+		{
+			CMapItemLayerTilemap &Layer = m_aLayers[i];
+			mem_zero(&Layer, sizeof(Layer));
+			Layer.m_Layer.m_Type = LAYERTYPE_TILES;
+			Layer.m_Version = 3;
+			Layer.m_Width = Width;
+			Layer.m_Height = Height;
+			Layer.m_Flags = aFlags[i];
+			Layer.m_Data = DATA_EMPTY;
+		}
+		m_aLayers[0].m_Data = DATA_GAME;
+		m_aLayers[1].m_Front = DATA_FRONT;
+		m_aLayers[2].m_Tele = DATA_TELE;
+
+		// mostly air with walls of every kind the line queries care about
+		std::mt19937 Rng(Seed);
+		const int aGameTiles[] = {TILE_SOLID, TILE_NOHOOK, TILE_NOLASER, TILE_THROUGH, TILE_THROUGH_ALL, TILE_THROUGH_DIR, TILE_FREEZE, TILE_STOP};
+		const int aFrontTiles[] = {TILE_NOLASER, TILE_THROUGH, TILE_THROUGH_ALL, TILE_THROUGH_CUT, TILE_THROUGH_DIR, TILE_FREEZE};
+		const int aTeleTiles[] = {TILE_TELEIN, TILE_TELEINWEAPON, TILE_TELEINHOOK};
+		m_vGame.resize(Width * Height);
+		m_vFront.resize(Width * Height);
+		m_vTele.resize(Width * Height);
+		m_vEmpty.resize(Width * Height);
+		for(int i = 0; i < Width * Height; i++)
+		{
+			mem_zero(&m_vGame[i], sizeof(CTile));
+			mem_zero(&m_vFront[i], sizeof(CTile));
+			mem_zero(&m_vTele[i], sizeof(CTeleTile));
+			mem_zero(&m_vEmpty[i], sizeof(CTile));
+			if(Rng() % 8 == 0)
+			{
+				m_vGame[i].m_Index = aGameTiles[Rng() % std::size(aGameTiles)];
+				m_vGame[i].m_Flags = Rng() % 4 * TILEFLAG_ROTATE;
+			}
+			if(Rng() % 24 == 0)
+			{
+				m_vFront[i].m_Index = aFrontTiles[Rng() % std::size(aFrontTiles)];
+				m_vFront[i].m_Flags = Rng() % 4 * TILEFLAG_ROTATE;
+			}
+			if(Rng() % 48 == 0)
+			{
+				m_vTele[i].m_Type = aTeleTiles[Rng() % std::size(aTeleTiles)];
+				m_vTele[i].m_Number = 1 + Rng() % 8;
+			}
+		}
+	}
+
+	void *GetData(int Index) override
+	{
+		switch(Index)
+		{
+		case DATA_GAME: return m_vGame.data();
+		case DATA_FRONT: return m_vFront.data();
+		case DATA_TELE: return m_vTele.data();
+		default: return m_vEmpty.data();
+		}
+	}
+	int GetDataSize(int Index) override
+	{
+		return Index == DATA_TELE ? m_vTele.size() * sizeof(CTeleTile) : m_vGame.size() * sizeof(CTile);
+	}
+	void *GetDataSwapped(int Index) override { return GetData(Index); }
+	void UnloadData(int Index) override {}
+	void LoadData(const int *pIndices, int NumIndices) override {}
+	void *GetItem(int Index, int *pType, int *pID) override
+	{
+		if(Index == 0)
+			return &m_Group;
+		return &m_aLayers[Index - 1];
+	}
+	int GetItemSize(int Index) override { return Index == 0 ? sizeof(m_Group) : sizeof(CMapItemLayerTilemap); }
+	void GetType(int Type, int *pStart, int *pNum) override
+	{
+		*pStart = Type == MAPITEMTYPE_LAYER ? 1 : 0;
+		*pNum = Type == MAPITEMTYPE_GROUP ? 1 : Type == MAPITEMTYPE_LAYER ? 3 : 0;
+	}
+	void *FindItem(int Type, int ID) override { return nullptr; }
+	int NumItems() override { return 4; }
+};
+
+// The line queries as they were before they learned to skip whole tiles,
+// everything they return has to stay bit-identical.
+static int RefIntersectLine(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+		if(Collision.CheckPoint(ix, iy))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return Collision.GetCollisionAt(ix, iy);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int RefIntersectLineTeleHook(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	int dx = 0, dy = 0;
+	ThroughOffset(Pos0, Pos1, &dx, &dy);
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+
+		int Index = Collision.GetPureMapIndex(Pos);
+		if(g_Config.m_SvOldTeleportHook)
+			*pTeleNr = Collision.IsTeleport(Index);
+		else
+			*pTeleNr = Collision.IsTeleportHook(Index);
+		if(*pTeleNr)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return TILE_TELEINHOOK;
+		}
+
+		int Hit = 0;
+		if(Collision.CheckPoint(ix, iy))
+		{
+			if(!Collision.IsThrough(ix, iy, dx, dy, Pos0, Pos1))
+				Hit = Collision.GetCollisionAt(ix, iy);
+		}
+		else if(Collision.IsHookBlocker(ix, iy, Pos0, Pos1))
+			Hit = TILE_NOHOOK;
+		if(Hit)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return Hit;
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int RefIntersectLineTeleWeapon(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+
+		int Index = Collision.GetPureMapIndex(Pos);
+		if(g_Config.m_SvOldTeleportWeapons)
+			*pTeleNr = Collision.IsTeleport(Index);
+		else
+			*pTeleNr = Collision.IsTeleportWeapon(Index);
+		if(*pTeleNr)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return TILE_TELEINWEAPON;
+		}
+
+		if(Collision.CheckPoint(ix, iy))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return Collision.GetCollisionAt(ix, iy);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int RefIntersectNoLaser(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float d = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+	for(int i = 0, id = (int)ceilf(d); i < id; i++)
+	{
+		float a = (int)i / d;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int Nx = clamp(round_to_int(Pos.x) / 32, 0, Collision.GetWidth() - 1);
+		int Ny = clamp(round_to_int(Pos.y) / 32, 0, Collision.GetHeight() - 1);
+		if(Collision.GetIndex(Nx, Ny) == TILE_SOLID || Collision.GetIndex(Nx, Ny) == TILE_NOHOOK || Collision.GetIndex(Nx, Ny) == TILE_NOLASER || Collision.GetFIndex(Nx, Ny) == TILE_NOLASER)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			if(Collision.GetFIndex(Nx, Ny) == TILE_NOLASER)
+				return Collision.GetFCollisionAt(Pos.x, Pos.y);
+			else
+				return Collision.GetCollisionAt(Pos.x, Pos.y);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static std::vector<int> RefGetMapIndices(const CCollision &Collision, vec2 PrevPos, vec2 Pos)
+{
+	std::vector<int> vIndices;
+	float d = distance(PrevPos, Pos);
+	int End(d + 1);
+	int LastIndex = 0;
+	for(int i = 0; i < End; i++)
+	{
+		float a = i / d;
+		vec2 Tmp = mix(PrevPos, Pos, a);
+		int Nx = clamp((int)Tmp.x / 32, 0, Collision.GetWidth() - 1);
+		int Ny = clamp((int)Tmp.y / 32, 0, Collision.GetHeight() - 1);
+		int Index = Ny * Collision.GetWidth() + Nx;
+		if(Collision.TileExists(Index) && LastIndex != Index)
+		{
+			vIndices.push_back(Index);
+			LastIndex = Index;
+		}
+	}
+	return vIndices;
+}
+
+class Collision : public ::testing::Test
+{
+protected:
+	enum
+	{
+		WIDTH = 60,
+		HEIGHT = 40,
+	};
+
+	CTestMap m_Map;
+	std::unique_ptr<IKernel> m_pKernel;
+	CLayers m_Layers;
+	CCollision m_Collision;
+	std::mt19937 m_Rng;
+
+	Collision() :
+		m_Map(WIDTH, HEIGHT, 1), m_pKernel(IKernel::Create()), m_Rng(2)
+	{
+		m_pKernel->RegisterInterface(static_cast<IMap *>(&m_Map), false);
+		m_Layers.Init(m_pKernel.get());
+		m_Collision.Init(&m_Layers);
+	}
+
+	float RandomCoord(int Size)
+	{
+		switch(m_Rng() % 4)
+		{
+		// right on a tile border, where rounding decides the tile
+		case 0: return (int)(m_Rng() % (Size + 2)) * 32 - 32 + ((int)(m_Rng() % 3) - 1) * 0.5f;
+		// sometimes off the map
+		case 1: return std::uniform_real_distribution<float>(-200.0f, Size * 32 + 200.0f)(m_Rng);
+		default: return std::uniform_real_distribution<float>(0.0f, Size * 32)(m_Rng);
+		}
+	}
+
+	// random lines, short ones, axis aligned ones and diagonals
+	void RandomLine(vec2 *pPos0, vec2 *pPos1)
+	{
+		*pPos0 = vec2(RandomCoord(WIDTH), RandomCoord(HEIGHT));
+		switch(m_Rng() % 5)
+		{
+		case 0: *pPos1 = *pPos0 + vec2(RandomCoord(3) - 48, RandomCoord(3) - 48); break;
+		case 1: *pPos1 = vec2(RandomCoord(WIDTH), pPos0->y); break;
+		case 2: *pPos1 = vec2(pPos0->x, RandomCoord(HEIGHT)); break;
+		case 3:
+		{
+			float Length = RandomCoord(20) * (m_Rng() % 2 ? 1 : -1);
+			*pPos1 = *pPos0 + vec2(Length, Length * (m_Rng() % 2 ? 1 : -1));
+			break;
+		}
+		default: *pPos1 = vec2(RandomCoord(WIDTH), RandomCoord(HEIGHT));
+		}
+	}
+};
+
+static std::string LineName(vec2 Pos0, vec2 Pos1)
+{
+	char aBuf[128];
+	str_format(aBuf, sizeof(aBuf), "(%.9g, %.9g) -> (%.9g, %.9g)", Pos0.x, Pos0.y, Pos1.x, Pos1.y);
+	return aBuf;
+}
+
+static void ExpectSame(vec2 Ref, vec2 Pos)
+{
+	EXPECT_EQ(Ref.x, Pos.x);
+	EXPECT_EQ(Ref.y, Pos.y);
+}
+
+TEST_F(Collision, IntersectLine)
+{
+	for(int i = 0; i < 20000; i++)
+	{
+		vec2 Pos0, Pos1, RefColl, RefBefore, Coll, Before;
+		RandomLine(&Pos0, &Pos1);
+		ASSERT_EQ(RefIntersectLine(m_Collision, Pos0, Pos1, &RefColl, &RefBefore), m_Collision.IntersectLine(Pos0, Pos1, &Coll, &Before)) << LineName(Pos0, Pos1);
+		ExpectSame(RefColl, Coll);
+		ExpectSame(RefBefore, Before);
+	}
+}
+
+TEST_F(Collision, IntersectLineTele)
+{
+	for(int Old = 0; Old < 2; Old++)
+	{
+		g_Config.m_SvOldTeleportHook = Old;
+		g_Config.m_SvOldTeleportWeapons = Old;
+		for(int i = 0; i < 20000; i++)
+		{
+			vec2 Pos0, Pos1, RefColl, RefBefore, Coll, Before;
+			int RefTeleNr = -1, TeleNr = -1;
+			RandomLine(&Pos0, &Pos1);
+			ASSERT_EQ(RefIntersectLineTeleHook(m_Collision, Pos0, Pos1, &RefColl, &RefBefore, &RefTeleNr), m_Collision.IntersectLineTeleHook(Pos0, Pos1, &Coll, &Before, &TeleNr)) << LineName(Pos0, Pos1);
+			ExpectSame(RefColl, Coll);
+			ExpectSame(RefBefore, Before);
+			EXPECT_EQ(RefTeleNr, TeleNr);
+
+			ASSERT_EQ(RefIntersectLineTeleWeapon(m_Collision, Pos0, Pos1, &RefColl, &RefBefore, &RefTeleNr), m_Collision.IntersectLineTeleWeapon(Pos0, Pos1, &Coll, &Before, &TeleNr)) << LineName(Pos0, Pos1);
+			ExpectSame(RefColl, Coll);
+			ExpectSame(RefBefore, Before);
+			EXPECT_EQ(RefTeleNr, TeleNr);
+		}
+	}
+	g_Config.m_SvOldTeleportHook = 0;
+	g_Config.m_SvOldTeleportWeapons = 0;
+}
+
+TEST_F(Collision, IntersectNoLaser)
+{
+	for(int i = 0; i < 20000; i++)
+	{
+		vec2 Pos0, Pos1, RefColl, RefBefore, Coll, Before;
+		RandomLine(&Pos0, &Pos1);
+		ASSERT_EQ(RefIntersectNoLaser(m_Collision, Pos0, Pos1, &RefColl, &RefBefore), m_Collision.IntersectNoLaser(Pos0, Pos1, &Coll, &Before)) << LineName(Pos0, Pos1);
+		ExpectSame(RefColl, Coll);
+		ExpectSame(RefBefore, Before);
+	}
+}
+
+TEST_F(Collision, GetMapIndices)
+{
+	for(int i = 0; i < 20000; i++)
+	{
+		vec2 Pos0, Pos1;
+		RandomLine(&Pos0, &Pos1);
+		if(Pos0 == Pos1)
+			continue;
+		std::vector<int> vRef = RefGetMapIndices(m_Collision, Pos0, Pos1);
+		CMapIndices Indices = m_Collision.GetMapIndices(Pos0, Pos1);
+		ASSERT_EQ((int)vRef.size(), Indices.size()) << LineName(Pos0, Pos1);
+		for(int j = 0; j < Indices.size(); j++)
+			EXPECT_EQ(vRef[j], Indices[j]);
+	}
+}
+
+TEST(SmallVector, Spill)
+{
+	CSmallVector<int, 4> Vector;
+	EXPECT_TRUE(Vector.empty());
+	for(int i = 0; i < 10; i++)
+		Vector.push_back(i);
+	ASSERT_EQ(Vector.size(), 10);
+	int Expected = 0;
+	for(int Value : Vector)
+		EXPECT_EQ(Value, Expected++);
+
+	CSmallVector<int, 4> Copy = Vector;
+	Vector.clear();
+	EXPECT_TRUE(Vector.empty());
+	EXPECT_EQ(Copy.size(), 10);
+	EXPECT_EQ(Copy[9], 9);
+}
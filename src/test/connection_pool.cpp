@@ -0,0 +1,104 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/server/databases/connection.h>
+#include <engine/server/databases/connection_pool.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+struct CPoolTestData : ISqlData
+{
+	CPoolTestData(std::shared_ptr<ISqlResult> pResult, int Index) :
+		ISqlData(std::move(pResult)),
+		m_Index(Index)
+	{
+	}
+	int m_Index;
+};
+
+static std::atomic_int s_NumReading{0};
+static std::atomic_int s_MaxReading{0};
+static std::mutex s_WriteLock;
+static std::vector<int> s_vWrites;
+
+static bool SlowRead(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const int NumReading = s_NumReading.fetch_add(1) + 1;
+	int Max = s_MaxReading.load();
+	while(Max < NumReading && !s_MaxReading.compare_exchange_weak(Max, NumReading))
+	{
+	}
+
+	bool Error = pSqlServer->PrepareStatement("SELECT COUNT(*) FROM record_points", pError, ErrorSize);
+	bool End;
+	if(!Error)
+		Error = pSqlServer->Step(&End, pError, ErrorSize);
+	std::this_thread::sleep_for(20ms);
+	s_NumReading.fetch_sub(1);
+	return Error;
+}
+
+static bool Write(IDbConnection *pSqlServer, const ISqlData *pGameData, bool Failure, char *pError, int ErrorSize)
+{
+	const CPoolTestData *pData = dynamic_cast<const CPoolTestData *>(pGameData);
+	char aName[16];
+	str_format(aName, sizeof(aName), "%d", pData->m_Index);
+	if(pSqlServer->PrepareStatement("INSERT INTO record_points(Name, Points) VALUES (?, 1)", pError, ErrorSize))
+		return true;
+	pSqlServer->BindString(1, aName);
+	int NumInserted;
+	if(pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize))
+		return true;
+
+	std::lock_guard<std::mutex> Lock(s_WriteLock);
+	s_vWrites.push_back(pData->m_Index);
+	return false;
+}
+
+TEST(DbConnectionPool, ReadWorkers)
+{
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+	str_format(aFilename, sizeof(aFilename), "%s.sqlite", Info.m_aFilename);
+
+	{
+		CDbConnectionPool Pool;
+		auto pConn = CreateSqliteConnection(aFilename, true);
+		auto pCopy = std::unique_ptr<IDbConnection>(pConn->Copy());
+		Pool.RegisterDatabase(std::move(pConn), CDbConnectionPool::READ);
+		Pool.RegisterDatabase(std::move(pCopy), CDbConnectionPool::WRITE);
+
+		std::vector<std::shared_ptr<ISqlResult>> vpResults;
+		for(int i = 0; i < 32; i++)
+		{
+			vpResults.push_back(std::make_shared<ISqlResult>());
+			if(i % 2 == 0)
+				Pool.Execute(SlowRead, std::make_unique<CPoolTestData>(vpResults.back(), i), "slow read");
+			else
+				Pool.ExecuteWrite(Write, std::make_unique<CPoolTestData>(vpResults.back(), i), "write");
+		}
+		Pool.Start(4);
+		for(auto &pResult : vpResults)
+		{
+			while(!pResult->m_Completed.load())
+				std::this_thread::sleep_for(1ms);
+			EXPECT_TRUE(pResult->m_Success);
+		}
+		Pool.OnShutdown();
+	}
+
+	// reads overlap, writes stay in order
+	EXPECT_GT(s_MaxReading.load(), 1);
+	ASSERT_EQ(s_vWrites.size(), 16u);
+	for(int i = 0; i < 16; i++)
+		EXPECT_EQ(s_vWrites[i], i * 2 + 1);
+
+	fs_remove(aFilename);
+}
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include <engine/console.h>
+#include <engine/shared/config.h>
+
+#include <memory>
+
+static void Nop(IConsole::IResult *pResult, void *pUserData)
+{
+}
+
+TEST(Console, GetCommandInfo)
+{
+	auto pConsole = std::unique_ptr<IConsole>(CreateConsole(CFGFLAG_SERVER));
+	pConsole->Register("test_command", "", CFGFLAG_SERVER, Nop, nullptr, "server");
+	pConsole->Register("test_command", "", CFGFLAG_CLIENT, Nop, nullptr, "client");
+
+	const IConsole::CCommandInfo *pInfo = pConsole->GetCommandInfo("Test_Command", CFGFLAG_SERVER, false);
+	ASSERT_TRUE(pInfo);
+	EXPECT_STREQ(pInfo->m_pName, "test_command");
+	EXPECT_STREQ(pInfo->m_pHelp, "server");
+	pInfo = pConsole->GetCommandInfo("TEST_COMMAND", CFGFLAG_CLIENT, false);
+	ASSERT_TRUE(pInfo);
+	EXPECT_STREQ(pInfo->m_pHelp, "client");
+	EXPECT_FALSE(pConsole->GetCommandInfo("test_command", CFGFLAG_SERVER, true));
+	EXPECT_FALSE(pConsole->GetCommandInfo("test_comman", CFGFLAG_SERVER, false));
+	EXPECT_TRUE(pConsole->GetCommandInfo("echo", CFGFLAG_SERVER, false));
+}
+
+TEST(Console, TempCommands)
+{
+	auto pConsole = std::unique_ptr<IConsole>(CreateConsole(CFGFLAG_CLIENT));
+	pConsole->RegisterTemp("temp_a", "", CFGFLAG_SERVER, "a");
+	pConsole->RegisterTemp("temp_b", "", CFGFLAG_SERVER, "b");
+	ASSERT_TRUE(pConsole->GetCommandInfo("TEMP_A", CFGFLAG_SERVER, true));
+	ASSERT_TRUE(pConsole->GetCommandInfo("temp_b", CFGFLAG_SERVER, true));
+	EXPECT_FALSE(pConsole->GetCommandInfo("temp_a", CFGFLAG_SERVER, false));
+
+	pConsole->DeregisterTemp("temp_a");
+	EXPECT_FALSE(pConsole->GetCommandInfo("temp_a", CFGFLAG_SERVER, true));
+	EXPECT_TRUE(pConsole->GetCommandInfo("temp_b", CFGFLAG_SERVER, true));
+
+	// reuses the removed command
+	pConsole->RegisterTemp("temp_c", "", CFGFLAG_SERVER, "c");
+	EXPECT_FALSE(pConsole->GetCommandInfo("temp_a", CFGFLAG_SERVER, true));
+	const IConsole::CCommandInfo *pInfo = pConsole->GetCommandInfo("temp_c", CFGFLAG_SERVER, true);
+	ASSERT_TRUE(pInfo);
+	EXPECT_STREQ(pInfo->m_pHelp, "c");
+
+	pConsole->DeregisterTempAll();
+	EXPECT_FALSE(pConsole->GetCommandInfo("temp_b", CFGFLAG_SERVER, true));
+	EXPECT_FALSE(pConsole->GetCommandInfo("temp_c", CFGFLAG_SERVER, true));
+	EXPECT_TRUE(pConsole->GetCommandInfo("exec", CFGFLAG_CLIENT, false));
+}
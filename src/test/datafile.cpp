@@ -1,7 +1,9 @@
 #include "test.h"
 #include <gtest/gtest.h>
 #include <memory>
+#include <vector>
 
+#include <engine/engine.h>
 #include <engine/shared/datafile.h>
 #include <engine/storage.h>
 #include <game/mapitems_ex.h>
@@ -58,3 +60,92 @@ TEST(Datafile, ExtendedType)
 		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
 	}
 }
+
+TEST(Datafile, LoadData)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	auto pEngine = std::unique_ptr<IEngine>(CreateTestEngine("test", 2));
+	CTestInfo Info;
+
+	std::vector<std::vector<int>> vvData;
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage.get(), Info.m_aFilename);
+		// random data that doesn't compress, so it is loaded in parallel
+		unsigned Seed = 1;
+		for(int i = 0; i < 16; i++)
+		{
+			vvData.emplace_back(16 * 1024 + i * 100);
+			for(int &Value : vvData.back())
+			{
+				Seed = Seed * 1103515245 + 12345;
+				Value = Seed >> 8;
+			}
+			Writer.AddData(vvData.back().size() * sizeof(int), vvData.back().data());
+		}
+		Writer.Finish();
+	}
+
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+		ASSERT_EQ(Reader.NumData(), 16);
+
+		// out of range and repeated indices are skipped
+		const int aIndices[] = {-1, 3, 0, 15, 3, 7, 16, 2, 9, 11, 12};
+		Reader.LoadData(aIndices, std::size(aIndices), pEngine.get());
+		for(int i = 0; i < 16; i++)
+		{
+			ASSERT_EQ(Reader.GetDataSize(i), (int)(vvData[i].size() * sizeof(int)));
+			EXPECT_EQ(mem_comp(Reader.GetData(i), vvData[i].data(), Reader.GetDataSize(i)), 0);
+		}
+	}
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Datafile, CorruptData)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	auto pEngine = std::unique_ptr<IEngine>(CreateTestEngine("test", 2));
+	CTestInfo Info;
+
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage.get(), Info.m_aFilename);
+		std::vector<int> vData(64 * 1024, 1234);
+		Writer.AddData(vData.size() * sizeof(int), vData.data());
+		Writer.Finish();
+	}
+
+	{
+		// the data is stored last, break the checksum at its end
+		void *pFile;
+		unsigned FileSize;
+		ASSERT_TRUE(pStorage->ReadFile(Info.m_aFilename, IStorage::TYPE_SAVE, &pFile, &FileSize));
+		((unsigned char *)pFile)[FileSize - 1] ^= 0xff;
+		IOHANDLE File = pStorage->OpenFile(Info.m_aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		ASSERT_TRUE(File);
+		io_write(File, pFile, FileSize);
+		io_close(File);
+		free(pFile);
+	}
+
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+		ASSERT_EQ(Reader.NumData(), 1);
+
+		const int aIndices[] = {0};
+		Reader.LoadData(aIndices, std::size(aIndices), pEngine.get());
+		EXPECT_EQ(Reader.GetData(0), nullptr);
+	}
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
@@ -78,3 +78,39 @@ TEST(Io, SyncWorks)
 	EXPECT_FALSE(io_close(File));
 	EXPECT_FALSE(fs_remove(Info.m_aFilename));
 }
+TEST(Io, Map)
+{
+	CTestInfo Info;
+	IOHANDLE File = io_open(Info.m_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	EXPECT_EQ(io_write(File, "abcdef", 6), 6);
+	EXPECT_FALSE(io_close(File));
+
+	File = io_open(Info.m_aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	unsigned Size;
+	void *pData = io_map(File, &Size);
+	EXPECT_FALSE(io_close(File));
+	ASSERT_TRUE(pData);
+	EXPECT_EQ(Size, 6u);
+	EXPECT_TRUE(mem_comp(pData, "abcdef", 6) == 0);
+	io_unmap(pData, Size);
+
+	EXPECT_FALSE(fs_remove(Info.m_aFilename));
+}
+TEST(Io, MapEmpty)
+{
+	CTestInfo Info;
+	IOHANDLE File = io_open(Info.m_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	EXPECT_FALSE(io_close(File));
+
+	File = io_open(Info.m_aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	unsigned Size;
+	EXPECT_FALSE(io_map(File, &Size));
+	EXPECT_EQ(Size, 0u);
+	EXPECT_FALSE(io_close(File));
+
+	EXPECT_FALSE(fs_remove(Info.m_aFilename));
+}
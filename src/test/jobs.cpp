@@ -6,6 +6,7 @@
 #include <engine/shared/jobs.h>
 
 #include <functional>
+#include <thread>
 
 static const int TEST_NUM_THREADS = 4;
 
@@ -19,9 +20,9 @@ protected:
 		m_Pool.Init(TEST_NUM_THREADS);
 	}
 
-	void Add(std::shared_ptr<IJob> pJob)
+	void Add(std::shared_ptr<IJob> pJob, int Priority = CJobPool::PRIORITY_INTERACTIVE)
 	{
-		m_Pool.Add(std::move(pJob));
+		m_Pool.Add(std::move(pJob), Priority);
 	}
 	void RunBlocking(IJob *pJob)
 	{
@@ -141,3 +142,129 @@ TEST_F(Jobs, Many)
 	}
 	new(&m_Pool) CJobPool();
 }
+
+TEST_F(Jobs, BackgroundDoesNotStarve)
+{
+	// background jobs that block all the workers they get
+	SEMAPHORE Blocked;
+	sphore_init(&Blocked);
+	std::vector<std::shared_ptr<IJob>> vpJobs;
+	for(int i = 0; i < TEST_NUM_THREADS; i++)
+	{
+		vpJobs.push_back(std::make_shared<CJob>([&] { sphore_wait(&Blocked); }));
+		Add(vpJobs.back(), CJobPool::PRIORITY_BACKGROUND);
+	}
+
+	SEMAPHORE Done;
+	sphore_init(&Done);
+	Add(std::make_shared<CJob>([&] { sphore_signal(&Done); }));
+	sphore_wait(&Done);
+	sphore_destroy(&Done);
+
+	// one of the background jobs is still waiting for a worker
+	int NumPending = 0;
+	for(auto &pJob : vpJobs)
+		NumPending += pJob->Status() == IJob::STATE_PENDING;
+	EXPECT_GE(NumPending, 1);
+
+	for(int i = 0; i < TEST_NUM_THREADS; i++)
+		sphore_signal(&Blocked);
+	for(auto &pJob : vpJobs)
+		while(pJob->Status() != IJob::STATE_DONE)
+			thread_yield();
+	sphore_destroy(&Blocked);
+}
+
+TEST_F(Jobs, AddFromJob)
+{
+	static const int NUM_JOBS = 100;
+	std::atomic<int> NumDone(0);
+	SEMAPHORE sphore;
+	sphore_init(&sphore);
+	// the jobs go to the queue of the worker and are stolen by the others
+	Add(std::make_shared<CJob>([&] {
+		for(int i = 0; i < NUM_JOBS; i++)
+		{
+			Add(std::make_shared<CJob>([&] {
+				if(NumDone.fetch_add(1) == NUM_JOBS - 1)
+					sphore_signal(&sphore);
+			}));
+		}
+	}));
+	sphore_wait(&sphore);
+	sphore_destroy(&sphore);
+	EXPECT_EQ(NumDone.load(), NUM_JOBS);
+}
+
+TEST_F(Jobs, ParallelFor)
+{
+	static const int NUM = 1000;
+	std::vector<std::atomic<int>> vCalls(NUM);
+	m_Pool.ParallelFor(NUM, [&](int i) { vCalls[i].fetch_add(1); });
+	for(int i = 0; i < NUM; i++)
+		EXPECT_EQ(vCalls[i].load(), 1);
+
+	m_Pool.ParallelFor(0, [](int i) { FAIL(); });
+}
+
+TEST_F(Jobs, ParallelForNested)
+{
+	std::atomic<int> NumCalls(0);
+	m_Pool.ParallelFor(TEST_NUM_THREADS, [&](int i) {
+		m_Pool.ParallelFor(100, [&](int j) { NumCalls.fetch_add(1); });
+	});
+	EXPECT_EQ(NumCalls.load(), TEST_NUM_THREADS * 100);
+}
+
+TEST_F(Jobs, ParallelForNoThreads)
+{
+	m_Pool.~CJobPool();
+	new(&m_Pool) CJobPool();
+	m_Pool.Init(0);
+	int NumCalls = 0;
+	m_Pool.ParallelFor(10, [&](int i) { NumCalls++; });
+	EXPECT_EQ(NumCalls, 10);
+}
+
+// many tiny jobs added by several threads at once, both to the shared
+// queue and from inside the workers
+static void RunContention(CJobPool *pPool, int NumProducers, int NumJobs, bool FromJobs)
+{
+	std::atomic<int> NumDone(0);
+	const int Total = NumProducers * NumJobs;
+	auto Produce = [&] {
+		for(int i = 0; i < NumJobs; i++)
+			pPool->Add(std::make_shared<CJob>([&] { NumDone.fetch_add(1); }));
+	};
+
+	const int64_t Start = time_get();
+	if(FromJobs)
+	{
+		for(int i = 0; i < NumProducers; i++)
+			pPool->Add(std::make_shared<CJob>(Produce));
+	}
+	else
+	{
+		std::vector<std::thread> vThreads;
+		for(int i = 0; i < NumProducers; i++)
+			vThreads.emplace_back(Produce);
+		for(auto &Thread : vThreads)
+			Thread.join();
+	}
+	while(NumDone.load() < Total)
+		thread_yield();
+	const int64_t Time = time_get() - Start;
+
+	EXPECT_EQ(NumDone.load(), Total);
+	dbg_msg("jobs", "%d producers, %d jobs %s: %.2fms, %.0f jobs/s", NumProducers, Total, FromJobs ? "from jobs" : "from threads", Time * 1000.0 / time_freq(), Total / (Time / (double)time_freq()));
+}
+
+TEST_F(Jobs, ContentionThreads)
+{
+	RunContention(&m_Pool, 4, 10000, false);
+}
+
+TEST_F(Jobs, ContentionJobs)
+{
+	RunContention(&m_Pool, 4, 10000, true);
+}
@@ -45,3 +45,61 @@ TEST(Net, Ipv4AndIpv6Work)
 	EXPECT_EQ(Addr, LocalhostV6);
 	EXPECT_EQ(mem_comp(pData, "def", 3), 0);
 }
+
+TEST(Net, SendQueue)
+{
+	NETADDR Bindaddr = {};
+	NETSOCKET Socket1;
+	NETSOCKET Socket2;
+
+	Bindaddr.type = NETTYPE_IPV4;
+	Socket2 = net_udp_create(Bindaddr);
+	do
+	{
+		Bindaddr.port = secure_rand() % 64511 + 1024;
+	} while(!(Socket1 = net_udp_create(Bindaddr)));
+
+	NETADDR Target;
+	ASSERT_FALSE(net_addr_from_str(&Target, "127.0.0.1"));
+	Target.port = Bindaddr.port;
+
+	static const int NUM_PACKETS = 200;
+	NETSTATS Before;
+	net_stats(&Before);
+	net_udp_set_send_queue(Socket2, 1);
+	for(int i = 0; i < NUM_PACKETS; i++)
+		EXPECT_EQ(net_udp_send(Socket2, &Target, &i, sizeof(i)), (int)sizeof(i));
+	NETSTATS Queued;
+	net_stats(&Queued);
+	net_udp_flush(Socket2);
+	NETSTATS After;
+	net_stats(&After);
+	EXPECT_EQ(After.sent_packets - Before.sent_packets, (uint64_t)NUM_PACKETS);
+	EXPECT_EQ(After.sent_bytes - Before.sent_bytes, (uint64_t)NUM_PACKETS * sizeof(int));
+#if defined(CONF_PLATFORM_LINUX)
+	// counted once they are sent, the queue holds less than all of them
+	EXPECT_LT(Queued.sent_packets - Before.sent_packets, (uint64_t)NUM_PACKETS);
+	EXPECT_EQ(After.sent_queued_packets - Before.sent_queued_packets, (uint64_t)NUM_PACKETS);
+	EXPECT_LT(After.sent_syscalls - Before.sent_syscalls, (uint64_t)NUM_PACKETS);
+#endif
+
+	// in order, as long as the receive buffer of the socket is big enough
+	NETADDR Addr;
+	unsigned char *pData;
+	for(int i = 0; i < NUM_PACKETS; i++)
+	{
+		int Bytes = net_udp_recv(Socket1, &Addr, &pData);
+		if(Bytes <= 0)
+		{
+			ASSERT_EQ(net_socket_read_wait(Socket1, 10000000), 1);
+			Bytes = net_udp_recv(Socket1, &Addr, &pData);
+		}
+		ASSERT_EQ(Bytes, (int)sizeof(i));
+		int Received;
+		mem_copy(&Received, pData, sizeof(Received));
+		EXPECT_EQ(Received, i);
+	}
+
+	net_udp_close(Socket1);
+	net_udp_close(Socket2);
+}
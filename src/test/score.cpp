@@ -513,6 +513,110 @@ TEST_P(RandomMap, UnfinishedDoesntExist)
 	EXPECT_STREQ(m_pRandomMapResult->m_aMessage, "You have no more unfinished maps on this server!");
 }
 
+struct RankCache : public Score
+{
+	RankCache()
+	{
+		g_Config.m_SvRankCache = 60;
+		str_copy(m_PlayerRequest.m_aMap, "Kobra 3", sizeof(m_PlayerRequest.m_aMap));
+		str_copy(m_PlayerRequest.m_aRequestingPlayer, "brainless tee", sizeof(m_PlayerRequest.m_aRequestingPlayer));
+		str_copy(m_PlayerRequest.m_aServer, "GER", sizeof(m_PlayerRequest.m_aServer));
+
+		// the ranks are loaded with some scores and have to add the others
+		InsertScores(0, 20);
+		EXPECT_TRUE(m_pRankCache->Update(m_pConn, "Kobra 3", "GER", g_Config.m_SvRankCache));
+		InsertScores(20, 40);
+	}
+
+	~RankCache()
+	{
+		g_Config.m_SvRankCache = 0;
+	}
+
+	void InsertScores(int From, int To)
+	{
+		static const char *s_apServers[] = {"GER", "USA", "GER2", "CHL"};
+		for(int i = From; i < To; i++)
+		{
+			str_copy(g_Config.m_SvSqlServerName, s_apServers[i % 4], sizeof(g_Config.m_SvSqlServerName));
+			CSqlScoreData ScoreData(std::make_shared<CScorePlayerResult>());
+			str_copy(ScoreData.m_aMap, "Kobra 3", sizeof(ScoreData.m_aMap));
+			str_copy(ScoreData.m_aGameUuid, "8d300ecf-5873-4297-bee5-95668fdff320", sizeof(ScoreData.m_aGameUuid));
+			str_format(ScoreData.m_aName, sizeof(ScoreData.m_aName), "player%d", i % 9);
+			ScoreData.m_Time = 100.0f + (i * 37 % 40) + i * 0.01f;
+			str_copy(ScoreData.m_aTimestamp, "2021-11-24 19:24:08", sizeof(ScoreData.m_aTimestamp));
+			for(float &TimeCp : ScoreData.m_aCurrentTimeCp)
+				TimeCp = 0;
+			ScoreData.m_pRankCache = m_pRankCache;
+			ASSERT_FALSE(CScoreWorker::SaveScore(m_pConn, &ScoreData, false, m_aError, sizeof(m_aError))) << m_aError;
+
+			CSqlTeamScoreData TeamScoreData;
+			str_copy(TeamScoreData.m_aMap, "Kobra 3", sizeof(TeamScoreData.m_aMap));
+			str_copy(TeamScoreData.m_aGameUuid, "8d300ecf-5873-4297-bee5-95668fdff320", sizeof(TeamScoreData.m_aGameUuid));
+			TeamScoreData.m_Size = 2 + i % 2;
+			for(unsigned int j = 0; j < TeamScoreData.m_Size; j++)
+				str_format(TeamScoreData.m_aaNames[j], sizeof(TeamScoreData.m_aaNames[j]), "player%d", (i + j * 3) % 7);
+			TeamScoreData.m_Time = 200.0f + (i * 53 % 60) + i * 0.01f;
+			str_copy(TeamScoreData.m_aTimestamp, "2021-11-24 19:24:08", sizeof(TeamScoreData.m_aTimestamp));
+			TeamScoreData.m_pRankCache = m_pRankCache;
+			ASSERT_FALSE(CScoreWorker::SaveTeamScore(m_pConn, &TeamScoreData, false, m_aError, sizeof(m_aError))) << m_aError;
+		}
+	}
+
+	// the request has to be answered the same with and without the cache
+	void ExpectSameLines(bool (*pFunc)(IDbConnection *, const ISqlData *, char *, int), const char *pName, int Offset)
+	{
+		std::shared_ptr<CScorePlayerResult> apResults[2];
+		for(int Cached = 0; Cached < 2; Cached++)
+		{
+			apResults[Cached] = std::make_shared<CScorePlayerResult>();
+			CSqlPlayerRequest Request(apResults[Cached]);
+			mem_copy(Request.m_aMap, m_PlayerRequest.m_aMap, sizeof(Request.m_aMap));
+			mem_copy(Request.m_aRequestingPlayer, m_PlayerRequest.m_aRequestingPlayer, sizeof(Request.m_aRequestingPlayer));
+			mem_copy(Request.m_aServer, m_PlayerRequest.m_aServer, sizeof(Request.m_aServer));
+			str_copy(Request.m_aName, pName, sizeof(Request.m_aName));
+			Request.m_Offset = Offset;
+			if(Cached)
+				Request.m_pRankCache = m_pRankCache;
+			ASSERT_FALSE(pFunc(m_pConn, &Request, m_aError, sizeof(m_aError))) << m_aError;
+		}
+		EXPECT_EQ(apResults[0]->m_MessageKind, apResults[1]->m_MessageKind);
+		for(int i = 0; i < CScorePlayerResult::MAX_MESSAGES; i++)
+			EXPECT_STREQ(apResults[0]->m_Data.m_aaMessages[i], apResults[1]->m_Data.m_aaMessages[i]) << pName << " " << Offset;
+	}
+
+	std::shared_ptr<CRankCache> m_pRankCache{std::make_shared<CRankCache>("Kobra 3", "GER")};
+};
+
+TEST_P(RankCache, Rank)
+{
+	for(int i = 0; i < 10; i++)
+	{
+		char aName[16];
+		str_format(aName, sizeof(aName), "player%d", i);
+		ExpectSameLines(CScoreWorker::ShowRank, aName, 0);
+		ExpectSameLines(CScoreWorker::ShowTeamRank, aName, 0);
+	}
+}
+
+TEST_P(RankCache, Top)
+{
+	for(int Offset : {0, 1, 3, 8, 20, -1, -4})
+	{
+		ExpectSameLines(CScoreWorker::ShowTop, "", Offset);
+		ExpectSameLines(CScoreWorker::ShowTeamTop5, "", Offset);
+	}
+}
+
+TEST_P(RankCache, OtherRegion)
+{
+	// answered by the database
+	str_copy(m_PlayerRequest.m_aServer, "USA", sizeof(m_PlayerRequest.m_aServer));
+	EXPECT_FALSE(m_pRankCache->Update(m_pConn, "Kobra 3", "USA", g_Config.m_SvRankCache));
+	ExpectSameLines(CScoreWorker::ShowRank, "player1", 0);
+	ExpectSameLines(CScoreWorker::ShowTop, "", 0);
+}
+
 auto g_pSqliteConn = CreateSqliteConnection(":memory:", true);
 #if defined(CONF_TEST_MYSQL)
 auto g_pMysqlConn = CreateMysqlConnection("ddnet", "record", "ddnet", "thebestpassword", "localhost", "", 3306, true);
@@ -544,3 +648,4 @@ INSTANTIATE(MapInfo);
 INSTANTIATE(MapVote);
 INSTANTIATE(Points);
 INSTANTIATE(RandomMap);
+INSTANTIATE(RankCache);
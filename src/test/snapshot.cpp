@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/snapshot.h>
+
+static int BuildSnapshot(CSnapshotBuilder *pBuilder, void *pData, int NumItems, int Offset)
+{
+	pBuilder->Init();
+	for(int i = 0; i < NumItems; i++)
+	{
+		const int ID = i + Offset;
+		int *pItem = (int *)pBuilder->NewItem(1 + ID % 3, ID, sizeof(int) * 4);
+		for(int j = 0; j < 4; j++)
+			pItem[j] = i * j + Offset;
+	}
+	return pBuilder->Finish(pData);
+}
+
+TEST(SnapshotItemHash, GetItemIndex)
+{
+	static CSnapshotBuilder s_Builder;
+	static char s_aData[CSnapshot::MAX_SIZE];
+	BuildSnapshot(&s_Builder, s_aData, 500, 0);
+	CSnapshot *pSnap = (CSnapshot *)s_aData;
+
+	alignas(CSnapshotItemHash) static char s_aHash[CSnapshotItemHash::TotalSize(500)];
+	CSnapshotItemHash *pHash = (CSnapshotItemHash *)s_aHash;
+	pHash->Generate(pSnap);
+	for(int i = 0; i < pSnap->NumItems(); i++)
+		EXPECT_EQ(pHash->GetItemIndex(pSnap->GetItem(i)->Key()), i);
+	EXPECT_EQ(pHash->GetItemIndex((1 << 16) | 1), -1);
+	EXPECT_EQ(pHash->GetItemIndex((1 << 16) | 500), -1);
+	EXPECT_EQ(pHash->GetItemIndex((7 << 16) | 0), -1);
+}
+
+TEST(SnapshotItemHash, Empty)
+{
+	CSnapshot Empty;
+	Empty.Clear();
+	alignas(CSnapshotItemHash) char aHash[CSnapshotItemHash::TotalSize(0)];
+	CSnapshotItemHash *pHash = (CSnapshotItemHash *)aHash;
+	pHash->Generate(&Empty);
+	EXPECT_EQ(pHash->GetItemIndex(0), -1);
+}
+
+TEST(SnapshotDelta, Roundtrip)
+{
+	static CSnapshotBuilder s_Builder;
+	static char s_aFrom[CSnapshot::MAX_SIZE];
+	static char s_aTo[CSnapshot::MAX_SIZE];
+	static char s_aDelta[CSnapshot::MAX_SIZE];
+	static char s_aCachedDelta[CSnapshot::MAX_SIZE];
+	static char s_aUnpacked[CSnapshot::MAX_SIZE];
+
+	// some items stay, some change, some go and some come
+	const int FromSize = BuildSnapshot(&s_Builder, s_aFrom, 300, 0);
+	const int ToSize = BuildSnapshot(&s_Builder, s_aTo, 300, 100);
+	CSnapshot *pFrom = (CSnapshot *)s_aFrom;
+	CSnapshot *pTo = (CSnapshot *)s_aTo;
+
+	CSnapshotDelta Delta;
+	const int DeltaSize = Delta.CreateDelta(pFrom, pTo, s_aDelta);
+	ASSERT_GT(DeltaSize, 0);
+
+	// with the hashes the storage keeps the delta must be the same
+	CSnapshotStorage Storage;
+	Storage.Add(0, 0, FromSize, s_aFrom, 0, nullptr);
+	Storage.Add(1, 0, ToSize, s_aTo, 0, nullptr);
+	const CSnapshotItemHash *pFromHash;
+	const CSnapshotItemHash *pToHash;
+	ASSERT_EQ(Storage.Get(0, nullptr, nullptr, nullptr, &pFromHash), FromSize);
+	ASSERT_EQ(Storage.Get(1, nullptr, nullptr, nullptr, &pToHash), ToSize);
+	ASSERT_EQ(Delta.CreateDelta(pFrom, pTo, s_aCachedDelta, pFromHash, pToHash), DeltaSize);
+	EXPECT_EQ(mem_comp(s_aDelta, s_aCachedDelta, DeltaSize), 0);
+
+	ASSERT_EQ(Delta.UnpackDelta(pFrom, (CSnapshot *)s_aUnpacked, s_aDelta, DeltaSize), ToSize);
+	EXPECT_EQ(mem_comp(s_aUnpacked, s_aTo, ToSize), 0);
+	ASSERT_EQ(Delta.UnpackDelta(pFrom, (CSnapshot *)s_aUnpacked, s_aDelta, DeltaSize, pFromHash), ToSize);
+	EXPECT_EQ(mem_comp(s_aUnpacked, s_aTo, ToSize), 0);
+}
+
+TEST(SnapshotDelta, DataRate)
+{
+	static CSnapshotBuilder s_Builder;
+	static char s_aFrom[CSnapshot::MAX_SIZE];
+	static char s_aTo[CSnapshot::MAX_SIZE];
+	static char s_aDelta[CSnapshot::MAX_SIZE];
+	static char s_aUnpacked[CSnapshot::MAX_SIZE];
+
+	// diffs of 0, 1, 64, 8192 and -2^31 take 1 bit, 1, 2, 3 and 5 bytes
+	const int aDiffs[] = {0, 1, 64, 8192, -2147483647 - 1};
+	s_Builder.Init();
+	mem_zero(s_Builder.NewItem(1, 0, sizeof(aDiffs)), sizeof(aDiffs));
+	s_Builder.Finish(s_aFrom);
+	s_Builder.Init();
+	mem_copy(s_Builder.NewItem(1, 0, sizeof(aDiffs)), aDiffs, sizeof(aDiffs));
+	s_Builder.Finish(s_aTo);
+
+	CSnapshotDelta Delta;
+	const int DeltaSize = Delta.CreateDelta((CSnapshot *)s_aFrom, (CSnapshot *)s_aTo, s_aDelta);
+	ASSERT_GT(Delta.UnpackDelta((CSnapshot *)s_aFrom, (CSnapshot *)s_aUnpacked, s_aDelta, DeltaSize), 0);
+	EXPECT_EQ(Delta.GetDataRate(1), 1 + (1 + 2 + 3 + 5) * 8);
+	EXPECT_EQ(Delta.GetDataUpdates(1), 1);
+}
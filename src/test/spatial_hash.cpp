@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <base/tl/small_vector.h>
+#include <game/spatial_hash.h>
+
+#include <random>
+#include <vector>
+
+struct CTestEntity
+{
+	CSpatialHash<CTestEntity>::CNode m_Node;
+	vec2 m_Pos;
+	float m_Radius;
+	bool m_Inserted = false;
+};
+
+TEST(SpatialHash, MatchesList)
+{
+	std::mt19937 Rng(1);
+	std::uniform_real_distribution<float> Coord(-2000.0f, 6000.0f);
+	std::uniform_real_distribution<float> Radius(0.0f, 40.0f);
+
+	std::vector<CTestEntity> vEntities(300);
+	// reference of the entity list, front first
+	std::vector<CTestEntity *> vpList;
+	CSpatialHash<CTestEntity> Hash;
+	std::vector<CTestEntity *> vpResult;
+	CSmallVector<CTestEntity *, 8> vpSmallResult;
+	for(int Round = 0; Round < 50; Round++)
+	{
+		for(auto &Entity : vEntities)
+		{
+			if(!Entity.m_Inserted && Rng() % 4 == 0)
+			{
+				Entity.m_Pos = vec2(Coord(Rng), Coord(Rng));
+				Entity.m_Radius = Radius(Rng);
+				const bool Back = Rng() % 2;
+				Hash.Insert(&Entity.m_Node, &Entity, Entity.m_Pos, Entity.m_Radius, Back);
+				vpList.insert(Back ? vpList.end() : vpList.begin(), &Entity);
+				Entity.m_Inserted = true;
+			}
+			else if(Entity.m_Inserted && Rng() % 8 == 0)
+			{
+				Hash.Remove(&Entity.m_Node);
+				vpList.erase(std::find(vpList.begin(), vpList.end(), &Entity));
+				Entity.m_Inserted = false;
+			}
+			else if(Entity.m_Inserted)
+			{
+				Entity.m_Pos += vec2(Rng() % 201 - 100.0f, Rng() % 201 - 100.0f);
+				Hash.Move(&Entity.m_Node, Entity.m_Pos);
+			}
+		}
+
+		for(int i = 0; i < 20; i++)
+		{
+			const vec2 Pos = vec2(Coord(Rng), Coord(Rng));
+			const float QueryRadius = Rng() % 300;
+			const vec2 Min = Pos - vec2(QueryRadius, QueryRadius);
+			const vec2 Max = Pos + vec2(QueryRadius, QueryRadius);
+			ASSERT_TRUE(Hash.Query(Min, Max, vpResult));
+
+			// everything touching the box, in list order
+			std::vector<CTestEntity *> vpExpected;
+			for(CTestEntity *pEntity : vpList)
+			{
+				const vec2 Closest = vec2(clamp(pEntity->m_Pos.x, Min.x, Max.x), clamp(pEntity->m_Pos.y, Min.y, Max.y));
+				if(distance(Closest, pEntity->m_Pos) <= pEntity->m_Radius)
+					vpExpected.push_back(pEntity);
+			}
+			std::vector<CTestEntity *> vpFound;
+			for(CTestEntity *pEntity : vpResult)
+			{
+				if(std::find(vpExpected.begin(), vpExpected.end(), pEntity) != vpExpected.end())
+					vpFound.push_back(pEntity);
+			}
+			EXPECT_EQ(vpFound, vpExpected);
+
+			// the result has no duplicates and keeps list order
+			int Last = -1;
+			for(CTestEntity *pEntity : vpResult)
+			{
+				const int Index = std::find(vpList.begin(), vpList.end(), pEntity) - vpList.begin();
+				ASSERT_LT(Index, (int)vpList.size());
+				EXPECT_GT(Index, Last);
+				Last = Index;
+			}
+
+			// the same into a small vector, also when it spills to the heap
+			ASSERT_TRUE(Hash.Query(Min, Max, vpSmallResult));
+			EXPECT_EQ(std::vector<CTestEntity *>(vpSmallResult.begin(), vpSmallResult.end()), vpResult);
+		}
+	}
+}
+
+TEST(SpatialHash, LargeQuery)
+{
+	CSpatialHash<CTestEntity> Hash;
+	std::vector<CTestEntity *> vpResult;
+	EXPECT_FALSE(Hash.Query(vec2(0, 0), vec2(100000, 100), vpResult));
+	EXPECT_FALSE(Hash.Query(vec2(0, 0), vec2(2000, 2000), vpResult));
+	EXPECT_FALSE(Hash.Query(vec2(0, 0), vec2(NAN, 0), vpResult));
+	EXPECT_TRUE(Hash.Query(vec2(0, 0), vec2(500, 500), vpResult));
+	EXPECT_TRUE(vpResult.empty());
+}
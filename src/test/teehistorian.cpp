@@ -1,3 +1,4 @@
+#include "test.h"
 #include <gtest/gtest.h>
 
 #include <base/detect.h>
@@ -6,6 +7,8 @@
 #include <game/gamecore.h>
 #include <game/server/teehistorian.h>
 
+#include <vector>
+
 void RegisterGameUuids(CUuidManager *pManager);
 
 class TeeHistorian : public ::testing::Test
@@ -166,7 +169,7 @@ protected:
 		ASSERT_TRUE(mem_comp(m_Buffer.Data(), pOutput, OutputSize) == 0);
 	}
 
-	void Tick(int Tick)
+	void EndTick()
 	{
 		if(m_State == STATE_PLAYERS)
 		{
@@ -177,6 +180,11 @@ protected:
 			m_TH.EndInputs();
 			m_TH.EndTick();
 		}
+		m_State = STATE_NONE;
+	}
+	void Tick(int Tick)
+	{
+		EndTick();
 		m_TH.BeginTick(Tick);
 		m_TH.BeginPlayers();
 		m_State = STATE_PLAYERS;
@@ -189,15 +197,7 @@ protected:
 	}
 	void Finish()
 	{
-		if(m_State == STATE_PLAYERS)
-		{
-			Inputs();
-		}
-		if(m_State == STATE_INPUTS)
-		{
-			m_TH.EndInputs();
-			m_TH.EndTick();
-		}
+		EndTick();
 		m_TH.Finish();
 	}
 	void DeadPlayer(int ClientID)
@@ -757,3 +757,224 @@ TEST_F(TeeHistorian, PlayerReadyMultiple)
 	Finish();
 	Expect(EXPECTED, sizeof(EXPECTED));
 }
+
+TEST_F(TeeHistorian, Reader)
+{
+	CNetObj_CharacterCore Char;
+	mem_zero(&Char, sizeof(Char));
+	CNetObj_PlayerInput Input = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+
+	Tick(1);
+	m_TH.RecordPlayerJoin(3, CTeeHistorian::PROTOCOL_7);
+	Tick(2);
+	Char.m_X = 100;
+	Char.m_Y = 200;
+	m_TH.RecordPlayer(3, &Char);
+	Inputs();
+	m_TH.RecordPlayerReady(3);
+	m_TH.RecordPlayerInput(3, 1, &Input);
+	const CNetObj_PlayerInput FirstInput = Input;
+	Tick(3);
+	Char.m_X = 110;
+	m_TH.RecordPlayer(3, &Char);
+	Inputs();
+	Input.m_Direction = -1;
+	m_TH.RecordPlayerInput(3, 1, &Input);
+	m_TH.RecordPlayerMessage(3, "msg", 3);
+	Tick(4);
+	// implicit tick
+	Char.m_Y = 190;
+	m_TH.RecordPlayer(3, &Char);
+	Tick(9);
+	m_TH.RecordDeadPlayer(3);
+	Inputs();
+	m_TH.RecordTestExtra();
+	m_TH.RecordPlayerDrop(3, "reason");
+	Finish();
+
+	CTeeHistorianReader Reader;
+	ASSERT_TRUE(Reader.Open(m_Buffer.Data(), m_Buffer.Size()));
+	EXPECT_TRUE(str_startswith(Reader.Header(), "{\"comment\":\"teehistorian@ddnet.tw\""));
+
+	CTeeHistorianReader::CItem Item;
+	auto Next = [&](int Type, int Tick, int ClientID) {
+		ASSERT_TRUE(Reader.Read(&Item));
+		EXPECT_EQ(Item.m_Type, Type);
+		EXPECT_EQ(Item.m_Tick, Tick);
+		EXPECT_EQ(Item.m_ClientID, ClientID);
+	};
+
+	Next(CTeeHistorianReader::ITEM_TICK, 1, -1);
+	Next(CTeeHistorianReader::ITEM_EX, 1, -1);
+	Next(CTeeHistorianReader::ITEM_JOIN, 1, 3);
+	EXPECT_EQ(Item.m_Protocol, CTeeHistorian::PROTOCOL_7);
+	Next(CTeeHistorianReader::ITEM_TICK, 2, -1);
+	Next(CTeeHistorianReader::ITEM_PLAYER, 2, 3);
+	EXPECT_EQ(Item.m_X, 100);
+	EXPECT_EQ(Item.m_Y, 200);
+	Next(CTeeHistorianReader::ITEM_PLAYER_READY, 2, 3);
+	Next(CTeeHistorianReader::ITEM_INPUT, 2, 3);
+	EXPECT_EQ(mem_comp(&Item.m_Input, &FirstInput, sizeof(FirstInput)), 0);
+	Next(CTeeHistorianReader::ITEM_TICK, 3, -1);
+	Next(CTeeHistorianReader::ITEM_PLAYER, 3, 3);
+	EXPECT_EQ(Item.m_X, 110);
+	EXPECT_EQ(Item.m_Y, 200);
+	Next(CTeeHistorianReader::ITEM_INPUT, 3, 3);
+	EXPECT_EQ(mem_comp(&Item.m_Input, &Input, sizeof(Input)), 0);
+	Next(CTeeHistorianReader::ITEM_MESSAGE, 3, 3);
+	ASSERT_EQ(Item.m_DataSize, 3);
+	EXPECT_EQ(mem_comp(Item.m_pData, "msg", 3), 0);
+	Next(CTeeHistorianReader::ITEM_TICK, 4, -1);
+	Next(CTeeHistorianReader::ITEM_PLAYER, 4, 3);
+	EXPECT_EQ(Item.m_X, 110);
+	EXPECT_EQ(Item.m_Y, 190);
+	Next(CTeeHistorianReader::ITEM_TICK, 9, -1);
+	Next(CTeeHistorianReader::ITEM_PLAYER_DEAD, 9, 3);
+	Next(CTeeHistorianReader::ITEM_EX, 9, -1);
+	Next(CTeeHistorianReader::ITEM_DROP, 9, 3);
+	EXPECT_STREQ(Item.m_pString, "reason");
+	Next(CTeeHistorianReader::ITEM_FINISH, 9, -1);
+	EXPECT_FALSE(Reader.Read(&Item));
+	EXPECT_FALSE(Reader.Error());
+}
+
+TEST_F(TeeHistorian, Compressed)
+{
+	std::vector<unsigned char> vData;
+	m_TH.Reset(
+		&m_GameInfo, [](const void *pData, int DataSize, void *pUser) {
+			std::vector<unsigned char> *pvData = (std::vector<unsigned char> *)pUser;
+			pvData->insert(pvData->end(), (const unsigned char *)pData, (const unsigned char *)pData + DataSize);
+		},
+		&vData);
+
+	CTestInfo Info;
+	CTeeHistorianCompressor Compressor;
+	IOHANDLE File = io_open(Info.m_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	ASYNCIO *pAio = aio_new_ex(File, CTeeHistorianCompressor::Write, &Compressor);
+	ASSERT_TRUE(pAio);
+	size_t Queued = 0;
+
+	for(int t = 1; t <= 1000; t++)
+	{
+		EndTick();
+		if(t % 7 == 0)
+		{
+			std::vector<unsigned char> vState;
+			m_TH.PackState(vState);
+			Compressor.BeginBlock(vData.size(), t - 1, std::move(vState));
+		}
+		// queue the data in pieces that don't line up with the blocks
+		if(t % 3 == 0)
+		{
+			aio_write(pAio, vData.data() + Queued, vData.size() - Queued);
+			Queued = vData.size();
+		}
+
+		Tick(t);
+		// nobody is there for a while
+		if(t > 300 && t < 400)
+			continue;
+		for(int i = 0; i < 4; i++)
+		{
+			if((t + i * 50) % 200 < 20)
+				DeadPlayer(i);
+			else
+				Player(i, t * (i + 1), 100 * i + t % 13);
+		}
+		Inputs();
+		for(int i = 0; i < 4; i++)
+		{
+			CNetObj_PlayerInput Input;
+			mem_zero(&Input, sizeof(Input));
+			Input.m_Direction = (t / 5 + i) % 3 - 1;
+			Input.m_TargetX = t / 3;
+			m_TH.RecordPlayerInput(i, i + 1, &Input);
+		}
+		if(t % 50 == 0)
+			m_TH.RecordPlayerMessage(t / 50 % 4, "msg", 3);
+	}
+	Finish();
+	aio_write(pAio, vData.data() + Queued, vData.size() - Queued);
+	aio_close(pAio);
+	aio_wait(pAio);
+	ASSERT_EQ(aio_error(pAio), 0);
+	aio_free(pAio);
+
+	File = io_open(Info.m_aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	void *pCompressed;
+	unsigned CompressedSize;
+	io_read_all(File, &pCompressed, &CompressedSize);
+	io_close(File);
+	EXPECT_LT(CompressedSize, vData.size());
+
+	// returns the number of items read
+	auto ExpectSame = [](CTeeHistorianReader &Expected, CTeeHistorianReader &Reader, int MaxItems) {
+		CTeeHistorianReader::CItem ExpectedItem, Item;
+		int NumItems = 0;
+		for(; NumItems < MaxItems; NumItems++)
+		{
+			if(!Reader.Read(&Item))
+				break;
+			EXPECT_TRUE(Expected.Read(&ExpectedItem));
+			EXPECT_EQ(Item.m_Type, ExpectedItem.m_Type);
+			EXPECT_EQ(Item.m_Tick, ExpectedItem.m_Tick);
+			EXPECT_EQ(Item.m_ClientID, ExpectedItem.m_ClientID);
+			if(Item.m_Type == CTeeHistorianReader::ITEM_PLAYER)
+			{
+				EXPECT_EQ(Item.m_X, ExpectedItem.m_X);
+				EXPECT_EQ(Item.m_Y, ExpectedItem.m_Y);
+			}
+			else if(Item.m_Type == CTeeHistorianReader::ITEM_INPUT)
+			{
+				EXPECT_EQ(mem_comp(&Item.m_Input, &ExpectedItem.m_Input, sizeof(Item.m_Input)), 0);
+			}
+		}
+		EXPECT_FALSE(Reader.Error());
+		return NumItems;
+	};
+
+	CTeeHistorianReader Expected;
+	CTeeHistorianReader Reader;
+	ASSERT_TRUE(Expected.Open(vData.data(), vData.size()));
+	ASSERT_TRUE(Reader.Open(pCompressed, CompressedSize));
+	EXPECT_FALSE(Expected.Compressed());
+	EXPECT_TRUE(Reader.Compressed());
+	EXPECT_STREQ(Reader.Header(), Expected.Header());
+	const int NumItems = ExpectSame(Expected, Reader, 1000000);
+	CTeeHistorianReader::CItem Item;
+	EXPECT_FALSE(Expected.Read(&Item));
+
+	for(int Tick : {0, 1, 7, 8, 123, 350, 398, 999, 1000})
+	{
+		ASSERT_TRUE(Expected.Seek(Tick));
+		ASSERT_TRUE(Reader.Seek(Tick));
+		ExpectSame(Expected, Reader, 200);
+	}
+	EXPECT_FALSE(Reader.Seek(1001));
+
+	// without the indices at the end, like after a crash
+	ASSERT_TRUE(Expected.Open(vData.data(), vData.size()));
+	ASSERT_TRUE(Reader.Open(pCompressed, CompressedSize - 1000));
+	const int NumTruncatedItems = ExpectSame(Expected, Reader, 1000000);
+	EXPECT_GT(NumTruncatedItems, 0);
+	EXPECT_LT(NumTruncatedItems, NumItems);
+
+	// a last index whose entry count wraps around to its size, the blocks
+	// are found by scanning the file instead
+	unsigned char *pTrailer = (unsigned char *)pCompressed + CompressedSize - 8 - sizeof(CUuid);
+	int64_t IndexOffset = 0;
+	for(int i = 0; i < 8; i++)
+		IndexOffset = (IndexOffset << 8) | pTrailer[i];
+	ASSERT_LT(IndexOffset, (int64_t)CompressedSize);
+	uint_to_bytes_be((unsigned char *)pCompressed + IndexOffset + 4, 0x15555556);
+	uint_to_bytes_be((unsigned char *)pCompressed + IndexOffset + 8, 8);
+	ASSERT_TRUE(Expected.Open(vData.data(), vData.size()));
+	ASSERT_TRUE(Reader.Open(pCompressed, CompressedSize));
+	EXPECT_EQ(ExpectSame(Expected, Reader, 1000000), NumItems);
+
+	free(pCompressed);
+	fs_remove(Info.m_aFilename);
+}